@@ -177,7 +177,8 @@ void audio_convert_init_simd(void)
 #endif
 }
 
-#ifdef HAVE_RSOUND
+// retroarch-transcode links this for the sample conversions only, without any drivers.
+#if defined(HAVE_RSOUND) && !defined(IS_TRANSCODE)
 
 bool rarch_rsound_start(const char *ip)
 {
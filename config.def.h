@@ -282,15 +282,33 @@ static const float message_pos_offset_y = 0.05;
 // Color of the message.
 static const uint32_t message_color = 0xffff00; // RGB hex value.
 
+// Number of threads used to render CPU filters.
+// Only used if the filter implements filter_render_slice(), otherwise filters render on the main thread.
+static const unsigned video_filter_threads = 1;
+
+// Number of threads used by the XVideo driver to convert frames to YUV.
+static const unsigned video_xvideo_threads = 1;
+
 // Record post-filtered (CPU filter) video rather than raw game output.
 static const bool post_filter_record = false;
 
 // Screenshots post-shaded GPU output if available.
 static const bool gpu_screenshot = true;
 
+// Number of threads used to encode screenshots.
+// Screenshots are always encoded off the main thread if threads are available.
+static const unsigned video_screenshot_threads = 1;
+
+// Takes a screenshot every N frames (time-lapse). 0 disables.
+static const unsigned video_screenshot_interval = 0;
+
 // Record post-shaded GPU output instead of raw game footage if available.
 static const bool gpu_record = false;
 
+// Number of frames GPU recording reads back asynchronously before a frame is consumed.
+// Deeper rings avoid stalling on the GPU, at the cost of memory.
+static const unsigned gpu_record_depth = 4;
+
 // OSD-messages
 static const bool font_enable = true;
 
@@ -372,6 +390,10 @@ static const unsigned autosave_interval = 0;
 // When being client over netplay, use keybinds for player 1 rather than player 2.
 static const bool netplay_client_swap_input = true;
 
+// Netplay delays input by up to this many frames, as needed to hide network latency.
+// Higher values mean fewer rollbacks on slow connections, at the cost of input lag. 0 disables input delay.
+static const unsigned netplay_max_input_delay = 4;
+
 // On save state load, block SRAM from being overwritten.
 // This could potentially lead to buggy games.
 static const bool block_sram_overwrite = false;
@@ -26,6 +26,7 @@
 #include "gfx/thread_wrapper.h"
 #include "audio/thread_wrapper.h"
 #include "gfx/gfx_common.h"
+#include "gfx/scaler/pixconv.h"
 
 #ifdef HAVE_X11
 #include "gfx/context/x11_common.h"
@@ -728,6 +729,12 @@ static void deinit_filter(void)
 {
    g_extern.filter.active = false;
 
+#ifdef HAVE_THREADS
+   if (g_extern.filter.threads)
+      filter_threads_free(g_extern.filter.threads);
+   g_extern.filter.threads = NULL;
+#endif
+
    if (g_extern.filter.lib)
       dylib_close(g_extern.filter.lib);
    g_extern.filter.lib = NULL;
@@ -784,6 +791,23 @@ static void init_filter(bool rgb32)
       goto error;
    }
 
+   // Optional, lets us split rendering across threads.
+   g_extern.filter.prender_slice =
+      (filter_render_slice_t)dylib_proc(g_extern.filter.lib, "filter_render_slice");
+
+#ifdef HAVE_THREADS
+   if (g_extern.filter.prender_slice && g_settings.video.filter_threads > 1)
+   {
+      g_extern.filter.threads = filter_threads_new(g_extern.filter.prender_slice,
+            g_settings.video.filter_threads);
+
+      if (g_extern.filter.threads)
+         RARCH_LOG("CPU filter renders with %u threads.\n", g_settings.video.filter_threads);
+      else
+         RARCH_WARN("Failed to create CPU filter threads. Rendering on main thread.\n");
+   }
+#endif
+
    g_extern.filter.active = true;
    g_extern.filter.psize(&width, &height);
 
@@ -894,8 +918,17 @@ static bool init_video_pixel_converter(unsigned size)
    return true;
 }
 
+static void init_pixel_converter_simd(void)
+{
+   struct rarch_cpu_features cpu;
+   rarch_get_cpu_features(&cpu);
+   RARCH_LOG("Pixel converter [%s]\n", conv_init_simd(cpu.simd));
+}
+
 void init_video_input(void)
 {
+   init_pixel_converter_simd();
+
 #ifdef HAVE_DYLIB
    init_filter(g_extern.system.pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888);
 #endif
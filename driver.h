@@ -367,6 +367,18 @@ typedef struct video_poke_interface
 
    void (*show_mouse)(void *data, bool state);
    void (*grab_mouse_toggle)(void *data);
+
+   // Optional. Returns a buffer the frontend can convert a width x height frame into,
+   // in the pixel format (*fmt) and line pitch (*pitch) the driver uploads from.
+   // Passing this buffer to frame() skips the driver's own conversion and copy. Returns NULL if unavailable.
+   void *(*get_upload_buffer)(void *data, unsigned width, unsigned height, unsigned *pitch, enum scaler_pix_fmt *fmt);
+
+   // Optional. Maps the oldest frame in the driver's asynchronous readback ring, so the viewport can be consumed without extra copies.
+   // The frame is bottom-up ARGB8888 with *pitch bytes per line and stays valid until unmap_viewport() is called.
+   // Returns NULL if no frame has been read back yet, or if asynchronous readback isn't active.
+   // If the driver only reads back on demand, returning NULL starts a readback of the next frames, so call again later.
+   const void *(*map_viewport)(void *data, unsigned *pitch);
+   void (*unmap_viewport)(void *data);
 } video_poke_interface_t;
 
 typedef struct video_driver
@@ -380,6 +392,8 @@ typedef struct video_driver
    bool (*alive)(void *data);
    bool (*focus)(void *data); // Does the window have focus?
    bool (*set_shader)(void *data, enum rarch_shader_type type, const char *path); // Sets shader. Might not be implemented. Will be moved to poke_interface later.
+   // Drivers might only queue the shader and build it in the background, in which case true means it was queued.
+   // If it fails to build later, the driver reports it and falls back to the stock shader.
    void (*free)(void *data);
    const char *ident;
 
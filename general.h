@@ -23,6 +23,7 @@
 #include <setjmp.h>
 #include "driver.h"
 #include "record/ffemu.h"
+#include "record/rawcap.h"
 #include "message.h"
 #include "rewind.h"
 #include "movie.h"
@@ -30,6 +31,7 @@
 #include "dynamic.h"
 #include "cheats.h"
 #include "audio/ext/rarch_dsp.h"
+#include "gfx/filter_threads.h"
 #include "compat/strl.h"
 #include "performance.h"
 #include "core_options.h"
@@ -174,10 +176,14 @@ struct settings
       bool shader_enable;
 
       char filter_path[PATH_MAX];
+      unsigned filter_threads;
+      unsigned xvideo_threads;
       float refresh_rate;
       bool threaded;
 
       char shader_dir[PATH_MAX];
+      char shader_cache_dir[PATH_MAX];
+      char image_cache_dir[PATH_MAX];
 
       char font_path[PATH_MAX];
       float font_size;
@@ -193,7 +199,10 @@ struct settings
 
       bool post_filter_record;
       bool gpu_record;
+      unsigned gpu_record_depth;
       bool gpu_screenshot;
+      unsigned screenshot_threads;
+      unsigned screenshot_interval;
 
       bool allow_rotate;
    } video;
@@ -240,6 +249,7 @@ struct settings
       unsigned icade_count;
 #endif
       bool netplay_client_swap_input;
+      unsigned netplay_max_input_delay;
 
       unsigned turbo_period;
       unsigned turbo_duty_cycle;
@@ -466,6 +476,10 @@ struct global
       void (*psize)(unsigned *width, unsigned *height);
       void (*prender)(uint32_t *colormap, uint32_t *output, unsigned outpitch,
             const uint16_t *input, unsigned pitch, unsigned width, unsigned height);
+      filter_render_slice_t prender_slice;
+#ifdef HAVE_THREADS
+      filter_threads_t *threads;
+#endif
 
       // CPU filters only work on *XRGB1555*. We have to convert to XRGB1555 first.
       struct scaler_ctx scaler;
@@ -495,6 +509,11 @@ struct global
       bool movie_start_recording;
       bool movie_start_playback;
       bool movie_end;
+
+      // Headless rendering of the played back movie to the recording.
+      bool movie_render;
+      rarch_time_t movie_render_start;
+      unsigned movie_render_frames;
    } bsv;
 #endif
 
@@ -524,12 +543,15 @@ struct global
    bool netplay_is_spectate;
    unsigned netplay_sync_frames;
    uint16_t netplay_port;
+   uint16_t netplay_relay_port;
+   unsigned netplay_players;
    char netplay_nick[32];
 #endif
 
    // FFmpeg record.
 #ifdef HAVE_FFMPEG
    ffemu_t *rec;
+   rawcap_t *rec_raw; // Set instead of rec when recording a lossless raw capture.
    char record_path[PATH_MAX];
    char record_config[PATH_MAX];
    bool recording;
@@ -537,6 +559,7 @@ struct global
    unsigned record_height;
 
    uint8_t *record_gpu_buffer;
+   bool record_gpu_mapped; // Frames are recorded straight out of video_poke->map_viewport().
    size_t record_gpu_width;
    size_t record_gpu_height;
 #endif
@@ -0,0 +1,242 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filter_threads.h"
+#include "../thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct slice
+{
+   struct slice_threads *owner;
+   sthread_t *thread;
+
+   // Guards go and first_line/last_line.
+   slock_t *lock;
+   scond_t *cond;
+   bool go;
+
+   unsigned first_line;
+   unsigned last_line;
+};
+
+struct slice_threads
+{
+   struct slice *slices;
+   unsigned num_slices;
+
+   // Work currently being done. Only written while all workers are idle.
+   slice_func_t func;
+   void *data;
+
+   volatile bool quit;
+
+   slock_t *done_lock;
+   scond_t *done_cond;
+   unsigned done;
+};
+
+static void slice_thread(void *data)
+{
+   struct slice *slice = (struct slice*)data;
+   struct slice_threads *threads = slice->owner;
+
+   for (;;)
+   {
+      slock_lock(slice->lock);
+      while (!slice->go)
+         scond_wait(slice->cond, slice->lock);
+      slice->go = false;
+      slock_unlock(slice->lock);
+
+      if (threads->quit)
+         break;
+
+      threads->func(threads->data, slice->first_line, slice->last_line);
+
+      slock_lock(threads->done_lock);
+      threads->done++;
+      scond_signal(threads->done_cond);
+      slock_unlock(threads->done_lock);
+   }
+}
+
+static void slice_kick(struct slice *slice, unsigned first_line, unsigned last_line)
+{
+   slock_lock(slice->lock);
+   slice->first_line = first_line;
+   slice->last_line  = last_line;
+   slice->go         = true;
+   scond_signal(slice->cond);
+   slock_unlock(slice->lock);
+}
+
+slice_threads_t *slice_threads_new(unsigned num_threads)
+{
+   if (num_threads < 1)
+      return NULL;
+
+   slice_threads_t *threads = (slice_threads_t*)calloc(1, sizeof(*threads));
+   if (!threads)
+      return NULL;
+
+   threads->num_slices = num_threads;
+   threads->slices     = (struct slice*)calloc(num_threads, sizeof(*threads->slices));
+   threads->done_lock  = slock_new();
+   threads->done_cond  = scond_new();
+
+   if (!threads->slices || !threads->done_lock || !threads->done_cond)
+      goto error;
+
+   // Slice 0 is handled by the caller.
+   for (unsigned i = 1; i < num_threads; i++)
+   {
+      struct slice *slice = &threads->slices[i];
+      slice->owner = threads;
+      slice->lock  = slock_new();
+      slice->cond  = scond_new();
+      if (!slice->lock || !slice->cond)
+         goto error;
+
+      slice->thread = sthread_create(slice_thread, slice);
+      if (!slice->thread)
+         goto error;
+   }
+
+   return threads;
+
+error:
+   slice_threads_free(threads);
+   return NULL;
+}
+
+void slice_threads_free(slice_threads_t *threads)
+{
+   if (!threads)
+      return;
+
+   threads->quit = true;
+
+   if (threads->slices)
+   {
+      for (unsigned i = 1; i < threads->num_slices; i++)
+      {
+         struct slice *slice = &threads->slices[i];
+         if (slice->thread)
+         {
+            slice_kick(slice, 0, 0);
+            sthread_join(slice->thread);
+         }
+
+         if (slice->lock)
+            slock_free(slice->lock);
+         if (slice->cond)
+            scond_free(slice->cond);
+      }
+   }
+
+   if (threads->done_lock)
+      slock_free(threads->done_lock);
+   if (threads->done_cond)
+      scond_free(threads->done_cond);
+
+   free(threads->slices);
+   free(threads);
+}
+
+void slice_threads_run(slice_threads_t *threads, slice_func_t func, void *data, unsigned lines)
+{
+   threads->func = func;
+   threads->data = data;
+   threads->done = 0;
+
+   unsigned num_slices = threads->num_slices;
+   for (unsigned i = 1; i < num_slices; i++)
+      slice_kick(&threads->slices[i], (lines * i) / num_slices, (lines * (i + 1)) / num_slices);
+
+   func(data, 0, lines / num_slices);
+
+   slock_lock(threads->done_lock);
+   while (threads->done < num_slices - 1)
+      scond_wait(threads->done_cond, threads->done_lock);
+   slock_unlock(threads->done_lock);
+}
+
+struct filter_threads
+{
+   slice_threads_t *slices;
+   filter_render_slice_t render;
+
+   // Frame currently being rendered.
+   uint32_t *colormap;
+   uint32_t *output;
+   unsigned outpitch;
+   const uint16_t *input;
+   unsigned pitch;
+   unsigned width;
+   unsigned height;
+};
+
+static void filter_render_slice(void *data, unsigned first_line, unsigned last_line)
+{
+   struct filter_threads *threads = (struct filter_threads*)data;
+   threads->render(threads->colormap, threads->output, threads->outpitch,
+         threads->input, threads->pitch, threads->width, threads->height,
+         first_line, last_line);
+}
+
+filter_threads_t *filter_threads_new(filter_render_slice_t render, unsigned num_threads)
+{
+   if (!render)
+      return NULL;
+
+   filter_threads_t *threads = (filter_threads_t*)calloc(1, sizeof(*threads));
+   if (!threads)
+      return NULL;
+
+   threads->render = render;
+   threads->slices = slice_threads_new(num_threads);
+   if (!threads->slices)
+   {
+      free(threads);
+      return NULL;
+   }
+
+   return threads;
+}
+
+void filter_threads_free(filter_threads_t *threads)
+{
+   if (!threads)
+      return;
+
+   slice_threads_free(threads->slices);
+   free(threads);
+}
+
+void filter_threads_render(filter_threads_t *threads,
+      uint32_t *colormap, uint32_t *output, unsigned outpitch,
+      const uint16_t *input, unsigned pitch, unsigned width, unsigned height)
+{
+   threads->colormap = colormap;
+   threads->output   = output;
+   threads->outpitch = outpitch;
+   threads->input    = input;
+   threads->pitch    = pitch;
+   threads->width    = width;
+   threads->height   = height;
+
+   slice_threads_run(threads->slices, filter_render_slice, threads, height);
+}
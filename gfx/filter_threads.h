@@ -0,0 +1,55 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RARCH_FILTER_THREADS_H__
+#define RARCH_FILTER_THREADS_H__
+
+#include <stdint.h>
+#include "../boolean.h"
+
+// Optional CPU filter entry point ("filter_render_slice").
+// Same as filter_render(), but only renders output for input lines [first_line, last_line).
+// The whole input frame is still passed, so filters can read neighbouring lines.
+// It is called concurrently for disjoint slices of the same frame, so it must be reentrant.
+typedef void (*filter_render_slice_t)(uint32_t *colormap, uint32_t *output, unsigned outpitch,
+      const uint16_t *input, unsigned pitch, unsigned width, unsigned height,
+      unsigned first_line, unsigned last_line);
+
+// Pool of worker threads that splits work on a frame into bands of lines.
+typedef struct slice_threads slice_threads_t;
+
+// Processes lines [first_line, last_line). Called concurrently for disjoint bands of the same frame.
+typedef void (*slice_func_t)(void *data, unsigned first_line, unsigned last_line);
+
+slice_threads_t *slice_threads_new(unsigned num_threads);
+void slice_threads_free(slice_threads_t *threads);
+
+// Splits [0, lines) into one band per thread. The calling thread handles the first band.
+// Blocks until all bands are done.
+void slice_threads_run(slice_threads_t *threads, slice_func_t func, void *data, unsigned lines);
+
+typedef struct filter_threads filter_threads_t;
+
+// Renders frames in num_threads slices. The calling thread renders the first slice.
+filter_threads_t *filter_threads_new(filter_render_slice_t render, unsigned num_threads);
+void filter_threads_free(filter_threads_t *threads);
+
+// Blocks until the whole frame is rendered.
+void filter_threads_render(filter_threads_t *threads,
+      uint32_t *colormap, uint32_t *output, unsigned outpitch,
+      const uint16_t *input, unsigned pitch, unsigned width, unsigned height);
+
+#endif
+
@@ -90,7 +90,7 @@ static void font_renderer_msg(void *data, const char *msg, struct font_output_li
       tmp->width = FONT_WIDTH * handle->scale_factor;
       tmp->height = FONT_HEIGHT * handle->scale_factor;
       tmp->pitch = tmp->width;
-      tmp->advance_x = tmp->width;
+      tmp->advance_x = FONT_WIDTH_STRIDE * handle->scale_factor;
       tmp->advance_y = tmp->height;
       tmp->char_off_x = 0;
       tmp->char_off_y = tmp->height;
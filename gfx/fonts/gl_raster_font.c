@@ -17,6 +17,38 @@
 #include "../gfx_common.h"
 #include "../gl_common.h"
 #include "../shader_common.h"
+#include "../../performance.h"
+#include <limits.h>
+
+// Glyphs are rasterized on first use and kept in a single atlas texture.
+// A message is then drawn as one batch of quads (shadow and foreground) out of the atlas,
+// so changing text, such as an FPS counter, does not cost a rasterization and texture upload per frame.
+#define FONT_ATLAS_SIZE 512
+#define FONT_ATLAS_PADDING 1
+
+struct gl_glyph
+{
+   bool cached;
+   int atlas_x, atlas_y;
+   int width, height;
+   int off_x, off_y;
+   int advance;
+};
+
+struct gl_font_atlas
+{
+   struct gl_glyph glyphs[256];
+   int width, height;
+   int cursor_x, cursor_y, row_height;
+
+   uint32_t *upload;
+   size_t upload_size;
+
+   GLfloat *vertex;
+   GLfloat *tex_coord;
+   GLfloat *color;
+   size_t capacity; // In quads.
+};
 
 static bool gl_init_font(void *data, const char *font_path, float font_size)
 {
@@ -26,23 +58,40 @@ static bool gl_init_font(void *data, const char *font_path, float font_size)
    (void)font_size;
    gl_t *gl = (gl_t*)data;
 
-   if (font_renderer_create_default(&gl->font_driver, &gl->font))
+   if (!font_renderer_create_default(&gl->font_driver, &gl->font))
    {
-      glGenTextures(1, &gl->font_tex);
-      glBindTexture(GL_TEXTURE_2D, gl->font_tex);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-      glBindTexture(GL_TEXTURE_2D, gl->texture[gl->tex_index]);
-      glGetIntegerv(GL_MAX_TEXTURE_SIZE, &gl->max_font_size);
+      RARCH_WARN("Couldn't init font renderer.\n");
+      return false;
    }
-   else
+
+   gl->font_atlas = (struct gl_font_atlas*)calloc(1, sizeof(*gl->font_atlas));
+   if (!gl->font_atlas)
    {
-      RARCH_WARN("Couldn't init font renderer.\n");
+      gl->font_driver->free(gl->font);
+      gl->font = NULL;
       return false;
    }
 
+   glGetIntegerv(GL_MAX_TEXTURE_SIZE, &gl->max_font_size);
+   struct gl_font_atlas *atlas = gl->font_atlas;
+   atlas->width  = min(FONT_ATLAS_SIZE, gl->max_font_size);
+   atlas->height = min(FONT_ATLAS_SIZE, gl->max_font_size);
+
+   // Start out fully transparent, so filtering never picks up garbage around glyphs.
+   void *clear = calloc(atlas->width * atlas->height, sizeof(uint32_t));
+
+   glGenTextures(1, &gl->font_tex);
+   glBindTexture(GL_TEXTURE_2D, gl->font_tex);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlas->width, atlas->height,
+         0, GL_RGBA, GL_UNSIGNED_BYTE, clear);
+   glBindTexture(GL_TEXTURE_2D, gl->texture[gl->tex_index]);
+   free(clear);
+
    for (unsigned i = 0; i < 4; i++)
    {
       gl->font_color[4 * i + 0] = g_settings.video.msg_color_r;
@@ -69,181 +118,260 @@ void gl_deinit_font(void *data)
    {
       gl->font_driver->free(gl->font);
       glDeleteTextures(1, &gl->font_tex);
+   }
 
-      if (gl->font_tex_buf)
-         free(gl->font_tex_buf);
+   if (gl->font_atlas)
+   {
+      free(gl->font_atlas->upload);
+      free(gl->font_atlas->vertex);
+      free(gl->font_atlas->tex_coord);
+      free(gl->font_atlas->color);
+      free(gl->font_atlas);
+      gl->font_atlas = NULL;
    }
 }
 
-// Somewhat overwhelming code just to render some damn fonts.
-// We aim to use NPOT textures for compatibility with old and shitty cards.
-// Also, we want to avoid reallocating a texture for each glyph (performance dips), so we
-// contruct the whole texture using one call, and copy straight to it with
-// glTexSubImage.
-
-struct font_rect
+static void atlas_flush(struct gl_font_atlas *atlas)
 {
-   int x, y;
-   int width, height;
-   int pot_width, pot_height;
-};
+   RARCH_LOG("[GL]: Font atlas is full, flushing.\n");
+   for (unsigned i = 0; i < 256; i++)
+      atlas->glyphs[i].cached = false;
+   atlas->cursor_x   = 0;
+   atlas->cursor_y   = 0;
+   atlas->row_height = 0;
+}
 
-static void calculate_msg_geometry(const struct font_output *head, struct font_rect *rect)
+// Shelf packing. Returns false if the atlas has no room left.
+static bool atlas_alloc(struct gl_font_atlas *atlas, int width, int height, int *x, int *y)
 {
-   int x_min = head->off_x;
-   int x_max = head->off_x + head->width;
-   int y_min = head->off_y;
-   int y_max = head->off_y + head->height;
+   width  += FONT_ATLAS_PADDING;
+   height += FONT_ATLAS_PADDING;
 
-   while ((head = head->next))
+   if (atlas->cursor_x + width > atlas->width)
    {
-      int left = head->off_x;
-      int right = head->off_x + head->width;
-      int bottom = head->off_y;
-      int top = head->off_y + head->height;
-
-      if (left < x_min)
-         x_min = left;
-      if (right > x_max)
-         x_max = right;
-
-      if (bottom < y_min)
-         y_min = bottom;
-      if (top > y_max)
-         y_max = top;
+      atlas->cursor_x    = 0;
+      atlas->cursor_y   += atlas->row_height;
+      atlas->row_height  = 0;
    }
 
-   rect->x = x_min;
-   rect->y = y_min;
-   rect->width = x_max - x_min;
-   rect->height = y_max - y_min;
+   if (atlas->cursor_y + height > atlas->height || width > atlas->width)
+      return false;
+
+   *x = atlas->cursor_x;
+   *y = atlas->cursor_y;
+   atlas->cursor_x  += width;
+   atlas->row_height = max(atlas->row_height, height);
+   return true;
 }
 
-static void adjust_power_of_two(gl_t *gl, struct font_rect *geom)
+static bool atlas_cache_glyph(gl_t *gl, uint8_t c)
 {
-   // Some systems really hate NPOT textures.
-   geom->pot_width  = next_pow2(geom->width);
-   geom->pot_height = next_pow2(geom->height);
+   struct gl_font_atlas *atlas = gl->font_atlas;
+   struct gl_glyph *glyph = &atlas->glyphs[c];
 
-   if (geom->pot_width > gl->max_font_size)
-      geom->pot_width = gl->max_font_size;
-   if (geom->pot_height > gl->max_font_size)
-      geom->pot_height = gl->max_font_size;
+   char str[2] = { (char)c, '\0' };
+   struct font_output_list out;
+   gl->font_driver->render_msg(gl->font, str, &out);
 
-   if ((geom->pot_width > gl->font_tex_w) || (geom->pot_height > gl->font_tex_h))
+   const struct font_output *head = out.head;
+   if (!head)
    {
-      gl->font_tex_buf = (uint32_t*)realloc(gl->font_tex_buf,
-            geom->pot_width * geom->pot_height * sizeof(uint32_t));
+      // Nothing to draw (e.g. unknown character), but remember it anyway.
+      memset(glyph, 0, sizeof(*glyph));
+      glyph->cached = true;
+      gl->font_driver->free_output(gl->font, &out);
+      return true;
+   }
+
+   int x = 0, y = 0;
+   if (!atlas_alloc(atlas, head->width, head->height, &x, &y))
+   {
+      gl->font_driver->free_output(gl->font, &out);
+      return false;
+   }
 
-      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, geom->pot_width, geom->pot_height,
-            0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+   glyph->atlas_x = x;
+   glyph->atlas_y = y;
+   glyph->width   = head->width;
+   glyph->height  = head->height;
+   glyph->off_x   = head->off_x;
+   glyph->off_y   = head->off_y;
+   glyph->advance = head->advance_x;
+   glyph->cached  = true;
+
+   size_t pixels = head->width * head->height;
+   if (pixels)
+   {
+      if (pixels > atlas->upload_size)
+      {
+         uint32_t *upload = (uint32_t*)realloc(atlas->upload, pixels * sizeof(uint32_t));
+         if (!upload)
+         {
+            gl->font_driver->free_output(gl->font, &out);
+            return true;
+         }
+         atlas->upload      = upload;
+         atlas->upload_size = pixels;
+      }
 
-      gl->font_tex_w = geom->pot_width;
-      gl->font_tex_h = geom->pot_height;
+      // Glyph rows are top-down, and so are the atlas rows.
+      uint8_t *dst = (uint8_t*)atlas->upload;
+      for (unsigned h = 0; h < head->height; h++)
+      {
+         const uint8_t *src = head->output + h * head->pitch;
+         for (unsigned w = 0; w < head->width; w++)
+         {
+            *dst++ = 0xff;
+            *dst++ = 0xff;
+            *dst++ = 0xff;
+            *dst++ = src[w];
+         }
+      }
+
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, head->width, head->height,
+            GL_RGBA, GL_UNSIGNED_BYTE, atlas->upload);
    }
+
+   gl->font_driver->free_output(gl->font, &out);
+   return true;
 }
 
-static void copy_glyph(const struct font_output *head, const struct font_rect *geom, uint32_t *buffer, unsigned width, unsigned height)
+// Makes sure every glyph in msg is in the atlas.
+static void atlas_cache_msg(gl_t *gl, const char *msg)
 {
-   // head has top-left oriented coords.
-   int x = head->off_x - geom->x;
-   int y = head->off_y - geom->y;
-   y     = height - head->height - y - 1;
-
-   const uint8_t *src = head->output;
-   int font_width  = head->width  + ((x < 0) ? x : 0);
-   int font_height = head->height + ((y < 0) ? y : 0);
+   struct gl_font_atlas *atlas = gl->font_atlas;
+   bool flushed = false;
 
-   if (x < 0)
+   for (const uint8_t *c = (const uint8_t*)msg; *c; c++)
    {
-      src += -x;
-      x    = 0;
-   }
+      if (atlas->glyphs[*c].cached)
+         continue;
 
-   if (y < 0)
-   {
-      src += -y * head->pitch;
-      y    = 0;
+      if (atlas_cache_glyph(gl, *c))
+         continue;
+
+      // Out of space. Start over once, a single message will always fit unless the font is huge.
+      if (flushed)
+         return;
+
+      atlas_flush(atlas);
+      flushed = true;
+      c = (const uint8_t*)msg - 1;
    }
+}
 
-   if (x + font_width > (int)width)
-      font_width = width - x;
+static bool atlas_reserve(struct gl_font_atlas *atlas, size_t quads)
+{
+   if (quads <= atlas->capacity)
+      return true;
+
+   GLfloat *vertex    = (GLfloat*)realloc(atlas->vertex,    quads * 6 * 2 * sizeof(GLfloat));
+   if (vertex)
+      atlas->vertex = vertex;
+   GLfloat *tex_coord = (GLfloat*)realloc(atlas->tex_coord, quads * 6 * 2 * sizeof(GLfloat));
+   if (tex_coord)
+      atlas->tex_coord = tex_coord;
+   GLfloat *color     = (GLfloat*)realloc(atlas->color,     quads * 6 * 4 * sizeof(GLfloat));
+   if (color)
+      atlas->color = color;
+
+   if (!vertex || !tex_coord || !color)
+      return false;
+
+   atlas->capacity = quads;
+   return true;
+}
 
-   if (y + font_height > (int)height)
-      font_height = height - y;
+static void emit_quad(struct gl_font_atlas *atlas, unsigned quad,
+      GLfloat lx, GLfloat ly, GLfloat hx, GLfloat hy,
+      GLfloat tlx, GLfloat tly, GLfloat thx, GLfloat thy,
+      const GLfloat *color)
+{
+   // Two triangles. Top of the glyph is the low texture row.
+   const GLfloat vertex[12] = {
+      lx, ly,  hx, ly,  lx, hy,
+      lx, hy,  hx, ly,  hx, hy,
+   };
+   const GLfloat tex_coord[12] = {
+      tlx, thy,  thx, thy,  tlx, tly,
+      tlx, tly,  thx, thy,  thx, tly,
+   };
+
+   memcpy(atlas->vertex + quad * 12, vertex, sizeof(vertex));
+   memcpy(atlas->tex_coord + quad * 12, tex_coord, sizeof(tex_coord));
+   for (unsigned i = 0; i < 6; i++)
+      memcpy(atlas->color + quad * 24 + i * 4, color, 4 * sizeof(GLfloat));
+}
 
-   uint32_t *dst = buffer + y * width + x;
-   for (int h = 0; h < font_height; h++, dst += width, src += head->pitch)
+// Builds shadow quads followed by foreground quads. Returns number of quads.
+static unsigned build_msg_quads(gl_t *gl, const char *msg,
+      GLfloat scale, GLfloat pos_x, GLfloat pos_y)
+{
+   struct gl_font_atlas *atlas = gl->font_atlas;
+   size_t len = strlen(msg);
+   if (!len || !atlas_reserve(atlas, 2 * len))
+      return 0;
+
+   // Anchor the bottom-left of the message's bounding box at pos, like the old single-texture path did.
+   int pen = 0;
+   int x_min = INT_MAX, y_min = INT_MAX;
+   for (size_t i = 0; i < len; i++)
    {
-      uint8_t *d = (uint8_t*)dst;
-      for (int w = 0; w < font_width; w++)
+      const struct gl_glyph *glyph = &atlas->glyphs[(uint8_t)msg[i]];
+      if (glyph->cached && glyph->width)
       {
-         *d++ = 0xff;
-         *d++ = 0xff;
-         *d++ = 0xff;
-         *d++ = src[w];
+         x_min = min(x_min, pen + glyph->off_x);
+         y_min = min(y_min, glyph->off_y);
       }
+      pen += glyph->advance;
    }
-}
 
-// Old style "blitting", so we can render all the fonts in one go.
-// TODO: Is it possible that fonts could overlap if we blit without alpha blending?
-static void blit_fonts(gl_t *gl, const struct font_output *head, const struct font_rect *geom)
-{
-   memset(gl->font_tex_buf, 0, gl->font_tex_w * gl->font_tex_h * sizeof(uint32_t));
+   if (x_min == INT_MAX)
+      return 0;
 
-   while (head)
+   GLfloat scale_x  = scale / gl->vp.width;
+   GLfloat scale_y  = scale / gl->vp.height;
+   GLfloat shift_x  = 2.0f / gl->vp.width;
+   GLfloat shift_y  = 2.0f / gl->vp.height;
+   GLfloat inv_w    = 1.0f / atlas->width;
+   GLfloat inv_h    = 1.0f / atlas->height;
+
+   unsigned glyphs = 0;
+   pen = 0;
+   for (size_t i = 0; i < len; i++)
    {
-      copy_glyph(head, geom, gl->font_tex_buf, gl->font_tex_w, gl->font_tex_h);
-      head = head->next;
+      const struct gl_glyph *glyph = &atlas->glyphs[(uint8_t)msg[i]];
+      if (glyph->cached && glyph->width)
+      {
+         GLfloat lx = pos_x + (pen + glyph->off_x - x_min) * scale_x;
+         GLfloat ly = pos_y + (glyph->off_y - y_min) * scale_y;
+         GLfloat hx = lx + glyph->width * scale_x;
+         GLfloat hy = ly + glyph->height * scale_y;
+
+         GLfloat tlx = glyph->atlas_x * inv_w;
+         GLfloat tly = glyph->atlas_y * inv_h;
+         GLfloat thx = (glyph->atlas_x + glyph->width) * inv_w;
+         GLfloat thy = (glyph->atlas_y + glyph->height) * inv_h;
+
+         emit_quad(atlas, glyphs, lx - shift_x, ly - shift_y, hx - shift_x, hy - shift_y,
+               tlx, tly, thx, thy, gl->font_color_dark);
+         emit_quad(atlas, len + glyphs, lx, ly, hx, hy,
+               tlx, tly, thx, thy, gl->font_color);
+         glyphs++;
+      }
+      pen += glyph->advance;
    }
 
-   glPixelStorei(GL_UNPACK_ALIGNMENT, 8);
-   glTexSubImage2D(GL_TEXTURE_2D,
-      0, 0, 0, gl->font_tex_w, gl->font_tex_h,
-      GL_RGBA, GL_UNSIGNED_BYTE, gl->font_tex_buf);
-}
-
-static void calculate_font_coords(gl_t *gl,
-      GLfloat font_vertex[8], GLfloat font_vertex_dark[8], GLfloat font_tex_coords[8], GLfloat scale, GLfloat pos_x, GLfloat pos_y)
-{
-   GLfloat scale_factor = scale;
-
-   GLfloat lx = pos_x;
-   GLfloat hx = (GLfloat)gl->font_last_width * scale_factor / gl->vp.width + lx;
-   GLfloat ly = pos_y;
-   GLfloat hy = (GLfloat)gl->font_last_height * scale_factor / gl->vp.height + ly;
-
-   font_vertex[0] = lx;
-   font_vertex[2] = hx;
-   font_vertex[4] = lx;
-   font_vertex[6] = hx;
-   font_vertex[1] = hy;
-   font_vertex[3] = hy;
-   font_vertex[5] = ly;
-   font_vertex[7] = ly;
-
-   GLfloat shift_x = 2.0f / gl->vp.width;
-   GLfloat shift_y = 2.0f / gl->vp.height;
-   for (unsigned i = 0; i < 4; i++)
+   // Close the gap between shadow and foreground quads.
+   if (glyphs < len)
    {
-      font_vertex_dark[2 * i + 0] = font_vertex[2 * i + 0] - shift_x;
-      font_vertex_dark[2 * i + 1] = font_vertex[2 * i + 1] - shift_y;
+      memmove(atlas->vertex + glyphs * 12, atlas->vertex + len * 12, glyphs * 12 * sizeof(GLfloat));
+      memmove(atlas->tex_coord + glyphs * 12, atlas->tex_coord + len * 12, glyphs * 12 * sizeof(GLfloat));
+      memmove(atlas->color + glyphs * 24, atlas->color + len * 24, glyphs * 24 * sizeof(GLfloat));
    }
 
-   lx = 0.0f;
-   hx = (GLfloat)gl->font_last_width / gl->font_tex_w;
-   ly = 1.0f - (GLfloat)gl->font_last_height / gl->font_tex_h; 
-   hy = 1.0f;
-
-   font_tex_coords[0] = lx;
-   font_tex_coords[2] = hx;
-   font_tex_coords[4] = lx;
-   font_tex_coords[6] = hx;
-   font_tex_coords[1] = ly;
-   font_tex_coords[3] = ly;
-   font_tex_coords[5] = hy;
-   font_tex_coords[7] = hy;
+   return 2 * glyphs;
 }
 
 static void setup_font(void *data, const char *msg, GLfloat scale, GLfloat pos_x, GLfloat pos_y)
@@ -252,63 +380,41 @@ static void setup_font(void *data, const char *msg, GLfloat scale, GLfloat pos_x
    if (!gl->font)
       return;
 
-   if (gl->shader)
-      gl->shader->use(GL_SHADER_STOCK_BLEND);
-
-   gl_set_viewport(gl, gl->win_width, gl->win_height, false, false);
-
-   glEnable(GL_BLEND);
-
-   GLfloat font_vertex[8]; 
-   GLfloat font_vertex_dark[8]; 
-   GLfloat font_tex_coords[8];
+   RARCH_PERFORMANCE_INIT(gl_render_msg);
+   RARCH_PERFORMANCE_START(gl_render_msg);
 
    glBindTexture(GL_TEXTURE_2D, gl->font_tex);
+   atlas_cache_msg(gl, msg);
 
-   gl->coords.tex_coord = font_tex_coords;
-
-   struct font_output_list out;
-
-   // If we get the same message, there's obviously no need to render fonts again ...
-   if (strcmp(gl->font_last_msg, msg) != 0)
+   unsigned quads = build_msg_quads(gl, msg, scale, pos_x, pos_y);
+   if (quads)
    {
-      gl->font_driver->render_msg(gl->font, msg, &out);
-      struct font_output *head = out.head;
-
-      struct font_rect geom;
-      calculate_msg_geometry(head, &geom);
-      adjust_power_of_two(gl, &geom);
-      blit_fonts(gl, head, &geom);
-
-      gl->font_driver->free_output(gl->font, &out);
-      strlcpy(gl->font_last_msg, msg, sizeof(gl->font_last_msg));
-
-      gl->font_last_width = geom.width;
-      gl->font_last_height = geom.height;
+      if (gl->shader)
+         gl->shader->use(GL_SHADER_STOCK_BLEND);
+
+      gl_set_viewport(gl, gl->win_width, gl->win_height, false, false);
+      glEnable(GL_BLEND);
+
+      struct gl_coords coords;
+      coords.vertex        = gl->font_atlas->vertex;
+      coords.tex_coord     = gl->font_atlas->tex_coord;
+      coords.lut_tex_coord = gl->font_atlas->tex_coord;
+      coords.color         = gl->font_atlas->color;
+      coords.vertices      = quads * 6;
+      gl_shader_set_coords(gl, &coords, &gl->mvp);
+      glDrawArrays(GL_TRIANGLES, 0, quads * 6);
+
+      // Post - Go back to old rendering path.
+      gl_shader_set_coords(gl, &gl->coords, &gl->mvp);
+      glDisable(GL_BLEND);
+
+      struct gl_ortho ortho = {0, 1, 0, 1, -1, 1};
+      gl_set_projection(gl, &ortho, true);
    }
-   calculate_font_coords(gl, font_vertex, font_vertex_dark, font_tex_coords, 
-         scale, pos_x, pos_y);
-   
-   gl->coords.vertex = font_vertex_dark;
-   gl->coords.color  = gl->font_color_dark;
-   gl_shader_set_coords(gl, &gl->coords, &gl->mvp);
-   glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-   gl->coords.vertex = font_vertex;
-   gl->coords.color  = gl->font_color;
-   gl_shader_set_coords(gl, &gl->coords, &gl->mvp);
-   glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-   // Post - Go back to old rendering path.
-   gl->coords.vertex    = gl->vertex_ptr;
-   gl->coords.tex_coord = gl->tex_coords;
-   gl->coords.color     = gl->white_color_ptr;
-   glBindTexture(GL_TEXTURE_2D, gl->texture[gl->tex_index]);
 
-   glDisable(GL_BLEND);
+   glBindTexture(GL_TEXTURE_2D, gl->texture[gl->tex_index]);
 
-   struct gl_ortho ortho = {0, 1, 0, 1, -1, 1};
-   gl_set_projection(gl, &ortho, true);
+   RARCH_PERFORMANCE_STOP(gl_render_msg);
 }
 
 static void gl_render_msg(void *data, const char *msg, void *parms)
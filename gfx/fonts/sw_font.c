@@ -0,0 +1,518 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sw_font.h"
+#include "fonts.h"
+#include "../../general.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(HAVE_NEON) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define SW_FONT_NEON
+#include <arm_neon.h>
+#endif
+
+// A horizontal span of glyphs. Spans never overlap, so no pixel is blended twice.
+struct sw_font_run
+{
+   unsigned x, width;
+   unsigned y, height;
+};
+
+struct sw_font
+{
+   const font_renderer_driver_t *driver;
+   void *handle;
+
+   char msg[256];
+   bool cached;
+
+   // Mask of the whole message. Width is always even, so 4:2:2 targets can blend in pairs.
+   uint8_t *mask;
+   size_t mask_size;
+   unsigned width, height, pitch;
+
+   // Top-left corner of the mask relative to the message origin.
+   int off_x, off_y;
+
+   struct sw_font_run *runs;
+   unsigned num_runs, runs_size;
+};
+
+sw_font_t *sw_font_new(void)
+{
+   sw_font_t *font = (sw_font_t*)calloc(1, sizeof(*font));
+   if (!font)
+      return NULL;
+
+   if (!font_renderer_create_default(&font->driver, &font->handle))
+   {
+      free(font);
+      return NULL;
+   }
+
+   return font;
+}
+
+void sw_font_free(sw_font_t *font)
+{
+   if (!font)
+      return;
+
+   font->driver->free(font->handle);
+   free(font->mask);
+   free(font->runs);
+   free(font);
+}
+
+static bool add_run(sw_font_t *font, unsigned x, unsigned width, unsigned y, unsigned height)
+{
+   // Glyphs come in pen order, so the new run almost always goes last.
+   unsigned i = font->num_runs;
+   while (i && font->runs[i - 1].x > x)
+      i--;
+
+   // Merge with the left neighbour if they overlap.
+   if (i && font->runs[i - 1].x + font->runs[i - 1].width > x)
+   {
+      struct sw_font_run *run = &font->runs[i - 1];
+      unsigned right  = max(run->x + run->width, x + width);
+      unsigned bottom = max(run->y + run->height, y + height);
+      run->y      = min(run->y, y);
+      run->width  = right - run->x;
+      run->height = bottom - run->y;
+      i--;
+   }
+   else
+   {
+      if (font->num_runs == font->runs_size)
+      {
+         unsigned size = font->runs_size ? font->runs_size * 2 : 32;
+         struct sw_font_run *runs = (struct sw_font_run*)realloc(font->runs, size * sizeof(*runs));
+         if (!runs)
+            return false;
+         font->runs      = runs;
+         font->runs_size = size;
+      }
+
+      memmove(font->runs + i + 1, font->runs + i, (font->num_runs - i) * sizeof(*font->runs));
+      font->runs[i].x      = x;
+      font->runs[i].width  = width;
+      font->runs[i].y      = y;
+      font->runs[i].height = height;
+      font->num_runs++;
+   }
+
+   // Growing a run can make it swallow the following ones.
+   struct sw_font_run *run = &font->runs[i];
+   while (i + 1 < font->num_runs && run->x + run->width > run[1].x)
+   {
+      unsigned right  = max(run->x + run->width, run[1].x + run[1].width);
+      unsigned bottom = max(run->y + run->height, run[1].y + run[1].height);
+      run->y      = min(run->y, run[1].y);
+      run->width  = right - run->x;
+      run->height = bottom - run->y;
+
+      memmove(run + 1, run + 2, (font->num_runs - i - 2) * sizeof(*run));
+      font->num_runs--;
+   }
+
+   return true;
+}
+
+// Draws the glyphs into the mask, and finds the runs of the mask with text in them.
+static void rasterize_msg(sw_font_t *font, const struct font_output_list *out)
+{
+   const struct font_output *head = out->head;
+   if (!head)
+      return;
+
+   // Font renderers work with Y going up from the baseline.
+   int x_min = INT_MAX, x_max = INT_MIN;
+   int y_min = INT_MAX, y_max = INT_MIN;
+   for (head = out->head; head; head = head->next)
+   {
+      x_min = min(x_min, head->off_x);
+      x_max = max(x_max, head->off_x + (int)head->width);
+      y_min = min(y_min, head->off_y);
+      y_max = max(y_max, head->off_y + (int)head->height);
+   }
+
+   font->width  = (x_max - x_min + 1) & ~1;
+   font->height = y_max - y_min;
+   font->pitch  = (font->width + 15) & ~15;
+   font->off_x  = x_min;
+   font->off_y  = -y_max;
+
+   size_t size = font->pitch * font->height;
+   if (size > font->mask_size)
+   {
+      uint8_t *mask = (uint8_t*)realloc(font->mask, size);
+      if (!mask)
+         return;
+      font->mask      = mask;
+      font->mask_size = size;
+   }
+   memset(font->mask, 0, size);
+
+   for (head = out->head; head; head = head->next)
+   {
+      if (!head->width || !head->height)
+         continue;
+
+      unsigned x = head->off_x - x_min;
+      unsigned y = y_max - (head->off_y + head->height);
+
+      const uint8_t *src = head->output;
+      uint8_t *dst = font->mask + y * font->pitch + x;
+      for (unsigned h = 0; h < head->height; h++, src += head->pitch, dst += font->pitch)
+      {
+         // Neighbouring glyphs can overlap slightly.
+         for (unsigned w = 0; w < head->width; w++)
+            dst[w] = max(dst[w], src[w]);
+      }
+
+      unsigned left  = x & ~1;
+      unsigned right = (x + head->width + 1) & ~1;
+      if (!add_run(font, left, right - left, y, head->height))
+         break;
+   }
+}
+
+static void render_msg(sw_font_t *font, const char *msg)
+{
+   font->num_runs = 0;
+
+   struct font_output_list out;
+   font->driver->render_msg(font->handle, msg, &out);
+   rasterize_msg(font, &out);
+   font->driver->free_output(font->handle, &out);
+}
+
+static void update_msg(sw_font_t *font, const char *msg)
+{
+   if (font->cached && strcmp(font->msg, msg) == 0)
+      return;
+
+   render_msg(font, msg);
+
+   // Very long messages are not cached, they are not worth the buffer.
+   font->cached = strlcpy(font->msg, msg, sizeof(font->msg)) < sizeof(font->msg);
+}
+
+static inline unsigned blend_channel(unsigned color, unsigned pixel, unsigned alpha)
+{
+   return (color * alpha + pixel * (256 - alpha)) >> 8;
+}
+
+static void blend_argb8888_C(uint32_t *out, const uint8_t *alpha, unsigned count,
+      uint32_t color, uint32_t color_mask)
+{
+   for (unsigned i = 0; i < count; i++)
+   {
+      unsigned a = alpha[i];
+      if (!a)
+         continue;
+
+      uint32_t pixel = out[i];
+      uint32_t blended = 0;
+      for (unsigned shift = 0; shift < 32; shift += 8)
+         blended |= blend_channel((color >> shift) & 0xff, (pixel >> shift) & 0xff, a) << shift;
+
+      out[i] = (blended & color_mask) | (pixel & ~color_mask);
+   }
+}
+
+static void blend_yuv422_C(uint8_t *out, const uint8_t *alpha, unsigned pairs,
+      const struct sw_font_yuv *yuv)
+{
+   for (unsigned i = 0; i < pairs; i++, out += 4, alpha += 2)
+   {
+      unsigned a0 = alpha[0];
+      unsigned a1 = alpha[1];
+      if (!(a0 | a1))
+         continue;
+
+      unsigned alpha_sub = (a0 + a1) >> 1; // Blended alpha for the sub-sampled U/V channels.
+
+      out[yuv->luma_index[0]] = blend_channel(yuv->y, out[yuv->luma_index[0]], a0);
+      out[yuv->luma_index[1]] = blend_channel(yuv->y, out[yuv->luma_index[1]], a1);
+      out[yuv->u_index] = blend_channel(yuv->u, out[yuv->u_index], alpha_sub);
+      out[yuv->v_index] = blend_channel(yuv->v, out[yuv->v_index], alpha_sub);
+   }
+}
+
+#if defined(__SSE2__)
+// (color * a + pixel * (256 - a)) >> 8 on 16 bytes. Fits in 16 bits, same result as blend_channel().
+static inline __m128i blend_sse2(__m128i color, __m128i pixel, __m128i alpha)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i c256 = _mm_set1_epi16(256);
+
+   __m128i a_lo = _mm_unpacklo_epi8(alpha, zero);
+   __m128i a_hi = _mm_unpackhi_epi8(alpha, zero);
+
+   __m128i lo = _mm_add_epi16(
+         _mm_mullo_epi16(_mm_unpacklo_epi8(color, zero), a_lo),
+         _mm_mullo_epi16(_mm_unpacklo_epi8(pixel, zero), _mm_sub_epi16(c256, a_lo)));
+   __m128i hi = _mm_add_epi16(
+         _mm_mullo_epi16(_mm_unpackhi_epi8(color, zero), a_hi),
+         _mm_mullo_epi16(_mm_unpackhi_epi8(pixel, zero), _mm_sub_epi16(c256, a_hi)));
+
+   return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+
+static void blend_argb8888(uint32_t *out, const uint8_t *alpha, unsigned count,
+      uint32_t color, uint32_t color_mask)
+{
+   const __m128i color_vec = _mm_set1_epi32(color);
+   const __m128i mask_vec  = _mm_set1_epi32(color_mask);
+
+   unsigned i;
+   for (i = 0; i + 4 <= count; i += 4)
+   {
+      uint32_t a;
+      memcpy(&a, alpha + i, sizeof(a));
+      if (!a)
+         continue;
+
+      // Spread each alpha over its pixel.
+      __m128i a_vec = _mm_cvtsi32_si128(a);
+      a_vec = _mm_unpacklo_epi8(a_vec, a_vec);
+      a_vec = _mm_unpacklo_epi16(a_vec, a_vec);
+
+      __m128i pixel = _mm_loadu_si128((const __m128i*)(out + i));
+      __m128i res   = blend_sse2(color_vec, pixel, a_vec);
+      res = _mm_or_si128(_mm_and_si128(res, mask_vec), _mm_andnot_si128(mask_vec, pixel));
+      _mm_storeu_si128((__m128i*)(out + i), res);
+   }
+
+   blend_argb8888_C(out + i, alpha + i, count - i, color, color_mask);
+}
+
+static void blend_yuv422(uint8_t *out, const uint8_t *alpha, unsigned pairs,
+      const struct sw_font_yuv *yuv)
+{
+   // Luma either on even or odd bytes. Anything else takes the slow path.
+   bool luma_first = yuv->luma_index[0] == 0 && yuv->luma_index[1] == 2;
+   if (!luma_first && !(yuv->luma_index[0] == 1 && yuv->luma_index[1] == 3))
+   {
+      blend_yuv422_C(out, alpha, pairs, yuv);
+      return;
+   }
+
+   uint8_t pattern[4];
+   pattern[yuv->luma_index[0]] = yuv->y;
+   pattern[yuv->luma_index[1]] = yuv->y;
+   pattern[yuv->u_index]       = yuv->u;
+   pattern[yuv->v_index]       = yuv->v;
+   uint32_t pattern32;
+   memcpy(&pattern32, pattern, sizeof(pattern32));
+
+   const __m128i color_vec = _mm_set1_epi32(pattern32);
+   const __m128i zero      = _mm_setzero_si128();
+   const __m128i low_mask  = _mm_set1_epi32(0xffff);
+
+   unsigned i;
+   for (i = 0; i + 4 <= pairs; i += 4)
+   {
+      __m128i a = _mm_loadl_epi64((const __m128i*)(alpha + 2 * i));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, zero)) == 0xffff)
+         continue;
+
+      // Luma alpha, 8 x 16-bit.
+      __m128i luma = _mm_unpacklo_epi8(a, zero);
+
+      // Chroma alpha (a0 + a1) >> 1 per pair, duplicated to 8 x 16-bit.
+      __m128i sub = _mm_srli_epi32(_mm_add_epi32(_mm_and_si128(luma, low_mask), _mm_srli_epi32(luma, 16)), 1);
+      __m128i chroma = _mm_or_si128(sub, _mm_slli_epi32(sub, 16));
+
+      __m128i lo = luma_first ? _mm_unpacklo_epi16(luma, chroma) : _mm_unpacklo_epi16(chroma, luma);
+      __m128i hi = luma_first ? _mm_unpackhi_epi16(luma, chroma) : _mm_unpackhi_epi16(chroma, luma);
+      __m128i a_vec = _mm_packus_epi16(lo, hi);
+
+      __m128i pixel = _mm_loadu_si128((const __m128i*)(out + 4 * i));
+      _mm_storeu_si128((__m128i*)(out + 4 * i), blend_sse2(color_vec, pixel, a_vec));
+   }
+
+   blend_yuv422_C(out + 4 * i, alpha + 2 * i, pairs - i, yuv);
+}
+#elif defined(SW_FONT_NEON)
+// (color * a + pixel * (256 - a)) >> 8, with 256 - a split up as (255 - a) + 1 to stay in 8-bit lanes.
+static inline uint8x8_t blend_neon(uint8x8_t color, uint8x8_t pixel, uint8x8_t alpha)
+{
+   uint16x8_t acc = vmull_u8(color, alpha);
+   acc = vmlal_u8(acc, pixel, vmvn_u8(alpha));
+   acc = vaddw_u8(acc, pixel);
+   return vshrn_n_u16(acc, 8);
+}
+
+static void blend_argb8888(uint32_t *out, const uint8_t *alpha, unsigned count,
+      uint32_t color, uint32_t color_mask)
+{
+   unsigned i;
+   for (i = 0; i + 8 <= count; i += 8)
+   {
+      uint8x8_t a = vld1_u8(alpha + i);
+      if (!vget_lane_u64(vreinterpret_u64_u8(a), 0))
+         continue;
+
+      uint8x8x4_t pixel = vld4_u8((const uint8_t*)(out + i));
+      for (unsigned c = 0; c < 4; c++)
+      {
+         uint8x8_t blended = blend_neon(vdup_n_u8((color >> (8 * c)) & 0xff), pixel.val[c], a);
+         pixel.val[c] = vbsl_u8(vdup_n_u8((color_mask >> (8 * c)) & 0xff), blended, pixel.val[c]);
+      }
+      vst4_u8((uint8_t*)(out + i), pixel);
+   }
+
+   blend_argb8888_C(out + i, alpha + i, count - i, color, color_mask);
+}
+
+static void blend_yuv422(uint8_t *out, const uint8_t *alpha, unsigned pairs,
+      const struct sw_font_yuv *yuv)
+{
+   bool luma_first = yuv->luma_index[0] == 0 && yuv->luma_index[1] == 2;
+   if (!luma_first && !(yuv->luma_index[0] == 1 && yuv->luma_index[1] == 3))
+   {
+      blend_yuv422_C(out, alpha, pairs, yuv);
+      return;
+   }
+
+   uint8_t pattern[16];
+   for (unsigned i = 0; i < 16; i += 4)
+   {
+      pattern[i + yuv->luma_index[0]] = yuv->y;
+      pattern[i + yuv->luma_index[1]] = yuv->y;
+      pattern[i + yuv->u_index]       = yuv->u;
+      pattern[i + yuv->v_index]       = yuv->v;
+   }
+   const uint8x16_t color = vld1q_u8(pattern);
+
+   unsigned i;
+   for (i = 0; i + 4 <= pairs; i += 4)
+   {
+      uint8x8_t a = vld1_u8(alpha + 2 * i);
+      if (!vget_lane_u64(vreinterpret_u64_u8(a), 0))
+         continue;
+
+      // Chroma alpha (a0 + a1) >> 1 per pair, each duplicated once.
+      uint16x4_t sub = vshr_n_u16(vpaddl_u8(a), 1);
+      uint8x8_t sub8 = vmovn_u16(vcombine_u16(sub, sub));
+      uint8x8_t chroma = vzip_u8(sub8, sub8).val[0];
+
+      uint8x8x2_t zip = luma_first ? vzip_u8(a, chroma) : vzip_u8(chroma, a);
+
+      uint8x16_t pixel = vld1q_u8(out + 4 * i);
+      uint8x8_t lo = blend_neon(vget_low_u8(color), vget_low_u8(pixel), zip.val[0]);
+      uint8x8_t hi = blend_neon(vget_high_u8(color), vget_high_u8(pixel), zip.val[1]);
+      vst1q_u8(out + 4 * i, vcombine_u8(lo, hi));
+   }
+
+   blend_yuv422_C(out + 4 * i, alpha + 2 * i, pairs - i, yuv);
+}
+#else
+#define blend_argb8888 blend_argb8888_C
+#define blend_yuv422 blend_yuv422_C
+#endif
+
+// Clips a run against the target. Returns false if nothing is left.
+static bool clip_run(const struct sw_font_run *run, int x, int y,
+      unsigned width, unsigned height,
+      unsigned *mask_x, unsigned *mask_y, unsigned *out_x, unsigned *out_y,
+      unsigned *out_width, unsigned *out_height)
+{
+   int left   = x + (int)run->x;
+   int top    = y + (int)run->y;
+   int right  = min(left + (int)run->width, (int)width);
+   int bottom = min(top + (int)run->height, (int)height);
+
+   *mask_x = run->x;
+   *mask_y = run->y;
+
+   if (left < 0)
+   {
+      *mask_x -= left;
+      left = 0;
+   }
+   if (top < 0)
+   {
+      *mask_y -= top;
+      top = 0;
+   }
+
+   if (left >= right || top >= bottom)
+      return false;
+
+   *out_x      = left;
+   *out_y      = top;
+   *out_width  = right - left;
+   *out_height = bottom - top;
+   return true;
+}
+
+void sw_font_blend_argb8888(sw_font_t *font, const char *msg,
+      uint32_t *pixels, size_t pitch, unsigned width, unsigned height,
+      int x, int y, uint32_t color, uint32_t color_mask)
+{
+   update_msg(font, msg);
+
+   x += font->off_x;
+   y += font->off_y;
+
+   for (unsigned i = 0; i < font->num_runs; i++)
+   {
+      unsigned mask_x, mask_y, out_x, out_y, out_width, out_height;
+      if (!clip_run(&font->runs[i], x, y, width, height,
+               &mask_x, &mask_y, &out_x, &out_y, &out_width, &out_height))
+         continue;
+
+      const uint8_t *src = font->mask + mask_y * font->pitch + mask_x;
+      uint8_t *dst = (uint8_t*)pixels + out_y * pitch + out_x * sizeof(uint32_t);
+
+      for (unsigned h = 0; h < out_height; h++, src += font->pitch, dst += pitch)
+         blend_argb8888((uint32_t*)dst, src, out_width, color, color_mask);
+   }
+}
+
+void sw_font_blend_yuv422(sw_font_t *font, const char *msg,
+      uint8_t *pixels, size_t pitch, unsigned width, unsigned height,
+      int x, int y, const struct sw_font_yuv *yuv)
+{
+   update_msg(font, msg);
+
+   // Make sure we always start on a pixel pair, so the component indices are correct.
+   // Runs are pair aligned within the mask.
+   x = (x + font->off_x) & ~1;
+   y += font->off_y;
+   width &= ~1;
+
+   for (unsigned i = 0; i < font->num_runs; i++)
+   {
+      unsigned mask_x, mask_y, out_x, out_y, out_width, out_height;
+      if (!clip_run(&font->runs[i], x, y, width, height,
+               &mask_x, &mask_y, &out_x, &out_y, &out_width, &out_height))
+         continue;
+
+      const uint8_t *src = font->mask + mask_y * font->pitch + mask_x;
+      uint8_t *dst = pixels + out_y * pitch + out_x * 2; // YUV formats used are 16 bpp.
+
+      for (unsigned h = 0; h < out_height; h++, src += font->pitch, dst += pitch)
+         blend_yuv422(dst, src, out_width >> 1, yuv);
+   }
+}
+
@@ -0,0 +1,51 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RARCH_SW_FONT_H
+#define __RARCH_SW_FONT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../../boolean.h"
+
+// Text compositor for software video drivers.
+// The last message is kept rasterized as a single alpha mask,
+// and only the glyph boxes are blended into the target surface.
+typedef struct sw_font sw_font_t;
+
+// Packed 4:2:2 layout (YUY2, UYVY, ...) and text color in that space.
+struct sw_font_yuv
+{
+   unsigned luma_index[2];
+   unsigned u_index;
+   unsigned v_index;
+   uint8_t y, u, v;
+};
+
+sw_font_t *sw_font_new(void);
+void sw_font_free(sw_font_t *font);
+
+// x and y is the message origin (left edge, baseline) in target pixels.
+// pitch is in bytes.
+void sw_font_blend_argb8888(sw_font_t *font, const char *msg,
+      uint32_t *pixels, size_t pitch, unsigned width, unsigned height,
+      int x, int y, uint32_t color, uint32_t color_mask);
+
+void sw_font_blend_yuv422(sw_font_t *font, const char *msg,
+      uint8_t *pixels, size_t pitch, unsigned width, unsigned height,
+      int x, int y, const struct sw_font_yuv *yuv);
+
+#endif
+
@@ -117,6 +117,10 @@ static inline bool gl_query_extension(gl_t *gl, const char *ext)
    return ret;
 }
 
+#if defined(HAVE_GLSL) || defined(HAVE_CG)
+static void gl_poll_shader(gl_t *gl);
+#endif
+
 #ifdef HAVE_OVERLAY
 static void gl_render_overlay(void *data);
 static void gl_overlay_vertex_geom(void *data,
@@ -455,75 +459,183 @@ static void gl_compute_fbo_geometry(void *data, unsigned width, unsigned height,
    }
 }
 
-static void gl_create_fbo_textures(void *data)
+// FBO textures are pooled by size (always power-of-two) and format.
+// Rebuilding the FBO chain (shader changes, cores changing resolution, resizes)
+// picks up textures of the same size again instead of reallocating them.
+static void gl_fbo_pool_alloc_storage(gl_t *gl, unsigned width, unsigned height, bool fp)
 {
-   gl_t *gl = (gl_t*)data;
+   if (fp)
+   {
+      // GLES and GL are inconsistent in which arguments to pass.
+#ifdef HAVE_OPENGLES2
+      bool has_fp_fbo = gl_query_extension(gl, "OES_texture_float_linear");
+      if (!has_fp_fbo)
+         RARCH_ERR("OES_texture_float_linear extension not found.\n");
 
-   glGenTextures(gl->fbo_pass, gl->fbo_texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 
+            width, height,
+            0, GL_RGBA, GL_FLOAT, NULL);
+#else
+      bool has_fp_fbo = gl_query_extension(gl, "ARB_texture_float");
+      if (!has_fp_fbo)
+         RARCH_ERR("ARB_texture_float extension was not found.\n");
 
-   GLuint base_filt = g_settings.video.smooth ? GL_LINEAR : GL_NEAREST;
-   for (int i = 0; i < gl->fbo_pass; i++)
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 
+            width, height,
+            0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+#endif
+   }
+   else
+   {
+#ifdef HAVE_OPENGLES2
+      glTexImage2D(GL_TEXTURE_2D,
+            0, GL_RGBA,
+            width, height, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+#else
+      // Avoid potential performance reductions on particular platforms.
+      glTexImage2D(GL_TEXTURE_2D,
+            0, RARCH_GL_INTERNAL_FORMAT32,
+            width, height, 0,
+            RARCH_GL_TEXTURE_TYPE32, RARCH_GL_FORMAT32, NULL);
+#endif
+   }
+}
+
+// Returns a texture of the given size and format, bound to GL_TEXTURE_2D.
+static GLuint gl_fbo_pool_acquire(gl_t *gl, unsigned width, unsigned height, bool fp)
+{
+   struct gl_fbo_pool_entry *slot = NULL;
+
+   for (unsigned i = 0; i < MAX_FBO_POOL; i++)
    {
-      glBindTexture(GL_TEXTURE_2D, gl->fbo_texture[i]);
+      struct gl_fbo_pool_entry *entry = &gl->fbo_pool[i];
+      if (entry->used)
+         continue;
 
-      GLuint filter_type = base_filt;
-      bool smooth = false;
-      if (gl_shader_filter_type(gl, i + 2, &smooth))
-         filter_type = smooth ? GL_LINEAR : GL_NEAREST;
+      if (entry->tex && entry->width == width && entry->height == height && entry->fp == fp)
+      {
+         entry->used = true;
+         entry->age  = 0;
+         gl->fbo_pool_reuses++;
+         glBindTexture(GL_TEXTURE_2D, entry->tex);
+         return entry->tex;
+      }
 
-      enum gfx_wrap_type wrap = gl_shader_wrap_type(gl, i + 2);
-      GLenum wrap_enum = gl_wrap_type_to_enum(wrap);
+      // Prefer an empty slot, otherwise evict the texture that has gone unused the longest.
+      if (!slot || (slot->tex && (!entry->tex || entry->age > slot->age)))
+         slot = entry;
+   }
 
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter_type);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter_type);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_enum);
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_enum);
+   // Can't happen as long as the pool is larger than the number of passes.
+   if (!slot)
+      return 0;
 
-      bool fp_fbo = gl->fbo_scale[i].valid && gl->fbo_scale[i].fp_fbo;
+   RARCH_PERFORMANCE_INIT(fbo_pool_alloc);
+   RARCH_PERFORMANCE_START(fbo_pool_alloc);
 
-      if (fp_fbo)
-      {
-         // GLES and GL are inconsistent in which arguments to pass.
-#ifdef HAVE_OPENGLES2
-         bool has_fp_fbo = gl_query_extension(gl, "OES_texture_float_linear");
-         if (!has_fp_fbo)
-            RARCH_ERR("OES_texture_float_linear extension not found.\n");
+   if (slot->tex)
+      glDeleteTextures(1, &slot->tex);
 
-         RARCH_LOG("FBO pass #%d is floating-point.\n", i);
-         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 
-               gl->fbo_rect[i].width, gl->fbo_rect[i].height,
-               0, GL_RGBA, GL_FLOAT, NULL);
-#else
-         bool has_fp_fbo = gl_query_extension(gl, "ARB_texture_float");
-         if (!has_fp_fbo)
-            RARCH_ERR("ARB_texture_float extension was not found.\n");
+   glGenTextures(1, &slot->tex);
+   glBindTexture(GL_TEXTURE_2D, slot->tex);
+   gl_fbo_pool_alloc_storage(gl, width, height, fp);
 
-         RARCH_LOG("FBO pass #%d is floating-point.\n", i);
-         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 
-               gl->fbo_rect[i].width, gl->fbo_rect[i].height,
-               0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-#endif
+   RARCH_PERFORMANCE_STOP(fbo_pool_alloc);
+
+   slot->width  = width;
+   slot->height = height;
+   slot->fp     = fp;
+   slot->used   = true;
+   slot->age    = 0;
+   gl->fbo_pool_allocs++;
+   return slot->tex;
+}
+
+static void gl_fbo_pool_release(gl_t *gl, GLuint tex)
+{
+   for (unsigned i = 0; i < MAX_FBO_POOL; i++)
+   {
+      if (gl->fbo_pool[i].tex == tex)
+      {
+         gl->fbo_pool[i].used = false;
+         return;
       }
-      else
+   }
+}
+
+// Frees textures which haven't been picked up again for a few FBO chain rebuilds,
+// so VRAM doesn't stay tied up in sizes that are not coming back.
+static void gl_fbo_pool_trim(gl_t *gl)
+{
+   for (unsigned i = 0; i < MAX_FBO_POOL; i++)
+   {
+      struct gl_fbo_pool_entry *entry = &gl->fbo_pool[i];
+      if (entry->tex && !entry->used && ++entry->age > FBO_POOL_MAX_AGE)
       {
-#ifdef HAVE_OPENGLES2
-         glTexImage2D(GL_TEXTURE_2D,
-               0, GL_RGBA,
-               gl->fbo_rect[i].width, gl->fbo_rect[i].height, 0,
-               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-#else
-         // Avoid potential performance reductions on particular platforms.
-         glTexImage2D(GL_TEXTURE_2D,
-               0, RARCH_GL_INTERNAL_FORMAT32,
-               gl->fbo_rect[i].width, gl->fbo_rect[i].height, 0,
-               RARCH_GL_TEXTURE_TYPE32, RARCH_GL_FORMAT32, NULL);
-#endif
+         glDeleteTextures(1, &entry->tex);
+         memset(entry, 0, sizeof(*entry));
       }
    }
+}
+
+static void gl_fbo_pool_free(gl_t *gl)
+{
+   for (unsigned i = 0; i < MAX_FBO_POOL; i++)
+   {
+      if (gl->fbo_pool[i].tex)
+         glDeleteTextures(1, &gl->fbo_pool[i].tex);
+   }
+   memset(gl->fbo_pool, 0, sizeof(gl->fbo_pool));
+
+   if (gl->fbo_pool_allocs)
+      RARCH_LOG("[GL]: FBO texture pool: %u allocations, %u reuses.\n",
+            gl->fbo_pool_allocs, gl->fbo_pool_reuses);
+}
+
+// Pulls a texture for FBO pass i out of the pool and leaves it bound.
+// Pooled textures may have been used by another pass, so sampling state is always set again.
+static void gl_acquire_fbo_texture(gl_t *gl, int i)
+{
+   bool fp_fbo = gl->fbo_scale[i].valid && gl->fbo_scale[i].fp_fbo;
+   gl->fbo_texture[i] = gl_fbo_pool_acquire(gl,
+         gl->fbo_rect[i].width, gl->fbo_rect[i].height, fp_fbo);
+
+   GLuint filter_type = g_settings.video.smooth ? GL_LINEAR : GL_NEAREST;
+   bool smooth = false;
+   if (gl_shader_filter_type(gl, i + 2, &smooth))
+      filter_type = smooth ? GL_LINEAR : GL_NEAREST;
+
+   enum gfx_wrap_type wrap = gl_shader_wrap_type(gl, i + 2);
+   GLenum wrap_enum = gl_wrap_type_to_enum(wrap);
+
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter_type);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter_type);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_enum);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_enum);
+}
+
+static void gl_create_fbo_textures(void *data)
+{
+   gl_t *gl = (gl_t*)data;
+
+   for (int i = 0; i < gl->fbo_pass; i++)
+   {
+      if (gl->fbo_scale[i].valid && gl->fbo_scale[i].fp_fbo)
+         RARCH_LOG("FBO pass #%d is floating-point.\n", i);
+      gl_acquire_fbo_texture(gl, i);
+   }
 
    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+static void gl_release_fbo_textures(gl_t *gl)
+{
+   for (int i = 0; i < gl->fbo_pass; i++)
+      gl_fbo_pool_release(gl, gl->fbo_texture[i]);
+   memset(gl->fbo_texture, 0, sizeof(gl->fbo_texture));
+}
+
 static bool gl_create_fbo_targets(void *data)
 {
    gl_t *gl = (gl_t*)data;
@@ -554,9 +666,8 @@ void gl_deinit_fbo(void *data)
 
    if (gl->fbo_inited)
    {
-      glDeleteTextures(gl->fbo_pass, gl->fbo_texture);
+      gl_release_fbo_textures(gl);
       glDeleteFramebuffers(gl->fbo_pass, gl->fbo);
-      memset(gl->fbo_texture, 0, sizeof(gl->fbo_texture));
       memset(gl->fbo, 0, sizeof(gl->fbo));
       gl->fbo_inited = false;
       gl->fbo_pass = 0;
@@ -620,9 +731,10 @@ void gl_init_fbo(void *data, unsigned width, unsigned height)
    }
 
    gl_create_fbo_textures(gl);
+   gl_fbo_pool_trim(gl);
    if (!gl_create_fbo_targets(gl))
    {
-      glDeleteTextures(gl->fbo_pass, gl->fbo_texture);
+      gl_release_fbo_textures(gl);
       RARCH_ERR("Failed to create FBO targets. Will continue without FBO.\n");
       return;
    }
@@ -874,14 +986,11 @@ static void gl_check_fbo_dimensions(void *data)
          unsigned pow2_size = next_pow2(max);
          gl->fbo_rect[i].width = gl->fbo_rect[i].height = pow2_size;
 
-         glBindFramebuffer(GL_FRAMEBUFFER, gl->fbo[i]);
-         glBindTexture(GL_TEXTURE_2D, gl->fbo_texture[i]);
-
-         glTexImage2D(GL_TEXTURE_2D,
-               0, RARCH_GL_INTERNAL_FORMAT32, gl->fbo_rect[i].width, gl->fbo_rect[i].height,
-               0, RARCH_GL_TEXTURE_TYPE32,
-               RARCH_GL_FORMAT32, NULL);
+         // The old texture goes back to the pool, where another pass or a later rebuild can pick it up.
+         gl_fbo_pool_release(gl, gl->fbo_texture[i]);
+         gl_acquire_fbo_texture(gl, i);
 
+         glBindFramebuffer(GL_FRAMEBUFFER, gl->fbo[i]);
          glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gl->fbo_texture[i], 0);
 
          GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -1256,7 +1365,9 @@ static inline void gl_copy_frame(void *data, const void *frame, unsigned width,
    if (gl->base_size == 2)
    {
       // Always use 32-bit textures on desktop GL.
-      gl_convert_frame_rgb16_32(gl, gl->conv_buffer, frame, width, height, pitch);
+      // The frontend might already have converted into conv_buffer for us (see gl_get_upload_buffer()).
+      if (frame != gl->conv_buffer)
+         gl_convert_frame_rgb16_32(gl, gl->conv_buffer, frame, width, height, pitch);
       glTexSubImage2D(GL_TEXTURE_2D,
             0, 0, 0, width, height, gl->texture_type,
             gl->texture_fmt, gl->conv_buffer);
@@ -1289,13 +1400,66 @@ static inline void gl_set_shader_viewport(void *data, unsigned shader)
 }
 
 #if !defined(HAVE_OPENGLES) && defined(HAVE_FFMPEG)
+static void gl_free_pbo_readback(void *data)
+{
+   gl_t *gl = (gl_t*)data;
+   if (!gl->pbo_readback_enable)
+      return;
+
+   glDeleteBuffers(gl->pbo_readback_depth, gl->pbo_readback);
+   scaler_ctx_gen_reset(&gl->pbo_readback_scaler);
+   gl->pbo_readback_enable = false;
+}
+
+static bool gl_alloc_pbo_readback(void *data, unsigned depth)
+{
+   gl_t *gl = (gl_t*)data;
+
+   gl->pbo_readback_depth  = depth;
+   gl->pbo_readback_index  = 0;
+   gl->pbo_readback_valid  = false;
+   gl->pbo_readback_width  = gl->vp.width;
+   gl->pbo_readback_height = gl->vp.height;
+
+   glGenBuffers(depth, gl->pbo_readback);
+   for (unsigned i = 0; i < depth; i++)
+   {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, gl->pbo_readback[i]);
+      glBufferData(GL_PIXEL_PACK_BUFFER, gl->vp.width * gl->vp.height * sizeof(uint32_t),
+            NULL, GL_STREAM_COPY);
+   }
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+   struct scaler_ctx *scaler = &gl->pbo_readback_scaler;
+   scaler->in_width    = gl->vp.width;
+   scaler->in_height   = gl->vp.height;
+   scaler->out_width   = gl->vp.width;
+   scaler->out_height  = gl->vp.height;
+   scaler->in_stride   = gl->vp.width * sizeof(uint32_t);
+   scaler->out_stride  = gl->vp.width * 3;
+   scaler->in_fmt      = SCALER_FMT_ARGB8888;
+   scaler->out_fmt     = SCALER_FMT_BGR24;
+   scaler->scaler_type = SCALER_TYPE_POINT;
+
+   if (!scaler_ctx_gen_filter(scaler))
+   {
+      RARCH_ERR("Failed to init pixel conversion for PBO.\n");
+      glDeleteBuffers(depth, gl->pbo_readback);
+      return false;
+   }
+
+   return true;
+}
+
 static void gl_pbo_async_readback(void *data)
 {
    gl_t *gl = (gl_t*)data;
    glBindBuffer(GL_PIXEL_PACK_BUFFER, gl->pbo_readback[gl->pbo_readback_index++]);
-   gl->pbo_readback_index &= 3;
+   if (gl->pbo_readback_index >= gl->pbo_readback_depth)
+      gl->pbo_readback_index = 0;
 
-   // If set, we 3 rendered frames already buffered up.
+   // If set, the ring is full, and the next buffer in line holds the oldest frame.
+   // It was read back depth - 1 frames ago, so mapping it should not stall.
    gl->pbo_readback_valid |= gl->pbo_readback_index == 0;
 
    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
@@ -1312,6 +1476,78 @@ static void gl_pbo_async_readback(void *data)
 
    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 }
+
+// Starts reading back the next frames when the ring isn't running for recording.
+// Two buffers are enough, the frame is mapped one frame after it was read back.
+static void gl_request_pbo_readback(void *data)
+{
+   gl_t *gl = (gl_t*)data;
+   bool resized = gl->pbo_readback_width != gl->vp.width ||
+      gl->pbo_readback_height != gl->vp.height;
+
+   if (gl->pbo_readback_enable && gl->pbo_readback_request && !resized)
+      return; // Already in flight.
+
+   if (!gl->pbo_readback_enable || resized)
+   {
+      gl_free_pbo_readback(gl);
+      gl->pbo_readback_enable = gl_alloc_pbo_readback(gl, 2);
+      if (!gl->pbo_readback_enable)
+         return;
+   }
+
+   gl->pbo_readback_index   = 0;
+   gl->pbo_readback_valid   = false;
+   gl->pbo_readback_request = true;
+}
+
+static const void *gl_map_viewport(void *data, unsigned *pitch)
+{
+   gl_t *gl = (gl_t*)data;
+   if (!gl->pbo_readback_continuous)
+   {
+      if (!gl->pbo_readback_enable || !gl->pbo_readback_request || !gl->pbo_readback_valid ||
+            gl->pbo_readback_width != gl->vp.width || gl->pbo_readback_height != gl->vp.height)
+      {
+         gl_request_pbo_readback(gl);
+         return NULL;
+      }
+   }
+   else if (!gl->pbo_readback_enable || !gl->pbo_readback_valid) // We haven't buffered up enough frames yet, come back later.
+      return NULL;
+
+   // Mapping blocks if the GPU hasn't finished the readback yet.
+   // With a deep enough ring, this should be close to free.
+   RARCH_PERFORMANCE_INIT(pbo_readback_stall);
+   RARCH_PERFORMANCE_START(pbo_readback_stall);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, gl->pbo_readback[gl->pbo_readback_index]);
+   const void *ptr = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+   RARCH_PERFORMANCE_STOP(pbo_readback_stall);
+
+   if (!ptr)
+   {
+      RARCH_ERR("Failed to map pixel pack buffer.\n");
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      return NULL;
+   }
+
+   *pitch = gl->vp.width * sizeof(uint32_t);
+   return ptr;
+}
+
+static void gl_unmap_viewport(void *data)
+{
+   gl_t *gl = (gl_t*)data;
+   glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+   // One-off request is done, the next map starts a new one.
+   if (!gl->pbo_readback_continuous)
+   {
+      gl->pbo_readback_request = false;
+      gl->pbo_readback_valid   = false;
+   }
+}
 #endif
 
 #if defined(HAVE_RGUI) || defined(HAVE_RMENU)
@@ -1369,6 +1605,10 @@ static bool gl_frame(void *data, const void *frame, unsigned width, unsigned hei
       glBindVertexArray(gl->vao);
 #endif
 
+#if defined(HAVE_GLSL) || defined(HAVE_CG)
+   gl_poll_shader(gl);
+#endif
+
    if (gl->shader)
       gl->shader->use(1);
 
@@ -1508,7 +1748,9 @@ static bool gl_frame(void *data, const void *frame, unsigned width, unsigned hei
 #endif
 
 #if !defined(HAVE_OPENGLES) && defined(HAVE_FFMPEG)
-   if (gl->pbo_readback_enable)
+   // One-off requests stop reading back once the ring has filled up.
+   if (gl->pbo_readback_enable &&
+         (gl->pbo_readback_continuous || (gl->pbo_readback_request && !gl->pbo_readback_valid)))
       gl_pbo_async_readback(gl);
 #endif
 
@@ -1593,15 +1835,12 @@ static void gl_free(void *data)
    scaler_ctx_gen_reset(&gl->scaler);
 
 #if !defined(HAVE_OPENGLES) && defined(HAVE_FFMPEG)
-   if (gl->pbo_readback_enable)
-   {
-      glDeleteBuffers(4, gl->pbo_readback);
-      scaler_ctx_gen_reset(&gl->pbo_readback_scaler);
-   }
+   gl_free_pbo_readback(gl);
 #endif
 
 #ifdef HAVE_FBO
    gl_deinit_fbo(gl);
+   gl_fbo_pool_free(gl);
 #ifndef HAVE_RGL
    gl_deinit_hw_render(gl);
 #endif
@@ -1761,39 +2000,24 @@ static inline void gl_reinit_textures(void *data, const video_info_t *video)
 static void gl_init_pbo_readback(void *data)
 {
    gl_t *gl = (gl_t*)data;
-   // Only bother with this if we're doing FFmpeg GPU recording.
-   gl->pbo_readback_enable = g_settings.video.gpu_record && g_extern.recording;
-   if (!gl->pbo_readback_enable)
-      return;
-
-   RARCH_LOG("Async PBO readback enabled.\n");
+   gl->pbo_readback_enable = false;
+   gl->pbo_readback_request = false;
 
-   glGenBuffers(4, gl->pbo_readback);
-   for (unsigned i = 0; i < 4; i++)
-   {
-      glBindBuffer(GL_PIXEL_PACK_BUFFER, gl->pbo_readback[i]);
-      glBufferData(GL_PIXEL_PACK_BUFFER, gl->vp.width * gl->vp.height * sizeof(uint32_t),
-            NULL, GL_STREAM_COPY);
-   }
-   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+   // Only bother with a full ring if we're doing FFmpeg GPU recording.
+   // Screenshots allocate buffers on demand in gl_request_pbo_readback().
+   gl->pbo_readback_continuous = g_settings.video.gpu_record && g_extern.recording;
+   if (!gl->pbo_readback_continuous)
+      return;
 
-   struct scaler_ctx *scaler = &gl->pbo_readback_scaler;
-   scaler->in_width    = gl->vp.width;
-   scaler->in_height   = gl->vp.height;
-   scaler->out_width   = gl->vp.width;
-   scaler->out_height  = gl->vp.height;
-   scaler->in_stride   = gl->vp.width * sizeof(uint32_t);
-   scaler->out_stride  = gl->vp.width * 3;
-   scaler->in_fmt      = SCALER_FMT_ARGB8888;
-   scaler->out_fmt     = SCALER_FMT_BGR24;
-   scaler->scaler_type = SCALER_TYPE_POINT;
+   unsigned depth = g_settings.video.gpu_record_depth;
+   if (depth < 2)
+      depth = 2;
+   else if (depth > MAX_PBO_READBACK)
+      depth = MAX_PBO_READBACK;
 
-   if (!scaler_ctx_gen_filter(scaler))
-   {
-      gl->pbo_readback_enable = false;
-      RARCH_ERR("Failed to init pixel conversion for PBO.\n");
-      glDeleteBuffers(4, gl->pbo_readback);
-   }
+   gl->pbo_readback_enable = gl_alloc_pbo_readback(gl, depth);
+   if (gl->pbo_readback_enable)
+      RARCH_LOG("Async PBO readback enabled (%u frames deep).\n", depth);
 }
 #endif
 
@@ -2026,6 +2250,8 @@ static void *gl_init(const video_info_t *video, const input_driver_t **input, vo
 #ifdef HAVE_GLSL
    gl_glsl_set_get_proc_address(gl->ctx_driver->get_proc_address);
    gl_glsl_set_context_type(gl->core_context, hw_render->version_major, hw_render->version_minor);
+   gl_glsl_set_parallel_compile(gl_query_extension(gl, "_parallel_shader_compile"));
+   gl_glsl_set_program_binary(gl_query_extension(gl, "get_program_binary"));
 #endif
 
    if (!gl_shader_init(gl))
@@ -2185,6 +2411,90 @@ static void gl_update_tex_filter_frame(gl_t *gl)
 }
 
 #if defined(HAVE_GLSL) || defined(HAVE_CG)
+// Sets up the rest of the pipeline after a new shader chain has been installed.
+static void gl_shader_changed(gl_t *gl)
+{
+   gl_update_tex_filter_frame(gl);
+
+   if (gl->shader)
+   {
+      unsigned textures = gl->shader->get_prev_textures() + 1;
+      if (textures > gl->textures) // Have to reinit a bit.
+      {
+#if defined(HAVE_FBO) && !defined(HAVE_RGL)
+         gl_deinit_hw_render(gl);
+#endif
+
+         glDeleteTextures(gl->textures, gl->texture);
+#if defined(HAVE_PSGL)
+         glBindBuffer(GL_TEXTURE_REFERENCE_BUFFER_SCE, 0);
+         glDeleteBuffers(1, &gl->pbo);
+#endif
+         gl->textures = textures;
+         RARCH_LOG("GL: Using %u textures.\n", gl->textures);
+         gl->tex_index = 0;
+         gl_init_textures(gl, &gl->video_info);
+         gl_init_textures_data(gl);
+
+#if defined(HAVE_FBO) && !defined(HAVE_RGL)
+         if (gl->hw_render_use)
+            gl_init_hw_render(gl, gl->tex_w, gl->tex_h);
+#endif
+      }
+   }
+
+#ifdef HAVE_FBO
+   // Set up render to texture again.
+   gl_init_fbo(gl, gl->tex_w, gl->tex_h);
+#endif
+
+   // Apparently need to set viewport for passes when we aren't using FBOs.
+   gl_set_shader_viewport(gl, 0);
+   gl_set_shader_viewport(gl, 1);
+}
+
+static void gl_poll_shader(gl_t *gl)
+{
+   if (!gl->shader || !gl->shader->poll_async)
+      return;
+
+   switch (gl->shader->poll_async())
+   {
+      case GL_SHADER_ASYNC_READY:
+#ifdef HAVE_FBO
+         gl_deinit_fbo(gl);
+         glBindTexture(GL_TEXTURE_2D, gl->texture[gl->tex_index]);
+#endif
+         gl_shader_changed(gl);
+         break;
+
+      // gl_set_shader() already returned true, so this is where the failure is reported.
+      // Same as failing synchronously, we fall back to stock.
+      case GL_SHADER_ASYNC_FAILED:
+      {
+         RARCH_ERR("[GL]: Failed to build new shader chain. Falling back to stock.\n");
+         msg_queue_push(g_extern.msg_queue, "Failed to apply shader. Falling back to stock.", 1, 180);
+
+         const gl_shader_backend_t *backend = gl->shader;
+         gl_shader_deinit(gl);
+#ifdef HAVE_FBO
+         gl_deinit_fbo(gl);
+         glBindTexture(GL_TEXTURE_2D, gl->texture[gl->tex_index]);
+#endif
+         if (backend->init(NULL))
+            gl->shader = backend;
+         else
+            RARCH_ERR("[GL]: Failed to load stock shader.\n");
+
+         gl_shader_changed(gl);
+         break;
+      }
+
+      default:
+         break;
+   }
+}
+
 static bool gl_set_shader(void *data, enum rarch_shader_type type, const char *path)
 {
    gl_t *gl = (gl_t*)data;
@@ -2192,6 +2502,11 @@ static bool gl_set_shader(void *data, enum rarch_shader_type type, const char *p
    if (type == RARCH_SHADER_NONE)
       return false;
 
+   // Keep rendering with the current chain while the new one compiles.
+   // True only means the new chain is queued, gl_poll_shader() reports if it fails.
+   if (gl->shader && gl->shader->type == type && gl->shader->init_async)
+      return gl->shader->init_async(path);
+
    gl_shader_deinit(gl);
 
    switch (type)
@@ -2233,43 +2548,7 @@ static bool gl_set_shader(void *data, enum rarch_shader_type type, const char *p
       return false;
    }
 
-   gl_update_tex_filter_frame(gl);
-
-   if (gl->shader)
-   {
-      unsigned textures = gl->shader->get_prev_textures() + 1;
-      if (textures > gl->textures) // Have to reinit a bit.
-      {
-#if defined(HAVE_FBO) && !defined(HAVE_RGL)
-         gl_deinit_hw_render(gl);
-#endif
-
-         glDeleteTextures(gl->textures, gl->texture);
-#if defined(HAVE_PSGL)
-         glBindBuffer(GL_TEXTURE_REFERENCE_BUFFER_SCE, 0);
-         glDeleteBuffers(1, &gl->pbo);
-#endif
-         gl->textures = textures;
-         RARCH_LOG("GL: Using %u textures.\n", gl->textures);
-         gl->tex_index = 0;
-         gl_init_textures(gl, &gl->video_info);
-         gl_init_textures_data(gl);
-
-#if defined(HAVE_FBO) && !defined(HAVE_RGL)
-         if (gl->hw_render_use)
-            gl_init_hw_render(gl, gl->tex_w, gl->tex_h);
-#endif
-      }
-   }
-
-#ifdef HAVE_FBO
-   // Set up render to texture again.
-   gl_init_fbo(gl, gl->tex_w, gl->tex_h);
-#endif
-
-   // Apparently need to set viewport for passes when we aren't using FBOs.
-   gl_set_shader_viewport(gl, 0);
-   gl_set_shader_viewport(gl, 1);
+   gl_shader_changed(gl);
    return true;
 }
 #endif
@@ -2313,22 +2592,18 @@ static bool gl_read_viewport(void *data, uint8_t *buffer)
    }
 #else
 #ifdef HAVE_FFMPEG
-   if (gl->pbo_readback_enable)
+   if (gl->pbo_readback_enable && gl->pbo_readback_continuous)
    {
       if (!gl->pbo_readback_valid) // We haven't buffered up enough frames yet, come back later.
          return false;
 
-      glBindBuffer(GL_PIXEL_PACK_BUFFER, gl->pbo_readback[gl->pbo_readback_index]);
-      const void *ptr = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+      unsigned pitch;
+      const void *ptr = gl_map_viewport(gl, &pitch);
       if (!ptr)
-      {
-         RARCH_ERR("Failed to map pixel unpack buffer.\n");
          return false;
-      }
 
       scaler_ctx_scale(&gl->pbo_readback_scaler, buffer, ptr);
-      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
-      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      gl_unmap_viewport(gl);
    }
    else // Use slow synchronous readbacks. Use this with plain screenshots as we don't really care about performance in this case.
 #endif
@@ -2639,6 +2914,27 @@ static void gl_show_mouse(void *data, bool state)
       gl->ctx_driver->show_mouse(state);
 }
 
+#if !defined(HAVE_PSGL) && !defined(HAVE_OPENGLES2)
+// 16-bit frames are expanded to ARGB8888 in conv_buffer before upload.
+// Let the frontend write there directly when it has to convert frames anyways.
+static void *gl_get_upload_buffer(void *data, unsigned width, unsigned height,
+      unsigned *pitch, enum scaler_pix_fmt *fmt)
+{
+   gl_t *gl = (gl_t*)data;
+   if (gl->base_size != sizeof(uint16_t) || !gl->conv_buffer || width > gl->tex_w || height > gl->tex_h)
+      return NULL;
+
+#ifdef HAVE_FBO
+   if (gl->hw_render_fbo_init)
+      return NULL;
+#endif
+
+   *pitch = width * sizeof(uint32_t);
+   *fmt   = SCALER_FMT_ARGB8888;
+   return gl->conv_buffer;
+}
+#endif
+
 static const video_poke_interface_t gl_poke_interface = {
    NULL,
 #ifdef HAVE_FBO
@@ -2654,6 +2950,19 @@ static const video_poke_interface_t gl_poke_interface = {
    gl_set_osd_msg,
 
    gl_show_mouse,
+   NULL,
+#if !defined(HAVE_PSGL) && !defined(HAVE_OPENGLES2)
+   gl_get_upload_buffer,
+#else
+   NULL,
+#endif
+#if !defined(HAVE_OPENGLES) && defined(HAVE_FFMPEG)
+   gl_map_viewport,
+   gl_unmap_viewport,
+#else
+   NULL,
+   NULL,
+#endif
 };
 
 static void gl_get_poke_interface(void *data, const video_poke_interface_t **iface)
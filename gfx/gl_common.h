@@ -105,6 +105,17 @@ struct gl_fbo_rect
    unsigned height;
 };
 
+// Render target texture, kept around after its FBO pass goes away so it can be reused.
+struct gl_fbo_pool_entry
+{
+   GLuint tex;
+   unsigned width;
+   unsigned height;
+   bool fp;
+   bool used;
+   unsigned age; // Number of FBO chain rebuilds this texture has gone unused.
+};
+
 struct gl_ortho
 {
    GLfloat left;
@@ -129,12 +140,16 @@ struct gl_coords
    const GLfloat *color;
    const GLfloat *tex_coord;
    const GLfloat *lut_tex_coord;
+   unsigned vertices; // 0 means a single quad (4 vertices).
 };
 
 typedef struct gl_shader_backend gl_shader_backend_t;
 
 #define MAX_SHADERS 16
 #define MAX_TEXTURES 8
+#define MAX_PBO_READBACK 16
+#define MAX_FBO_POOL (2 * MAX_SHADERS)
+#define FBO_POOL_MAX_AGE 4
 
 typedef struct gl
 {
@@ -164,6 +179,10 @@ typedef struct gl
    int fbo_pass;
    bool fbo_inited;
 
+   struct gl_fbo_pool_entry fbo_pool[MAX_FBO_POOL];
+   unsigned fbo_pool_allocs;
+   unsigned fbo_pool_reuses;
+
    GLuint hw_render_fbo[MAX_TEXTURES];
    GLuint hw_render_depth[MAX_TEXTURES];
    bool hw_render_fbo_init;
@@ -208,10 +227,7 @@ typedef struct gl
    const font_renderer_driver_t *font_driver;
    GLuint font_tex;
    GLint max_font_size;
-   int font_tex_w, font_tex_h;
-   uint32_t *font_tex_buf;
-   char font_last_msg[256];
-   int font_last_width, font_last_height;
+   struct gl_font_atlas *font_atlas;
    GLfloat font_color[16];
    GLfloat font_color_dark[16];
 
@@ -229,12 +245,18 @@ typedef struct gl
 #endif
 
 #if !defined(HAVE_OPENGLES) && defined(HAVE_FFMPEG)
-   // PBOs used for asynchronous viewport readbacks.
-   GLuint pbo_readback[4];
+   // Ring of PBOs used for asynchronous viewport readbacks.
+   GLuint pbo_readback[MAX_PBO_READBACK];
+   unsigned pbo_readback_depth;
    bool pbo_readback_enable;
    bool pbo_readback_valid;
    unsigned pbo_readback_index;
+   unsigned pbo_readback_width;
+   unsigned pbo_readback_height;
    struct scaler_ctx pbo_readback_scaler;
+   // Continuous when GPU recording, otherwise frames are only read back on request (screenshots).
+   bool pbo_readback_continuous;
+   bool pbo_readback_request;
 #endif
 
 #if defined(HAVE_RGUI) || defined(HAVE_RMENU)
@@ -23,9 +23,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "../general.h"
+#include "../hash.h"
+#include "../compat/strl.h"
 #include "rpng/rpng.h"
 
+#if !defined(_WIN32) && !defined(RARCH_CONSOLE)
+#define HAVE_IMAGE_CACHE_MMAP
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #ifdef HAVE_SDL_IMAGE
 
 #include "SDL_image.h"
@@ -221,12 +233,253 @@ bool texture_image_load_argb_shift(const char *path, struct texture_image *out_i
 
 #endif
 
+// Decoded images are shared between everyone loading the same file (overlays, LUTs, ...),
+// and optionally kept in video_image_cache_dir as raw pixels which are mapped on later loads.
+#define IMAGE_CACHE_MAGIC 0x474d4952 // RIMG
+
+struct image_cache_header
+{
+   uint32_t magic;
+   uint32_t width;
+   uint32_t height;
+   uint32_t pad; // Keeps pixels 16 byte aligned.
+};
+
+struct image_entry
+{
+   struct image_entry *next;
+   char key[64 + 1];
+   unsigned refcount;
+
+   unsigned width;
+   unsigned height;
+   uint32_t *pixels;
+
+   // Set if pixels point into a mapped cache file.
+   void *map;
+   size_t map_size;
+};
+
+static struct image_entry *image_entries;
+
+// Key is unique for a file version and pixel layout.
+static bool image_cache_key(char *key, const char *path, bool rgba)
+{
+   char real_path[PATH_MAX];
+   strlcpy(real_path, path, sizeof(real_path));
+   path_resolve_realpath(real_path, sizeof(real_path));
+
+   struct stat st;
+   if (stat(real_path, &st) < 0)
+      return false;
+
+   char buf[PATH_MAX + 64];
+   size_t len = snprintf(buf, sizeof(buf), "%s|%llu|%llu|%s", real_path,
+         (unsigned long long)st.st_mtime, (unsigned long long)st.st_size, rgba ? "rgba" : "argb");
+   if (len >= sizeof(buf))
+      return false;
+
+   sha256_hash(key, (const uint8_t*)buf, len);
+   return true;
+}
+
+static void image_cache_path(char *path, size_t size, const char *key)
+{
+   char name[64 + 16];
+   snprintf(name, sizeof(name), "%s.rimg", key);
+   fill_pathname_join(path, g_settings.video.image_cache_dir, name, size);
+}
+
+static bool image_cache_load(struct image_entry *entry)
+{
+   char path[PATH_MAX];
+   image_cache_path(path, sizeof(path), entry->key);
+
+   struct image_cache_header header;
+#ifdef HAVE_IMAGE_CACHE_MMAP
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return false;
+
+   struct stat st;
+   if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(header))
+   {
+      close(fd);
+      return false;
+   }
+
+   size_t size = st.st_size;
+   // Private mapping, so users may scribble on the pixels without touching the cache.
+   void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return false;
+
+   memcpy(&header, map, sizeof(header));
+   if (header.magic != IMAGE_CACHE_MAGIC ||
+         size != sizeof(header) + (size_t)header.width * header.height * sizeof(uint32_t))
+   {
+      munmap(map, size);
+      return false;
+   }
+
+   entry->map      = map;
+   entry->map_size = size;
+   entry->pixels   = (uint32_t*)((uint8_t*)map + sizeof(header));
+#else
+   void *buf = NULL;
+   ssize_t len = read_file(path, &buf);
+   if (len < (ssize_t)sizeof(header))
+   {
+      free(buf);
+      return false;
+   }
+
+   memcpy(&header, buf, sizeof(header));
+   if (header.magic != IMAGE_CACHE_MAGIC ||
+         (size_t)len != sizeof(header) + (size_t)header.width * header.height * sizeof(uint32_t))
+   {
+      free(buf);
+      return false;
+   }
+
+   entry->pixels = (uint32_t*)malloc(len - sizeof(header));
+   if (entry->pixels)
+      memcpy(entry->pixels, (const uint8_t*)buf + sizeof(header), len - sizeof(header));
+   free(buf);
+   if (!entry->pixels)
+      return false;
+#endif
+
+   entry->width  = header.width;
+   entry->height = header.height;
+   return true;
+}
+
+static void image_cache_save(const struct image_entry *entry)
+{
+   char path[PATH_MAX];
+   image_cache_path(path, sizeof(path), entry->key);
+
+   FILE *file = fopen(path, "wb");
+   if (!file)
+   {
+      RARCH_WARN("Failed to open image cache \"%s\" for writing.\n", path);
+      return;
+   }
+
+   struct image_cache_header header = { IMAGE_CACHE_MAGIC, entry->width, entry->height, 0 };
+   size_t size = (size_t)entry->width * entry->height;
+
+   bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(entry->pixels, sizeof(uint32_t), size, file) == size;
+   fclose(file);
+
+   // A truncated file is rejected by the size check on load, but don't leave it around.
+   if (!ok)
+   {
+      RARCH_WARN("Failed to write image cache \"%s\".\n", path);
+      remove(path);
+   }
+}
+
+static void image_entry_free(struct image_entry *entry)
+{
+#ifdef HAVE_IMAGE_CACHE_MMAP
+   if (entry->map)
+      munmap(entry->map, entry->map_size);
+   else
+#endif
+      free(entry->pixels);
+   free(entry);
+}
+
 bool texture_image_load(const char *path, struct texture_image *out_img)
 {
    // This interface "leak" is very ugly. FIXME: Fix this properly ...
-   if (driver.gfx_use_rgba)
-      return texture_image_load_argb_shift(path, out_img, 24, 0, 8, 16);
+   bool rgba = driver.gfx_use_rgba;
+
+   char key[64 + 1];
+   if (!image_cache_key(key, path, rgba))
+   {
+      if (rgba)
+         return texture_image_load_argb_shift(path, out_img, 24, 0, 8, 16);
+      else
+         return texture_image_load_argb_shift(path, out_img, 24, 16, 8, 0);
+   }
+
+   struct image_entry *entry;
+   for (entry = image_entries; entry; entry = entry->next)
+   {
+      if (!strcmp(entry->key, key))
+         break;
+   }
+
+   if (entry)
+      entry->refcount++;
    else
-      return texture_image_load_argb_shift(path, out_img, 24, 16, 8, 0);
+   {
+      entry = (struct image_entry*)calloc(1, sizeof(*entry));
+      if (!entry)
+         return false;
+      strlcpy(entry->key, key, sizeof(entry->key));
+
+      bool cached = *g_settings.video.image_cache_dir && image_cache_load(entry);
+      if (cached)
+         RARCH_LOG("Loaded image from cache: %s.\n", path);
+      else
+      {
+         struct texture_image img = {0};
+         bool ret = rgba ?
+            texture_image_load_argb_shift(path, &img, 24, 0, 8, 16) :
+            texture_image_load_argb_shift(path, &img, 24, 16, 8, 0);
+
+         if (!ret)
+         {
+            free(entry);
+            return false;
+         }
+
+         entry->width  = img.width;
+         entry->height = img.height;
+         entry->pixels = img.pixels;
+
+         if (*g_settings.video.image_cache_dir)
+            image_cache_save(entry);
+      }
+
+      entry->refcount = 1;
+      entry->next     = image_entries;
+      image_entries   = entry;
+   }
+
+   out_img->width  = entry->width;
+   out_img->height = entry->height;
+   out_img->pixels = entry->pixels;
+   return true;
 }
 
+void texture_image_free(struct texture_image *img)
+{
+   if (!img->pixels)
+      return;
+
+   for (struct image_entry **entry = &image_entries; *entry; entry = &(*entry)->next)
+   {
+      if ((*entry)->pixels != img->pixels)
+         continue;
+
+      struct image_entry *tmp = *entry;
+      if (--tmp->refcount == 0)
+      {
+         *entry = tmp->next;
+         image_entry_free(tmp);
+      }
+
+      img->pixels = NULL;
+      return;
+   }
+
+   free(img->pixels);
+   img->pixels = NULL;
+}
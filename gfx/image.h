@@ -38,7 +38,10 @@ struct texture_image
 #endif
 };
 
+// Images are shared between everyone loading the same file,
+// and must be released with texture_image_free().
 bool texture_image_load(const char *path, struct texture_image* img);
+void texture_image_free(struct texture_image *img);
 
 #endif
 
@@ -179,6 +179,10 @@ struct py_state
    PyObject *dict;
    PyObject *inst;
 
+   // Bound methods resolved by py_state_bind().
+   PyObject **methods;
+   unsigned num_methods;
+
    bool warned_ret;
    bool warned_type;
 };
@@ -319,6 +323,10 @@ void py_state_free(py_state_t *handle)
       PyErr_Print();
       PyErr_Clear();
 
+      for (unsigned i = 0; i < handle->num_methods; i++)
+         Py_CLEAR(handle->methods[i]);
+      free(handle->methods);
+
       Py_CLEAR(handle->inst);
       Py_CLEAR(handle->dict);
       Py_CLEAR(handle->main);
@@ -350,3 +358,54 @@ float py_state_get(py_state_t *handle, const char *id,
    return retval;
 }
 
+bool py_state_bind(py_state_t *handle, const char * const *ids, unsigned count)
+{
+   handle->methods = (PyObject**)calloc(count, sizeof(PyObject*));
+   if (!handle->methods)
+      return false;
+   handle->num_methods = count;
+
+   for (unsigned i = 0; i < count; i++)
+   {
+      handle->methods[i] = PyObject_GetAttrString(handle->inst, ids[i]);
+      if (!handle->methods[i])
+      {
+         RARCH_ERR("Python script does not implement \"%s\".\n", ids[i]);
+         PyErr_Print();
+         PyErr_Clear();
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void py_state_get_batch(py_state_t *handle, float *values, unsigned frame_count)
+{
+   PyObject *args = Py_BuildValue("(I)", frame_count);
+   if (!args)
+      return;
+
+   for (unsigned i = 0; i < handle->num_methods; i++)
+   {
+      PyObject *ret = PyObject_CallObject(handle->methods[i], args);
+      if (!ret)
+      {
+         if (!handle->warned_ret)
+         {
+            RARCH_WARN("Didn't get return value from script. Bug?\n");
+            PyErr_Print();
+            PyErr_Clear();
+         }
+
+         handle->warned_ret = true;
+         values[i] = 0.0f;
+         continue;
+      }
+
+      values[i] = (float)PyFloat_AsDouble(ret);
+      Py_DECREF(ret);
+   }
+
+   Py_DECREF(args);
+}
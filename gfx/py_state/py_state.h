@@ -29,4 +29,9 @@ void py_state_free(py_state_t *handle);
 float py_state_get(py_state_t *handle, 
       const char *id, unsigned frame_count);
 
+// Resolves the methods for ids once, so py_state_get_batch()
+// can evaluate all of them without any lookups by name.
+bool py_state_bind(py_state_t *handle, const char * const *ids, unsigned count);
+void py_state_get_batch(py_state_t *handle, float *values, unsigned frame_count);
+
 #endif
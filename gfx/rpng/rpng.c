@@ -26,10 +26,20 @@
 #include <string.h>
 #include "../../hash.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(HAVE_NEON) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define RPNG_NEON
+#include <arm_neon.h>
+#endif
+
 // Decodes a subset of PNG standard.
 // Does not handle much outside 24/32-bit RGB(A) images.
 //
-// Missing: Adam7 interlace, 16 bpp, various color formats.
+// Missing: 16 bpp (truncated to 8 bpp), tRNS, gamma.
+//
+// IDAT data is inflated and unfiltered one scanline at a time,
+// so apart from the output image, memory use is a couple of scanlines.
 
 #undef GOTO_END_ERROR
 #define GOTO_END_ERROR() do { \
@@ -104,12 +114,6 @@ struct
    { "PLTE", PNG_CHUNK_PLTE },
 };
 
-struct idat_buffer
-{
-   uint8_t *data;
-   size_t size;
-};
-
 static enum png_chunk_type png_chunk_type(const struct png_chunk *chunk)
 {
    for (unsigned i = 0; i < ARRAY_SIZE(chunk_map); i++)
@@ -240,10 +244,416 @@ static inline int paeth(int a, int b, int c)
       return c;
 }
 
+#if defined(__SSE2__)
+// Pixels are always accessed as dwords, scanline buffers are padded for this.
+// With bpp = 3, the byte following the pixel is left intact on store.
+static inline uint32_t merge_pixel(const uint8_t *buf, uint32_t val, unsigned bpp)
+{
+   if (bpp == 3)
+   {
+      uint32_t old;
+      memcpy(&old, buf, sizeof(old));
+      val = (val & 0x00ffffff) | (old & 0xff000000);
+   }
+   return val;
+}
+
+static inline __m128i load_pixel(const uint8_t *buf)
+{
+   uint32_t val;
+   memcpy(&val, buf, sizeof(val));
+   return _mm_cvtsi32_si128(val);
+}
+
+static inline void store_pixel(uint8_t *buf, __m128i pixel, unsigned bpp)
+{
+   uint32_t val = merge_pixel(buf, _mm_cvtsi128_si32(pixel), bpp);
+   memcpy(buf, &val, sizeof(val));
+}
+
+static inline __m128i abs_epi16(__m128i x)
+{
+   return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static inline __m128i select_si128(__m128i mask, __m128i a, __m128i b)
+{
+   return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Swaps R and B of RGBA (as bytes) to get ARGB (as dwords).
+static inline __m128i rgba_to_argb(__m128i x)
+{
+   __m128i ag = _mm_and_si128(x, _mm_set1_epi32(0xff00ff00));
+   __m128i rb = _mm_and_si128(x, _mm_set1_epi32(0x00ff00ff));
+   rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+   return _mm_or_si128(ag, rb);
+}
+
+// Sub is a prefix sum over pixels.
+// Pixels of a block are summed in log steps, carrying in the last pixel of the previous block.
+static inline unsigned unfilter_sub_simd(uint8_t *line, unsigned pitch, unsigned bpp)
+{
+   __m128i last = _mm_setzero_si128();
+   unsigned i = 0;
+
+   if (bpp == 4)
+   {
+      for (; i + 16 <= pitch; i += 16)
+      {
+         __m128i x = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(line + i)), last);
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+         _mm_storeu_si128((__m128i*)(line + i), x);
+         last = _mm_srli_si128(x, 12);
+      }
+   }
+   else
+   {
+      // Four pixels per block, the last 4 bytes are loaded, but left alone.
+      for (; i + 16 <= pitch; i += 12)
+      {
+         __m128i x = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(line + i)), last);
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+         _mm_storel_epi64((__m128i*)(line + i), x);
+         store_pixel(line + i + 8, _mm_srli_si128(x, 8), 4);
+         last = _mm_and_si128(_mm_srli_si128(x, 9), _mm_cvtsi32_si128(0xffffff));
+      }
+   }
+
+   return i;
+}
+
+static inline unsigned unfilter_up_simd(uint8_t *line, const uint8_t *prev, unsigned pitch)
+{
+   unsigned i = 0;
+   for (; i + 16 <= pitch; i += 16)
+   {
+      __m128i x = _mm_loadu_si128((const __m128i*)(line + i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(prev + i));
+      _mm_storeu_si128((__m128i*)(line + i), _mm_add_epi8(x, b));
+   }
+   return i;
+}
+
+static inline void unfilter_avg_simd(uint8_t *line, const uint8_t *prev, unsigned pitch, unsigned bpp)
+{
+   const __m128i one = _mm_set1_epi8(1);
+   __m128i a = _mm_setzero_si128();
+   for (unsigned i = 0; i < pitch; i += bpp)
+   {
+      __m128i b = load_pixel(prev + i);
+      __m128i x = load_pixel(line + i);
+
+      // pavgb rounds up, PNG rounds down.
+      __m128i avg = _mm_avg_epu8(a, b);
+      avg = _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a, b), one));
+
+      a = _mm_add_epi8(x, avg);
+      store_pixel(line + i, a, bpp);
+   }
+}
+
+static inline void unfilter_paeth_simd(uint8_t *line, const uint8_t *prev, unsigned pitch, unsigned bpp)
+{
+   const __m128i zero = _mm_setzero_si128();
+   __m128i a = zero;
+   __m128i c = zero;
+   for (unsigned i = 0; i < pitch; i += bpp)
+   {
+      __m128i b = _mm_unpacklo_epi8(load_pixel(prev + i), zero);
+      __m128i x = load_pixel(line + i);
+
+      // p - a = b - c, p - b = a - c, p - c = (b - c) + (a - c).
+      __m128i pa = _mm_sub_epi16(b, c);
+      __m128i pb = _mm_sub_epi16(a, c);
+      __m128i pc = abs_epi16(_mm_add_epi16(pa, pb));
+      pa = abs_epi16(pa);
+      pb = abs_epi16(pb);
+
+      // Ties favor a over b over c.
+      __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      __m128i nearest = select_si128(_mm_cmpeq_epi16(smallest, pa), a,
+            select_si128(_mm_cmpeq_epi16(smallest, pb), b, c));
+
+      x = _mm_add_epi8(x, _mm_packus_epi16(nearest, nearest));
+      store_pixel(line + i, x, bpp);
+
+      a = _mm_unpacklo_epi8(x, zero);
+      c = b;
+   }
+}
+
+static inline unsigned copy_line_rgb_simd(uint32_t *data, const uint8_t *decoded, unsigned width)
+{
+   const __m128i alpha = _mm_set1_epi32(0xff000000);
+   unsigned i = 0;
+   for (; i + 6 <= width; i += 4, decoded += 12) // 16 byte load must stay within the line.
+   {
+      __m128i x  = _mm_loadu_si128((const __m128i*)decoded);
+      __m128i p0 = _mm_unpacklo_epi32(x, _mm_srli_si128(x, 3));
+      __m128i p1 = _mm_unpacklo_epi32(_mm_srli_si128(x, 6), _mm_srli_si128(x, 9));
+      __m128i rgbx = _mm_unpacklo_epi64(p0, p1);
+      _mm_storeu_si128((__m128i*)(data + i), _mm_or_si128(rgba_to_argb(rgbx), alpha));
+   }
+   return i;
+}
+
+static inline unsigned copy_line_rgba_simd(uint32_t *data, const uint8_t *decoded, unsigned width)
+{
+   unsigned i = 0;
+   for (; i + 4 <= width; i += 4, decoded += 16)
+      _mm_storeu_si128((__m128i*)(data + i), rgba_to_argb(_mm_loadu_si128((const __m128i*)decoded)));
+   return i;
+}
+
+static inline unsigned copy_line_gray_simd(uint32_t *data, const uint8_t *decoded, unsigned width)
+{
+   const __m128i alpha = _mm_set1_epi8(0xff);
+   unsigned i = 0;
+   for (; i + 16 <= width; i += 16)
+   {
+      __m128i g  = _mm_loadu_si128((const __m128i*)(decoded + i));
+      __m128i gg = _mm_unpacklo_epi8(g, g);
+      __m128i ga = _mm_unpacklo_epi8(g, alpha);
+      _mm_storeu_si128((__m128i*)(data + i +  0), _mm_unpacklo_epi16(gg, ga));
+      _mm_storeu_si128((__m128i*)(data + i +  4), _mm_unpackhi_epi16(gg, ga));
+      gg = _mm_unpackhi_epi8(g, g);
+      ga = _mm_unpackhi_epi8(g, alpha);
+      _mm_storeu_si128((__m128i*)(data + i +  8), _mm_unpacklo_epi16(gg, ga));
+      _mm_storeu_si128((__m128i*)(data + i + 12), _mm_unpackhi_epi16(gg, ga));
+   }
+   return i;
+}
+#elif defined(RPNG_NEON)
+// See the SSE2 version.
+static inline uint32_t merge_pixel(const uint8_t *buf, uint32_t val, unsigned bpp)
+{
+   if (bpp == 3)
+   {
+      uint32_t old;
+      memcpy(&old, buf, sizeof(old));
+      val = (val & 0x00ffffff) | (old & 0xff000000);
+   }
+   return val;
+}
+
+static inline uint8x8_t load_pixel(const uint8_t *buf)
+{
+   uint32_t val;
+   memcpy(&val, buf, sizeof(val));
+   return vreinterpret_u8_u32(vdup_n_u32(val));
+}
+
+static inline void store_pixel(uint8_t *buf, uint8x8_t pixel, unsigned bpp)
+{
+   uint32_t val = merge_pixel(buf, vget_lane_u32(vreinterpret_u32_u8(pixel), 0), bpp);
+   memcpy(buf, &val, sizeof(val));
+}
+
+static inline unsigned unfilter_sub_simd(uint8_t *line, unsigned pitch, unsigned bpp)
+{
+   uint8x8_t a = vdup_n_u8(0);
+   for (unsigned i = 0; i < pitch; i += bpp)
+   {
+      a = vadd_u8(load_pixel(line + i), a);
+      store_pixel(line + i, a, bpp);
+   }
+   return pitch;
+}
+
+static inline unsigned unfilter_up_simd(uint8_t *line, const uint8_t *prev, unsigned pitch)
+{
+   unsigned i = 0;
+   for (; i + 16 <= pitch; i += 16)
+      vst1q_u8(line + i, vaddq_u8(vld1q_u8(line + i), vld1q_u8(prev + i)));
+   return i;
+}
+
+static inline void unfilter_avg_simd(uint8_t *line, const uint8_t *prev, unsigned pitch, unsigned bpp)
+{
+   uint8x8_t a = vdup_n_u8(0);
+   for (unsigned i = 0; i < pitch; i += bpp)
+   {
+      a = vadd_u8(load_pixel(line + i), vhadd_u8(a, load_pixel(prev + i)));
+      store_pixel(line + i, a, bpp);
+   }
+}
+
+static inline void unfilter_paeth_simd(uint8_t *line, const uint8_t *prev, unsigned pitch, unsigned bpp)
+{
+   uint8x8_t a = vdup_n_u8(0);
+   uint8x8_t c = vdup_n_u8(0);
+   for (unsigned i = 0; i < pitch; i += bpp)
+   {
+      uint8x8_t b = load_pixel(prev + i);
+
+      uint16x8_t pa = vmovl_u8(vabd_u8(b, c));
+      uint16x8_t pb = vmovl_u8(vabd_u8(a, c));
+      uint16x8_t pc = vabdq_u16(vaddl_u8(a, b), vshll_n_u8(c, 1));
+
+      // Ties favor a over b over c.
+      uint8x8_t use_a = vmovn_u16(vandq_u16(vcleq_u16(pa, pb), vcleq_u16(pa, pc)));
+      uint8x8_t use_b = vmovn_u16(vcleq_u16(pb, pc));
+      uint8x8_t nearest = vbsl_u8(use_a, a, vbsl_u8(use_b, b, c));
+
+      a = vadd_u8(load_pixel(line + i), nearest);
+      store_pixel(line + i, a, bpp);
+      c = b;
+   }
+}
+
+static inline unsigned copy_line_rgb_simd(uint32_t *data, const uint8_t *decoded, unsigned width)
+{
+   unsigned i = 0;
+   for (; i + 8 <= width; i += 8, decoded += 24)
+   {
+      uint8x8x3_t rgb = vld3_u8(decoded);
+      uint8x8x4_t argb = {{ rgb.val[2], rgb.val[1], rgb.val[0], vdup_n_u8(0xff) }};
+      vst4_u8((uint8_t*)(data + i), argb);
+   }
+   return i;
+}
+
+static inline unsigned copy_line_rgba_simd(uint32_t *data, const uint8_t *decoded, unsigned width)
+{
+   unsigned i = 0;
+   for (; i + 8 <= width; i += 8, decoded += 32)
+   {
+      uint8x8x4_t rgba = vld4_u8(decoded);
+      uint8x8x4_t argb = {{ rgba.val[2], rgba.val[1], rgba.val[0], rgba.val[3] }};
+      vst4_u8((uint8_t*)(data + i), argb);
+   }
+   return i;
+}
+
+static inline unsigned copy_line_gray_simd(uint32_t *data, const uint8_t *decoded, unsigned width)
+{
+   unsigned i = 0;
+   for (; i + 8 <= width; i += 8)
+   {
+      uint8x8_t g = vld1_u8(decoded + i);
+      uint8x8x4_t argb = {{ g, g, g, vdup_n_u8(0xff) }};
+      vst4_u8((uint8_t*)(data + i), argb);
+   }
+   return i;
+}
+#endif
+
+#if defined(__SSE2__) || defined(RPNG_NEON)
+#define RPNG_SIMD
+#endif
+
+static void unfilter_sub(uint8_t *line, unsigned pitch, unsigned bpp)
+{
+   unsigned i = bpp;
+#ifdef RPNG_SIMD
+   // Constant bpp lets the pixel loads inline.
+   if (bpp == 4)
+      i = unfilter_sub_simd(line, pitch, 4);
+   else if (bpp == 3)
+      i = unfilter_sub_simd(line, pitch, 3);
+   if (i < bpp)
+      i = bpp;
+#endif
+   for (; i < pitch; i++)
+      line[i] += line[i - bpp];
+}
+
+static void unfilter_up(uint8_t *line, const uint8_t *prev, unsigned pitch)
+{
+   unsigned i = 0;
+#ifdef RPNG_SIMD
+   i = unfilter_up_simd(line, prev, pitch);
+#endif
+   for (; i < pitch; i++)
+      line[i] += prev[i];
+}
+
+static void unfilter_avg(uint8_t *line, const uint8_t *prev, unsigned pitch, unsigned bpp)
+{
+#ifdef RPNG_SIMD
+   if (bpp == 4)
+   {
+      unfilter_avg_simd(line, prev, pitch, 4);
+      return;
+   }
+   else if (bpp == 3)
+   {
+      unfilter_avg_simd(line, prev, pitch, 3);
+      return;
+   }
+#endif
+
+   for (unsigned i = 0; i < bpp; i++)
+      line[i] += prev[i] >> 1;
+   for (unsigned i = bpp; i < pitch; i++)
+      line[i] += (line[i - bpp] + prev[i]) >> 1;
+}
+
+static void unfilter_paeth(uint8_t *line, const uint8_t *prev, unsigned pitch, unsigned bpp)
+{
+#ifdef RPNG_SIMD
+   if (bpp == 4)
+   {
+      unfilter_paeth_simd(line, prev, pitch, 4);
+      return;
+   }
+   else if (bpp == 3)
+   {
+      unfilter_paeth_simd(line, prev, pitch, 3);
+      return;
+   }
+#endif
+
+   for (unsigned i = 0; i < bpp; i++)
+      line[i] += paeth(0, prev[i], 0);
+   for (unsigned i = bpp; i < pitch; i++)
+      line[i] += paeth(line[i - bpp], prev[i], prev[i - bpp]);
+}
+
+// Reverses the filter of a scanline in place. prev is the previous (unfiltered) scanline.
+static bool png_unfilter_line(uint8_t *line, const uint8_t *prev,
+      unsigned filter, unsigned pitch, unsigned bpp)
+{
+   switch (filter)
+   {
+      case 0: // None
+         return true;
+
+      case 1: // Sub
+         unfilter_sub(line, pitch, bpp);
+         return true;
+
+      case 2: // Up
+         unfilter_up(line, prev, pitch);
+         return true;
+
+      case 3: // Average
+         unfilter_avg(line, prev, pitch, bpp);
+         return true;
+
+      case 4: // Paeth
+         unfilter_paeth(line, prev, pitch, bpp);
+         return true;
+
+      default:
+         return false;
+   }
+}
+
 static inline void copy_line_rgb(uint32_t *data, const uint8_t *decoded, unsigned width, unsigned bpp)
 {
+   unsigned i = 0;
+#ifdef RPNG_SIMD
+   if (bpp == 8)
+      i = copy_line_rgb_simd(data, decoded, width);
+#endif
+
    bpp /= 8;
-   for (unsigned i = 0; i < width; i++)
+   decoded += i * 3 * bpp;
+   for (; i < width; i++)
    {
       uint32_t r = *decoded;
       decoded += bpp;
@@ -257,8 +667,15 @@ static inline void copy_line_rgb(uint32_t *data, const uint8_t *decoded, unsigne
 
 static inline void copy_line_rgba(uint32_t *data, const uint8_t *decoded, unsigned width, unsigned bpp)
 {
+   unsigned i = 0;
+#ifdef RPNG_SIMD
+   if (bpp == 8)
+      i = copy_line_rgba_simd(data, decoded, width);
+#endif
+
    bpp /= 8;
-   for (unsigned i = 0; i < width; i++)
+   decoded += i * 4 * bpp;
+   for (; i < width; i++)
    {
       uint32_t r = *decoded;
       decoded += bpp;
@@ -282,6 +699,15 @@ static inline void copy_line_bw(uint32_t *data, const uint8_t *decoded, unsigned
          data[i] = (val * 0x010101) | (0xffu << 24);
       }
    }
+   else if (depth == 8)
+   {
+      unsigned i = 0;
+#ifdef RPNG_SIMD
+      i = copy_line_gray_simd(data, decoded, width);
+#endif
+      for (; i < width; i++)
+         data[i] = (decoded[i] * 0x010101) | (0xffu << 24);
+   }
    else
    {
       static const unsigned mul_table[] = { 0, 0xff, 0x55, 0, 0x11, 0, 0, 0, 0x01 };
@@ -326,9 +752,23 @@ static inline void copy_line_plt(uint32_t *data, const uint8_t *decoded, unsigne
    }
 }
 
+static void png_copy_line(uint32_t *data, const uint8_t *decoded,
+      const struct png_ihdr *ihdr, unsigned width, const uint32_t *palette)
+{
+   if (ihdr->color_type == 0)
+      copy_line_bw(data, decoded, width, ihdr->depth);
+   else if (ihdr->color_type == 2)
+      copy_line_rgb(data, decoded, width, ihdr->depth);
+   else if (ihdr->color_type == 3)
+      copy_line_plt(data, decoded, width, ihdr->depth, palette);
+   else if (ihdr->color_type == 4)
+      copy_line_gray_alpha(data, decoded, width, ihdr->depth);
+   else if (ihdr->color_type == 6)
+      copy_line_rgba(data, decoded, width, ihdr->depth);
+}
+
 static void png_pass_geom(const struct png_ihdr *ihdr,
-      unsigned width, unsigned height,
-      unsigned *bpp_out, unsigned *pitch_out, size_t *pass_size)
+      unsigned width, unsigned *bpp_out, unsigned *pitch_out)
 {
    unsigned bpp;
    unsigned pitch;
@@ -336,27 +776,27 @@ static void png_pass_geom(const struct png_ihdr *ihdr,
    {
       case 0:
          bpp = (ihdr->depth + 7) / 8;
-         pitch = (ihdr->width * ihdr->depth + 7) / 8;
+         pitch = (width * ihdr->depth + 7) / 8;
          break;
 
       case 2:
          bpp = (ihdr->depth * 3 + 7) / 8;
-         pitch = (ihdr->width * ihdr->depth * 3 + 7) / 8;
+         pitch = (width * ihdr->depth * 3 + 7) / 8;
          break;
 
       case 3:
          bpp = (ihdr->depth + 7) / 8;
-         pitch = (ihdr->width * ihdr->depth + 7) / 8;
+         pitch = (width * ihdr->depth + 7) / 8;
          break;
 
       case 4:
          bpp = (ihdr->depth * 2 + 7) / 8;
-         pitch = (ihdr->width * ihdr->depth * 2 + 7) / 8;
+         pitch = (width * ihdr->depth * 2 + 7) / 8;
          break;
 
       case 6:
          bpp = (ihdr->depth * 4 + 7) / 8;
-         pitch = (ihdr->width * ihdr->depth * 4 + 7) / 8;
+         pitch = (width * ihdr->depth * 4 + 7) / 8;
          break;
 
       default:
@@ -365,98 +805,95 @@ static void png_pass_geom(const struct png_ihdr *ihdr,
          break;
    }
 
-   if (pass_size)
-      *pass_size = (pitch + 1) * ihdr->height;
    if (bpp_out)
       *bpp_out = bpp;
    if (pitch_out)
       *pitch_out = pitch;
 }
 
-
-static bool png_reverse_filter(uint32_t *data, const struct png_ihdr *ihdr,
-      const uint8_t *inflate_buf, size_t inflate_buf_size, const uint32_t *palette)
+// Feeds the zlib stream spread over consecutive IDAT chunks to inflate.
+struct idat_stream
 {
-   bool ret = true;
+   FILE *file;
+   z_stream stream;
 
-   unsigned bpp;
-   unsigned pitch;
-   size_t pass_size;
-   png_pass_geom(ihdr, ihdr->width, ihdr->height, &bpp, &pitch, &pass_size);
+   // Bytes of the current IDAT chunk not read yet.
+   uint32_t chunk_left;
+   // The chunk following the last IDAT was reached, and the file is positioned at its header.
+   bool end;
 
-   if (inflate_buf_size < pass_size)
-      return false;
+   uint8_t in[16 * 1024];
+};
 
-   uint8_t *prev_scanline    = (uint8_t*)calloc(1, pitch);
-   uint8_t *decoded_scanline = (uint8_t*)calloc(1, pitch);
+static bool idat_stream_refill(struct idat_stream *idat)
+{
+   while (!idat->chunk_left)
+   {
+      if (idat->end)
+         return false;
 
-   if (!decoded_scanline || !decoded_scanline)
-      GOTO_END_ERROR();
+      // Skip CRC of the current chunk.
+      struct png_chunk chunk = {0};
+      if (fseek(idat->file, sizeof(uint32_t), SEEK_CUR) < 0)
+         return false;
+      if (!read_chunk_header(idat->file, &chunk))
+         return false;
 
-   for (unsigned h = 0; h < ihdr->height;
-         h++, inflate_buf += pitch, data += ihdr->width)
-   {
-      unsigned filter = *inflate_buf++;
-      switch (filter)
+      if (png_chunk_type(&chunk) != PNG_CHUNK_IDAT)
       {
-         case 0: // None
-            memcpy(decoded_scanline, inflate_buf, pitch);
-            break;
+         // Leave the chunk to the main parser.
+         fseek(idat->file, -8, SEEK_CUR);
+         idat->end = true;
+         return false;
+      }
 
-         case 1: // Sub
-            for (unsigned i = 0; i < bpp; i++)
-               decoded_scanline[i] = inflate_buf[i];
-            for (unsigned i = bpp; i < pitch; i++)
-               decoded_scanline[i] = decoded_scanline[i - bpp] + inflate_buf[i];
-            break;
+      idat->chunk_left = chunk.size;
+   }
 
-         case 2: // Up
-            for (unsigned i = 0; i < pitch; i++)
-               decoded_scanline[i] = prev_scanline[i] + inflate_buf[i];
-            break;
+   size_t size = idat->chunk_left < sizeof(idat->in) ? idat->chunk_left : sizeof(idat->in);
+   if (fread(idat->in, 1, size, idat->file) != size)
+      return false;
 
-         case 3: // Average
-            for (unsigned i = 0; i < bpp; i++)
-            {
-               uint8_t avg = prev_scanline[i] >> 1;
-               decoded_scanline[i] = avg + inflate_buf[i];
-            }
-            for (unsigned i = bpp; i < pitch; i++)
-            {
-               uint8_t avg = (decoded_scanline[i - bpp] + prev_scanline[i]) >> 1;
-               decoded_scanline[i] = avg + inflate_buf[i];
-            }
-            break;
+   idat->chunk_left      -= size;
+   idat->stream.next_in   = idat->in;
+   idat->stream.avail_in  = size;
+   return true;
+}
 
-         case 4: // Paeth
-            for (unsigned i = 0; i < bpp; i++)
-               decoded_scanline[i] = paeth(0, prev_scanline[i], 0) + inflate_buf[i];
-            for (unsigned i = bpp; i < pitch; i++)
-               decoded_scanline[i] = paeth(decoded_scanline[i - bpp], prev_scanline[i], prev_scanline[i - bpp]) + inflate_buf[i];
-            break;
+static bool idat_stream_read(struct idat_stream *idat, uint8_t *data, size_t size)
+{
+   idat->stream.next_out  = data;
+   idat->stream.avail_out = size;
 
-         default:
-            GOTO_END_ERROR();
-      }
+   while (idat->stream.avail_out)
+   {
+      if (!idat->stream.avail_in && !idat_stream_refill(idat))
+         return false;
 
-      if (ihdr->color_type == 0)
-         copy_line_bw(data, decoded_scanline, ihdr->width, ihdr->depth);
-      else if (ihdr->color_type == 2)
-         copy_line_rgb(data, decoded_scanline, ihdr->width, ihdr->depth);
-      else if (ihdr->color_type == 3)
-         copy_line_plt(data, decoded_scanline, ihdr->width, ihdr->depth, palette);
-      else if (ihdr->color_type == 4)
-         copy_line_gray_alpha(data, decoded_scanline, ihdr->width, ihdr->depth);
-      else if (ihdr->color_type == 6)
-         copy_line_rgba(data, decoded_scanline, ihdr->width, ihdr->depth);
-
-      memcpy(prev_scanline, decoded_scanline, pitch);
+      int status = inflate(&idat->stream, Z_NO_FLUSH);
+      if (status == Z_STREAM_END)
+         return !idat->stream.avail_out;
+      if (status != Z_OK)
+         return false;
    }
 
-end:
-   free(decoded_scanline);
-   free(prev_scanline);
-   return ret;
+   return true;
+}
+
+// Positions the file after the last IDAT chunk. Trailing data in the zlib stream is ignored.
+static bool idat_stream_finish(struct idat_stream *idat)
+{
+   while (!idat->end)
+   {
+      if (fseek(idat->file, idat->chunk_left, SEEK_CUR) < 0)
+         return false;
+      idat->chunk_left = 0;
+
+      // A file cut off before the chunk after the last IDAT never sets end.
+      if (!idat_stream_refill(idat) && !idat->end)
+         return false;
+   }
+   return true;
 }
 
 struct adam7_pass
@@ -467,21 +904,55 @@ struct adam7_pass
    unsigned stride_y;
 };
 
-static void deinterlace_pass(uint32_t *data, const struct png_ihdr *ihdr,
-      const uint32_t *input, unsigned pass_width, unsigned pass_height, const struct adam7_pass *pass)
+// line and prev hold a full scanline including filter byte.
+// line32 is scratch for interlaced passes.
+static bool png_decode_pass(struct idat_stream *idat, uint32_t *data,
+      const struct png_ihdr *ihdr, const struct adam7_pass *pass, const uint32_t *palette,
+      uint8_t *line, uint8_t *prev, uint32_t *line32)
 {
+   if (ihdr->width <= pass->x || ihdr->height <= pass->y) // Empty pass
+      return true;
+
+   unsigned pass_width  = (ihdr->width - pass->x + pass->stride_x - 1) / pass->stride_x;
+   unsigned pass_height = (ihdr->height - pass->y + pass->stride_y - 1) / pass->stride_y;
+
+   unsigned bpp;
+   unsigned pitch;
+   png_pass_geom(ihdr, pass_width, &bpp, &pitch);
+   memset(prev, 0, pitch + 1);
+
    data += pass->y * ihdr->width + pass->x;
-   for (unsigned y = 0; y < pass_height; y++, data += ihdr->width * pass->stride_y, input += pass_width)
+   for (unsigned h = 0; h < pass_height; h++, data += ihdr->width * pass->stride_y)
    {
-      uint32_t *out = data;
-      for (unsigned x = 0; x < pass_width; x++, out += pass->stride_x)
-         *out = input[x];
+      if (!idat_stream_read(idat, line, pitch + 1))
+         return false;
+
+      if (!png_unfilter_line(line + 1, prev + 1, line[0], pitch, bpp))
+         return false;
+
+      if (pass->stride_x == 1)
+         png_copy_line(data, line + 1, ihdr, pass_width, palette);
+      else
+      {
+         png_copy_line(line32, line + 1, ihdr, pass_width, palette);
+         for (unsigned x = 0; x < pass_width; x++)
+            data[x * pass->stride_x] = line32[x];
+      }
+
+      uint8_t *tmp = prev;
+      prev = line;
+      line = tmp;
    }
+
+   return true;
 }
 
-static bool png_reverse_filter_adam7(uint32_t *data, const struct png_ihdr *ihdr,
-      const uint8_t *inflate_buf, size_t inflate_buf_size, const uint32_t *palette)
+// Decodes the image, starting with an IDAT chunk of size bytes.
+// On return, the file is positioned at the chunk following the last IDAT.
+static bool png_decode_idat(FILE *file, uint32_t size, const struct png_ihdr *ihdr,
+      const uint32_t *palette, uint32_t *data)
 {
+   static const struct adam7_pass progressive = { 0, 0, 1, 1 };
    static const struct adam7_pass passes[] = {
       { 0, 0, 8, 8 },
       { 4, 0, 8, 8 },
@@ -492,60 +963,56 @@ static bool png_reverse_filter_adam7(uint32_t *data, const struct png_ihdr *ihdr
       { 0, 1, 1, 2 },
    };
 
-   for (unsigned pass = 0; pass < ARRAY_SIZE(passes); pass++)
-   {
-      if (ihdr->width <= passes[pass].x || ihdr->height <= passes[pass].y) // Empty pass
-         continue;
+   bool ret = true;
+   uint8_t *lines  = NULL;
+   uint32_t *line32 = NULL;
 
-      unsigned pass_width  = (ihdr->width - passes[pass].x + passes[pass].stride_x - 1) / passes[pass].stride_x;
-      unsigned pass_height = (ihdr->height - passes[pass].y + passes[pass].stride_y - 1) / passes[pass].stride_y;
+   struct idat_stream *idat = (struct idat_stream*)calloc(1, sizeof(*idat));
+   if (!idat)
+      return false;
 
-      uint32_t *tmp_data = (uint32_t*)malloc(pass_width * pass_height * sizeof(uint32_t));
-      if (!tmp_data)
-         return false;
+   idat->file       = file;
+   idat->chunk_left = size;
+   if (inflateInit(&idat->stream) != Z_OK)
+   {
+      free(idat);
+      return false;
+   }
 
-      struct png_ihdr tmp_ihdr = *ihdr;
-      tmp_ihdr.width = pass_width;
-      tmp_ihdr.height = pass_height;
+   unsigned pitch;
+   png_pass_geom(ihdr, ihdr->width, NULL, &pitch);
 
-      size_t pass_size;
-      png_pass_geom(&tmp_ihdr, pass_width, pass_height, NULL, NULL, &pass_size);
+   // Padded for dword pixel access.
+   lines = (uint8_t*)calloc(1, 2 * (pitch + 1) + sizeof(uint32_t));
+   if (!lines)
+      GOTO_END_ERROR();
 
-      if (pass_size > inflate_buf_size)
-      {
-         free(tmp_data);
-         return false;
-      }
+   if (ihdr->interlace == 1)
+   {
+      line32 = (uint32_t*)malloc(ihdr->width * sizeof(uint32_t));
+      if (!line32)
+         GOTO_END_ERROR();
 
-      if (!png_reverse_filter(tmp_data, &tmp_ihdr, inflate_buf, pass_size, palette))
+      for (unsigned i = 0; i < ARRAY_SIZE(passes); i++)
       {
-         free(tmp_data);
-         return false;
+         if (!png_decode_pass(idat, data, ihdr, &passes[i], palette,
+                  lines, lines + pitch + 1, line32))
+            GOTO_END_ERROR();
       }
-
-      inflate_buf += pass_size;
-      inflate_buf_size -= pass_size;
-
-      deinterlace_pass(data, ihdr, tmp_data, pass_width, pass_height, &passes[pass]);
-      free(tmp_data);
    }
+   else if (!png_decode_pass(idat, data, ihdr, &progressive, palette,
+            lines, lines + pitch + 1, NULL))
+      GOTO_END_ERROR();
 
-   return true;
-}
-
-static bool png_append_idat(FILE *file, const struct png_chunk *chunk, struct idat_buffer *buf)
-{
-   uint8_t *new_buffer = (uint8_t*)realloc(buf->data, buf->size + chunk->size);
-   if (!new_buffer)
-      return false;
+   if (!idat_stream_finish(idat))
+      GOTO_END_ERROR();
 
-   buf->data  = new_buffer;
-   if (fread(buf->data + buf->size, 1, chunk->size, file) != chunk->size)
-      return false;
-   if (fseek(file, sizeof(uint32_t), SEEK_CUR) < 0)
-      return false;
-   buf->size += chunk->size;
-   return true;
+end:
+   inflateEnd(&idat->stream);
+   free(idat);
+   free(lines);
+   free(line32);
+   return ret;
 }
 
 static bool png_read_plte(FILE *file, uint32_t *buffer, unsigned entries)
@@ -590,11 +1057,7 @@ bool rpng_load_image_argb(const char *path, uint32_t **data, unsigned *width, un
    bool has_idat = false;
    bool has_iend = false;
    bool has_plte = false;
-   uint8_t *inflate_buf = NULL;
-   size_t inflate_buf_size = 0;
-   z_stream stream = {0};
 
-   struct idat_buffer idat_buf = {0};
    struct png_ihdr ihdr = {0};
    uint32_t palette[256] = {0};
 
@@ -647,10 +1110,15 @@ bool rpng_load_image_argb(const char *path, uint32_t **data, unsigned *width, un
             break;
 
          case PNG_CHUNK_IDAT:
-            if (!has_ihdr || has_iend || (ihdr.color_type == 3 && !has_plte))
+            // IDAT chunks must be consecutive, and are all consumed by the decoder.
+            if (!has_ihdr || has_idat || has_iend || (ihdr.color_type == 3 && !has_plte))
+               GOTO_END_ERROR();
+
+            *data = (uint32_t*)malloc(ihdr.width * ihdr.height * sizeof(uint32_t));
+            if (!*data)
                GOTO_END_ERROR();
 
-            if (!png_append_idat(file, &chunk, &idat_buf))
+            if (!png_decode_idat(file, chunk.size, &ihdr, palette, *data))
                GOTO_END_ERROR();
 
             has_idat = true;
@@ -671,50 +1139,17 @@ bool rpng_load_image_argb(const char *path, uint32_t **data, unsigned *width, un
    if (!has_ihdr || !has_idat || !has_iend)
       GOTO_END_ERROR();
 
-   if (inflateInit(&stream) != Z_OK)
-      GOTO_END_ERROR();
-
-   png_pass_geom(&ihdr, ihdr.width, ihdr.height, NULL, NULL, &inflate_buf_size);
-   if (ihdr.interlace == 1) // To be sure.
-      inflate_buf_size *= 2;
-
-   inflate_buf = (uint8_t*)malloc(inflate_buf_size);
-   if (!inflate_buf)
-      GOTO_END_ERROR();
-
-   stream.next_in   = idat_buf.data;
-   stream.avail_in  = idat_buf.size;
-   stream.avail_out = inflate_buf_size;
-   stream.next_out  = inflate_buf;
-
-   if (inflate(&stream, Z_FINISH) != Z_STREAM_END)
-   {
-      inflateEnd(&stream);
-      GOTO_END_ERROR();
-   }
-   inflateEnd(&stream);
-
    *width  = ihdr.width;
    *height = ihdr.height;
-   *data = (uint32_t*)malloc(ihdr.width * ihdr.height * sizeof(uint32_t));
-   if (!*data)
-      GOTO_END_ERROR();
-
-   if (ihdr.interlace == 1)
-   {
-      if (!png_reverse_filter_adam7(*data, &ihdr, inflate_buf, stream.total_out, palette))
-         GOTO_END_ERROR();
-   }
-   else if (!png_reverse_filter(*data, &ihdr, inflate_buf, stream.total_out, palette))
-      GOTO_END_ERROR();
 
 end:
    if (file)
       fclose(file);
    if (!ret)
+   {
       free(*data);
-   free(idat_buf.data);
-   free(inflate_buf);
+      *data = NULL;
+   }
    return ret;
 }
 
@@ -866,69 +1301,83 @@ static unsigned filter_paeth(uint8_t *target, const uint8_t *line, const uint8_t
    return count_sad(target, width);
 }
 
-static bool rpng_save_image(const char *path, const uint8_t *data,
-      unsigned width, unsigned height, unsigned pitch, unsigned bpp)
+// Deflate input is split into chunks which are compressed independently,
+// each primed with the tail of the previous chunk as dictionary.
+#define RPNG_DEFLATE_CHUNK (128 * 1024)
+#define RPNG_DEFLATE_WINDOW (32 * 1024)
+
+struct rpng_deflate_chunk
 {
-   bool ret = true;
-   struct png_ihdr ihdr = {0};
+   uint8_t *data;
+   size_t size;
+   uint32_t adler;
+   bool ok;
+};
 
-   size_t encode_buf_size  = 0;
-   uint8_t *encode_buf     = NULL;
-   uint8_t *deflate_buf    = NULL;
-   uint8_t *rgba_line      = NULL;
-   uint8_t *up_filtered    = NULL;
-   uint8_t *sub_filtered   = NULL;
-   uint8_t *avg_filtered   = NULL;
-   uint8_t *paeth_filtered = NULL;
-   uint8_t *prev_encoded   = NULL;
-   uint8_t *encode_target  = NULL;
+struct rpng_encoder
+{
+   const uint8_t *data;
+   unsigned width;
+   unsigned height;
+   unsigned pitch;
+   unsigned bpp;
 
-   z_stream stream = {0};
+   uint8_t *encode_buf;
+   size_t encode_buf_size;
 
-   FILE *file = fopen(path, "wb");
-   if (!file)
-      GOTO_END_ERROR();
+   struct rpng_deflate_chunk *chunks;
+   unsigned num_chunks;
 
-   if (fwrite(png_magic, 1, sizeof(png_magic), file) != sizeof(png_magic))
-      GOTO_END_ERROR();
+   bool ok;
+};
 
-   ihdr.width = width;
-   ihdr.height = height;
-   ihdr.depth = 8;
-   ihdr.color_type = bpp == sizeof(uint32_t) ? 6 : 2; // RGBA or RGB
-   if (!png_write_ihdr(file, &ihdr))
-      GOTO_END_ERROR();
+static void copy_line(const struct rpng_encoder *enc, uint8_t *dst, unsigned line)
+{
+   const uint8_t *src = enc->data + line * enc->pitch;
+   if (enc->bpp == sizeof(uint32_t))
+      copy_argb_line(dst, (const uint32_t*)src, enc->width);
+   else
+      copy_bgr24_line(dst, src, enc->width);
+}
 
-   encode_buf_size = (width * bpp + 1) * height;
-   encode_buf = (uint8_t*)malloc(encode_buf_size);
-   if (!encode_buf)
-      GOTO_END_ERROR();
+// Filters lines [first, last). Filters only depend on the unfiltered previous line,
+// so bands can be filtered concurrently.
+static void rpng_filter_lines(void *data, unsigned first, unsigned last)
+{
+   struct rpng_encoder *enc = (struct rpng_encoder*)data;
+   if (first >= last)
+      return;
 
-   prev_encoded = (uint8_t*)calloc(1, width * bpp);
-   if (!prev_encoded)
-      GOTO_END_ERROR();
+   unsigned width = enc->width;
+   unsigned bpp   = enc->bpp;
+   size_t size    = width * bpp;
 
-   rgba_line      = (uint8_t*)malloc(width * bpp);
-   up_filtered    = (uint8_t*)malloc(width * bpp);
-   sub_filtered   = (uint8_t*)malloc(width * bpp);
-   avg_filtered   = (uint8_t*)malloc(width * bpp);
-   paeth_filtered = (uint8_t*)malloc(width * bpp);
-   if (!rgba_line || !up_filtered || !sub_filtered || !avg_filtered || !paeth_filtered)
-      GOTO_END_ERROR();
+   uint8_t *scratch = (uint8_t*)calloc(6, size);
+   if (!scratch)
+   {
+      enc->ok = false;
+      return;
+   }
+
+   uint8_t *rgba_line      = scratch + 0 * size;
+   uint8_t *prev_encoded   = scratch + 1 * size;
+   uint8_t *up_filtered    = scratch + 2 * size;
+   uint8_t *sub_filtered   = scratch + 3 * size;
+   uint8_t *avg_filtered   = scratch + 4 * size;
+   uint8_t *paeth_filtered = scratch + 5 * size;
 
-   encode_target = encode_buf;
-   for (unsigned h = 0; h < height;
-         h++, encode_target += width * bpp, data += pitch)
+   if (first > 0)
+      copy_line(enc, prev_encoded, first - 1);
+
+   uint8_t *encode_target = enc->encode_buf + first * (size + 1);
+   for (unsigned h = first; h < last; h++, encode_target += size)
    {
-      if (bpp == sizeof(uint32_t))
-         copy_argb_line(rgba_line, (const uint32_t*)data, width);
-      else
-         copy_bgr24_line(rgba_line, data, width);
+      copy_line(enc, rgba_line, h);
 
       // Try every filtering method, and choose the method
       // which has most entries as zero.
       // This is probably not very optimal, but it's very simple to implement.
-      unsigned none_score  = count_sad(rgba_line, width * bpp);
+      unsigned none_score  = count_sad(rgba_line, size);
       unsigned up_score    = filter_up(up_filtered, rgba_line, prev_encoded, width, bpp);
       unsigned sub_score   = filter_sub(sub_filtered, rgba_line, width, bpp);
       unsigned avg_score   = filter_avg(avg_filtered, rgba_line, prev_encoded, width, bpp);
@@ -967,31 +1416,153 @@ static bool rpng_save_image(const char *path, const uint8_t *data,
       }
 
       *encode_target++ = filter;
-      memcpy(encode_target, chosen_filtered, width * bpp);
+      memcpy(encode_target, chosen_filtered, size);
 
-      memcpy(prev_encoded, rgba_line, width * bpp);
+      memcpy(prev_encoded, rgba_line, size);
    }
 
-   deflate_buf = (uint8_t*)malloc(encode_buf_size * 2); // Just to be sure.
-   if (!deflate_buf)
-      GOTO_END_ERROR();
+   free(scratch);
+}
 
-   stream.next_in   = encode_buf;
-   stream.avail_in  = encode_buf_size;
-   stream.next_out  = deflate_buf + 8;
-   stream.avail_out = encode_buf_size * 2;
+// Compresses chunks [first, last) as raw deflate.
+// Every chunk but the last ends on a byte boundary (sync flush),
+// so the compressed chunks can simply be concatenated.
+static void rpng_deflate_chunks(void *data, unsigned first, unsigned last)
+{
+   struct rpng_encoder *enc = (struct rpng_encoder*)data;
 
-   deflateInit(&stream, 9);
-   if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+   for (unsigned i = first; i < last; i++)
    {
+      struct rpng_deflate_chunk *chunk = &enc->chunks[i];
+      size_t offset = (size_t)i * RPNG_DEFLATE_CHUNK;
+      size_t size   = enc->encode_buf_size - offset;
+      if (size > RPNG_DEFLATE_CHUNK)
+         size = RPNG_DEFLATE_CHUNK;
+      bool final = i + 1 == enc->num_chunks;
+
+      const uint8_t *in = enc->encode_buf + offset;
+      chunk->adler = adler32(adler32(0, NULL, 0), in, size);
+
+      z_stream stream = {0};
+      if (deflateInit2(&stream, 9, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+         continue;
+
+      size_t bound = deflateBound(&stream, size) + 16; // Sync flush marker.
+      chunk->data = (uint8_t*)malloc(bound);
+      if (!chunk->data)
+      {
+         deflateEnd(&stream);
+         continue;
+      }
+
+      if (offset)
+      {
+         size_t dict = offset < RPNG_DEFLATE_WINDOW ? offset : RPNG_DEFLATE_WINDOW;
+         deflateSetDictionary(&stream, in - dict, dict);
+      }
+
+      stream.next_in   = (uint8_t*)in;
+      stream.avail_in  = size;
+      stream.next_out  = chunk->data;
+      stream.avail_out = bound;
+
+      int status = deflate(&stream, final ? Z_FINISH : Z_SYNC_FLUSH);
+      chunk->ok   = final ? status == Z_STREAM_END : (status == Z_OK && stream.avail_out);
+      chunk->size = stream.total_out;
       deflateEnd(&stream);
+   }
+}
+
+static void rpng_run_serial(void *userdata, rpng_range_func_t func, void *data, unsigned count)
+{
+   (void)userdata;
+   func(data, 0, count);
+}
+
+static bool rpng_save_image(const char *path, const uint8_t *data,
+      unsigned width, unsigned height, unsigned pitch, unsigned bpp,
+      rpng_run_parallel_t run, void *userdata)
+{
+   bool ret = true;
+   struct png_ihdr ihdr = {0};
+   struct rpng_encoder enc = {0};
+
+   uint8_t *deflate_buf = NULL;
+   uint8_t *deflate_ptr = NULL;
+   size_t deflate_size  = 0;
+   uint32_t adler       = adler32(0, NULL, 0);
+
+   if (!run)
+      run = rpng_run_serial;
+
+   FILE *file = fopen(path, "wb");
+   if (!file)
+      GOTO_END_ERROR();
+
+   if (fwrite(png_magic, 1, sizeof(png_magic), file) != sizeof(png_magic))
+      GOTO_END_ERROR();
+
+   ihdr.width = width;
+   ihdr.height = height;
+   ihdr.depth = 8;
+   ihdr.color_type = bpp == sizeof(uint32_t) ? 6 : 2; // RGBA or RGB
+   if (!png_write_ihdr(file, &ihdr))
       GOTO_END_ERROR();
+
+   enc.data   = data;
+   enc.width  = width;
+   enc.height = height;
+   enc.pitch  = pitch;
+   enc.bpp    = bpp;
+   enc.ok     = true;
+
+   enc.encode_buf_size = (width * bpp + 1) * height;
+   enc.encode_buf = (uint8_t*)malloc(enc.encode_buf_size);
+   if (!enc.encode_buf)
+      GOTO_END_ERROR();
+
+   run(userdata, rpng_filter_lines, &enc, height);
+   if (!enc.ok)
+      GOTO_END_ERROR();
+
+   enc.num_chunks = (enc.encode_buf_size + RPNG_DEFLATE_CHUNK - 1) / RPNG_DEFLATE_CHUNK;
+   enc.chunks = (struct rpng_deflate_chunk*)calloc(enc.num_chunks, sizeof(*enc.chunks));
+   if (!enc.chunks)
+      GOTO_END_ERROR();
+
+   run(userdata, rpng_deflate_chunks, &enc, enc.num_chunks);
+
+   for (unsigned i = 0; i < enc.num_chunks; i++)
+   {
+      if (!enc.chunks[i].ok)
+         GOTO_END_ERROR();
+      deflate_size += enc.chunks[i].size;
    }
-   deflateEnd(&stream);
+
+   // IDAT header, zlib header, deflate stream, Adler-32.
+   deflate_buf = (uint8_t*)malloc(8 + 2 + deflate_size + 4);
+   if (!deflate_buf)
+      GOTO_END_ERROR();
+
+   deflate_ptr = deflate_buf + 8;
+   *deflate_ptr++ = 0x78; // Deflate, 32K window.
+   *deflate_ptr++ = 0xda; // Maximum compression, no preset dictionary.
+
+   for (unsigned i = 0; i < enc.num_chunks; i++)
+   {
+      size_t size = enc.encode_buf_size - (size_t)i * RPNG_DEFLATE_CHUNK;
+      if (size > RPNG_DEFLATE_CHUNK)
+         size = RPNG_DEFLATE_CHUNK;
+
+      memcpy(deflate_ptr, enc.chunks[i].data, enc.chunks[i].size);
+      deflate_ptr += enc.chunks[i].size;
+      adler = adler32_combine(adler, enc.chunks[i].adler, size);
+   }
+   dword_write_be(deflate_ptr, adler);
 
    memcpy(deflate_buf + 4, "IDAT", 4);
-   dword_write_be(deflate_buf + 0, stream.total_out);
-   if (!png_write_idat(file, deflate_buf, stream.total_out + 8))
+   dword_write_be(deflate_buf + 0, 2 + deflate_size + 4);
+   if (!png_write_idat(file, deflate_buf, 8 + 2 + deflate_size + 4))
       GOTO_END_ERROR();
 
    if (!png_write_iend(file))
@@ -1000,27 +1571,34 @@ static bool rpng_save_image(const char *path, const uint8_t *data,
 end:
    if (file)
       fclose(file);
-   free(encode_buf);
+   if (enc.chunks)
+   {
+      for (unsigned i = 0; i < enc.num_chunks; i++)
+         free(enc.chunks[i].data);
+   }
+   free(enc.chunks);
+   free(enc.encode_buf);
    free(deflate_buf);
-   free(rgba_line);
-   free(prev_encoded);
-   free(up_filtered);
-   free(sub_filtered);
-   free(avg_filtered);
-   free(paeth_filtered);
    return ret;
 }
 
 bool rpng_save_image_argb(const char *path, const uint32_t *data,
       unsigned width, unsigned height, unsigned pitch)
 {
-   return rpng_save_image(path, (const uint8_t*)data, width, height, pitch, sizeof(uint32_t));
+   return rpng_save_image(path, (const uint8_t*)data, width, height, pitch, sizeof(uint32_t), NULL, NULL);
 }
 
 bool rpng_save_image_bgr24(const char *path, const uint8_t *data,
       unsigned width, unsigned height, unsigned pitch)
 {
-   return rpng_save_image(path, (const uint8_t*)data, width, height, pitch, 3);
+   return rpng_save_image(path, data, width, height, pitch, 3, NULL, NULL);
+}
+
+bool rpng_save_image_bgr24_parallel(const char *path, const uint8_t *data,
+      unsigned width, unsigned height, unsigned pitch,
+      rpng_run_parallel_t run, void *userdata)
+{
+   return rpng_save_image(path, data, width, height, pitch, 3, run, userdata);
 }
 
 #endif
@@ -30,10 +30,23 @@ extern "C" {
 bool rpng_load_image_argb(const char *path, uint32_t **data, unsigned *width, unsigned *height);
 
 #ifdef HAVE_ZLIB_DEFLATE
+// Processes items [first, last).
+typedef void (*rpng_range_func_t)(void *data, unsigned first, unsigned last);
+
+// Runs func over [0, count), possibly split into disjoint ranges which are processed concurrently.
+// Must not return before every range is done.
+typedef void (*rpng_run_parallel_t)(void *userdata, rpng_range_func_t func, void *data, unsigned count);
+
 bool rpng_save_image_argb(const char *path, const uint32_t *data,
       unsigned width, unsigned height, unsigned pitch);
 bool rpng_save_image_bgr24(const char *path, const uint8_t *data,
       unsigned width, unsigned height, unsigned pitch);
+
+// Row filtering and compression are spread over run.
+// Output is identical regardless of how run splits the work.
+bool rpng_save_image_bgr24_parallel(const char *path, const uint8_t *data,
+      unsigned width, unsigned height, unsigned pitch,
+      rpng_run_parallel_t run, void *userdata);
 #endif
 
 #ifdef __cplusplus
@@ -1,6 +1,6 @@
 /*  RetroArch - A frontend for libretro.
  *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
- * 
+ *
  *  RetroArch is free software: you can redistribute it and/or modify it under the terms
  *  of the GNU General Public License as published by the Free Software Found-
  *  ation, either version 3 of the License, or (at your option) any later version.
@@ -13,655 +13,1884 @@
  *  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "pixconv.h"
-#include <stdint.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
+#include "pixconv.h"
+#include "../../performance.h"
+#include "../../boolean.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// SIMD implementations are compiled in regardless of compiler flags where the compiler
+// lets us target instruction sets per function, and are selected at runtime in conv_init_simd().
+#if !defined(SCALER_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) && !defined(_XBOX)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#define PIXCONV_TARGET(isa) __attribute__((target(isa)))
+#define PIXCONV_SSE2
+#define PIXCONV_SSSE3
+#define PIXCONV_AVX2
+#elif defined(_MSC_VER)
+#define PIXCONV_TARGET(isa)
+#define PIXCONV_SSE2
+#if _MSC_VER >= 1500
+#define PIXCONV_SSSE3
+#endif
+#if _MSC_VER >= 1800
+#define PIXCONV_AVX2
+#endif
+#else
+#define PIXCONV_TARGET(isa)
+#if defined(__SSE2__)
+#define PIXCONV_SSE2
+#endif
+#if defined(__SSSE3__)
+#define PIXCONV_SSSE3
+#endif
+#if defined(__AVX2__)
+#define PIXCONV_AVX2
+#endif
+#endif
+#endif
+
+#if !defined(SCALER_NO_SIMD) && defined(HAVE_NEON) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define PIXCONV_NEON
+#endif
+
+#if defined(PIXCONV_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(PIXCONV_SSSE3)
+#include <tmmintrin.h>
+#endif
+#if defined(PIXCONV_AVX2)
+#include <immintrin.h>
+#endif
+#if defined(PIXCONV_NEON)
+#include <arm_neon.h>
+#endif
+
+// Single pixel conversions. Used by the C implementations and for the remainder of SIMD rows.
+static inline uint32_t pix_0rgb1555_argb8888(uint16_t col)
+{
+   uint32_t r = (col >> 10) & 0x1f;
+   uint32_t g = (col >>  5) & 0x1f;
+   uint32_t b = (col >>  0) & 0x1f;
+   r = (r << 3) | (r >> 2);
+   g = (g << 3) | (g >> 2);
+   b = (b << 3) | (b >> 2);
+
+   return (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
+}
+
+static inline uint32_t pix_rgb565_argb8888(uint16_t col)
+{
+   uint32_t r = (col >> 11) & 0x1f;
+   uint32_t g = (col >>  5) & 0x3f;
+   uint32_t b = (col >>  0) & 0x1f;
+   r = (r << 3) | (r >> 2);
+   g = (g << 2) | (g >> 4);
+   b = (b << 3) | (b >> 2);
+
+   return (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
+}
+
+static inline uint16_t pix_0rgb1555_rgb565(uint16_t col)
+{
+   uint16_t rg = (col << 1) & ((0x1f << 11) | (0x1f << 6));
+   uint16_t b = col & 0x1f;
+   uint16_t glow = (col >> 4) & (1 << 5);
+   return rg | b | glow;
+}
+
+static inline uint16_t pix_rgb565_0rgb1555(uint16_t col)
+{
+   uint16_t hi = (col >> 1) & 0x7fe0;
+   uint16_t lo = col & 0x1f;
+   return hi | lo;
+}
+
+static inline uint16_t pix_argb8888_0rgb1555(uint32_t col)
+{
+   uint16_t r = (col >> 19) & 0x1f;
+   uint16_t g = (col >> 11) & 0x1f;
+   uint16_t b = (col >>  3) & 0x1f;
+   return (r << 10) | (g << 5) | (b << 0);
+}
+
+static inline uint16_t pix_argb8888_rgb565(uint32_t col)
+{
+   uint16_t r = (col >> 19) & 0x1f;
+   uint16_t g = (col >> 10) & 0x3f;
+   uint16_t b = (col >>  3) & 0x1f;
+   return (r << 11) | (g << 5) | (b << 0);
+}
+
+static inline uint32_t pix_argb8888_abgr8888(uint32_t col)
+{
+   return ((col << 16) & 0xff0000) | ((col >> 16) & 0xff) | (col & 0xff00ff00);
+}
+
+static inline void store_pix_bgr24(uint8_t *out, uint32_t col)
+{
+   out[0] = (uint8_t)(col >>  0);
+   out[1] = (uint8_t)(col >>  8);
+   out[2] = (uint8_t)(col >> 16);
+}
+
+static void conv_rgb565_0rgb1555_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint16_t *output = (uint16_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
+      for (int w = 0; w < width; w++)
+         output[w] = pix_rgb565_0rgb1555(input[w]);
+}
+
+static void conv_0rgb1555_rgb565_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint16_t *output = (uint16_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
+      for (int w = 0; w < width; w++)
+         output[w] = pix_0rgb1555_rgb565(input[w]);
+}
+
+static void conv_0rgb1555_argb8888_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+      for (int w = 0; w < width; w++)
+         output[w] = pix_0rgb1555_argb8888(input[w]);
+}
+
+static void conv_rgb565_argb8888_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+      for (int w = 0; w < width; w++)
+         output[w] = pix_rgb565_argb8888(input[w]);
+}
+
+static void conv_0rgb1555_bgr24_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   {
+      uint8_t *out = output;
+      for (int w = 0; w < width; w++, out += 3)
+         store_pix_bgr24(out, pix_0rgb1555_argb8888(input[w]));
+   }
+}
+
+static void conv_rgb565_bgr24_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   {
+      uint8_t *out = output;
+      for (int w = 0; w < width; w++, out += 3)
+         store_pix_bgr24(out, pix_rgb565_argb8888(input[w]));
+   }
+}
+
+static void conv_bgr24_argb8888_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint8_t *input = (const uint8_t*)input_;
+   uint32_t *output     = (uint32_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride)
+   {
+      const uint8_t *inp = input;
+      for (int w = 0; w < width; w++)
+      {
+         uint32_t b = *inp++;
+         uint32_t g = *inp++;
+         uint32_t r = *inp++;
+         output[w] = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
+      }
+   }
+}
+
+static void conv_argb8888_0rgb1555_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 2)
+      for (int w = 0; w < width; w++)
+         output[w] = pix_argb8888_0rgb1555(input[w]);
+}
+
+static void conv_argb8888_rgb565_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 2)
+      for (int w = 0; w < width; w++)
+         output[w] = pix_argb8888_rgb565(input[w]);
+}
+
+static void conv_argb8888_bgr24_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
+   {
+      uint8_t *out = output;
+      for (int w = 0; w < width; w++, out += 3)
+         store_pix_bgr24(out, input[w]);
+   }
+}
+
+static void conv_argb8888_abgr8888_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 2)
+      for (int w = 0; w < width; w++)
+         output[w] = pix_argb8888_abgr8888(input[w]);
+}
+
+// YUV 4:2:2 output (BT.601, studio range) in 1.15 fixed point.
+// Every input pixel becomes a full macropixel, i.e. width is doubled and chroma is not subsampled.
+#define YUV_COEFF_Y_R   8421
+#define YUV_COEFF_Y_G  16515
+#define YUV_COEFF_Y_B   3211
+#define YUV_COEFF_U_R  -4850
+#define YUV_COEFF_U_G  -9535
+#define YUV_COEFF_U_B  14385
+#define YUV_COEFF_V_R  14385
+#define YUV_COEFF_V_G -12059
+#define YUV_COEFF_V_B  -2327
+#define YUV_ROUND      (1 << 14)
+
+static inline uint8_t pix_yuv_component(int r, int g, int b, int coeff_r, int coeff_g, int coeff_b, int offset)
+{
+   return (uint8_t)((r * coeff_r + g * coeff_g + b * coeff_b + YUV_ROUND + (offset << 15)) >> 15);
+}
+
+static inline void store_pix_yuv(uint8_t *out, int r, int g, int b, bool uyvy)
+{
+   uint8_t y = pix_yuv_component(r, g, b, YUV_COEFF_Y_R, YUV_COEFF_Y_G, YUV_COEFF_Y_B, 16);
+   uint8_t u = pix_yuv_component(r, g, b, YUV_COEFF_U_R, YUV_COEFF_U_G, YUV_COEFF_U_B, 128);
+   uint8_t v = pix_yuv_component(r, g, b, YUV_COEFF_V_R, YUV_COEFF_V_G, YUV_COEFF_V_B, 128);
+
+   if (uyvy)
+   {
+      out[0] = u;
+      out[1] = y;
+      out[2] = v;
+      out[3] = y;
+   }
+   else
+   {
+      out[0] = y;
+      out[1] = u;
+      out[2] = y;
+      out[3] = v;
+   }
+}
+
+static inline void store_pix_rgb565_yuv(uint8_t *out, uint16_t col, bool uyvy)
+{
+   uint32_t argb = pix_rgb565_argb8888(col);
+   store_pix_yuv(out, (argb >> 16) & 0xff, (argb >> 8) & 0xff, argb & 0xff, uyvy);
+}
+
+static inline void store_pix_argb8888_yuv(uint8_t *out, uint32_t col, bool uyvy)
+{
+   store_pix_yuv(out, (col >> 16) & 0xff, (col >> 8) & 0xff, col & 0xff, uyvy);
+}
+
+static void conv_rgb565_yuy2_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+      for (int w = 0; w < width; w++)
+         store_pix_rgb565_yuv(output + 4 * w, input[w], false);
+}
+
+static void conv_rgb565_uyvy_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+      for (int w = 0; w < width; w++)
+         store_pix_rgb565_yuv(output + 4 * w, input[w], true);
+}
+
+static void conv_argb8888_yuy2_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
+      for (int w = 0; w < width; w++)
+         store_pix_argb8888_yuv(output + 4 * w, input[w], false);
+}
+
+static void conv_argb8888_uyvy_C(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
+      for (int w = 0; w < width; w++)
+         store_pix_argb8888_yuv(output + 4 * w, input[w], true);
+}
+
+#if defined(PIXCONV_SSE2)
+// Expands 8 16-bit pixels to 8 ARGB8888 pixels.
+// Red, green and blue are expected in the low byte of each 16-bit lane.
+PIXCONV_TARGET("sse2")
+static inline void pack_argb8888_sse2(__m128i r, __m128i g, __m128i b,
+      __m128i *lo, __m128i *hi)
+{
+   const __m128i a = _mm_set1_epi16(0x00ff);
+
+   __m128i res_lo_bg = _mm_unpacklo_epi8(b, g);
+   __m128i res_hi_bg = _mm_unpackhi_epi8(b, g);
+   __m128i res_lo_ra = _mm_unpacklo_epi8(r, a);
+   __m128i res_hi_ra = _mm_unpackhi_epi8(r, a);
+
+   *lo = _mm_or_si128(res_lo_bg, _mm_slli_si128(res_lo_ra, 2));
+   *hi = _mm_or_si128(res_hi_bg, _mm_slli_si128(res_hi_ra, 2));
+}
+
+PIXCONV_TARGET("sse2")
+static inline void expand_0rgb1555_sse2(__m128i in, __m128i *lo, __m128i *hi)
+{
+   const __m128i pix_mask_r  = _mm_set1_epi16(0x1f << 10);
+   const __m128i pix_mask_gb = _mm_set1_epi16(0x1f <<  5);
+   const __m128i mul15_mid   = _mm_set1_epi16(0x4200);
+   const __m128i mul15_hi    = _mm_set1_epi16(0x0210);
+
+   __m128i r = _mm_and_si128(in, pix_mask_r);
+   __m128i g = _mm_and_si128(in, pix_mask_gb);
+   __m128i b = _mm_and_si128(_mm_slli_epi16(in, 5), pix_mask_gb);
+
+   r = _mm_mulhi_epi16(r, mul15_hi);
+   g = _mm_mulhi_epi16(g, mul15_mid);
+   b = _mm_mulhi_epi16(b, mul15_mid);
+
+   pack_argb8888_sse2(r, g, b, lo, hi);
+}
+
+PIXCONV_TARGET("sse2")
+static inline void expand_rgb565_sse2(__m128i in, __m128i *lo, __m128i *hi)
+{
+   const __m128i pix_mask_r = _mm_set1_epi16(0x1f << 10);
+   const __m128i pix_mask_g = _mm_set1_epi16(0x3f <<  5);
+   const __m128i pix_mask_b = _mm_set1_epi16(0x1f <<  5);
+   const __m128i mul16_r    = _mm_set1_epi16(0x0210);
+   const __m128i mul16_g    = _mm_set1_epi16(0x2080);
+   const __m128i mul16_b    = _mm_set1_epi16(0x4200);
+
+   __m128i r = _mm_and_si128(_mm_srli_epi16(in, 1), pix_mask_r);
+   __m128i g = _mm_and_si128(in, pix_mask_g);
+   __m128i b = _mm_and_si128(_mm_slli_epi16(in, 5), pix_mask_b);
+
+   r = _mm_mulhi_epi16(r, mul16_r);
+   g = _mm_mulhi_epi16(g, mul16_g);
+   b = _mm_mulhi_epi16(b, mul16_b);
+
+   pack_argb8888_sse2(r, g, b, lo, hi);
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_rgb565_0rgb1555_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint16_t *output = (uint16_t*)output_;
+
+   int max_width = width - 7;
+
+   const __m128i hi_mask   = _mm_set1_epi16(0x7fe0);
+   const __m128i lo_mask   = _mm_set1_epi16(0x1f);
+
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 8)
+      {
+         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
+         __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 1), hi_mask);
+         __m128i lo = _mm_and_si128(in, lo_mask);
+         _mm_storeu_si128((__m128i*)(output + w), _mm_or_si128(hi, lo));
+      }
+
+      for (; w < width; w++)
+         output[w] = pix_rgb565_0rgb1555(input[w]);
+   }
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_0rgb1555_rgb565_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint16_t *output = (uint16_t*)output_;
+
+   int max_width = width - 7;
+
+   const __m128i hi_mask   = _mm_set1_epi16((int16_t)((0x1f << 11) | (0x1f << 6)));
+   const __m128i lo_mask   = _mm_set1_epi16(0x1f);
+   const __m128i glow_mask = _mm_set1_epi16(1 << 5);
+
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 8)
+      {
+         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
+         __m128i rg   = _mm_and_si128(_mm_slli_epi16(in, 1), hi_mask);
+         __m128i b    = _mm_and_si128(in, lo_mask);
+         __m128i glow = _mm_and_si128(_mm_srli_epi16(in, 4), glow_mask);
+         _mm_storeu_si128((__m128i*)(output + w), _mm_or_si128(rg, _mm_or_si128(b, glow)));
+      }
+
+      for (; w < width; w++)
+         output[w] = pix_0rgb1555_rgb565(input[w]);
+   }
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_0rgb1555_argb8888_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   int max_width = width - 7;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 8)
+      {
+         __m128i res_lo, res_hi;
+         expand_0rgb1555_sse2(_mm_loadu_si128((const __m128i*)(input + w)), &res_lo, &res_hi);
+         _mm_storeu_si128((__m128i*)(output + w + 0), res_lo);
+         _mm_storeu_si128((__m128i*)(output + w + 4), res_hi);
+      }
+
+      for (; w < width; w++)
+         output[w] = pix_0rgb1555_argb8888(input[w]);
+   }
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_rgb565_argb8888_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   int max_width = width - 7;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 8)
+      {
+         __m128i res_lo, res_hi;
+         expand_rgb565_sse2(_mm_loadu_si128((const __m128i*)(input + w)), &res_lo, &res_hi);
+         _mm_storeu_si128((__m128i*)(output + w + 0), res_lo);
+         _mm_storeu_si128((__m128i*)(output + w + 4), res_hi);
+      }
+
+      for (; w < width; w++)
+         output[w] = pix_rgb565_argb8888(input[w]);
+   }
+}
+
+// :( TODO: Make this saner.
+PIXCONV_TARGET("sse2")
+static inline void store_bgr24_sse2(void *output, __m128i a, __m128i b, __m128i c, __m128i d)
+{
+   const __m128i mask_0 = _mm_set_epi32(0, 0, 0, 0x00ffffff);
+   const __m128i mask_1 = _mm_set_epi32(0, 0, 0x00ffffff, 0);
+   const __m128i mask_2 = _mm_set_epi32(0, 0x00ffffff, 0, 0);
+   const __m128i mask_3 = _mm_set_epi32(0x00ffffff, 0, 0, 0);
+
+   __m128i a0 = _mm_and_si128(a, mask_0);
+   __m128i a1 = _mm_srli_si128(_mm_and_si128(a, mask_1),  1);
+   __m128i a2 = _mm_srli_si128(_mm_and_si128(a, mask_2),  2);
+   __m128i a3 = _mm_srli_si128(_mm_and_si128(a, mask_3),  3);
+   __m128i a4 = _mm_slli_si128(_mm_and_si128(b, mask_0), 12);
+   __m128i a5 = _mm_slli_si128(_mm_and_si128(b, mask_1), 11);
+
+   __m128i b0 = _mm_srli_si128(_mm_and_si128(b, mask_1), 5);
+   __m128i b1 = _mm_srli_si128(_mm_and_si128(b, mask_2), 6);
+   __m128i b2 = _mm_srli_si128(_mm_and_si128(b, mask_3), 7);
+   __m128i b3 = _mm_slli_si128(_mm_and_si128(c, mask_0), 8);
+   __m128i b4 = _mm_slli_si128(_mm_and_si128(c, mask_1), 7);
+   __m128i b5 = _mm_slli_si128(_mm_and_si128(c, mask_2), 6);
+
+   __m128i c0 = _mm_srli_si128(_mm_and_si128(c, mask_2), 10);
+   __m128i c1 = _mm_srli_si128(_mm_and_si128(c, mask_3), 11);
+   __m128i c2 = _mm_slli_si128(_mm_and_si128(d, mask_0),  4);
+   __m128i c3 = _mm_slli_si128(_mm_and_si128(d, mask_1),  3);
+   __m128i c4 = _mm_slli_si128(_mm_and_si128(d, mask_2),  2);
+   __m128i c5 = _mm_slli_si128(_mm_and_si128(d, mask_3),  1);
+
+   __m128i *out = (__m128i*)output;
+
+   _mm_storeu_si128(out + 0,
+         _mm_or_si128(a0, _mm_or_si128(a1, _mm_or_si128(a2, _mm_or_si128(a3, _mm_or_si128(a4, a5))))));
+
+   _mm_storeu_si128(out + 1,
+         _mm_or_si128(b0, _mm_or_si128(b1, _mm_or_si128(b2, _mm_or_si128(b3, _mm_or_si128(b4, b5))))));
+
+   _mm_storeu_si128(out + 2,
+         _mm_or_si128(c0, _mm_or_si128(c1, _mm_or_si128(c2, _mm_or_si128(c3, _mm_or_si128(c4, c5))))));
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_0rgb1555_bgr24_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   int max_width = width - 15;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   {
+      uint8_t *out = output;
+
+      int w;
+      for (w = 0; w < max_width; w += 16, out += 48)
+      {
+         __m128i res_lo0, res_hi0, res_lo1, res_hi1;
+         expand_0rgb1555_sse2(_mm_loadu_si128((const __m128i*)(input + w + 0)), &res_lo0, &res_hi0);
+         expand_0rgb1555_sse2(_mm_loadu_si128((const __m128i*)(input + w + 8)), &res_lo1, &res_hi1);
+
+         // Non-POT pixel sizes ftl :(
+         store_bgr24_sse2(out, res_lo0, res_hi0, res_lo1, res_hi1);
+      }
+
+      for (; w < width; w++, out += 3)
+         store_pix_bgr24(out, pix_0rgb1555_argb8888(input[w]));
+   }
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_rgb565_bgr24_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output      = (uint8_t*)output_;
+
+   int max_width = width - 15;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   {
+      uint8_t *out = output;
+
+      int w;
+      for (w = 0; w < max_width; w += 16, out += 48)
+      {
+         __m128i res_lo0, res_hi0, res_lo1, res_hi1;
+         expand_rgb565_sse2(_mm_loadu_si128((const __m128i*)(input + w + 0)), &res_lo0, &res_hi0);
+         expand_rgb565_sse2(_mm_loadu_si128((const __m128i*)(input + w + 8)), &res_lo1, &res_hi1);
+
+         store_bgr24_sse2(out, res_lo0, res_hi0, res_lo1, res_hi1);
+      }
+
+      for (; w < width; w++, out += 3)
+         store_pix_bgr24(out, pix_rgb565_argb8888(input[w]));
+   }
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_argb8888_bgr24_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   int max_width = width - 15;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
+   {
+      uint8_t *out = output;
+      int w;
+
+      for (w = 0; w < max_width; w += 16, out += 48)
+      {
+         store_bgr24_sse2(out,
+               _mm_loadu_si128((const __m128i*)(input + w +  0)),
+               _mm_loadu_si128((const __m128i*)(input + w +  4)),
+               _mm_loadu_si128((const __m128i*)(input + w +  8)),
+               _mm_loadu_si128((const __m128i*)(input + w + 12)));
+      }
+
+      for (; w < width; w++, out += 3)
+         store_pix_bgr24(out, input[w]);
+   }
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_argb8888_0rgb1555_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+
+   const __m128i mask_r = _mm_set1_epi32(0x1f << 10);
+   const __m128i mask_g = _mm_set1_epi32(0x1f <<  5);
+   const __m128i mask_b = _mm_set1_epi32(0x1f <<  0);
+
+   int max_width = width - 7;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 2)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 8)
+      {
+         const __m128i in0 = _mm_loadu_si128((const __m128i*)(input + w + 0));
+         const __m128i in1 = _mm_loadu_si128((const __m128i*)(input + w + 4));
+
+         __m128i res0 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in0, 9), mask_r),
+               _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in0, 6), mask_g),
+                  _mm_and_si128(_mm_srli_epi32(in0, 3), mask_b)));
+         __m128i res1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in1, 9), mask_r),
+               _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in1, 6), mask_g),
+                  _mm_and_si128(_mm_srli_epi32(in1, 3), mask_b)));
+
+         // Results fit in 15 bits, so signed saturation is harmless.
+         _mm_storeu_si128((__m128i*)(output + w), _mm_packs_epi32(res0, res1));
+      }
+
+      for (; w < width; w++)
+         output[w] = pix_argb8888_0rgb1555(input[w]);
+   }
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_argb8888_rgb565_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+
+   const __m128i mask_r = _mm_set1_epi32(0x1f << 11);
+   const __m128i mask_g = _mm_set1_epi32(0x3f <<  5);
+   const __m128i mask_b = _mm_set1_epi32(0x1f <<  0);
+
+   int max_width = width - 7;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 2)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 8)
+      {
+         const __m128i in0 = _mm_loadu_si128((const __m128i*)(input + w + 0));
+         const __m128i in1 = _mm_loadu_si128((const __m128i*)(input + w + 4));
+
+         __m128i res0 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in0, 8), mask_r),
+               _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in0, 5), mask_g),
+                  _mm_and_si128(_mm_srli_epi32(in0, 3), mask_b)));
+         __m128i res1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in1, 8), mask_r),
+               _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in1, 5), mask_g),
+                  _mm_and_si128(_mm_srli_epi32(in1, 3), mask_b)));
+
+         // Sign extend so that the signed saturating pack keeps all 16 bits intact.
+         res0 = _mm_srai_epi32(_mm_slli_epi32(res0, 16), 16);
+         res1 = _mm_srai_epi32(_mm_slli_epi32(res1, 16), 16);
+         _mm_storeu_si128((__m128i*)(output + w), _mm_packs_epi32(res0, res1));
+      }
+
+      for (; w < width; w++)
+         output[w] = pix_argb8888_rgb565(input[w]);
+   }
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_argb8888_abgr8888_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   const __m128i mask_r  = _mm_set1_epi32(0x00ff0000);
+   const __m128i mask_b  = _mm_set1_epi32(0x000000ff);
+   const __m128i mask_ag = _mm_set1_epi32((int)0xff00ff00);
+
+   int max_width = width - 3;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 2)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 4)
+      {
+         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
+         __m128i res = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(in, 16), mask_r),
+               _mm_or_si128(_mm_and_si128(_mm_srli_epi32(in, 16), mask_b),
+                  _mm_and_si128(in, mask_ag)));
+         _mm_storeu_si128((__m128i*)(output + w), res);
+      }
+
+      for (; w < width; w++)
+         output[w] = pix_argb8888_abgr8888(input[w]);
+   }
+}
+// Two 16-bit coefficients for _mm_madd_epi16(), lo multiplies the even lanes.
+#define YUV_COEFF_PAIR(lo, hi) ((int)(((uint32_t)(uint16_t)(hi) << 16) | (uint16_t)(lo)))
+
+// r, g and b hold 8 8-bit channels in 16-bit lanes. rg and b1 are the
+// interleaved (r, g) and (b, 1) pairs. Returns 8 16-bit results.
+PIXCONV_TARGET("sse2")
+static inline __m128i yuv_component_sse2(__m128i rg_lo, __m128i rg_hi, __m128i b1_lo, __m128i b1_hi,
+      int coeff_r, int coeff_g, int coeff_b, int offset)
+{
+   const __m128i coeff_rg = _mm_set1_epi32(YUV_COEFF_PAIR(coeff_r, coeff_g));
+   const __m128i coeff_b1 = _mm_set1_epi32(YUV_COEFF_PAIR(coeff_b, YUV_ROUND));
+
+   __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(rg_lo, coeff_rg), _mm_madd_epi16(b1_lo, coeff_b1)), 15);
+   __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(rg_hi, coeff_rg), _mm_madd_epi16(b1_hi, coeff_b1)), 15);
+   return _mm_add_epi16(_mm_packs_epi32(lo, hi), _mm_set1_epi16(offset));
+}
+
+// Converts 8 pixels to 8 macropixels (32 bytes).
+PIXCONV_TARGET("sse2")
+static inline void store_yuv_sse2(uint8_t *output, __m128i r, __m128i g, __m128i b, bool uyvy)
+{
+   const __m128i one = _mm_set1_epi16(1);
+   __m128i rg_lo = _mm_unpacklo_epi16(r, g);
+   __m128i rg_hi = _mm_unpackhi_epi16(r, g);
+   __m128i b1_lo = _mm_unpacklo_epi16(b, one);
+   __m128i b1_hi = _mm_unpackhi_epi16(b, one);
+
+   __m128i y = yuv_component_sse2(rg_lo, rg_hi, b1_lo, b1_hi,
+         YUV_COEFF_Y_R, YUV_COEFF_Y_G, YUV_COEFF_Y_B, 16);
+   __m128i u = yuv_component_sse2(rg_lo, rg_hi, b1_lo, b1_hi,
+         YUV_COEFF_U_R, YUV_COEFF_U_G, YUV_COEFF_U_B, 128);
+   __m128i v = yuv_component_sse2(rg_lo, rg_hi, b1_lo, b1_hi,
+         YUV_COEFF_V_R, YUV_COEFF_V_G, YUV_COEFF_V_B, 128);
+
+   __m128i first, second;
+   if (uyvy)
+   {
+      first  = _mm_or_si128(u, _mm_slli_epi16(y, 8));
+      second = _mm_or_si128(v, _mm_slli_epi16(y, 8));
+   }
+   else
+   {
+      first  = _mm_or_si128(y, _mm_slli_epi16(u, 8));
+      second = _mm_or_si128(y, _mm_slli_epi16(v, 8));
+   }
+
+   _mm_storeu_si128((__m128i*)(output +  0), _mm_unpacklo_epi16(first, second));
+   _mm_storeu_si128((__m128i*)(output + 16), _mm_unpackhi_epi16(first, second));
+}
+
+PIXCONV_TARGET("sse2")
+static inline void unpack_rgb565_sse2(__m128i in, __m128i *r, __m128i *g, __m128i *b)
+{
+   __m128i r5 = _mm_srli_epi16(in, 11);
+   __m128i g6 = _mm_and_si128(_mm_srli_epi16(in, 5), _mm_set1_epi16(0x3f));
+   __m128i b5 = _mm_and_si128(in, _mm_set1_epi16(0x1f));
+
+   *r = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+   *g = _mm_or_si128(_mm_slli_epi16(g6, 2), _mm_srli_epi16(g6, 4));
+   *b = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+}
+
+PIXCONV_TARGET("sse2")
+static inline void unpack_argb8888_sse2(__m128i in_lo, __m128i in_hi, __m128i *r, __m128i *g, __m128i *b)
+{
+   const __m128i mask = _mm_set1_epi32(0xff);
+   *r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(in_lo, 16), mask), _mm_and_si128(_mm_srli_epi32(in_hi, 16), mask));
+   *g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(in_lo,  8), mask), _mm_and_si128(_mm_srli_epi32(in_hi,  8), mask));
+   *b = _mm_packs_epi32(_mm_and_si128(in_lo, mask), _mm_and_si128(in_hi, mask));
+}
+
+PIXCONV_TARGET("sse2")
+static inline void conv_rgb565_yuv_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride, bool uyvy)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   int max_width = width - 7;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 8)
+      {
+         __m128i r, g, b;
+         unpack_rgb565_sse2(_mm_loadu_si128((const __m128i*)(input + w)), &r, &g, &b);
+         store_yuv_sse2(output + 4 * w, r, g, b, uyvy);
+      }
+
+      for (; w < width; w++)
+         store_pix_rgb565_yuv(output + 4 * w, input[w], uyvy);
+   }
+}
+
+PIXCONV_TARGET("sse2")
+static inline void conv_argb8888_yuv_SSE2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride, bool uyvy)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   int max_width = width - 7;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 8)
+      {
+         __m128i r, g, b;
+         unpack_argb8888_sse2(_mm_loadu_si128((const __m128i*)(input + w + 0)),
+               _mm_loadu_si128((const __m128i*)(input + w + 4)), &r, &g, &b);
+         store_yuv_sse2(output + 4 * w, r, g, b, uyvy);
+      }
+
+      for (; w < width; w++)
+         store_pix_argb8888_yuv(output + 4 * w, input[w], uyvy);
+   }
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_rgb565_yuy2_SSE2(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_rgb565_yuv_SSE2(output, input, width, height, out_stride, in_stride, false);
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_rgb565_uyvy_SSE2(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_rgb565_yuv_SSE2(output, input, width, height, out_stride, in_stride, true);
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_argb8888_yuy2_SSE2(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_argb8888_yuv_SSE2(output, input, width, height, out_stride, in_stride, false);
+}
+
+PIXCONV_TARGET("sse2")
+static void conv_argb8888_uyvy_SSE2(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_argb8888_yuv_SSE2(output, input, width, height, out_stride, in_stride, true);
+}
+#endif
+
+#if defined(PIXCONV_SSSE3)
+// Packs 16 ARGB8888 pixels into 48 bytes of BGR24.
+PIXCONV_TARGET("ssse3")
+static inline void store_bgr24_ssse3(void *output, __m128i a, __m128i b, __m128i c, __m128i d)
+{
+   const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+   __m128i *out = (__m128i*)output;
+
+   a = _mm_shuffle_epi8(a, pack);
+   b = _mm_shuffle_epi8(b, pack);
+   c = _mm_shuffle_epi8(c, pack);
+   d = _mm_shuffle_epi8(d, pack);
+
+   _mm_storeu_si128(out + 0, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+   _mm_storeu_si128(out + 1, _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+   _mm_storeu_si128(out + 2, _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+}
+
+PIXCONV_TARGET("ssse3")
+static void conv_0rgb1555_bgr24_SSSE3(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   int max_width = width - 15;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   {
+      uint8_t *out = output;
+
+      int w;
+      for (w = 0; w < max_width; w += 16, out += 48)
+      {
+         __m128i res_lo0, res_hi0, res_lo1, res_hi1;
+         expand_0rgb1555_sse2(_mm_loadu_si128((const __m128i*)(input + w + 0)), &res_lo0, &res_hi0);
+         expand_0rgb1555_sse2(_mm_loadu_si128((const __m128i*)(input + w + 8)), &res_lo1, &res_hi1);
+         store_bgr24_ssse3(out, res_lo0, res_hi0, res_lo1, res_hi1);
+      }
+
+      for (; w < width; w++, out += 3)
+         store_pix_bgr24(out, pix_0rgb1555_argb8888(input[w]));
+   }
+}
+
+PIXCONV_TARGET("ssse3")
+static void conv_rgb565_bgr24_SSSE3(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   int max_width = width - 15;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   {
+      uint8_t *out = output;
 
-#ifdef SCALER_NO_SIMD
-#undef __SSE2__
-#endif
+      int w;
+      for (w = 0; w < max_width; w += 16, out += 48)
+      {
+         __m128i res_lo0, res_hi0, res_lo1, res_hi1;
+         expand_rgb565_sse2(_mm_loadu_si128((const __m128i*)(input + w + 0)), &res_lo0, &res_hi0);
+         expand_rgb565_sse2(_mm_loadu_si128((const __m128i*)(input + w + 8)), &res_lo1, &res_hi1);
+         store_bgr24_ssse3(out, res_lo0, res_hi0, res_lo1, res_hi1);
+      }
 
-#if defined(__SSE2__)
-#include <emmintrin.h>
-#endif
+      for (; w < width; w++, out += 3)
+         store_pix_bgr24(out, pix_rgb565_argb8888(input[w]));
+   }
+}
 
-#if defined(__SSE2_)
-void conv_rgb565_0rgb1555(void *output_, const void *input_,
+PIXCONV_TARGET("ssse3")
+static void conv_argb8888_bgr24_SSSE3(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
-   const uint16_t *input = (const uint16_t*)input_;
-   uint16_t *output = (uint16_t*)output_;
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
 
-   int max_width = width - 7;
+   int max_width = width - 15;
 
-   const __m128i hi_mask   = _mm_set1_epi16(0x7fe0);
-   const __m128i lo_mask   = _mm_set1_epi16(0x1f);
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
+   {
+      uint8_t *out = output;
+      int w;
 
-   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
+      for (w = 0; w < max_width; w += 16, out += 48)
+      {
+         store_bgr24_ssse3(out,
+               _mm_loadu_si128((const __m128i*)(input + w +  0)),
+               _mm_loadu_si128((const __m128i*)(input + w +  4)),
+               _mm_loadu_si128((const __m128i*)(input + w +  8)),
+               _mm_loadu_si128((const __m128i*)(input + w + 12)));
+      }
+
+      for (; w < width; w++, out += 3)
+         store_pix_bgr24(out, input[w]);
+   }
+}
+
+PIXCONV_TARGET("ssse3")
+static void conv_bgr24_argb8888_SSSE3(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint8_t *input = (const uint8_t*)input_;
+   uint32_t *output     = (uint32_t*)output_;
+
+   const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+   const __m128i a      = _mm_set1_epi32((int)0xff000000);
+
+   int max_width = width - 15;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride)
    {
+      const uint8_t *inp = input;
       int w;
-      for (w = 0; w < max_width; w += 8)
+
+      for (w = 0; w < max_width; w += 16, inp += 48)
+      {
+         const __m128i in0 = _mm_loadu_si128((const __m128i*)(inp +  0));
+         const __m128i in1 = _mm_loadu_si128((const __m128i*)(inp + 16));
+         const __m128i in2 = _mm_loadu_si128((const __m128i*)(inp + 32));
+
+         // Line up each group of 4 pixels (12 bytes) at the start of a register.
+         __m128i px0 = in0;
+         __m128i px1 = _mm_alignr_epi8(in1, in0, 12);
+         __m128i px2 = _mm_alignr_epi8(in2, in1, 8);
+         __m128i px3 = _mm_srli_si128(in2, 4);
+
+         _mm_storeu_si128((__m128i*)(output + w +  0), _mm_or_si128(_mm_shuffle_epi8(px0, expand), a));
+         _mm_storeu_si128((__m128i*)(output + w +  4), _mm_or_si128(_mm_shuffle_epi8(px1, expand), a));
+         _mm_storeu_si128((__m128i*)(output + w +  8), _mm_or_si128(_mm_shuffle_epi8(px2, expand), a));
+         _mm_storeu_si128((__m128i*)(output + w + 12), _mm_or_si128(_mm_shuffle_epi8(px3, expand), a));
+      }
+
+      for (; w < width; w++, inp += 3)
+      {
+         uint32_t b = inp[0];
+         uint32_t g = inp[1];
+         uint32_t r = inp[2];
+         output[w] = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
+      }
+   }
+}
+
+PIXCONV_TARGET("ssse3")
+static void conv_argb8888_abgr8888_SSSE3(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   const __m128i swizzle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+   int max_width = width - 3;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 2)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 4)
       {
          const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
-         __m128i hi = _mm_and_si128(_mm_slli_epi16(in, 1), hi_mask);
-         __m128i lo = _mm_and_si128(in, lo_mask);
-         _mm_storeu_si128((__m128i*)(output + w), _mm_or_si128(hi, lo));
+         _mm_storeu_si128((__m128i*)(output + w), _mm_shuffle_epi8(in, swizzle));
       }
 
       for (; w < width; w++)
+         output[w] = pix_argb8888_abgr8888(input[w]);
+   }
+}
+#endif
+
+#if defined(PIXCONV_AVX2)
+// 256-bit unpacks operate within 128-bit lanes, so the expanded pixels
+// have to be put back in order across lanes before storing.
+PIXCONV_TARGET("avx2")
+static inline void store_argb8888_avx2(uint32_t *output, __m256i r, __m256i g, __m256i b)
+{
+   const __m256i a = _mm256_set1_epi16(0x00ff);
+
+   __m256i res_lo = _mm256_or_si256(_mm256_unpacklo_epi8(b, g),
+         _mm256_slli_si256(_mm256_unpacklo_epi8(r, a), 2));
+   __m256i res_hi = _mm256_or_si256(_mm256_unpackhi_epi8(b, g),
+         _mm256_slli_si256(_mm256_unpackhi_epi8(r, a), 2));
+
+   _mm256_storeu_si256((__m256i*)(output + 0), _mm256_permute2x128_si256(res_lo, res_hi, 0x20));
+   _mm256_storeu_si256((__m256i*)(output + 8), _mm256_permute2x128_si256(res_lo, res_hi, 0x31));
+}
+
+PIXCONV_TARGET("avx2")
+static void conv_0rgb1555_argb8888_AVX2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   const __m256i pix_mask_r  = _mm256_set1_epi16(0x1f << 10);
+   const __m256i pix_mask_gb = _mm256_set1_epi16(0x1f <<  5);
+   const __m256i mul15_mid   = _mm256_set1_epi16(0x4200);
+   const __m256i mul15_hi    = _mm256_set1_epi16(0x0210);
+
+   int max_width = width - 15;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 16)
       {
-         uint16_t col = input[w];
-         uint16_t hi = (col >> 1) & 0x7fe0;
-         uint16_t lo = col & 0x1f;
-         output[w] = hi | lo;
+         const __m256i in = _mm256_loadu_si256((const __m256i*)(input + w));
+         __m256i r = _mm256_and_si256(in, pix_mask_r);
+         __m256i g = _mm256_and_si256(in, pix_mask_gb);
+         __m256i b = _mm256_and_si256(_mm256_slli_epi16(in, 5), pix_mask_gb);
+
+         r = _mm256_mulhi_epi16(r, mul15_hi);
+         g = _mm256_mulhi_epi16(g, mul15_mid);
+         b = _mm256_mulhi_epi16(b, mul15_mid);
+
+         store_argb8888_avx2(output + w, r, g, b);
       }
+
+      for (; w < width; w++)
+         output[w] = pix_0rgb1555_argb8888(input[w]);
    }
 }
-#else
-void conv_rgb565_0rgb1555(void *output_, const void *input_,
+
+PIXCONV_TARGET("avx2")
+static void conv_rgb565_argb8888_AVX2(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint16_t *input = (const uint16_t*)input_;
-   uint16_t *output = (uint16_t*)output_;
+   uint32_t *output      = (uint32_t*)output_;
 
-   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
+   const __m256i pix_mask_r = _mm256_set1_epi16(0x1f << 10);
+   const __m256i pix_mask_g = _mm256_set1_epi16(0x3f <<  5);
+   const __m256i pix_mask_b = _mm256_set1_epi16(0x1f <<  5);
+   const __m256i mul16_r    = _mm256_set1_epi16(0x0210);
+   const __m256i mul16_g    = _mm256_set1_epi16(0x2080);
+   const __m256i mul16_b    = _mm256_set1_epi16(0x4200);
+
+   int max_width = width - 15;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
    {
-      for (int w = 0; w < width; w++)
+      int w;
+      for (w = 0; w < max_width; w += 16)
       {
-         uint16_t col = input[w];
-         uint16_t hi = (col >> 1) & 0x7fe0;
-         uint16_t lo = col & 0x1f;
-         output[w] = hi | lo;
+         const __m256i in = _mm256_loadu_si256((const __m256i*)(input + w));
+         __m256i r = _mm256_and_si256(_mm256_srli_epi16(in, 1), pix_mask_r);
+         __m256i g = _mm256_and_si256(in, pix_mask_g);
+         __m256i b = _mm256_and_si256(_mm256_slli_epi16(in, 5), pix_mask_b);
+
+         r = _mm256_mulhi_epi16(r, mul16_r);
+         g = _mm256_mulhi_epi16(g, mul16_g);
+         b = _mm256_mulhi_epi16(b, mul16_b);
+
+         store_argb8888_avx2(output + w, r, g, b);
       }
+
+      for (; w < width; w++)
+         output[w] = pix_rgb565_argb8888(input[w]);
    }
 }
 
-#endif
-
-#if defined(__SSE2__)
-void conv_0rgb1555_rgb565(void *output_, const void *input_,
+PIXCONV_TARGET("avx2")
+static void conv_rgb565_0rgb1555_AVX2(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint16_t *input = (const uint16_t*)input_;
    uint16_t *output = (uint16_t*)output_;
 
-   int max_width = width - 7;
+   const __m256i hi_mask = _mm256_set1_epi16(0x7fe0);
+   const __m256i lo_mask = _mm256_set1_epi16(0x1f);
 
-   const __m128i hi_mask   = _mm_set1_epi16((int16_t)((0x1f << 11) | (0x1f << 6)));
-   const __m128i lo_mask   = _mm_set1_epi16(0x1f);
-   const __m128i glow_mask = _mm_set1_epi16(1 << 5);
+   int max_width = width - 15;
 
    for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
    {
       int w;
-      for (w = 0; w < max_width; w += 8)
+      for (w = 0; w < max_width; w += 16)
       {
-         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
-         __m128i rg   = _mm_and_si128(_mm_slli_epi16(in, 1), hi_mask);
-         __m128i b    = _mm_and_si128(in, lo_mask);
-         __m128i glow = _mm_and_si128(_mm_srli_epi16(in, 4), glow_mask);
-         _mm_storeu_si128((__m128i*)(output + w), _mm_or_si128(rg, _mm_or_si128(b, glow)));
+         const __m256i in = _mm256_loadu_si256((const __m256i*)(input + w));
+         __m256i hi = _mm256_and_si256(_mm256_srli_epi16(in, 1), hi_mask);
+         __m256i lo = _mm256_and_si256(in, lo_mask);
+         _mm256_storeu_si256((__m256i*)(output + w), _mm256_or_si256(hi, lo));
       }
 
       for (; w < width; w++)
-      {
-         uint16_t col = input[w];
-         uint16_t rg = (col << 1) & ((0x1f << 11) | (0x1f << 6));
-         uint16_t b = col & 0x1f;
-         uint16_t glow = (col >> 4) & (1 << 5);
-         output[w] = rg | b | glow;
-      }
+         output[w] = pix_rgb565_0rgb1555(input[w]);
    }
 }
-#else
-void conv_0rgb1555_rgb565(void *output_, const void *input_,
+
+PIXCONV_TARGET("avx2")
+static void conv_0rgb1555_rgb565_AVX2(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint16_t *input = (const uint16_t*)input_;
    uint16_t *output = (uint16_t*)output_;
 
+   const __m256i hi_mask   = _mm256_set1_epi16((int16_t)((0x1f << 11) | (0x1f << 6)));
+   const __m256i lo_mask   = _mm256_set1_epi16(0x1f);
+   const __m256i glow_mask = _mm256_set1_epi16(1 << 5);
+
+   int max_width = width - 15;
+
    for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
    {
-      for (int w = 0; w < width; w++)
+      int w;
+      for (w = 0; w < max_width; w += 16)
       {
-         uint16_t col = input[w];
-         uint16_t rg = (col << 1) & ((0x1f << 11) | (0x1f << 6));
-         uint16_t b = col & 0x1f;
-         uint16_t glow = (col >> 4) & (1 << 5);
-         output[w] = rg | b | glow;
+         const __m256i in = _mm256_loadu_si256((const __m256i*)(input + w));
+         __m256i rg   = _mm256_and_si256(_mm256_slli_epi16(in, 1), hi_mask);
+         __m256i b    = _mm256_and_si256(in, lo_mask);
+         __m256i glow = _mm256_and_si256(_mm256_srli_epi16(in, 4), glow_mask);
+         _mm256_storeu_si256((__m256i*)(output + w), _mm256_or_si256(rg, _mm256_or_si256(b, glow)));
       }
+
+      for (; w < width; w++)
+         output[w] = pix_0rgb1555_rgb565(input[w]);
    }
 }
-#endif
 
-#if defined(__SSE2__)
-void conv_0rgb1555_argb8888(void *output_, const void *input_,
+PIXCONV_TARGET("avx2")
+static void conv_argb8888_abgr8888_AVX2(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
-   const uint16_t *input = (const uint16_t*)input_;
+   const uint32_t *input = (const uint32_t*)input_;
    uint32_t *output      = (uint32_t*)output_;
 
-   const __m128i pix_mask_r  = _mm_set1_epi16(0x1f << 10);
-   const __m128i pix_mask_gb = _mm_set1_epi16(0x1f <<  5);
-   const __m128i mul15_mid   = _mm_set1_epi16(0x4200);
-   const __m128i mul15_hi    = _mm_set1_epi16(0x0210);
-   const __m128i a           = _mm_set1_epi16(0x00ff);
+   const __m256i swizzle = _mm256_setr_epi8(
+         2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+         2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
 
    int max_width = width - 7;
 
-   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 2)
    {
       int w;
       for (w = 0; w < max_width; w += 8)
       {
-         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
-         __m128i r = _mm_and_si128(in, pix_mask_r);
-         __m128i g = _mm_and_si128(in, pix_mask_gb);
-         __m128i b = _mm_and_si128(_mm_slli_epi16(in, 5), pix_mask_gb);
+         const __m256i in = _mm256_loadu_si256((const __m256i*)(input + w));
+         _mm256_storeu_si256((__m256i*)(output + w), _mm256_shuffle_epi8(in, swizzle));
+      }
+
+      for (; w < width; w++)
+         output[w] = pix_argb8888_abgr8888(input[w]);
+   }
+}
+PIXCONV_TARGET("avx2")
+static inline __m256i yuv_component_avx2(__m256i rg_lo, __m256i rg_hi, __m256i b1_lo, __m256i b1_hi,
+      int coeff_r, int coeff_g, int coeff_b, int offset)
+{
+   const __m256i coeff_rg = _mm256_set1_epi32(YUV_COEFF_PAIR(coeff_r, coeff_g));
+   const __m256i coeff_b1 = _mm256_set1_epi32(YUV_COEFF_PAIR(coeff_b, YUV_ROUND));
 
-         r = _mm_mulhi_epi16(r, mul15_hi);
-         g = _mm_mulhi_epi16(g, mul15_mid);
-         b = _mm_mulhi_epi16(b, mul15_mid);
+   __m256i lo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(rg_lo, coeff_rg), _mm256_madd_epi16(b1_lo, coeff_b1)), 15);
+   __m256i hi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(rg_hi, coeff_rg), _mm256_madd_epi16(b1_hi, coeff_b1)), 15);
+   return _mm256_add_epi16(_mm256_packs_epi32(lo, hi), _mm256_set1_epi16(offset));
+}
 
-         __m128i res_lo_bg = _mm_unpacklo_epi8(b, g);
-         __m128i res_hi_bg = _mm_unpackhi_epi8(b, g);
-         __m128i res_lo_ra = _mm_unpacklo_epi8(r, a);
-         __m128i res_hi_ra = _mm_unpackhi_epi8(r, a);
+// Converts 16 pixels to 16 macropixels (64 bytes).
+// Unpacks and packs stay within 128-bit lanes, so pixels are only reordered at the very end.
+PIXCONV_TARGET("avx2")
+static inline void store_yuv_avx2(uint8_t *output, __m256i r, __m256i g, __m256i b, bool uyvy)
+{
+   const __m256i one = _mm256_set1_epi16(1);
+   __m256i rg_lo = _mm256_unpacklo_epi16(r, g);
+   __m256i rg_hi = _mm256_unpackhi_epi16(r, g);
+   __m256i b1_lo = _mm256_unpacklo_epi16(b, one);
+   __m256i b1_hi = _mm256_unpackhi_epi16(b, one);
+
+   __m256i y = yuv_component_avx2(rg_lo, rg_hi, b1_lo, b1_hi,
+         YUV_COEFF_Y_R, YUV_COEFF_Y_G, YUV_COEFF_Y_B, 16);
+   __m256i u = yuv_component_avx2(rg_lo, rg_hi, b1_lo, b1_hi,
+         YUV_COEFF_U_R, YUV_COEFF_U_G, YUV_COEFF_U_B, 128);
+   __m256i v = yuv_component_avx2(rg_lo, rg_hi, b1_lo, b1_hi,
+         YUV_COEFF_V_R, YUV_COEFF_V_G, YUV_COEFF_V_B, 128);
+
+   __m256i first, second;
+   if (uyvy)
+   {
+      first  = _mm256_or_si256(u, _mm256_slli_epi16(y, 8));
+      second = _mm256_or_si256(v, _mm256_slli_epi16(y, 8));
+   }
+   else
+   {
+      first  = _mm256_or_si256(y, _mm256_slli_epi16(u, 8));
+      second = _mm256_or_si256(y, _mm256_slli_epi16(v, 8));
+   }
 
-         __m128i res_lo = _mm_or_si128(res_lo_bg, _mm_slli_si128(res_lo_ra, 2));
-         __m128i res_hi = _mm_or_si128(res_hi_bg, _mm_slli_si128(res_hi_ra, 2));
+   __m256i lo = _mm256_unpacklo_epi16(first, second);
+   __m256i hi = _mm256_unpackhi_epi16(first, second);
+   _mm256_storeu_si256((__m256i*)(output +  0), _mm256_permute2x128_si256(lo, hi, 0x20));
+   _mm256_storeu_si256((__m256i*)(output + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
 
-         _mm_storeu_si128((__m128i*)(output + w + 0), res_lo);
-         _mm_storeu_si128((__m128i*)(output + w + 4), res_hi);
-      }
+PIXCONV_TARGET("avx2")
+static inline void conv_rgb565_yuv_AVX2(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride, bool uyvy)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
 
-      for (; w < width; w++)
+   const __m256i mask_g = _mm256_set1_epi16(0x3f);
+   const __m256i mask_b = _mm256_set1_epi16(0x1f);
+
+   int max_width = width - 15;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 16)
       {
-         uint32_t col = input[w];
-         uint32_t r = (col >> 10) & 0x1f;
-         uint32_t g = (col >>  5) & 0x1f;
-         uint32_t b = (col >>  0) & 0x1f;
-         r = (r << 3) | (r >> 2);
-         g = (g << 3) | (g >> 2);
-         b = (b << 3) | (b >> 2);
+         const __m256i in = _mm256_loadu_si256((const __m256i*)(input + w));
+         __m256i r5 = _mm256_srli_epi16(in, 11);
+         __m256i g6 = _mm256_and_si256(_mm256_srli_epi16(in, 5), mask_g);
+         __m256i b5 = _mm256_and_si256(in, mask_b);
+
+         __m256i r = _mm256_or_si256(_mm256_slli_epi16(r5, 3), _mm256_srli_epi16(r5, 2));
+         __m256i g = _mm256_or_si256(_mm256_slli_epi16(g6, 2), _mm256_srli_epi16(g6, 4));
+         __m256i b = _mm256_or_si256(_mm256_slli_epi16(b5, 3), _mm256_srli_epi16(b5, 2));
 
-         output[w] = (0xff << 24) | (r << 16) | (g << 8) | (b << 0);
+         store_yuv_avx2(output + 4 * w, r, g, b, uyvy);
       }
+
+      for (; w < width; w++)
+         store_pix_rgb565_yuv(output + 4 * w, input[w], uyvy);
    }
 }
-#else
-void conv_0rgb1555_argb8888(void *output_, const void *input_,
+
+PIXCONV_TARGET("avx2")
+static inline void conv_argb8888_yuv_AVX2(void *output_, const void *input_,
       int width, int height,
-      int out_stride, int in_stride)
+      int out_stride, int in_stride, bool uyvy)
 {
-   const uint16_t *input = (const uint16_t*)input_;
-   uint32_t *output      = (uint32_t*)output_;
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
 
-   for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
+   const __m256i mask = _mm256_set1_epi32(0xff);
+
+   int max_width = width - 15;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
    {
-      for (int w = 0; w < width; w++)
+      int w;
+      for (w = 0; w < max_width; w += 16)
       {
-         uint32_t col = input[w];
-         uint32_t r = (col >> 10) & 0x1f;
-         uint32_t g = (col >>  5) & 0x1f;
-         uint32_t b = (col >>  0) & 0x1f;
-         r = (r << 3) | (r >> 2);
-         g = (g << 3) | (g >> 2);
-         b = (b << 3) | (b >> 2);
-
-         output[w] = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
+         const __m256i in_lo = _mm256_loadu_si256((const __m256i*)(input + w + 0));
+         const __m256i in_hi = _mm256_loadu_si256((const __m256i*)(input + w + 8));
+
+         // Packing interleaves the 128-bit lanes of both inputs, put pixels back in order.
+         __m256i r = _mm256_permute4x64_epi64(_mm256_packs_epi32(
+                  _mm256_and_si256(_mm256_srli_epi32(in_lo, 16), mask),
+                  _mm256_and_si256(_mm256_srli_epi32(in_hi, 16), mask)), 0xd8);
+         __m256i g = _mm256_permute4x64_epi64(_mm256_packs_epi32(
+                  _mm256_and_si256(_mm256_srli_epi32(in_lo, 8), mask),
+                  _mm256_and_si256(_mm256_srli_epi32(in_hi, 8), mask)), 0xd8);
+         __m256i b = _mm256_permute4x64_epi64(_mm256_packs_epi32(
+                  _mm256_and_si256(in_lo, mask),
+                  _mm256_and_si256(in_hi, mask)), 0xd8);
+
+         store_yuv_avx2(output + 4 * w, r, g, b, uyvy);
       }
+
+      for (; w < width; w++)
+         store_pix_argb8888_yuv(output + 4 * w, input[w], uyvy);
    }
 }
+
+PIXCONV_TARGET("avx2")
+static void conv_rgb565_yuy2_AVX2(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_rgb565_yuv_AVX2(output, input, width, height, out_stride, in_stride, false);
+}
+
+PIXCONV_TARGET("avx2")
+static void conv_rgb565_uyvy_AVX2(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_rgb565_yuv_AVX2(output, input, width, height, out_stride, in_stride, true);
+}
+
+PIXCONV_TARGET("avx2")
+static void conv_argb8888_yuy2_AVX2(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_argb8888_yuv_AVX2(output, input, width, height, out_stride, in_stride, false);
+}
+
+PIXCONV_TARGET("avx2")
+static void conv_argb8888_uyvy_AVX2(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_argb8888_yuv_AVX2(output, input, width, height, out_stride, in_stride, true);
+}
 #endif
 
-#if defined(__SSE2__)
-void conv_rgb565_argb8888(void *output_, const void *input_,
+#if defined(PIXCONV_NEON)
+static inline uint8x8_t expand5_neon(uint16x8_t c)
+{
+   return vmovn_u16(vorrq_u16(vshlq_n_u16(c, 3), vshrq_n_u16(c, 2)));
+}
+
+static inline uint8x8_t expand6_neon(uint16x8_t c)
+{
+   return vmovn_u16(vorrq_u16(vshlq_n_u16(c, 2), vshrq_n_u16(c, 4)));
+}
+
+// Channels are returned as B, G, R, A planes, ready for vst3/vst4.
+static inline uint8x8x4_t unpack_0rgb1555_neon(uint16x8_t in)
+{
+   const uint16x8_t mask = vdupq_n_u16(0x1f);
+   uint8x8x4_t res;
+   res.val[0] = expand5_neon(vandq_u16(in, mask));
+   res.val[1] = expand5_neon(vandq_u16(vshrq_n_u16(in, 5), mask));
+   res.val[2] = expand5_neon(vandq_u16(vshrq_n_u16(in, 10), mask));
+   res.val[3] = vdup_n_u8(0xff);
+   return res;
+}
+
+static inline uint8x8x4_t unpack_rgb565_neon(uint16x8_t in)
+{
+   uint8x8x4_t res;
+   res.val[0] = expand5_neon(vandq_u16(in, vdupq_n_u16(0x1f)));
+   res.val[1] = expand6_neon(vandq_u16(vshrq_n_u16(in, 5), vdupq_n_u16(0x3f)));
+   res.val[2] = expand5_neon(vshrq_n_u16(in, 11));
+   res.val[3] = vdup_n_u8(0xff);
+   return res;
+}
+
+static void conv_0rgb1555_argb8888_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint16_t *input = (const uint16_t*)input_;
    uint32_t *output      = (uint32_t*)output_;
 
-   const __m128i pix_mask_r = _mm_set1_epi16(0x1f << 10);
-   const __m128i pix_mask_g = _mm_set1_epi16(0x3f <<  5);
-   const __m128i pix_mask_b = _mm_set1_epi16(0x1f <<  5);
-   const __m128i mul16_r    = _mm_set1_epi16(0x0210);
-   const __m128i mul16_g    = _mm_set1_epi16(0x2080);
-   const __m128i mul16_b    = _mm_set1_epi16(0x4200);
-   const __m128i a          = _mm_set1_epi16(0x00ff);
-
    int max_width = width - 7;
 
    for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
    {
       int w;
       for (w = 0; w < max_width; w += 8)
-      {
-         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
-         __m128i r = _mm_and_si128(_mm_srli_epi16(in, 1), pix_mask_r);
-         __m128i g = _mm_and_si128(in, pix_mask_g);
-         __m128i b = _mm_and_si128(_mm_slli_epi16(in, 5), pix_mask_b);
-
-         r = _mm_mulhi_epi16(r, mul16_r);
-         g = _mm_mulhi_epi16(g, mul16_g);
-         b = _mm_mulhi_epi16(b, mul16_b);
-
-         __m128i res_lo_bg = _mm_unpacklo_epi8(b, g);
-         __m128i res_hi_bg = _mm_unpackhi_epi8(b, g);
-         __m128i res_lo_ra = _mm_unpacklo_epi8(r, a);
-         __m128i res_hi_ra = _mm_unpackhi_epi8(r, a);
-
-         __m128i res_lo = _mm_or_si128(res_lo_bg, _mm_slli_si128(res_lo_ra, 2));
-         __m128i res_hi = _mm_or_si128(res_hi_bg, _mm_slli_si128(res_hi_ra, 2));
-
-         _mm_storeu_si128((__m128i*)(output + w + 0), res_lo);
-         _mm_storeu_si128((__m128i*)(output + w + 4), res_hi);
-      }
+         vst4_u8((uint8_t*)(output + w), unpack_0rgb1555_neon(vld1q_u16(input + w)));
 
       for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t r = (col >> 11) & 0x1f;
-         uint32_t g = (col >>  5) & 0x3f;
-         uint32_t b = (col >>  0) & 0x1f;
-         r = (r << 3) | (r >> 2);
-         g = (g << 2) | (g >> 4);
-         b = (b << 3) | (b >> 2);
-
-         output[w] = (0xff << 24) | (r << 16) | (g << 8) | (b << 0);
-      }
+         output[w] = pix_0rgb1555_argb8888(input[w]);
    }
 }
-#else
-void conv_rgb565_argb8888(void *output_, const void *input_,
+
+static void conv_rgb565_argb8888_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint16_t *input = (const uint16_t*)input_;
    uint32_t *output      = (uint32_t*)output_;
 
+   int max_width = width - 7;
+
    for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 1)
    {
-      for (int w = 0; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t r = (col >> 11) & 0x1f;
-         uint32_t g = (col >>  5) & 0x3f;
-         uint32_t b = (col >>  0) & 0x1f;
-         r = (r << 3) | (r >> 2);
-         g = (g << 2) | (g >> 4);
-         b = (b << 3) | (b >> 2);
+      int w;
+      for (w = 0; w < max_width; w += 8)
+         vst4_u8((uint8_t*)(output + w), unpack_rgb565_neon(vld1q_u16(input + w)));
 
-         output[w] = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
-      }
+      for (; w < width; w++)
+         output[w] = pix_rgb565_argb8888(input[w]);
    }
 }
-#endif
-
-#if defined(__SSE2__)
-// :( TODO: Make this saner.
-static inline void store_bgr24_sse2(void *output, __m128i a, __m128i b, __m128i c, __m128i d)
-{
-   const __m128i mask_0 = _mm_set_epi32(0, 0, 0, 0x00ffffff);
-   const __m128i mask_1 = _mm_set_epi32(0, 0, 0x00ffffff, 0);
-   const __m128i mask_2 = _mm_set_epi32(0, 0x00ffffff, 0, 0);
-   const __m128i mask_3 = _mm_set_epi32(0x00ffffff, 0, 0, 0);
-
-   __m128i a0 = _mm_and_si128(a, mask_0);
-   __m128i a1 = _mm_srli_si128(_mm_and_si128(a, mask_1),  1);
-   __m128i a2 = _mm_srli_si128(_mm_and_si128(a, mask_2),  2);
-   __m128i a3 = _mm_srli_si128(_mm_and_si128(a, mask_3),  3);
-   __m128i a4 = _mm_slli_si128(_mm_and_si128(b, mask_0), 12);
-   __m128i a5 = _mm_slli_si128(_mm_and_si128(b, mask_1), 11);
-
-   __m128i b0 = _mm_srli_si128(_mm_and_si128(b, mask_1), 5);
-   __m128i b1 = _mm_srli_si128(_mm_and_si128(b, mask_2), 6);
-   __m128i b2 = _mm_srli_si128(_mm_and_si128(b, mask_3), 7);
-   __m128i b3 = _mm_slli_si128(_mm_and_si128(c, mask_0), 8);
-   __m128i b4 = _mm_slli_si128(_mm_and_si128(c, mask_1), 7);
-   __m128i b5 = _mm_slli_si128(_mm_and_si128(c, mask_2), 6);
-
-   __m128i c0 = _mm_srli_si128(_mm_and_si128(c, mask_2), 10);
-   __m128i c1 = _mm_srli_si128(_mm_and_si128(c, mask_3), 11);
-   __m128i c2 = _mm_slli_si128(_mm_and_si128(d, mask_0),  4);
-   __m128i c3 = _mm_slli_si128(_mm_and_si128(d, mask_1),  3);
-   __m128i c4 = _mm_slli_si128(_mm_and_si128(d, mask_2),  2);
-   __m128i c5 = _mm_slli_si128(_mm_and_si128(d, mask_3),  1);
-
-   __m128i *out = (__m128i*)output;
-
-   _mm_storeu_si128(out + 0,
-         _mm_or_si128(a0, _mm_or_si128(a1, _mm_or_si128(a2, _mm_or_si128(a3, _mm_or_si128(a4, a5))))));
-
-   _mm_storeu_si128(out + 1,
-         _mm_or_si128(b0, _mm_or_si128(b1, _mm_or_si128(b2, _mm_or_si128(b3, _mm_or_si128(b4, b5))))));
-
-   _mm_storeu_si128(out + 2,
-         _mm_or_si128(c0, _mm_or_si128(c1, _mm_or_si128(c2, _mm_or_si128(c3, _mm_or_si128(c4, c5))))));
-}
 
-void conv_0rgb1555_bgr24(void *output_, const void *input_,
+static void conv_0rgb1555_bgr24_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint16_t *input = (const uint16_t*)input_;
    uint8_t *output       = (uint8_t*)output_;
 
-   const __m128i pix_mask_r  = _mm_set1_epi16(0x1f << 10);
-   const __m128i pix_mask_gb = _mm_set1_epi16(0x1f <<  5);
-   const __m128i mul15_mid   = _mm_set1_epi16(0x4200);
-   const __m128i mul15_hi    = _mm_set1_epi16(0x0210);
-   const __m128i a           = _mm_set1_epi16(0x00ff);
-
-   int max_width = width - 15;
+   int max_width = width - 7;
 
    for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
    {
       uint8_t *out = output;
-
       int w;
-      for (w = 0; w < max_width; w += 16, out += 48)
+      for (w = 0; w < max_width; w += 8, out += 24)
       {
-         const __m128i in0 = _mm_loadu_si128((const __m128i*)(input + w + 0));
-         const __m128i in1 = _mm_loadu_si128((const __m128i*)(input + w + 8));
-         __m128i r0 = _mm_and_si128(in0, pix_mask_r);
-         __m128i r1 = _mm_and_si128(in1, pix_mask_r);
-         __m128i g0 = _mm_and_si128(in0, pix_mask_gb);
-         __m128i g1 = _mm_and_si128(in1, pix_mask_gb);
-         __m128i b0 = _mm_and_si128(_mm_slli_epi16(in0, 5), pix_mask_gb);
-         __m128i b1 = _mm_and_si128(_mm_slli_epi16(in1, 5), pix_mask_gb);
-
-         r0 = _mm_mulhi_epi16(r0, mul15_hi);
-         r1 = _mm_mulhi_epi16(r1, mul15_hi);
-         g0 = _mm_mulhi_epi16(g0, mul15_mid);
-         g1 = _mm_mulhi_epi16(g1, mul15_mid);
-         b0 = _mm_mulhi_epi16(b0, mul15_mid);
-         b1 = _mm_mulhi_epi16(b1, mul15_mid);
-
-         __m128i res_lo_bg0 = _mm_unpacklo_epi8(b0, g0);
-         __m128i res_lo_bg1 = _mm_unpacklo_epi8(b1, g1);
-         __m128i res_hi_bg0 = _mm_unpackhi_epi8(b0, g0);
-         __m128i res_hi_bg1 = _mm_unpackhi_epi8(b1, g1);
-         __m128i res_lo_ra0 = _mm_unpacklo_epi8(r0, a);
-         __m128i res_lo_ra1 = _mm_unpacklo_epi8(r1, a);
-         __m128i res_hi_ra0 = _mm_unpackhi_epi8(r0, a);
-         __m128i res_hi_ra1 = _mm_unpackhi_epi8(r1, a);
-
-         __m128i res_lo0 = _mm_or_si128(res_lo_bg0, _mm_slli_si128(res_lo_ra0, 2));
-         __m128i res_lo1 = _mm_or_si128(res_lo_bg1, _mm_slli_si128(res_lo_ra1, 2));
-         __m128i res_hi0 = _mm_or_si128(res_hi_bg0, _mm_slli_si128(res_hi_ra0, 2));
-         __m128i res_hi1 = _mm_or_si128(res_hi_bg1, _mm_slli_si128(res_hi_ra1, 2));
-
-         // Non-POT pixel sizes ftl :(
-         store_bgr24_sse2(out, res_lo0, res_hi0, res_lo1, res_hi1);
+         uint8x8x4_t pix = unpack_0rgb1555_neon(vld1q_u16(input + w));
+         uint8x8x3_t res = {{ pix.val[0], pix.val[1], pix.val[2] }};
+         vst3_u8(out, res);
       }
 
-      for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t b = (col >>  0) & 0x1f;
-         uint32_t g = (col >>  5) & 0x1f;
-         uint32_t r = (col >> 10) & 0x1f;
-         b = (b << 3) | (b >> 2);
-         g = (g << 3) | (g >> 2);
-         r = (r << 3) | (r >> 2);
-
-         *out++ = b;
-         *out++ = g;
-         *out++ = r;
-      }
+      for (; w < width; w++, out += 3)
+         store_pix_bgr24(out, pix_0rgb1555_argb8888(input[w]));
    }
 }
 
-void conv_rgb565_bgr24(void *output_, const void *input_,
+static void conv_rgb565_bgr24_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint16_t *input = (const uint16_t*)input_;
-   uint8_t *output      = (uint8_t*)output_;
-
-   const __m128i pix_mask_r = _mm_set1_epi16(0x1f << 10);
-   const __m128i pix_mask_g = _mm_set1_epi16(0x3f <<  5);
-   const __m128i pix_mask_b = _mm_set1_epi16(0x1f <<  5);
-   const __m128i mul16_r    = _mm_set1_epi16(0x0210);
-   const __m128i mul16_g    = _mm_set1_epi16(0x2080);
-   const __m128i mul16_b    = _mm_set1_epi16(0x4200);
-   const __m128i a          = _mm_set1_epi16(0x00ff);
+   uint8_t *output       = (uint8_t*)output_;
 
-   int max_width = width - 15;
+   int max_width = width - 7;
 
    for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
    {
       uint8_t *out = output;
-
       int w;
-      for (w = 0; w < max_width; w += 16, out += 48)
+      for (w = 0; w < max_width; w += 8, out += 24)
       {
-         const __m128i in0 = _mm_loadu_si128((const __m128i*)(input + w));
-         const __m128i in1 = _mm_loadu_si128((const __m128i*)(input + w + 8));
-         __m128i r0 = _mm_and_si128(_mm_srli_epi16(in0, 1), pix_mask_r);
-         __m128i g0 = _mm_and_si128(in0, pix_mask_g);
-         __m128i b0 = _mm_and_si128(_mm_slli_epi16(in0, 5), pix_mask_b);
-         __m128i r1 = _mm_and_si128(_mm_srli_epi16(in1, 1), pix_mask_r);
-         __m128i g1 = _mm_and_si128(in1, pix_mask_g);
-         __m128i b1 = _mm_and_si128(_mm_slli_epi16(in1, 5), pix_mask_b);
-
-         r0 = _mm_mulhi_epi16(r0, mul16_r);
-         g0 = _mm_mulhi_epi16(g0, mul16_g);
-         b0 = _mm_mulhi_epi16(b0, mul16_b);
-         r1 = _mm_mulhi_epi16(r1, mul16_r);
-         g1 = _mm_mulhi_epi16(g1, mul16_g);
-         b1 = _mm_mulhi_epi16(b1, mul16_b);
-
-         __m128i res_lo_bg0 = _mm_unpacklo_epi8(b0, g0);
-         __m128i res_hi_bg0 = _mm_unpackhi_epi8(b0, g0);
-         __m128i res_lo_ra0 = _mm_unpacklo_epi8(r0, a);
-         __m128i res_hi_ra0 = _mm_unpackhi_epi8(r0, a);
-         __m128i res_lo_bg1 = _mm_unpacklo_epi8(b1, g1);
-         __m128i res_hi_bg1 = _mm_unpackhi_epi8(b1, g1);
-         __m128i res_lo_ra1 = _mm_unpacklo_epi8(r1, a);
-         __m128i res_hi_ra1 = _mm_unpackhi_epi8(r1, a);
-
-         __m128i res_lo0 = _mm_or_si128(res_lo_bg0, _mm_slli_si128(res_lo_ra0, 2));
-         __m128i res_hi0 = _mm_or_si128(res_hi_bg0, _mm_slli_si128(res_hi_ra0, 2));
-         __m128i res_lo1 = _mm_or_si128(res_lo_bg1, _mm_slli_si128(res_lo_ra1, 2));
-         __m128i res_hi1 = _mm_or_si128(res_hi_bg1, _mm_slli_si128(res_hi_ra1, 2));
-
-         store_bgr24_sse2(out, res_lo0, res_hi0, res_lo1, res_hi1);
+         uint8x8x4_t pix = unpack_rgb565_neon(vld1q_u16(input + w));
+         uint8x8x3_t res = {{ pix.val[0], pix.val[1], pix.val[2] }};
+         vst3_u8(out, res);
       }
 
-      for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t r = (col >> 11) & 0x1f;
-         uint32_t g = (col >>  5) & 0x3f;
-         uint32_t b = (col >>  0) & 0x1f;
-         r = (r << 3) | (r >> 2);
-         g = (g << 2) | (g >> 4);
-         b = (b << 3) | (b >> 2);
-
-         *out++ = b;
-         *out++ = g;
-         *out++ = r;
-      }
+      for (; w < width; w++, out += 3)
+         store_pix_bgr24(out, pix_rgb565_argb8888(input[w]));
    }
 }
-#else
-void conv_0rgb1555_bgr24(void *output_, const void *input_,
+
+static void conv_rgb565_0rgb1555_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint16_t *input = (const uint16_t*)input_;
-   uint8_t *output       = (uint8_t*)output_;
+   uint16_t *output = (uint16_t*)output_;
 
-   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   const uint16x8_t hi_mask = vdupq_n_u16(0x7fe0);
+   const uint16x8_t lo_mask = vdupq_n_u16(0x1f);
+
+   int max_width = width - 7;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
    {
-      uint8_t *out = output;
-      for (int w = 0; w < width; w++)
+      int w;
+      for (w = 0; w < max_width; w += 8)
       {
-         uint32_t col = input[w];
-         uint32_t b = (col >>  0) & 0x1f;
-         uint32_t g = (col >>  5) & 0x1f;
-         uint32_t r = (col >> 10) & 0x1f;
-         b = (b << 3) | (b >> 2);
-         g = (g << 3) | (g >> 2);
-         r = (r << 3) | (r >> 2);
-
-         *out++ = b;
-         *out++ = g;
-         *out++ = r;
+         uint16x8_t in = vld1q_u16(input + w);
+         vst1q_u16(output + w, vorrq_u16(vandq_u16(vshrq_n_u16(in, 1), hi_mask), vandq_u16(in, lo_mask)));
       }
+
+      for (; w < width; w++)
+         output[w] = pix_rgb565_0rgb1555(input[w]);
    }
 }
 
-void conv_rgb565_bgr24(void *output_, const void *input_,
+static void conv_0rgb1555_rgb565_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint16_t *input = (const uint16_t*)input_;
-   uint8_t *output       = (uint8_t*)output_;
+   uint16_t *output = (uint16_t*)output_;
 
-   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   const uint16x8_t hi_mask   = vdupq_n_u16((0x1f << 11) | (0x1f << 6));
+   const uint16x8_t lo_mask   = vdupq_n_u16(0x1f);
+   const uint16x8_t glow_mask = vdupq_n_u16(1 << 5);
+
+   int max_width = width - 7;
+
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 1)
    {
-      uint8_t *out = output;
-      for (int w = 0; w < width; w++)
+      int w;
+      for (w = 0; w < max_width; w += 8)
       {
-         uint32_t col = input[w];
-         uint32_t b = (col >>  0) & 0x1f;
-         uint32_t g = (col >>  5) & 0x3f;
-         uint32_t r = (col >> 11) & 0x1f;
-         b = (b << 3) | (b >> 2);
-         g = (g << 2) | (g >> 4);
-         r = (r << 3) | (r >> 2);
-
-         *out++ = b;
-         *out++ = g;
-         *out++ = r;
+         uint16x8_t in   = vld1q_u16(input + w);
+         uint16x8_t rg   = vandq_u16(vshlq_n_u16(in, 1), hi_mask);
+         uint16x8_t b    = vandq_u16(in, lo_mask);
+         uint16x8_t glow = vandq_u16(vshrq_n_u16(in, 4), glow_mask);
+         vst1q_u16(output + w, vorrq_u16(rg, vorrq_u16(b, glow)));
       }
+
+      for (; w < width; w++)
+         output[w] = pix_0rgb1555_rgb565(input[w]);
    }
 }
-#endif
 
-void conv_bgr24_argb8888(void *output_, const void *input_,
+static void conv_bgr24_argb8888_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint8_t *input = (const uint8_t*)input_;
    uint32_t *output     = (uint32_t*)output_;
 
+   int max_width = width - 7;
+
    for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride)
    {
       const uint8_t *inp = input;
-      for (int w = 0; w < width; w++)
+      int w;
+      for (w = 0; w < max_width; w += 8, inp += 24)
       {
-         uint32_t b = *inp++;
-         uint32_t g = *inp++;
-         uint32_t r = *inp++;
+         uint8x8x3_t in  = vld3_u8(inp);
+         uint8x8x4_t res = {{ in.val[0], in.val[1], in.val[2], vdup_n_u8(0xff) }};
+         vst4_u8((uint8_t*)(output + w), res);
+      }
+
+      for (; w < width; w++, inp += 3)
+      {
+         uint32_t b = inp[0];
+         uint32_t g = inp[1];
+         uint32_t r = inp[2];
          output[w] = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
       }
    }
 }
 
-void conv_argb8888_0rgb1555(void *output_, const void *input_,
+static void conv_argb8888_0rgb1555_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint32_t *input = (const uint32_t*)input_;
    uint16_t *output      = (uint16_t*)output_;
 
+   int max_width = width - 7;
+
    for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 2)
    {
-      for (int w = 0; w < width; w++)
+      int w;
+      for (w = 0; w < max_width; w += 8)
       {
-         uint32_t col = input[w];
-         uint16_t r = (col >> 19) & 0x1f;
-         uint16_t g = (col >> 11) & 0x1f;
-         uint16_t b = (col >>  3) & 0x1f;
-         output[w] = (r << 10) | (g << 5) | (b << 0);
+         uint8x8x4_t in = vld4_u8((const uint8_t*)(input + w));
+         uint16x8_t r = vshlq_n_u16(vmovl_u8(vshr_n_u8(in.val[2], 3)), 10);
+         uint16x8_t g = vshlq_n_u16(vmovl_u8(vshr_n_u8(in.val[1], 3)), 5);
+         uint16x8_t b = vmovl_u8(vshr_n_u8(in.val[0], 3));
+         vst1q_u16(output + w, vorrq_u16(r, vorrq_u16(g, b)));
       }
+
+      for (; w < width; w++)
+         output[w] = pix_argb8888_0rgb1555(input[w]);
    }
 }
 
-#if defined(__SSE2__)
-void conv_argb8888_bgr24(void *output_, const void *input_,
+static void conv_argb8888_rgb565_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint32_t *input = (const uint32_t*)input_;
-   uint8_t *output       = (uint8_t*)output_;
+   uint16_t *output      = (uint16_t*)output_;
 
-   int max_width = width - 15;
+   int max_width = width - 7;
 
-   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
+   for (int h = 0; h < height; h++, output += out_stride >> 1, input += in_stride >> 2)
    {
-      uint8_t *out = output;
       int w;
-
-      for (w = 0; w < max_width; w += 16, out += 48)
+      for (w = 0; w < max_width; w += 8)
       {
-         store_bgr24_sse2(out,
-               _mm_loadu_si128((const __m128i*)(input + w +  0)),
-               _mm_loadu_si128((const __m128i*)(input + w +  4)),
-               _mm_loadu_si128((const __m128i*)(input + w +  8)),
-               _mm_loadu_si128((const __m128i*)(input + w + 12)));
+         uint8x8x4_t in = vld4_u8((const uint8_t*)(input + w));
+         uint16x8_t r = vshlq_n_u16(vmovl_u8(vshr_n_u8(in.val[2], 3)), 11);
+         uint16x8_t g = vshlq_n_u16(vmovl_u8(vshr_n_u8(in.val[1], 2)), 5);
+         uint16x8_t b = vmovl_u8(vshr_n_u8(in.val[0], 3));
+         vst1q_u16(output + w, vorrq_u16(r, vorrq_u16(g, b)));
       }
 
       for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         *out++ = (uint8_t)(col >>  0);
-         *out++ = (uint8_t)(col >>  8);
-         *out++ = (uint8_t)(col >> 16);
-      }
+         output[w] = pix_argb8888_rgb565(input[w]);
    }
 }
-#else
-void conv_argb8888_bgr24(void *output_, const void *input_,
+
+static void conv_argb8888_bgr24_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint32_t *input = (const uint32_t*)input_;
    uint8_t *output       = (uint8_t*)output_;
 
+   int max_width = width - 7;
+
    for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
    {
       uint8_t *out = output;
-      for (int w = 0; w < width; w++)
+      int w;
+      for (w = 0; w < max_width; w += 8, out += 24)
       {
-         uint32_t col = input[w];
-         *out++ = (uint8_t)(col >>  0);
-         *out++ = (uint8_t)(col >>  8);
-         *out++ = (uint8_t)(col >> 16);
+         uint8x8x4_t in  = vld4_u8((const uint8_t*)(input + w));
+         uint8x8x3_t res = {{ in.val[0], in.val[1], in.val[2] }};
+         vst3_u8(out, res);
       }
+
+      for (; w < width; w++, out += 3)
+         store_pix_bgr24(out, input[w]);
    }
 }
-#endif
 
-void conv_argb8888_abgr8888(void *output_, const void *input_,
+static void conv_argb8888_abgr8888_NEON(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
    const uint32_t *input = (const uint32_t*)input_;
    uint32_t *output      = (uint32_t*)output_;
 
+   int max_width = width - 7;
+
    for (int h = 0; h < height; h++, output += out_stride >> 2, input += in_stride >> 2)
    {
-      for (int w = 0; w < width; w++)
+      int w;
+      for (w = 0; w < max_width; w += 8)
+      {
+         uint8x8x4_t in = vld4_u8((const uint8_t*)(input + w));
+         uint8x8_t tmp  = in.val[0];
+         in.val[0]      = in.val[2];
+         in.val[2]      = tmp;
+         vst4_u8((uint8_t*)(output + w), in);
+      }
+
+      for (; w < width; w++)
+         output[w] = pix_argb8888_abgr8888(input[w]);
+   }
+}
+static inline uint8x8_t yuv_component_neon(int16x8_t r, int16x8_t g, int16x8_t b,
+      int16_t coeff_r, int16_t coeff_g, int16_t coeff_b, int16_t offset)
+{
+   int32x4_t lo = vmull_n_s16(vget_low_s16(r), coeff_r);
+   lo = vmlal_n_s16(lo, vget_low_s16(g), coeff_g);
+   lo = vmlal_n_s16(lo, vget_low_s16(b), coeff_b);
+   lo = vaddq_s32(lo, vdupq_n_s32(YUV_ROUND));
+
+   int32x4_t hi = vmull_n_s16(vget_high_s16(r), coeff_r);
+   hi = vmlal_n_s16(hi, vget_high_s16(g), coeff_g);
+   hi = vmlal_n_s16(hi, vget_high_s16(b), coeff_b);
+   hi = vaddq_s32(hi, vdupq_n_s32(YUV_ROUND));
+
+   int16x8_t res = vcombine_s16(vshrn_n_s32(lo, 15), vshrn_n_s32(hi, 15));
+   return vqmovun_s16(vaddq_s16(res, vdupq_n_s16(offset)));
+}
+
+// Converts 8 pixels to 8 macropixels (32 bytes).
+static inline void store_yuv_neon(uint8_t *output, uint16x8_t r_, uint16x8_t g_, uint16x8_t b_, bool uyvy)
+{
+   int16x8_t r = vreinterpretq_s16_u16(r_);
+   int16x8_t g = vreinterpretq_s16_u16(g_);
+   int16x8_t b = vreinterpretq_s16_u16(b_);
+
+   uint8x8_t y = yuv_component_neon(r, g, b, YUV_COEFF_Y_R, YUV_COEFF_Y_G, YUV_COEFF_Y_B, 16);
+   uint8x8_t u = yuv_component_neon(r, g, b, YUV_COEFF_U_R, YUV_COEFF_U_G, YUV_COEFF_U_B, 128);
+   uint8x8_t v = yuv_component_neon(r, g, b, YUV_COEFF_V_R, YUV_COEFF_V_G, YUV_COEFF_V_B, 128);
+
+   uint8x8x4_t res;
+   if (uyvy)
+   {
+      res.val[0] = u;
+      res.val[1] = y;
+      res.val[2] = v;
+      res.val[3] = y;
+   }
+   else
+   {
+      res.val[0] = y;
+      res.val[1] = u;
+      res.val[2] = y;
+      res.val[3] = v;
+   }
+   vst4_u8(output, res);
+}
+
+static inline void conv_rgb565_yuv_NEON(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride, bool uyvy)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   int max_width = width - 7;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 8)
+      {
+         uint8x8x4_t in = unpack_rgb565_neon(vld1q_u16(input + w));
+         store_yuv_neon(output + 4 * w, vmovl_u8(in.val[2]), vmovl_u8(in.val[1]), vmovl_u8(in.val[0]), uyvy);
+      }
+
+      for (; w < width; w++)
+         store_pix_rgb565_yuv(output + 4 * w, input[w], uyvy);
+   }
+}
+
+static inline void conv_argb8888_yuv_NEON(void *output_, const void *input_,
+      int width, int height,
+      int out_stride, int in_stride, bool uyvy)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   int max_width = width - 7;
+
+   for (int h = 0; h < height; h++, output += out_stride, input += in_stride >> 2)
+   {
+      int w;
+      for (w = 0; w < max_width; w += 8)
       {
-         uint32_t col = input[w];
-         output[w] = ((col << 16) & 0xff0000) | ((col >> 16) & 0xff) | (col & 0xff00ff00);
+         uint8x8x4_t in = vld4_u8((const uint8_t*)(input + w));
+         store_yuv_neon(output + 4 * w, vmovl_u8(in.val[2]), vmovl_u8(in.val[1]), vmovl_u8(in.val[0]), uyvy);
       }
+
+      for (; w < width; w++)
+         store_pix_argb8888_yuv(output + 4 * w, input[w], uyvy);
    }
 }
 
+static void conv_rgb565_yuy2_NEON(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_rgb565_yuv_NEON(output, input, width, height, out_stride, in_stride, false);
+}
+
+static void conv_rgb565_uyvy_NEON(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_rgb565_yuv_NEON(output, input, width, height, out_stride, in_stride, true);
+}
+
+static void conv_argb8888_yuy2_NEON(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_argb8888_yuv_NEON(output, input, width, height, out_stride, in_stride, false);
+}
+
+static void conv_argb8888_uyvy_NEON(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   conv_argb8888_yuv_NEON(output, input, width, height, out_stride, in_stride, true);
+}
+#endif
+
 void conv_copy(void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
@@ -677,3 +1906,114 @@ void conv_copy(void *output_, const void *input_,
       memcpy(output, input, copy_len);
 }
 
+pixconv_func_t conv_0rgb1555_argb8888 = conv_0rgb1555_argb8888_C;
+pixconv_func_t conv_0rgb1555_rgb565   = conv_0rgb1555_rgb565_C;
+pixconv_func_t conv_rgb565_0rgb1555   = conv_rgb565_0rgb1555_C;
+pixconv_func_t conv_rgb565_argb8888   = conv_rgb565_argb8888_C;
+pixconv_func_t conv_bgr24_argb8888    = conv_bgr24_argb8888_C;
+pixconv_func_t conv_argb8888_0rgb1555 = conv_argb8888_0rgb1555_C;
+pixconv_func_t conv_argb8888_rgb565   = conv_argb8888_rgb565_C;
+pixconv_func_t conv_argb8888_bgr24    = conv_argb8888_bgr24_C;
+pixconv_func_t conv_argb8888_abgr8888 = conv_argb8888_abgr8888_C;
+pixconv_func_t conv_0rgb1555_bgr24    = conv_0rgb1555_bgr24_C;
+pixconv_func_t conv_rgb565_bgr24      = conv_rgb565_bgr24_C;
+pixconv_func_t conv_rgb565_yuy2       = conv_rgb565_yuy2_C;
+pixconv_func_t conv_rgb565_uyvy       = conv_rgb565_uyvy_C;
+pixconv_func_t conv_argb8888_yuy2     = conv_argb8888_yuy2_C;
+pixconv_func_t conv_argb8888_uyvy     = conv_argb8888_uyvy_C;
+
+const char *conv_init_simd(unsigned simd)
+{
+   const char *isa = "C";
+
+   conv_0rgb1555_argb8888 = conv_0rgb1555_argb8888_C;
+   conv_0rgb1555_rgb565   = conv_0rgb1555_rgb565_C;
+   conv_rgb565_0rgb1555   = conv_rgb565_0rgb1555_C;
+   conv_rgb565_argb8888   = conv_rgb565_argb8888_C;
+   conv_bgr24_argb8888    = conv_bgr24_argb8888_C;
+   conv_argb8888_0rgb1555 = conv_argb8888_0rgb1555_C;
+   conv_argb8888_rgb565   = conv_argb8888_rgb565_C;
+   conv_argb8888_bgr24    = conv_argb8888_bgr24_C;
+   conv_argb8888_abgr8888 = conv_argb8888_abgr8888_C;
+   conv_0rgb1555_bgr24    = conv_0rgb1555_bgr24_C;
+   conv_rgb565_bgr24      = conv_rgb565_bgr24_C;
+   conv_rgb565_yuy2       = conv_rgb565_yuy2_C;
+   conv_rgb565_uyvy       = conv_rgb565_uyvy_C;
+   conv_argb8888_yuy2     = conv_argb8888_yuy2_C;
+   conv_argb8888_uyvy     = conv_argb8888_uyvy_C;
+
+#if defined(PIXCONV_SSE2)
+   if (simd & RARCH_SIMD_SSE2)
+   {
+      conv_0rgb1555_argb8888 = conv_0rgb1555_argb8888_SSE2;
+      conv_0rgb1555_rgb565   = conv_0rgb1555_rgb565_SSE2;
+      conv_rgb565_0rgb1555   = conv_rgb565_0rgb1555_SSE2;
+      conv_rgb565_argb8888   = conv_rgb565_argb8888_SSE2;
+      conv_rgb565_yuy2       = conv_rgb565_yuy2_SSE2;
+      conv_rgb565_uyvy       = conv_rgb565_uyvy_SSE2;
+      conv_argb8888_yuy2     = conv_argb8888_yuy2_SSE2;
+      conv_argb8888_uyvy     = conv_argb8888_uyvy_SSE2;
+      conv_argb8888_0rgb1555 = conv_argb8888_0rgb1555_SSE2;
+      conv_argb8888_rgb565   = conv_argb8888_rgb565_SSE2;
+      conv_argb8888_bgr24    = conv_argb8888_bgr24_SSE2;
+      conv_argb8888_abgr8888 = conv_argb8888_abgr8888_SSE2;
+      conv_0rgb1555_bgr24    = conv_0rgb1555_bgr24_SSE2;
+      conv_rgb565_bgr24      = conv_rgb565_bgr24_SSE2;
+      isa = "SSE2";
+   }
+#endif
+
+#if defined(PIXCONV_SSSE3)
+   if ((simd & RARCH_SIMD_SSE2) && (simd & RARCH_SIMD_SSSE3))
+   {
+      conv_bgr24_argb8888    = conv_bgr24_argb8888_SSSE3;
+      conv_argb8888_bgr24    = conv_argb8888_bgr24_SSSE3;
+      conv_argb8888_abgr8888 = conv_argb8888_abgr8888_SSSE3;
+      conv_0rgb1555_bgr24    = conv_0rgb1555_bgr24_SSSE3;
+      conv_rgb565_bgr24      = conv_rgb565_bgr24_SSSE3;
+      isa = "SSSE3";
+   }
+#endif
+
+#if defined(PIXCONV_AVX2)
+   if (simd & RARCH_SIMD_AVX2)
+   {
+      conv_0rgb1555_argb8888 = conv_0rgb1555_argb8888_AVX2;
+      conv_0rgb1555_rgb565   = conv_0rgb1555_rgb565_AVX2;
+      conv_rgb565_0rgb1555   = conv_rgb565_0rgb1555_AVX2;
+      conv_rgb565_argb8888   = conv_rgb565_argb8888_AVX2;
+      conv_rgb565_yuy2       = conv_rgb565_yuy2_AVX2;
+      conv_rgb565_uyvy       = conv_rgb565_uyvy_AVX2;
+      conv_argb8888_yuy2     = conv_argb8888_yuy2_AVX2;
+      conv_argb8888_uyvy     = conv_argb8888_uyvy_AVX2;
+      conv_argb8888_abgr8888 = conv_argb8888_abgr8888_AVX2;
+      isa = "AVX2";
+   }
+#endif
+
+#if defined(PIXCONV_NEON)
+   if (simd & RARCH_SIMD_NEON)
+   {
+      conv_0rgb1555_argb8888 = conv_0rgb1555_argb8888_NEON;
+      conv_0rgb1555_rgb565   = conv_0rgb1555_rgb565_NEON;
+      conv_rgb565_0rgb1555   = conv_rgb565_0rgb1555_NEON;
+      conv_rgb565_argb8888   = conv_rgb565_argb8888_NEON;
+      conv_rgb565_yuy2       = conv_rgb565_yuy2_NEON;
+      conv_rgb565_uyvy       = conv_rgb565_uyvy_NEON;
+      conv_argb8888_yuy2     = conv_argb8888_yuy2_NEON;
+      conv_argb8888_uyvy     = conv_argb8888_uyvy_NEON;
+      conv_bgr24_argb8888    = conv_bgr24_argb8888_NEON;
+      conv_argb8888_0rgb1555 = conv_argb8888_0rgb1555_NEON;
+      conv_argb8888_rgb565   = conv_argb8888_rgb565_NEON;
+      conv_argb8888_bgr24    = conv_argb8888_bgr24_NEON;
+      conv_argb8888_abgr8888 = conv_argb8888_abgr8888_NEON;
+      conv_0rgb1555_bgr24    = conv_0rgb1555_bgr24_NEON;
+      conv_rgb565_bgr24      = conv_rgb565_bgr24_NEON;
+      isa = "NEON";
+   }
+#endif
+
+   (void)simd;
+   return isa;
+}
+
@@ -1,6 +1,6 @@
 /*  RetroArch - A frontend for libretro.
  *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
- * 
+ *
  *  RetroArch is free software: you can redistribute it and/or modify it under the terms
  *  of the GNU General Public License as published by the Free Software Found-
  *  ation, either version 3 of the License, or (at your option) any later version.
@@ -16,53 +16,40 @@
 #ifndef PIXCONV_H__
 #define PIXCONV_H__
 
-void conv_0rgb1555_argb8888(void *output, const void *input,
-      int width, int height,
-      int out_stride, int in_stride);
-
-void conv_0rgb1555_rgb565(void *output, const void *input,
-      int width, int height,
-      int out_stride, int in_stride);
-
-void conv_rgb565_0rgb1555(void *output, const void *input,
-      int width, int height,
-      int out_stride, int in_stride);
-
-void conv_rgb565_argb8888(void *output, const void *input,
-      int width, int height,
-      int out_stride, int in_stride);
-
-void conv_bgr24_argb8888(void *output, const void *input,
-      int width, int height,
-      int out_stride, int in_stride);
-
-void conv_argb8888_0rgb1555(void *output, const void *input,
-      int width, int height,
-      int out_stride, int in_stride);
-
-void conv_argb8888_rgb565(void *output, const void *input,
+typedef void (*pixconv_func_t)(void *output, const void *input,
       int width, int height,
       int out_stride, int in_stride);
 
-void conv_argb8888_bgr24(void *output, const void *input,
-      int width, int height,
-      int out_stride, int in_stride);
+// Conversion routines are bound at runtime by conv_init_simd().
+// Until then, they point to the plain C implementations.
+extern pixconv_func_t conv_0rgb1555_argb8888;
+extern pixconv_func_t conv_0rgb1555_rgb565;
+extern pixconv_func_t conv_rgb565_0rgb1555;
+extern pixconv_func_t conv_rgb565_argb8888;
+extern pixconv_func_t conv_bgr24_argb8888;
+extern pixconv_func_t conv_argb8888_0rgb1555;
+extern pixconv_func_t conv_argb8888_rgb565;
+extern pixconv_func_t conv_argb8888_bgr24;
+extern pixconv_func_t conv_argb8888_abgr8888;
+extern pixconv_func_t conv_0rgb1555_bgr24;
+extern pixconv_func_t conv_rgb565_bgr24;
 
-void conv_argb8888_abgr8888(void *output, const void *input,
-      int width, int height,
-      int out_stride, int in_stride);
-
-void conv_0rgb1555_bgr24(void *output, const void *input,
-      int width, int height,
-      int out_stride, int in_stride);
-
-void conv_rgb565_bgr24(void *output, const void *input,
-      int width, int height,
-      int out_stride, int in_stride);
+// Packed YUV 4:2:2 (BT.601). Every input pixel is written as a whole
+// macropixel (4 bytes), so output is twice as wide and chroma is not subsampled.
+extern pixconv_func_t conv_rgb565_yuy2;
+extern pixconv_func_t conv_rgb565_uyvy;
+extern pixconv_func_t conv_argb8888_yuy2;
+extern pixconv_func_t conv_argb8888_uyvy;
 
 void conv_copy(void *output, const void *input,
       int width, int height,
       int out_stride, int in_stride);
 
+// Binds the conversion routines to the fastest implementations allowed by
+// simd (a mask of RARCH_SIMD_* flags, see performance.h).
+// Passing 0 selects the C reference implementations.
+// Returns the name of the best instruction set in use.
+const char *conv_init_simd(unsigned simd);
+
 #endif
 
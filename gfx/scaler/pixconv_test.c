@@ -0,0 +1,190 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks every SIMD pixel conversion against the C reference, and benchmarks them.
+
+#include "pixconv.h"
+#include "../../performance.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+struct conv_desc
+{
+   const char *ident;
+   pixconv_func_t *func;
+   unsigned in_bpp;
+   unsigned out_bpp;
+};
+
+static const struct conv_desc convs[] = {
+   { "0rgb1555_argb8888", &conv_0rgb1555_argb8888, 2, 4 },
+   { "0rgb1555_rgb565",   &conv_0rgb1555_rgb565,   2, 2 },
+   { "rgb565_0rgb1555",   &conv_rgb565_0rgb1555,   2, 2 },
+   { "rgb565_argb8888",   &conv_rgb565_argb8888,   2, 4 },
+   { "bgr24_argb8888",    &conv_bgr24_argb8888,    3, 4 },
+   { "argb8888_0rgb1555", &conv_argb8888_0rgb1555, 4, 2 },
+   { "argb8888_rgb565",   &conv_argb8888_rgb565,   4, 2 },
+   { "argb8888_bgr24",    &conv_argb8888_bgr24,    4, 3 },
+   { "argb8888_abgr8888", &conv_argb8888_abgr8888, 4, 4 },
+   { "0rgb1555_bgr24",    &conv_0rgb1555_bgr24,    2, 3 },
+   { "rgb565_bgr24",      &conv_rgb565_bgr24,      2, 3 },
+   { "rgb565_yuy2",       &conv_rgb565_yuy2,       2, 4 },
+   { "rgb565_uyvy",       &conv_rgb565_uyvy,       2, 4 },
+   { "argb8888_yuy2",     &conv_argb8888_yuy2,     4, 4 },
+   { "argb8888_uyvy",     &conv_argb8888_uyvy,     4, 4 },
+};
+
+#define NUM_CONVS (sizeof(convs) / sizeof(convs[0]))
+
+static unsigned host_simd(void)
+{
+   unsigned simd = 0;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("sse2"))
+      simd |= RARCH_SIMD_SSE2;
+   if (__builtin_cpu_supports("ssse3"))
+      simd |= RARCH_SIMD_SSSE3;
+   if (__builtin_cpu_supports("avx2"))
+      simd |= RARCH_SIMD_AVX2;
+#elif defined(HAVE_NEON)
+   simd |= RARCH_SIMD_NEON;
+#endif
+   return simd;
+}
+
+static double get_time(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return tv.tv_sec + tv.tv_nsec / 1000000000.0;
+}
+
+static void fill_random(uint8_t *data, size_t size)
+{
+   for (size_t i = 0; i < size; i++)
+      data[i] = rand();
+}
+
+// Converts random images of awkward sizes with the reference and the active implementation.
+// Padding after each output line must be left untouched.
+static bool check_conv(const struct conv_desc *desc, pixconv_func_t reference)
+{
+   for (int width = 1; width < 100; width += 3)
+   {
+      int height     = 3;
+      int in_stride  = width * desc->in_bpp + 13;
+      int out_stride = width * desc->out_bpp + 17;
+
+      uint8_t *input   = (uint8_t*)malloc(in_stride * height);
+      uint8_t *out_ref = (uint8_t*)malloc(out_stride * height);
+      uint8_t *out     = (uint8_t*)malloc(out_stride * height);
+
+      fill_random(input, in_stride * height);
+      memset(out_ref, 0xaa, out_stride * height);
+      memset(out, 0xaa, out_stride * height);
+
+      // Conversions assume strides aligned to the pixel size.
+      in_stride  -= in_stride % desc->in_bpp;
+      out_stride -= out_stride % desc->out_bpp;
+
+      reference(out_ref, input, width, height, out_stride, in_stride);
+      (*desc->func)(out, input, width, height, out_stride, in_stride);
+
+      bool equal = memcmp(out_ref, out, out_stride * height) == 0;
+
+      free(input);
+      free(out_ref);
+      free(out);
+
+      if (!equal)
+      {
+         fprintf(stderr, "Mismatch in %s (width %d)!\n", desc->ident, width);
+         return false;
+      }
+   }
+
+   return true;
+}
+
+static double bench_conv(const struct conv_desc *desc)
+{
+   const int width  = 1024;
+   const int height = 512;
+   const int iterations = 50;
+
+   void *input  = malloc(width * height * desc->in_bpp);
+   void *output = malloc(width * height * desc->out_bpp);
+   fill_random((uint8_t*)input, width * height * desc->in_bpp);
+
+   double start = get_time();
+   for (int i = 0; i < iterations; i++)
+      (*desc->func)(output, input, width, height,
+            width * desc->out_bpp, width * desc->in_bpp);
+   double time = get_time() - start;
+
+   free(input);
+   free(output);
+
+   return (double)width * height * iterations / (time * 1000000.0);
+}
+
+int main(int argc, char *argv[])
+{
+   (void)argc;
+   (void)argv;
+
+   static const unsigned levels[] = {
+      0,
+      RARCH_SIMD_SSE2,
+      RARCH_SIMD_SSE2 | RARCH_SIMD_SSSE3,
+      RARCH_SIMD_SSE2 | RARCH_SIMD_SSSE3 | RARCH_SIMD_AVX2,
+      RARCH_SIMD_NEON,
+   };
+
+   pixconv_func_t reference[NUM_CONVS];
+   conv_init_simd(0);
+   for (unsigned i = 0; i < NUM_CONVS; i++)
+      reference[i] = *convs[i].func;
+
+   unsigned simd = host_simd();
+   int ret = 0;
+
+   for (unsigned l = 0; l < sizeof(levels) / sizeof(levels[0]); l++)
+   {
+      if ((levels[l] & simd) != levels[l])
+         continue;
+
+      const char *isa = conv_init_simd(levels[l]);
+      if (l && !strcmp(isa, "C"))
+         continue;
+
+      fprintf(stderr, "=== %s ===\n", isa);
+      for (unsigned i = 0; i < NUM_CONVS; i++)
+      {
+         bool ok = check_conv(&convs[i], reference[i]);
+         if (!ok)
+            ret = 1;
+
+         fprintf(stderr, "  %-20s %s %8.1f MPix/s\n", convs[i].ident,
+               ok ? "OK  " : "FAIL", bench_conv(&convs[i]));
+      }
+   }
+
+   return ret;
+}
@@ -21,7 +21,7 @@
 #include "scaler/scaler.h"
 #include "gfx_common.h"
 #include "gfx_context.h"
-#include "fonts/fonts.h"
+#include "fonts/sw_font.h"
 
 #ifdef HAVE_X11
 #include "context/x11_common.h"
@@ -38,8 +38,7 @@ typedef struct sdl_video
    SDL_Surface *screen;
    bool quitting;
 
-   void *font;
-   const font_renderer_driver_t *font_driver;
+   sw_font_t *font;
    uint8_t font_r;
    uint8_t font_g;
    uint8_t font_b;
@@ -57,8 +56,7 @@ static void sdl_gfx_free(void *data)
 
    SDL_QuitSubSystem(SDL_INIT_VIDEO);
 
-   if (vid->font)
-      vid->font_driver->free(vid->font);
+   sw_font_free(vid->font);
 
    scaler_ctx_gen_reset(&vid->scaler);
 
@@ -70,7 +68,8 @@ static void sdl_init_font(sdl_video_t *vid, const char *font_path, unsigned font
    if (!g_settings.video.font_enable)
       return;
 
-   if (font_renderer_create_default(&vid->font_driver, &vid->font))
+   vid->font = sw_font_new();
+   if (vid->font)
    {
          int r = g_settings.video.msg_color_r * 255;
          int g = g_settings.video.msg_color_g * 255;
@@ -94,73 +93,14 @@ static void sdl_render_msg(sdl_video_t *vid, SDL_Surface *buffer,
    if (!vid->font)
       return;
 
-   struct font_output_list out;
-   vid->font_driver->render_msg(vid->font, msg, &out);
-   struct font_output *head = out.head;
-
    int msg_base_x = g_settings.video.msg_pos_x * width;
    int msg_base_y = (1.0 - g_settings.video.msg_pos_y) * height;
 
-   unsigned rshift = fmt->Rshift;
-   unsigned gshift = fmt->Gshift;
-   unsigned bshift = fmt->Bshift;
-
-   for (; head; head = head->next)
-   {
-      int base_x = msg_base_x + head->off_x;
-      int base_y = msg_base_y - head->off_y - head->height;
-
-      int glyph_width  = head->width;
-      int glyph_height = head->height;
-
-      const uint8_t *src = head->output;
-
-      if (base_x < 0)
-      {
-         src -= base_x;
-         glyph_width += base_x;
-         base_x = 0;
-      }
-
-      if (base_y < 0)
-      {
-         src -= base_y * (int)head->pitch;
-         glyph_height += base_y;
-         base_y = 0;
-      }
-
-      int max_width  = width - base_x;
-      int max_height = height - base_y;
-
-      if (max_width <= 0 || max_height <= 0)
-         continue;
-
-      if (glyph_width > max_width)
-         glyph_width = max_width;
-      if (glyph_height > max_height)
-         glyph_height = max_height;
-
-      uint32_t *out = (uint32_t*)buffer->pixels + base_y * (buffer->pitch >> 2) + base_x;
-
-      for (int y = 0; y < glyph_height; y++, src += head->pitch, out += buffer->pitch >> 2)
-      {
-         for (int x = 0; x < glyph_width; x++)
-         {
-            unsigned blend = src[x];
-            unsigned out_pix = out[x];
-            unsigned r = (out_pix >> rshift) & 0xff;
-            unsigned g = (out_pix >> gshift) & 0xff;
-            unsigned b = (out_pix >> bshift) & 0xff;
-
-            unsigned out_r = (r * (256 - blend) + vid->font_r * blend) >> 8;
-            unsigned out_g = (g * (256 - blend) + vid->font_g * blend) >> 8;
-            unsigned out_b = (b * (256 - blend) + vid->font_b * blend) >> 8;
-            out[x] = (out_r << rshift) | (out_g << gshift) | (out_b << bshift);
-         }
-      }
-   }
+   uint32_t color = (vid->font_r << fmt->Rshift) | (vid->font_g << fmt->Gshift) | (vid->font_b << fmt->Bshift);
+   uint32_t color_mask = (0xffu << fmt->Rshift) | (0xffu << fmt->Gshift) | (0xffu << fmt->Bshift);
 
-   vid->font_driver->free_output(vid->font, &out);
+   sw_font_blend_argb8888(vid->font, msg, (uint32_t*)buffer->pixels, buffer->pitch,
+         width, height, msg_base_x, msg_base_y, color, color_mask);
 }
 
 static void sdl_gfx_set_handles(void)
@@ -131,6 +131,10 @@ struct cg_program
    struct cg_fbo_params fbo[GFX_MAX_SHADERS];
    struct cg_fbo_params orig;
    struct cg_fbo_params prev[PREV_TEXTURES];
+
+   // State tracker variables, in the order state_get_uniform() returns them.
+   CGparameter state_var_v[MAX_VARIABLES];
+   CGparameter state_var_f[MAX_VARIABLES];
 };
 
 static struct cg_program prg[GFX_MAX_SHADERS];
@@ -323,10 +327,8 @@ static void gl_cg_set_params(unsigned width, unsigned height,
 
       for (unsigned i = 0; i < cnt; i++)
       {
-         CGparameter param_v = cgGetNamedParameter(prg[active_index].vprg, info[i].id);
-         CGparameter param_f = cgGetNamedParameter(prg[active_index].fprg, info[i].id);
-         set_param_1f(param_v, info[i].value);
-         set_param_1f(param_f, info[i].value);
+         set_param_1f(prg[active_index].state_var_v[i], info[i].value);
+         set_param_1f(prg[active_index].state_var_f[i], info[i].value);
       }
    }
 }
@@ -493,7 +495,7 @@ static bool load_plain(const char *path)
 
 #define print_buf(buf, ...) snprintf(buf, sizeof(buf), __VA_ARGS__)
 
-static void load_texture_data(GLuint obj, const struct texture_image *img, bool smooth, GLenum wrap)
+static void load_texture_data(GLuint obj, struct texture_image *img, bool smooth, GLenum wrap)
 {
    glBindTexture(GL_TEXTURE_2D, obj);
 
@@ -509,7 +511,7 @@ static void load_texture_data(GLuint obj, const struct texture_image *img, bool
          0, driver.gfx_use_rgba ? GL_RGBA : RARCH_GL_INTERNAL_FORMAT32, img->width, img->height,
          0, driver.gfx_use_rgba ? GL_RGBA : RARCH_GL_TEXTURE_TYPE32, RARCH_GL_FORMAT32, img->pixels);
 
-   free(img->pixels);
+   texture_image_free(img);
 }
 
 static bool load_textures(void)
@@ -792,6 +794,12 @@ static void set_program_attributes(unsigned i)
       snprintf(pass_str, sizeof(pass_str), "PASSPREV%u", i - j); 
       set_pass_attrib(&prg[i], &prg[i].fbo[j], pass_str);
    }
+
+   for (unsigned j = 0; j < cg_shader->variables && j < MAX_VARIABLES; j++)
+   {
+      prg[i].state_var_v[j] = cgGetNamedParameter(prg[i].vprg, cg_shader->variable[j].id);
+      prg[i].state_var_f[j] = cgGetNamedParameter(prg[i].fprg, cg_shader->variable[j].id);
+   }
 }
 
 static bool gl_cg_init(const char *path)
@@ -32,6 +32,14 @@
 
 #define GL_SHADER_STOCK_BLEND (GFX_MAX_SHADERS - 1)
 
+enum gl_shader_async_status
+{
+   GL_SHADER_ASYNC_IDLE = 0,
+   GL_SHADER_ASYNC_PENDING,
+   GL_SHADER_ASYNC_READY,
+   GL_SHADER_ASYNC_FAILED
+};
+
 struct gl_shader_backend
 {
    bool (*init)(const char *path);
@@ -54,6 +62,12 @@ struct gl_shader_backend
    unsigned (*get_prev_textures)(void);
 
    enum rarch_shader_type type;
+
+   // Optional. Starts building a new shader chain while the current one keeps being used.
+   // poll_async() is called every frame, and swaps in the new chain once it is ready.
+   // If it fails, the current chain is left as is, and it's up to the driver what to fall back to.
+   bool (*init_async)(const char *path);
+   enum gl_shader_async_status (*poll_async)(void);
 };
 
 #endif
@@ -22,6 +22,8 @@
 #include "state_tracker.h"
 #include "../dynamic.h"
 #include "../file.h"
+#include "../performance.h"
+#include "../hash.h"
 
 #ifdef HAVE_CONFIG_H
 #include "../config.h"
@@ -66,6 +68,27 @@
 
 #define PREV_TEXTURES (MAX_TEXTURES - 1)
 
+#ifndef HAVE_PSGL
+#define GLSL_PROGRAM_BINARY
+#endif
+
+#ifdef HAVE_OPENGLES2
+// From GL_OES_get_program_binary.
+#define glGetProgramBinary glGetProgramBinaryOES
+#define glProgramBinary glProgramBinaryOES
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#endif
+
+// From GL_KHR_parallel_shader_compile / GL_ARB_parallel_shader_compile.
+#ifndef GL_COMPLETION_STATUS_ARB
+#define GL_COMPLETION_STATUS_ARB 0x91B1
+#endif
+
 static struct gfx_shader *glsl_shader;
 static bool glsl_core;
 static unsigned glsl_major;
@@ -83,16 +106,21 @@ static GLint gl_attribs[PREV_TEXTURES + 1 + 4 + GFX_MAX_SHADERS];
 static unsigned gl_attrib_index;
 
 // Cache the VBO.
+#define GLSL_VBO_CACHE_SIZE 128
 struct cache_vbo
 {
    GLuint vbo_primary;
-   GLfloat buffer_primary[128];
+   GLfloat buffer_primary[GLSL_VBO_CACHE_SIZE];
    size_t size_primary;
 
    GLuint vbo_secondary;
-   GLfloat buffer_secondary[128];
+   GLfloat buffer_secondary[GLSL_VBO_CACHE_SIZE];
    size_t size_secondary;
 };
+
+// Scratch space for coordinate batches which are larger than a single quad.
+static GLfloat *glsl_coord_buffer;
+static size_t glsl_coord_buffer_size;
 static struct cache_vbo glsl_vbo[GFX_MAX_SHADERS];
 
 struct glsl_attrib
@@ -103,6 +131,7 @@ struct glsl_attrib
 };
 
 static gfx_ctx_proc_t (*glsl_get_proc_address)(const char*);
+static bool glsl_binary_cache;
 
 struct shader_uniforms_frame
 {
@@ -129,6 +158,7 @@ struct shader_uniforms
    int frame_direction;
 
    int lut_texture[GFX_MAX_TEXTURES];
+   int state_var[GFX_MAX_VARIABLES];
    
    struct shader_uniforms_frame orig;
    struct shader_uniforms_frame pass[GFX_MAX_SHADERS];
@@ -284,31 +314,32 @@ static GLint get_attrib(GLuint prog, const char *base)
    return -1;
 }
 
-static bool load_luts(void)
+static bool load_luts(const struct gfx_shader *shader, GLuint *textures)
 {
-   if (!glsl_shader->luts)
+   if (!shader->luts)
       return true;
 
-   glGenTextures(1, gl_teximage);
+   glGenTextures(shader->luts, textures);
 
-   for (unsigned i = 0; i < glsl_shader->luts; i++)
+   for (unsigned i = 0; i < shader->luts; i++)
    {
       RARCH_LOG("Loading texture image from: \"%s\" ...\n",
-            glsl_shader->lut[i].path);
+            shader->lut[i].path);
 
       struct texture_image img = {0};
-      if (!texture_image_load(glsl_shader->lut[i].path, &img))
+      if (!texture_image_load(shader->lut[i].path, &img))
       {
-         RARCH_ERR("Failed to load texture image from: \"%s\"\n", glsl_shader->lut[i].path);
+         RARCH_ERR("Failed to load texture image from: \"%s\"\n", shader->lut[i].path);
+         glDeleteTextures(shader->luts, textures);
          return false;
       }
 
-      glBindTexture(GL_TEXTURE_2D, gl_teximage[i]);
+      glBindTexture(GL_TEXTURE_2D, textures[i]);
 
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, BORDER_FUNC);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, BORDER_FUNC);
 
-      GLenum filter = glsl_shader->lut[i].filter == RARCH_FILTER_NEAREST ?
+      GLenum filter = shader->lut[i].filter == RARCH_FILTER_NEAREST ?
          GL_NEAREST : GL_LINEAR;
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
@@ -321,7 +352,7 @@ static bool load_luts(void)
             RARCH_GL_FORMAT32, img.pixels);
 
       glBindTexture(GL_TEXTURE_2D, 0);
-      free(img.pixels);
+      texture_image_free(&img);
    }
 
    return true;
@@ -371,69 +402,58 @@ static void print_linker_log(GLuint obj)
    free(info_log);
 }
 
-static bool compile_shader(GLuint shader, const char *define, const char *program)
+static void get_version_string(char *version, size_t size, const char *program)
 {
-   char version[32] = {0};
-   if (glsl_core && !strstr(program, "#version"))
-   {
-      unsigned version_no = 0;
-      unsigned gl_ver = glsl_major * 100 + glsl_minor * 10;
-      switch (gl_ver)
-      {
-         case 300: version_no = 130; break;
-         case 310: version_no = 140; break;
-         case 320: version_no = 150; break;
-         default: version_no = gl_ver; break;
-      }
+   *version = '\0';
+   if (!glsl_core || strstr(program, "#version"))
+      return;
 
-      snprintf(version, sizeof(version), "#version %u\n", version_no);
-      RARCH_LOG("[GL]: Using GLSL version %u.\n", version_no);
+   unsigned version_no = 0;
+   unsigned gl_ver = glsl_major * 100 + glsl_minor * 10;
+   switch (gl_ver)
+   {
+      case 300: version_no = 130; break;
+      case 310: version_no = 140; break;
+      case 320: version_no = 150; break;
+      default: version_no = gl_ver; break;
    }
 
-   const char *source[] = { version, define, program };
-   glShaderSource(shader, ARRAY_SIZE(source), source, NULL);
-   glCompileShader(shader);
-
-   GLint status;
-   glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-   print_shader_log(shader);
-
-   return status == GL_TRUE;
+   snprintf(version, size, "#version %u\n", version_no);
 }
 
-static bool link_program(GLuint prog)
+static void compile_shader(GLuint shader, const char *define, const char *program)
 {
-   glLinkProgram(prog);
-
-   GLint status;
-   glGetProgramiv(prog, GL_LINK_STATUS, &status);
-   print_linker_log(prog);
+   char version[32];
+   get_version_string(version, sizeof(version), program);
+   if (*version)
+      RARCH_LOG("[GL]: Using GLSL %s", version + 1);
 
-   if (status == GL_TRUE)
-   {
-      glUseProgram(prog);
-      return true;
-   }
-   else
-      return false;
+   const char *source[] = { version, define, program };
+   glShaderSource(shader, ARRAY_SIZE(source), source, NULL);
+   glCompileShader(shader);
 }
 
-static GLuint compile_program(const char *vertex, const char *fragment, unsigned i)
+// Kicks off compilation and linking, but does not query any status.
+// Drivers which implement parallel shader compile will do the work in the background
+// until we ask for the result in check_program().
+static GLuint compile_program(const char *vertex, const char *fragment, bool retrievable)
 {
    GLuint prog = glCreateProgram();
    if (!prog)
       return 0;
 
+#if defined(GLSL_PROGRAM_BINARY) && !defined(HAVE_OPENGLES2)
+   if (retrievable)
+      glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#else
+   (void)retrievable;
+#endif
+
    if (vertex)
    {
       RARCH_LOG("Found GLSL vertex shader.\n");
       GLuint shader = glCreateShader(GL_VERTEX_SHADER);
-      if (!compile_shader(shader, "#define VERTEX\n", vertex))
-      {
-         RARCH_ERR("Failed to compile vertex shader #%u\n", i);
-         return false;
-      }
-
+      compile_shader(shader, "#define VERTEX\n", vertex);
       glAttachShader(prog, shader);
    }
 
@@ -441,33 +461,191 @@ static GLuint compile_program(const char *vertex, const char *fragment, unsigned
    {
       RARCH_LOG("Found GLSL fragment shader.\n");
       GLuint shader = glCreateShader(GL_FRAGMENT_SHADER);
-      if (!compile_shader(shader, "#define FRAGMENT\n", fragment))
-      {
-         RARCH_ERR("Failed to compile fragment shader #%u\n", i);
-         return false;
-      }
-
+      compile_shader(shader, "#define FRAGMENT\n", fragment);
       glAttachShader(prog, shader);
    }
 
    if (vertex || fragment)
+      glLinkProgram(prog);
+
+   return prog;
+}
+
+static bool check_program(GLuint prog, unsigned i)
+{
+   GLsizei count = 0;
+   GLuint shaders[2] = {0};
+   glGetAttachedShaders(prog, 2, &count, shaders);
+   if (!count)
+      return true;
+
+   for (GLsizei j = 0; j < count; j++)
    {
-      RARCH_LOG("Linking GLSL program.\n");
-      if (!link_program(prog))
+      GLint status, type;
+      glGetShaderiv(shaders[j], GL_COMPILE_STATUS, &status);
+      glGetShaderiv(shaders[j], GL_SHADER_TYPE, &type);
+      print_shader_log(shaders[j]);
+
+      if (status != GL_TRUE)
       {
-         RARCH_ERR("Failed to link program #%u.\n", i);
-         return 0;
+         RARCH_ERR("Failed to compile %s shader #%u\n",
+               type == GL_VERTEX_SHADER ? "vertex" : "fragment", i);
+         return false;
       }
+   }
+
+   GLint status;
+   glGetProgramiv(prog, GL_LINK_STATUS, &status);
+   print_linker_log(prog);
+
+   if (status != GL_TRUE)
+   {
+      RARCH_ERR("Failed to link program #%u.\n", i);
+      return false;
+   }
+
+   return true;
+}
+
+#ifdef GLSL_PROGRAM_BINARY
+// On-disk cache of linked programs.
+// Entries are keyed by a hash of the GL driver strings, the program index
+// and the exact sources handed to the compiler, so a driver update or an edited shader
+// simply misses the cache. Stale entries the driver refuses are recompiled and overwritten.
+struct glsl_cache_header
+{
+   uint32_t magic;
+   uint32_t format;
+   uint32_t size;
+};
+
+#define GLSL_CACHE_MAGIC 0x42534c47 // 'GLSB'
+
+static size_t append_key(char *buf, size_t pos, const char *str)
+{
+   size_t len = str ? strlen(str) + 1 : 1;
+   if (buf)
+   {
+      if (str)
+         memcpy(buf + pos, str, len);
+      else
+         buf[pos] = '\0';
+   }
+   return pos + len;
+}
+
+static size_t build_key(char *buf, unsigned index, const char *vertex, const char *fragment)
+{
+   char index_str[16];
+   snprintf(index_str, sizeof(index_str), "%u", index);
 
-      glUseProgram(prog);
-      GLint location = get_uniform(prog, "Texture");
-      glUniform1i(location, 0);
-      glUseProgram(0);
+   size_t pos = 0;
+   pos = append_key(buf, pos, (const char*)glGetString(GL_VENDOR));
+   pos = append_key(buf, pos, (const char*)glGetString(GL_RENDERER));
+   pos = append_key(buf, pos, (const char*)glGetString(GL_VERSION));
+   pos = append_key(buf, pos, index_str);
+
+   char version[32];
+   if (vertex)
+   {
+      get_version_string(version, sizeof(version), vertex);
+      pos = append_key(buf, pos, version);
+      pos = append_key(buf, pos, "#define VERTEX\n");
+      pos = append_key(buf, pos, vertex);
+   }
+
+   if (fragment)
+   {
+      get_version_string(version, sizeof(version), fragment);
+      pos = append_key(buf, pos, version);
+      pos = append_key(buf, pos, "#define FRAGMENT\n");
+      pos = append_key(buf, pos, fragment);
+   }
+
+   return pos;
+}
+
+static bool get_cache_path(char *path, size_t size,
+      unsigned index, const char *vertex, const char *fragment)
+{
+   if (!glsl_binary_cache || !*g_settings.video.shader_cache_dir || !(vertex || fragment))
+      return false;
+
+   size_t len = build_key(NULL, index, vertex, fragment);
+   char *key = (char*)malloc(len);
+   if (!key)
+      return false;
+   build_key(key, index, vertex, fragment);
+
+   char hash[64 + 1];
+   sha256_hash(hash, (const uint8_t*)key, len);
+   free(key);
+
+   char name[64 + 16];
+   snprintf(name, sizeof(name), "%s.glslbin", hash);
+   fill_pathname_join(path, g_settings.video.shader_cache_dir, name, size);
+   return true;
+}
+
+static GLuint load_program_binary(const char *path)
+{
+   void *buf = NULL;
+   ssize_t len = read_file(path, &buf);
+   if (len < (ssize_t)sizeof(struct glsl_cache_header))
+   {
+      free(buf);
+      return 0;
+   }
+
+   struct glsl_cache_header header;
+   memcpy(&header, buf, sizeof(header));
+   if (header.magic != GLSL_CACHE_MAGIC || header.size != len - sizeof(header))
+   {
+      free(buf);
+      return 0;
+   }
+
+   GLuint prog = glCreateProgram();
+   glProgramBinary(prog, header.format, (const uint8_t*)buf + sizeof(header), header.size);
+   free(buf);
+
+   GLint status = GL_FALSE;
+   glGetProgramiv(prog, GL_LINK_STATUS, &status);
+   if (status != GL_TRUE)
+   {
+      RARCH_LOG("[GL]: Driver rejected cached program binary, recompiling.\n");
+      glDeleteProgram(prog);
+      return 0;
    }
 
    return prog;
 }
 
+static void save_program_binary(GLuint prog, const char *path)
+{
+   GLint len = 0;
+   glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &len);
+   if (len <= 0)
+      return;
+
+   uint8_t *buf = (uint8_t*)malloc(sizeof(struct glsl_cache_header) + len);
+   if (!buf)
+      return;
+
+   GLsizei written = 0;
+   GLenum format = 0;
+   glGetProgramBinary(prog, len, &written, &format, buf + sizeof(struct glsl_cache_header));
+
+   struct glsl_cache_header header = { GLSL_CACHE_MAGIC, format, (uint32_t)written };
+   memcpy(buf, &header, sizeof(header));
+
+   if (written <= 0 || !write_file(path, buf, sizeof(header) + written))
+      RARCH_WARN("[GL]: Failed to write program binary to \"%s\".\n", path);
+
+   free(buf);
+}
+#endif
+
 static bool load_source_path(struct gfx_shader_pass *pass, const char *path)
 {
    if (read_file(path, (void**)&pass->source.xml.vertex) <= 0)
@@ -477,11 +655,11 @@ static bool load_source_path(struct gfx_shader_pass *pass, const char *path)
    return pass->source.xml.fragment && pass->source.xml.vertex;
 }
 
-static bool compile_programs(GLuint *gl_prog)
+static bool load_sources(struct gfx_shader *shader)
 {
-   for (unsigned i = 0; i < glsl_shader->passes; i++)
+   for (unsigned i = 0; i < shader->passes; i++)
    {
-      struct gfx_shader_pass *pass = &glsl_shader->pass[i];
+      struct gfx_shader_pass *pass = &shader->pass[i];
 
       // If we load from GLSLP (CGP),
       // load the file here, and pretend
@@ -492,17 +670,6 @@ static bool compile_programs(GLuint *gl_prog)
          return false;
       }
       *pass->source.cg = '\0';
-
-      const char *vertex   = pass->source.xml.vertex;
-      const char *fragment = pass->source.xml.fragment;
-
-      gl_prog[i] = compile_program(vertex, fragment, i);
-
-      if (!gl_prog[i])
-      {
-         RARCH_ERR("Failed to create GL program #%u.\n", i);
-         return false;
-      }
    }
 
    return true;
@@ -517,6 +684,14 @@ static void gl_glsl_reset_attrib(void)
 
 static void gl_glsl_set_vbo(GLfloat *buffer, size_t *buffer_elems, const GLfloat *data, size_t elems)
 {
+   // Too large to keep a shadow copy of, just upload it.
+   if (elems > GLSL_VBO_CACHE_SIZE)
+   {
+      glBufferData(GL_ARRAY_BUFFER, elems * sizeof(GLfloat), data, GL_STREAM_DRAW);
+      *buffer_elems = 0;
+      return;
+   }
+
    if (elems != *buffer_elems || memcmp(data, buffer, elems * sizeof(GLfloat)))
    {
       //RARCH_LOG("[GL]: VBO updated with %u elems.\n", (unsigned)elems);
@@ -596,6 +771,11 @@ static void find_uniforms(unsigned pass, GLuint prog, struct shader_uniforms *un
    for (unsigned i = 0; i < glsl_shader->luts; i++)
       uni->lut_texture[i] = glGetUniformLocation(prog, glsl_shader->lut[i].id);
 
+   // State tracker uniforms come back from state_get_uniform() in variable order.
+   for (unsigned i = 0; i < GFX_MAX_VARIABLES; i++)
+      uni->state_var[i] = i < glsl_shader->variables ?
+         glGetUniformLocation(prog, glsl_shader->variable[i].id) : -1;
+
    char frame_base[64];
    clear_uniforms_frame(&uni->orig);
    find_uniforms_frame(prog, &uni->orig, "Orig");
@@ -644,23 +824,22 @@ static void gl_glsl_delete_shader(GLuint prog)
    glDeleteProgram(prog);
 }
 
-static void gl_glsl_free_shader(void)
+static void free_shader(struct gfx_shader *shader)
 {
-   if (!glsl_shader)
+   if (!shader)
       return;
 
-   for (unsigned i = 0; i < glsl_shader->passes; i++)
+   for (unsigned i = 0; i < shader->passes; i++)
    {
-      free(glsl_shader->pass[i].source.xml.vertex);
-      free(glsl_shader->pass[i].source.xml.fragment);
+      free(shader->pass[i].source.xml.vertex);
+      free(shader->pass[i].source.xml.fragment);
    }
 
-   free(glsl_shader->script);
-   free(glsl_shader);
-   glsl_shader = NULL;
+   free(shader->script);
+   free(shader);
 }
 
-static void gl_glsl_deinit(void)
+static void gl_glsl_deinit_chain(void)
 {
    glUseProgram(0);
    for (unsigned i = 0; i < GFX_MAX_SHADERS; i++)
@@ -679,7 +858,8 @@ static void gl_glsl_deinit(void)
    glsl_enable  = false;
    active_index = 0;
 
-   gl_glsl_free_shader();
+   free_shader(glsl_shader);
+   glsl_shader = NULL;
 
    if (gl_state_tracker)
       state_tracker_free(gl_state_tracker);
@@ -697,39 +877,20 @@ static void gl_glsl_deinit(void)
    memset(&glsl_vbo, 0, sizeof(glsl_vbo));
 }
 
-static bool gl_glsl_init(const char *path)
+static struct gfx_shader *load_preset(const char *path)
 {
-#ifndef HAVE_OPENGLES2
-   RARCH_LOG("Checking GLSL shader support ...\n");
-   bool shader_support = glCreateProgram && glUseProgram && glCreateShader
-      && glDeleteShader && glShaderSource && glCompileShader && glAttachShader
-      && glDetachShader && glLinkProgram && glGetUniformLocation
-      && glUniform1i && glUniform1f && glUniform2fv && glUniform4fv && glUniformMatrix4fv
-      && glGetShaderiv && glGetShaderInfoLog && glGetProgramiv && glGetProgramInfoLog 
-      && glDeleteProgram && glGetAttachedShaders
-      && glGetAttribLocation && glEnableVertexAttribArray && glDisableVertexAttribArray
-      && glVertexAttribPointer
-      && glGenBuffers && glBufferData && glDeleteBuffers && glBindBuffer;
-
-   if (!shader_support)
-   {
-      RARCH_ERR("GLSL shaders aren't supported by your OpenGL driver.\n");
-      return false;
-   }
-#endif
-
-   glsl_shader = (struct gfx_shader*)calloc(1, sizeof(*glsl_shader));
-   if (!glsl_shader)
-      return false;
+   struct gfx_shader *shader = (struct gfx_shader*)calloc(1, sizeof(*shader));
+   if (!shader)
+      return NULL;
 
    if (path)
    {
       bool ret;
       if (strcmp(path_get_extension(path), "glsl") == 0)
       {
-         strlcpy(glsl_shader->pass[0].source.cg, path, sizeof(glsl_shader->pass[0].source.cg));
-         glsl_shader->passes = 1;
-         glsl_shader->modern = true;
+         strlcpy(shader->pass[0].source.cg, path, sizeof(shader->pass[0].source.cg));
+         shader->passes = 1;
+         shader->modern = true;
          ret = true;
       }
       else if (strcmp(path_get_extension(path), "glslp") == 0)
@@ -737,72 +898,259 @@ static bool gl_glsl_init(const char *path)
          config_file_t *conf = config_file_new(path);
          if (conf)
          {
-            ret = gfx_shader_read_conf_cgp(conf, glsl_shader);
-            glsl_shader->modern = true;
+            ret = gfx_shader_read_conf_cgp(conf, shader);
+            shader->modern = true;
             config_file_free(conf);
          }
          else
             ret = false;
       }
       else
-         ret = gfx_shader_read_xml(path, glsl_shader);
+         ret = gfx_shader_read_xml(path, shader);
 
       if (!ret)
       {
          RARCH_ERR("[GL]: Failed to parse GLSL shader.\n");
-         return false;
+         goto error;
       }
    }
    else
    {
       RARCH_WARN("[GL]: Stock GLSL shaders will be used.\n");
-      glsl_shader->passes = 1;
-      glsl_shader->pass[0].source.xml.vertex   = strdup(glsl_core ? stock_vertex_core : stock_vertex_modern);
-      glsl_shader->pass[0].source.xml.fragment = strdup(glsl_core ? stock_fragment_core : stock_fragment_modern);
-      glsl_shader->modern = true;
+      shader->passes = 1;
+      shader->pass[0].source.xml.vertex   = strdup(glsl_core ? stock_vertex_core : stock_vertex_modern);
+      shader->pass[0].source.xml.fragment = strdup(glsl_core ? stock_fragment_core : stock_fragment_modern);
+      shader->modern = true;
    }
 
-   gfx_shader_resolve_relative(glsl_shader, path);
-
-   const char *stock_vertex = glsl_shader->modern ?
-      stock_vertex_modern : stock_vertex_legacy;
-   const char *stock_fragment = glsl_shader->modern ?
-      stock_fragment_modern : stock_fragment_legacy;
-
-   if (glsl_core)
-   {
-      stock_vertex = stock_vertex_core;
-      stock_fragment = stock_fragment_core;
-   }
+   gfx_shader_resolve_relative(shader, path);
 
 #ifdef HAVE_OPENGLES2
-   if (!glsl_shader->modern)
+   if (!shader->modern)
    {
       RARCH_ERR("[GL]: GLES context is used, but shader is not modern. Cannot use it.\n");
       goto error;
    }
 #else
-   if (glsl_core && !glsl_shader->modern)
+   if (glsl_core && !shader->modern)
    {
       RARCH_ERR("[GL]: GL core context is used, but shader is not core compatible. Cannot use it.\n");
       goto error;
    }
 #endif
 
-   if (!(gl_program[0] = compile_program(stock_vertex, stock_fragment, 0)))
-   {
-      RARCH_ERR("GLSL stock programs failed to compile.\n");
+   if (!load_sources(shader))
       goto error;
+
+   return shader;
+
+error:
+   free_shader(shader);
+   return NULL;
+}
+
+// A shader chain which has been handed to the driver, but is not in use yet.
+// Program 0 is the stock shader, 1 through passes are the shader passes,
+// and GL_SHADER_STOCK_BLEND is the stock blending shader for modern chains.
+struct glsl_chain
+{
+   struct gfx_shader *shader;
+   GLuint program[GFX_MAX_SHADERS];
+   GLuint lut[GFX_MAX_TEXTURES];
+   rarch_time_t start;
+   rarch_time_t issued[GFX_MAX_SHADERS];
+   rarch_time_t ready[GFX_MAX_SHADERS];
+   bool cached[GFX_MAX_SHADERS];
+};
+
+static struct glsl_chain *glsl_pending;
+static bool glsl_parallel_compile;
+
+static bool chain_has_program(const struct glsl_chain *chain, unsigned i)
+{
+   if (i == GL_SHADER_STOCK_BLEND)
+      return chain->shader->modern;
+   return i <= chain->shader->passes;
+}
+
+static void chain_get_source(const struct glsl_chain *chain, unsigned i,
+      const char **vertex, const char **fragment)
+{
+   if (i == GL_SHADER_STOCK_BLEND)
+   {
+      *vertex   = glsl_core ? stock_vertex_core_blend : stock_vertex_modern_blend;
+      *fragment = glsl_core ? stock_fragment_core_blend : stock_fragment_modern_blend;
+   }
+   else if (i == 0)
+   {
+      if (glsl_core)
+      {
+         *vertex   = stock_vertex_core;
+         *fragment = stock_fragment_core;
+      }
+      else
+      {
+         *vertex   = chain->shader->modern ? stock_vertex_modern : stock_vertex_legacy;
+         *fragment = chain->shader->modern ? stock_fragment_modern : stock_fragment_legacy;
+      }
+   }
+   else
+   {
+      *vertex   = chain->shader->pass[i - 1].source.xml.vertex;
+      *fragment = chain->shader->pass[i - 1].source.xml.fragment;
+   }
+}
+
+static void chain_free(struct glsl_chain *chain)
+{
+   if (!chain)
+      return;
+
+   for (unsigned i = 0; i < GFX_MAX_SHADERS; i++)
+   {
+      if (chain->program[i])
+         gl_glsl_delete_shader(chain->program[i]);
    }
 
-   if (!compile_programs(&gl_program[1]))
+   free_shader(chain->shader);
+   free(chain);
+}
+
+static struct glsl_chain *chain_new(const char *path)
+{
+   struct glsl_chain *chain = (struct glsl_chain*)calloc(1, sizeof(*chain));
+   if (!chain)
+      return NULL;
+
+   chain->start  = rarch_get_time_usec();
+   chain->shader = load_preset(path);
+   if (!chain->shader)
       goto error;
 
-   if (!load_luts())
+   for (unsigned i = 0; i < GFX_MAX_SHADERS; i++)
+   {
+      if (!chain_has_program(chain, i))
+         continue;
+
+      const char *vertex, *fragment;
+      chain_get_source(chain, i, &vertex, &fragment);
+
+      chain->issued[i]  = rarch_get_time_usec();
+
+#ifdef GLSL_PROGRAM_BINARY
+      char cache_path[PATH_MAX];
+      if (get_cache_path(cache_path, sizeof(cache_path), i, vertex, fragment) &&
+            (chain->program[i] = load_program_binary(cache_path)))
+      {
+         chain->cached[i] = true;
+         chain->ready[i]  = rarch_get_time_usec();
+         continue;
+      }
+#endif
+
+      chain->program[i] = compile_program(vertex, fragment,
+            glsl_binary_cache && *g_settings.video.shader_cache_dir);
+      if (!chain->program[i])
+      {
+         RARCH_ERR("Failed to create GL program #%u.\n", i);
+         goto error;
+      }
+
+      // Without parallel compile, the driver has done its work by now.
+      if (!glsl_parallel_compile)
+         chain->ready[i] = rarch_get_time_usec();
+   }
+
+   return chain;
+
+error:
+   chain_free(chain);
+   return NULL;
+}
+
+// Returns true once the driver is done with every program in the chain.
+static bool chain_poll(struct glsl_chain *chain)
+{
+   bool done = true;
+   for (unsigned i = 0; i < GFX_MAX_SHADERS; i++)
+   {
+      if (!chain_has_program(chain, i) || chain->ready[i])
+         continue;
+
+      GLint status = GL_TRUE;
+      if (glsl_parallel_compile)
+         glGetProgramiv(chain->program[i], GL_COMPLETION_STATUS_ARB, &status);
+
+      if (status == GL_TRUE)
+         chain->ready[i] = rarch_get_time_usec();
+      else
+         done = false;
+   }
+
+   return done;
+}
+
+// Validates the chain and replaces the current one with it.
+// On failure, the current chain is left untouched.
+static bool chain_install(struct glsl_chain *chain)
+{
+   unsigned programs = 0, cached = 0;
+   chain_poll(chain);
+
+   for (unsigned i = 0; i < GFX_MAX_SHADERS; i++)
+   {
+      if (!chain_has_program(chain, i))
+         continue;
+
+      if (!check_program(chain->program[i], i))
+         return false;
+
+      RARCH_LOG("[GL]: GLSL program #%u %s in %.2f ms.\n", i,
+            chain->cached[i] ? "loaded from cache" : "compiled and linked",
+            (chain->ready[i] - chain->issued[i]) / 1000.0);
+
+#ifdef GLSL_PROGRAM_BINARY
+      const char *vertex, *fragment;
+      char cache_path[PATH_MAX];
+      chain_get_source(chain, i, &vertex, &fragment);
+      if (!chain->cached[i] && get_cache_path(cache_path, sizeof(cache_path), i, vertex, fragment))
+         save_program_binary(chain->program[i], cache_path);
+#endif
+
+      programs++;
+      if (chain->cached[i])
+         cached++;
+   }
+
+   RARCH_LOG("[GL]: GLSL shader chain ready in %.2f ms (%u of %u programs from cache).\n",
+         (rarch_get_time_usec() - chain->start) / 1000.0, cached, programs);
+
+   if (!load_luts(chain->shader, chain->lut))
    {
       RARCH_ERR("[GL]: Failed to load LUTs.\n");
-      goto error;
+      return false;
+   }
+
+   gl_glsl_deinit_chain();
+
+   glsl_shader   = chain->shader;
+   chain->shader = NULL;
+   memcpy(gl_program, chain->program, sizeof(gl_program));
+   memset(chain->program, 0, sizeof(chain->program));
+   memcpy(gl_teximage, chain->lut, sizeof(gl_teximage));
+
+   for (unsigned i = 0; i < GFX_MAX_SHADERS; i++)
+   {
+      GLint linked = GL_FALSE;
+      if (gl_program[i])
+         glGetProgramiv(gl_program[i], GL_LINK_STATUS, &linked);
+      if (linked != GL_TRUE)
+         continue;
+
+      glUseProgram(gl_program[i]);
+      glUniform1i(get_uniform(gl_program[i], "Texture"), 0);
    }
+   glUseProgram(0);
 
    for (unsigned i = 0; i <= glsl_shader->passes; i++)
       find_uniforms(i, gl_program[i], &gl_uniforms[i]);
@@ -835,11 +1183,7 @@ static bool gl_glsl_init(const char *path)
    gl_uniforms[glsl_shader->passes + 1] = gl_uniforms[0];
 
    if (glsl_shader->modern)
-   {
-      gl_program[GL_SHADER_STOCK_BLEND] = compile_program(glsl_core ? stock_vertex_core_blend : stock_vertex_modern_blend,
-            glsl_core ? stock_fragment_core_blend : stock_fragment_modern_blend, GL_SHADER_STOCK_BLEND);
       find_uniforms(0, gl_program[GL_SHADER_STOCK_BLEND], &gl_uniforms[GL_SHADER_STOCK_BLEND]);
-   }
    else
    {
       gl_program[GL_SHADER_STOCK_BLEND] = gl_program[0];
@@ -855,10 +1199,74 @@ static bool gl_glsl_init(const char *path)
    }
 
    return true;
+}
 
-error:
-   gl_glsl_deinit();
-   return false;
+static void gl_glsl_deinit(void)
+{
+   chain_free(glsl_pending);
+   glsl_pending = NULL;
+
+   free(glsl_coord_buffer);
+   glsl_coord_buffer      = NULL;
+   glsl_coord_buffer_size = 0;
+
+   gl_glsl_deinit_chain();
+}
+
+static bool gl_glsl_init(const char *path)
+{
+#ifndef HAVE_OPENGLES2
+   RARCH_LOG("Checking GLSL shader support ...\n");
+   bool shader_support = glCreateProgram && glUseProgram && glCreateShader
+      && glDeleteShader && glShaderSource && glCompileShader && glAttachShader
+      && glDetachShader && glLinkProgram && glGetUniformLocation
+      && glUniform1i && glUniform1f && glUniform2fv && glUniform4fv && glUniformMatrix4fv
+      && glGetShaderiv && glGetShaderInfoLog && glGetProgramiv && glGetProgramInfoLog 
+      && glDeleteProgram && glGetAttachedShaders
+      && glGetAttribLocation && glEnableVertexAttribArray && glDisableVertexAttribArray
+      && glVertexAttribPointer
+      && glGenBuffers && glBufferData && glDeleteBuffers && glBindBuffer;
+
+   if (!shader_support)
+   {
+      RARCH_ERR("GLSL shaders aren't supported by your OpenGL driver.\n");
+      return false;
+   }
+#endif
+
+   struct glsl_chain *chain = chain_new(path);
+   if (!chain)
+      return false;
+
+   bool ret = chain_install(chain);
+   chain_free(chain);
+   return ret;
+}
+
+// Starts compiling a new chain. The current chain keeps rendering
+// until gl_glsl_poll_async() finds the new one ready and swaps it in.
+static bool gl_glsl_init_async(const char *path)
+{
+   // A newer request supersedes anything still being compiled.
+   chain_free(glsl_pending);
+   glsl_pending = chain_new(path);
+   return glsl_pending;
+}
+
+static enum gl_shader_async_status gl_glsl_poll_async(void)
+{
+   if (!glsl_pending)
+      return GL_SHADER_ASYNC_IDLE;
+
+   if (!chain_poll(glsl_pending))
+      return GL_SHADER_ASYNC_PENDING;
+
+   struct glsl_chain *chain = glsl_pending;
+   glsl_pending = NULL;
+
+   bool ret = chain_install(chain);
+   chain_free(chain);
+   return ret ? GL_SHADER_ASYNC_READY : GL_SHADER_ASYNC_FAILED;
 }
 
 static void gl_glsl_set_params(unsigned width, unsigned height, 
@@ -1060,8 +1468,8 @@ static void gl_glsl_set_params(unsigned width, unsigned height,
 
       for (unsigned i = 0; i < cnt; i++)
       {
-         int location = glGetUniformLocation(gl_program[active_index], info[i].id);
-         glUniform1f(location, info[i].value);
+         if (uni->state_var[i] >= 0)
+            glUniform1f(uni->state_var[i], info[i].value);
       }
    }
 }
@@ -1083,9 +1491,26 @@ static bool gl_glsl_set_coords(const struct gl_coords *coords)
    if (!glsl_enable || !glsl_shader->modern)
       return false;
 
-   GLfloat buffer[128];
+   GLfloat short_buffer[GLSL_VBO_CACHE_SIZE];
+   GLfloat *buffer = short_buffer;
    size_t size = 0;
 
+   // Vertex, tex coord and LUT tex coord are vec2, color is vec4.
+   unsigned vertices = coords->vertices ? coords->vertices : 4;
+   size_t max_size = vertices * (2 + 2 + 2 + 4);
+   if (max_size > GLSL_VBO_CACHE_SIZE)
+   {
+      if (max_size > glsl_coord_buffer_size)
+      {
+         GLfloat *new_buffer = (GLfloat*)realloc(glsl_coord_buffer, max_size * sizeof(GLfloat));
+         if (!new_buffer)
+            return false;
+         glsl_coord_buffer      = new_buffer;
+         glsl_coord_buffer_size = max_size;
+      }
+      buffer = glsl_coord_buffer;
+   }
+
    struct glsl_attrib attribs[4];
    size_t attribs_size = 0;
    struct glsl_attrib *attr = attribs;
@@ -1099,8 +1524,8 @@ static bool gl_glsl_set_coords(const struct gl_coords *coords)
       attribs_size++;
       attr++;
 
-      memcpy(buffer + size, coords->tex_coord, 8 * sizeof(GLfloat));
-      size += 8;
+      memcpy(buffer + size, coords->tex_coord, 2 * vertices * sizeof(GLfloat));
+      size += 2 * vertices;
    }
 
    if (uni->vertex_coord >= 0)
@@ -1111,8 +1536,8 @@ static bool gl_glsl_set_coords(const struct gl_coords *coords)
       attribs_size++;
       attr++;
 
-      memcpy(buffer + size, coords->vertex, 8 * sizeof(GLfloat));
-      size += 8;
+      memcpy(buffer + size, coords->vertex, 2 * vertices * sizeof(GLfloat));
+      size += 2 * vertices;
    }
 
    if (uni->color >= 0)
@@ -1123,8 +1548,8 @@ static bool gl_glsl_set_coords(const struct gl_coords *coords)
       attribs_size++;
       attr++;
 
-      memcpy(buffer + size, coords->color, 16 * sizeof(GLfloat));
-      size += 16;
+      memcpy(buffer + size, coords->color, 4 * vertices * sizeof(GLfloat));
+      size += 4 * vertices;
    }
 
    if (uni->lut_tex_coord >= 0)
@@ -1135,8 +1560,8 @@ static bool gl_glsl_set_coords(const struct gl_coords *coords)
       attribs_size++;
       attr++;
 
-      memcpy(buffer + size, coords->lut_tex_coord, 8 * sizeof(GLfloat));
-      size += 8;
+      memcpy(buffer + size, coords->lut_tex_coord, 2 * vertices * sizeof(GLfloat));
+      size += 2 * vertices;
    }
 
    if (size)
@@ -1222,6 +1647,30 @@ void gl_glsl_set_context_type(bool core_profile, unsigned major, unsigned minor)
    glsl_minor = minor;
 }
 
+void gl_glsl_set_program_binary(bool enable)
+{
+#ifdef GLSL_PROGRAM_BINARY
+   if (enable)
+   {
+      GLint formats = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+      enable = formats > 0;
+   }
+
+   glsl_binary_cache = enable;
+   RARCH_LOG("[GL]: Program binary cache: %s.\n", !enable ? "unsupported" :
+         (*g_settings.video.shader_cache_dir ? g_settings.video.shader_cache_dir : "disabled"));
+#else
+   (void)enable;
+#endif
+}
+
+void gl_glsl_set_parallel_compile(bool enable)
+{
+   glsl_parallel_compile = enable;
+   RARCH_LOG("[GL]: Parallel shader compile: %s.\n", enable ? "yes" : "no");
+}
+
 const gl_shader_backend_t gl_glsl_backend = {
    gl_glsl_init,
    gl_glsl_deinit,
@@ -1236,5 +1685,8 @@ const gl_shader_backend_t gl_glsl_backend = {
    gl_glsl_get_prev_textures,
 
    RARCH_SHADER_GLSL,
+
+   gl_glsl_init_async,
+   gl_glsl_poll_async,
 };
 
@@ -22,6 +22,8 @@
 
 void gl_glsl_set_get_proc_address(gfx_ctx_proc_t (*proc)(const char*));
 void gl_glsl_set_context_type(bool core_profile, unsigned major, unsigned minor);
+void gl_glsl_set_parallel_compile(bool enable);
+void gl_glsl_set_program_binary(bool enable);
 extern const gl_shader_backend_t gl_glsl_backend;
 
 #endif
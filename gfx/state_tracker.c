@@ -23,23 +23,29 @@
 #include "py_state/py_state.h"
 #endif
 
-struct state_tracker_internal
+// The element list is compiled into a flat list of operations at init.
+// Every distinct memory location (a WRAM byte or an input slot) becomes a source,
+// which is read exactly once per frame. Operations only re-evaluate
+// when their source changed, as all tracker types are functions of the sequence
+// of distinct values seen.
+struct state_source
 {
-   char id[64];
-
-   bool is_input;
-   const uint16_t *input_ptr;
    const uint8_t *ptr;
-#ifdef HAVE_PYTHON
-   py_state_t *py;
-#endif
-
+   const uint16_t *input_ptr;
    uint32_t addr;
-   uint16_t mask;
 
-   uint16_t equal;
+   uint16_t value;
+   bool changed;
+};
 
+struct state_op
+{
    enum state_tracker_type type;
+   unsigned index;
+   unsigned source;
+
+   uint16_t mask;
+   uint16_t equal;
 
    uint32_t prev[2];
    int frame_count;
@@ -50,16 +56,44 @@ struct state_tracker_internal
 
 struct state_tracker
 {
-   struct state_tracker_internal *info;
+   char (*ids)[64];
+   float *values;
    unsigned info_elem;
 
+   struct state_op *ops;
+   unsigned num_ops;
+
+   struct state_source *sources;
+   unsigned num_sources;
+
+   bool input_used[2];
    uint16_t input_state[2];
 
 #ifdef HAVE_PYTHON
    py_state_t *py;
+   unsigned *py_index;
+   float *py_values;
+   unsigned num_py;
 #endif
 };
 
+static unsigned add_source(state_tracker_t *tracker,
+      const uint8_t *ptr, const uint16_t *input_ptr, uint32_t addr)
+{
+   for (unsigned i = 0; i < tracker->num_sources; i++)
+   {
+      const struct state_source *src = &tracker->sources[i];
+      if (src->ptr == ptr && src->input_ptr == input_ptr && src->addr == addr)
+         return i;
+   }
+
+   struct state_source *src = &tracker->sources[tracker->num_sources];
+   src->ptr       = ptr;
+   src->input_ptr = input_ptr;
+   src->addr      = addr;
+   return tracker->num_sources++;
+}
+
 state_tracker_t* state_tracker_init(const struct state_tracker_info *info)
 {
    state_tracker_t *tracker = (state_tracker_t*)calloc(1, sizeof(*tracker));
@@ -77,141 +111,164 @@ state_tracker_t* state_tracker_init(const struct state_tracker_info *info)
          return NULL;
       }
    }
+
+   const char **py_ids = (const char**)calloc(info->info_elem + 1, sizeof(*py_ids));
+   tracker->py_index   = (unsigned*)calloc(info->info_elem + 1, sizeof(unsigned));
+   tracker->py_values  = (float*)calloc(info->info_elem + 1, sizeof(float));
+   if (!py_ids || !tracker->py_index || !tracker->py_values)
+   {
+      free(py_ids);
+      goto error;
+   }
 #endif
 
-   tracker->info = (struct state_tracker_internal*)calloc(info->info_elem, sizeof(struct state_tracker_internal));
    tracker->info_elem = info->info_elem;
+   tracker->ids       = (char (*)[64])calloc(info->info_elem + 1, sizeof(*tracker->ids));
+   tracker->values    = (float*)calloc(info->info_elem + 1, sizeof(float));
+   tracker->ops       = (struct state_op*)calloc(info->info_elem + 1, sizeof(struct state_op));
+   tracker->sources   = (struct state_source*)calloc(info->info_elem + 1, sizeof(struct state_source));
+   if (!tracker->ids || !tracker->values || !tracker->ops || !tracker->sources)
+      goto error;
 
    for (unsigned i = 0; i < info->info_elem; i++)
    {
-      strlcpy(tracker->info[i].id, info->info[i].id, sizeof(tracker->info[i].id));
-      tracker->info[i].addr  = info->info[i].addr;
-      tracker->info[i].type  = info->info[i].type;
-      tracker->info[i].mask  = (info->info[i].mask == 0) ? 0xffff : info->info[i].mask;
-      tracker->info[i].equal = info->info[i].equal;
+      strlcpy(tracker->ids[i], info->info[i].id, sizeof(tracker->ids[i]));
 
 #ifdef HAVE_PYTHON
       if (info->info[i].type == RARCH_STATE_PYTHON)
       {
          if (!tracker->py)
          {
-            free(tracker->info);
-            free(tracker);
             RARCH_ERR("Python semantic was requested, but Python tracker is not loaded.\n");
-            return NULL;
+            free(py_ids);
+            goto error;
          }
-         tracker->info[i].py = tracker->py;
+
+         py_ids[tracker->num_py] = tracker->ids[i];
+         tracker->py_index[tracker->num_py++] = i;
+         continue;
       }
 #endif
 
       // If we don't have a valid pointer.
       static const uint8_t empty = 0;
+      unsigned source;
 
       switch (info->info[i].ram_type)
       {
          case RARCH_STATE_WRAM:
-            tracker->info[i].ptr = info->wram ? info->wram : &empty;
+            source = add_source(tracker, info->wram ? info->wram : &empty, NULL,
+                  info->wram ? info->info[i].addr : 0);
             break;
          case RARCH_STATE_INPUT_SLOT1:
-            tracker->info[i].input_ptr = &tracker->input_state[0];
-            tracker->info[i].is_input = true;
+            source = add_source(tracker, NULL, &tracker->input_state[0], 0);
+            tracker->input_used[0] = true;
             break;
          case RARCH_STATE_INPUT_SLOT2:
-            tracker->info[i].input_ptr = &tracker->input_state[1];
-            tracker->info[i].is_input = true;
+            source = add_source(tracker, NULL, &tracker->input_state[1], 0);
+            tracker->input_used[1] = true;
             break;
 
          default:
-            tracker->info[i].ptr = &empty;
+            source = add_source(tracker, &empty, NULL, 0);
       }
+
+      struct state_op *op = &tracker->ops[tracker->num_ops++];
+      op->type   = info->info[i].type;
+      op->index  = i;
+      op->source = source;
+      op->mask   = (info->info[i].mask == 0) ? 0xffff : info->info[i].mask;
+      op->equal  = info->info[i].equal;
+   }
+
+#ifdef HAVE_PYTHON
+   if (tracker->num_py && !py_state_bind(tracker->py, py_ids, tracker->num_py))
+   {
+      free(py_ids);
+      goto error;
    }
+   free(py_ids);
+#endif
 
    return tracker;
+
+error:
+   state_tracker_free(tracker);
+   return NULL;
 }
 
 void state_tracker_free(state_tracker_t *tracker)
 {
-   free(tracker->info);
+   if (!tracker)
+      return;
+
+   free(tracker->ids);
+   free(tracker->values);
+   free(tracker->ops);
+   free(tracker->sources);
 #ifdef HAVE_PYTHON
+   free(tracker->py_index);
+   free(tracker->py_values);
    py_state_free(tracker->py);
 #endif
    free(tracker);
 }
 
-static inline uint16_t fetch(const struct state_tracker_internal *info)
+static inline uint16_t fetch(const struct state_op *op, const struct state_source *src)
 {
-   uint16_t val = 0;
-   if (info->is_input)
-      val = *info->input_ptr;
-   else
-      val = info->ptr[info->addr];
-
-   val &= info->mask;
+   uint16_t val = src->value & op->mask;
 
-   if (info->equal && val != info->equal)
+   if (op->equal && val != op->equal)
       val = 0;
 
    return val;
 }
 
-static void update_element(
-      struct state_tracker_uniform *uniform,
-      struct state_tracker_internal *info,
+static float update_op(struct state_op *op, const struct state_source *src,
       unsigned frame_count)
 {
-   uniform->id = info->id;
+   uint16_t val = fetch(op, src);
 
-   switch (info->type)
+   switch (op->type)
    {
       case RARCH_STATE_CAPTURE:
-         uniform->value = fetch(info);
-         break;
+         return val;
 
       case RARCH_STATE_CAPTURE_PREV:
-         if (info->prev[0] != fetch(info))
+         if (op->prev[0] != val)
          {
-            info->prev[1] = info->prev[0];
-            info->prev[0] = fetch(info);
+            op->prev[1] = op->prev[0];
+            op->prev[0] = val;
          }
-         uniform->value = info->prev[1];
-         break;
+         return op->prev[1];
 
       case RARCH_STATE_TRANSITION:
-         if (info->old_value != fetch(info))
+         if (op->old_value != val)
          {
-            info->old_value = fetch(info);
-            info->frame_count = frame_count;
+            op->old_value = val;
+            op->frame_count = frame_count;
          }
-         uniform->value = info->frame_count;
-         break;
+         return op->frame_count;
 
       case RARCH_STATE_TRANSITION_COUNT:
-         if (info->old_value != fetch(info))
+         if (op->old_value != val)
          {
-            info->old_value = fetch(info);
-            info->transition_count++;
+            op->old_value = val;
+            op->transition_count++;
          }
-         uniform->value = info->transition_count;
-         break;
+         return op->transition_count;
 
       case RARCH_STATE_TRANSITION_PREV:
-         if (info->old_value != fetch(info))
+         if (op->old_value != val)
          {
-            info->old_value = fetch(info);
-            info->frame_count_prev = info->frame_count;
-            info->frame_count = frame_count;
+            op->old_value = val;
+            op->frame_count_prev = op->frame_count;
+            op->frame_count = frame_count;
          }
-         uniform->value = info->frame_count_prev;
-         break;
-      
-#ifdef HAVE_PYTHON
-      case RARCH_STATE_PYTHON:
-         uniform->value = py_state_get(info->py, info->id, frame_count);
-         break;
-#endif
-      
+         return op->frame_count_prev;
+
       default:
-         break;
+         return 0.0f;
    }
 }
 
@@ -242,26 +299,56 @@ static void update_input(state_tracker_t *tracker)
       g_settings.input.binds[1],
    };
 
-   uint16_t state[2] = {0};
-   for (unsigned i = 4; i < 16; i++)
+   // Only poll the players somebody is actually looking at.
+   for (unsigned p = 0; p < 2; p++)
    {
-      state[0] |= (input_input_state_func(binds, 0, RETRO_DEVICE_JOYPAD, 0, buttons[i - 4]) ? 1 : 0) << i;
-      state[1] |= (input_input_state_func(binds, 1, RETRO_DEVICE_JOYPAD, 0, buttons[i - 4]) ? 1 : 0) << i;
-   }
+      if (!tracker->input_used[p])
+         continue;
 
-   for (unsigned i = 0; i < 2; i++)
-      tracker->input_state[i] = state[i];
+      uint16_t state = 0;
+      for (unsigned i = 4; i < 16; i++)
+         state |= (input_input_state_func(binds, p, RETRO_DEVICE_JOYPAD, 0, buttons[i - 4]) ? 1 : 0) << i;
+      tracker->input_state[p] = state;
+   }
 }
 
 unsigned state_get_uniform(state_tracker_t *tracker, struct state_tracker_uniform *uniforms, unsigned elem, unsigned frame_count)
 {
    unsigned elems = tracker->info_elem < elem ? tracker->info_elem : elem;
 
-   update_input(tracker);
+   if (tracker->input_used[0] || tracker->input_used[1])
+      update_input(tracker);
+
+   for (unsigned i = 0; i < tracker->num_sources; i++)
+   {
+      struct state_source *src = &tracker->sources[i];
+      uint16_t val = src->input_ptr ? *src->input_ptr : src->ptr[src->addr];
+      src->changed = val != src->value;
+      src->value   = val;
+   }
+
+   for (unsigned i = 0; i < tracker->num_ops; i++)
+   {
+      struct state_op *op = &tracker->ops[i];
+      const struct state_source *src = &tracker->sources[op->source];
+      if (src->changed)
+         tracker->values[op->index] = update_op(op, src, frame_count);
+   }
+
+#ifdef HAVE_PYTHON
+   if (tracker->num_py)
+   {
+      py_state_get_batch(tracker->py, tracker->py_values, frame_count);
+      for (unsigned i = 0; i < tracker->num_py; i++)
+         tracker->values[tracker->py_index[i]] = tracker->py_values[i];
+   }
+#endif
 
    for (unsigned i = 0; i < elems; i++)
-      update_element(&uniforms[i], &tracker->info[i], frame_count);
+   {
+      uniforms[i].id    = tracker->ids[i];
+      uniforms[i].value = tracker->values[i];
+   }
 
    return elems;
 }
-
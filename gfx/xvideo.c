@@ -20,7 +20,8 @@
 #include <signal.h>
 #include <math.h>
 #include "gfx_common.h"
-#include "fonts/fonts.h"
+#include "fonts/sw_font.h"
+#include "scaler/pixconv.h"
 
 #include "context/x11_common.h"
 
@@ -58,12 +59,7 @@ typedef struct xv
    bool keep_aspect;
    struct rarch_viewport vp;
 
-   uint8_t *ytable;
-   uint8_t *utable;
-   uint8_t *vtable;
-
-   void *font;
-   const font_renderer_driver_t *font_driver;
+   sw_font_t *font;
 
    unsigned luma_index[2];
    unsigned chroma_u_index;
@@ -73,7 +69,16 @@ typedef struct xv
    uint8_t font_u;
    uint8_t font_v;
 
-   void (*render_func)(struct xv*, const void *frame, unsigned width, unsigned height, unsigned pitch);
+   pixconv_func_t *convert;
+
+   // Frame currently being converted.
+   const void *frame;
+   unsigned frame_width;
+   unsigned frame_pitch;
+
+#ifdef HAVE_THREADS
+   slice_threads_t *threads;
+#endif
 } xv_t;
 
 static void xv_set_nonblock_state(void *data, bool state)
@@ -103,30 +108,13 @@ static inline void calculate_yuv(uint8_t *y, uint8_t *u, uint8_t *v, unsigned r,
    *v = v_ < 0 ? 0 : (v_ > 255 ? 255 : v_);
 }
 
-static void init_yuv_tables(xv_t *xv)
-{
-   xv->ytable = (uint8_t*)malloc(0x10000);
-   xv->utable = (uint8_t*)malloc(0x10000);
-   xv->vtable = (uint8_t*)malloc(0x10000);
-
-   for (unsigned i = 0; i < 0x10000; i++)
-   {
-      // Extract RGB565 color data from i
-      unsigned r = (i >> 11) & 0x1f, g = (i >> 5) & 0x3f, b = (i >> 0) & 0x1f;
-      r = (r << 3) | (r >> 2);  // R5->R8
-      g = (g << 2) | (g >> 4);  // G6->G8
-      b = (b << 3) | (b >> 2);  // B5->B8
-
-      calculate_yuv(&xv->ytable[i], &xv->utable[i], &xv->vtable[i], r, g, b);
-   }
-}
-
 static void xv_init_font(xv_t *xv, const char *font_path, unsigned font_size)
 {
    if (!g_settings.video.font_enable)
       return;
 
-   if (font_renderer_create_default(&xv->font_driver, &xv->font))
+   xv->font = sw_font_new();
+   if (xv->font)
    {
       int r = g_settings.video.msg_color_r * 255;
       r = (r < 0 ? 0 : (r > 255 ? 255 : r));
@@ -143,126 +131,45 @@ static void xv_init_font(xv_t *xv, const char *font_path, unsigned font_size)
 }
 
 // We render @ 2x scale to combat chroma downsampling. Also makes fonts more bearable :)
-static void render16_yuy2(xv_t *xv, const void *input_, unsigned width, unsigned height, unsigned pitch)
+// Every input pixel becomes a whole macropixel, and every line is written twice.
+static void xv_render_slice(void *data, unsigned first_line, unsigned last_line)
 {
-   const uint16_t *input = (const uint16_t*)input_;
-   uint8_t *output = (uint8_t*)xv->image->data;
+   xv_t *xv = (xv_t*)data;
 
-   for (unsigned y = 0; y < height; y++)
-   {
-      for (unsigned x = 0; x < width; x++)
-      {
-         uint16_t p = *input++;
-
-         uint8_t y0 = xv->ytable[p];
-         uint8_t u = xv->utable[p];
-         uint8_t v = xv->vtable[p];
-
-         unsigned img_width = xv->width << 1;
-         output[0] = output[img_width] = y0;
-         output[1] = output[img_width + 1] = u;
-         output[2] = output[img_width + 2] = y0;
-         output[3] = output[img_width + 3] = v;
-         output += 4;
-      }
+   unsigned out_pitch = xv->width << 1; // YUV formats used are 16 bpp.
+   unsigned line_size = xv->frame_width << 2;
 
-      input  += (pitch >> 1) - width;
-      output += (xv->width - width) << 2;
-   }
-}
+   const uint8_t *input = (const uint8_t*)xv->frame + first_line * xv->frame_pitch;
+   uint8_t *output = (uint8_t*)xv->image->data + first_line * (out_pitch << 1);
 
-static void render16_uyvy(xv_t *xv, const void *input_, unsigned width, unsigned height, unsigned pitch)
-{
-   const uint16_t *input = (const uint16_t*)input_;
-   uint8_t *output = (uint8_t*)xv->image->data;
-
-   for (unsigned y = 0; y < height; y++)
+   for (unsigned y = first_line; y < last_line; y++, input += xv->frame_pitch, output += out_pitch << 1)
    {
-      for (unsigned x = 0; x < width; x++)
-      {
-         uint16_t p = *input++;
-
-         uint8_t y0 = xv->ytable[p];
-         uint8_t u = xv->utable[p];
-         uint8_t v = xv->vtable[p];
-
-         unsigned img_width = xv->width << 1;
-         output[0] = output[img_width] = u;
-         output[1] = output[img_width + 1] = y0;
-         output[2] = output[img_width + 2] = v;
-         output[3] = output[img_width + 3] = y0;
-         output += 4;
-      }
-
-      input  += (pitch >> 1) - width;
-      output += (xv->width - width) << 2;
+      (*xv->convert)(output, input, xv->frame_width, 1, out_pitch, xv->frame_pitch);
+      memcpy(output + out_pitch, output, line_size);
    }
 }
 
-static void render32_yuy2(xv_t *xv, const void *input_, unsigned width, unsigned height, unsigned pitch)
+static void xv_render(xv_t *xv, const void *frame, unsigned width, unsigned height, unsigned pitch)
 {
-   const uint32_t *input = (const uint32_t*)input_;
-   uint8_t *output = (uint8_t*)xv->image->data;
+   xv->frame       = frame;
+   xv->frame_width = width;
+   xv->frame_pitch = pitch;
 
-   for (unsigned y = 0; y < height; y++)
+#ifdef HAVE_THREADS
+   if (xv->threads)
    {
-      for (unsigned x = 0; x < width; x++)
-      {
-         uint32_t p = *input++;
-         p = ((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) | ((p >> 3) & 0x1f); // ARGB -> RGB16
-
-         uint8_t y0 = xv->ytable[p];
-         uint8_t u = xv->utable[p];
-         uint8_t v = xv->vtable[p];
-
-         unsigned img_width = xv->width << 1;
-         output[0] = output[img_width] = y0;
-         output[1] = output[img_width + 1] = u;
-         output[2] = output[img_width + 2] = y0;
-         output[3] = output[img_width + 3] = v;
-         output += 4;
-      }
-
-      input  += (pitch >> 2) - width;
-      output += (xv->width - width) << 2;
+      slice_threads_run(xv->threads, xv_render_slice, xv, height);
+      return;
    }
-}
-
-static void render32_uyvy(xv_t *xv, const void *input_, unsigned width, unsigned height, unsigned pitch)
-{
-   const uint32_t *input = (const uint32_t*)input_;
-   uint16_t *output = (uint16_t*)xv->image->data;
-
-   for (unsigned y = 0; y < height; y++)
-   {
-      for (unsigned x = 0; x < width; x++)
-      {
-         uint32_t p = *input++;
-         p = ((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) | ((p >> 3) & 0x1f); // ARGB -> RGB16
-
-         uint8_t y0 = xv->ytable[p];
-         uint8_t u = xv->utable[p];
-         uint8_t v = xv->vtable[p];
-
-         unsigned img_width = xv->width << 1;
-         output[0] = output[img_width] = u;
-         output[1] = output[img_width + 1] = y0;
-         output[2] = output[img_width + 2] = v;
-         output[3] = output[img_width + 3] = y0;
-         output += 4;
-      }
+#endif
 
-      input  += (pitch >> 2) - width;
-      output += (xv->width - width) << 2;
-   }
+   xv_render_slice(xv, 0, height);
 }
 
 struct format_desc
 {
-   void (*render_16)(xv_t *xv, const void *input,
-         unsigned width, unsigned height, unsigned pitch);
-   void (*render_32)(xv_t *xv, const void *input,
-         unsigned width, unsigned height, unsigned pitch);
+   pixconv_func_t *convert_16;
+   pixconv_func_t *convert_32;
    char components[4];
    unsigned luma_index[2];
    unsigned u_index;
@@ -271,16 +178,16 @@ struct format_desc
 
 static const struct format_desc formats[] = {
    {
-      render16_yuy2,
-      render32_yuy2,
+      &conv_rgb565_yuy2,
+      &conv_argb8888_yuy2,
       { 'Y', 'U', 'Y', 'V' },
       { 0, 2 },
       1,
       3,
    },
    {
-      render16_uyvy,
-      render32_uyvy,
+      &conv_rgb565_uyvy,
+      &conv_argb8888_uyvy,
       { 'U', 'Y', 'V', 'Y' },
       { 1, 3 },
       0,
@@ -307,7 +214,7 @@ static bool adaptor_set_format(xv_t *xv, Display *dpy, XvPortID port, const vide
                   format[i].component_order[3] == formats[j].components[3])
             {
                xv->fourcc = format[i].id;
-               xv->render_func = video->rgb32 ? formats[j].render_32 : formats[j].render_16;
+               xv->convert = video->rgb32 ? formats[j].convert_32 : formats[j].convert_16;
 
                xv->luma_index[0] = formats[j].luma_index[0];
                xv->luma_index[1] = formats[j].luma_index[1];
@@ -478,7 +385,17 @@ static void *xv_init(const video_info_t *video, const input_driver_t **input, vo
          *input = NULL;
    }
 
-   init_yuv_tables(xv);
+#ifdef HAVE_THREADS
+   if (g_settings.video.xvideo_threads > 1)
+   {
+      xv->threads = slice_threads_new(g_settings.video.xvideo_threads);
+      if (xv->threads)
+         RARCH_LOG("XVideo: Converting frames with %u threads.\n", g_settings.video.xvideo_threads);
+      else
+         RARCH_WARN("XVideo: Failed to create conversion threads.\n");
+   }
+#endif
+
    xv_init_font(xv, g_settings.video.font_path, g_settings.video.font_size);
 
    return xv;
@@ -587,90 +504,19 @@ static void xv_render_msg(xv_t *xv, const char *msg, unsigned width, unsigned he
    if (!xv->font)
       return;
 
-   struct font_output_list out;
-   xv->font_driver->render_msg(xv->font, msg, &out);
-   struct font_output *head = out.head;
-
    int msg_base_x = g_settings.video.msg_pos_x * width;
    int msg_base_y = height * (1.0 - g_settings.video.msg_pos_y);
 
-   unsigned luma_index[2] = { xv->luma_index[0], xv->luma_index[1] };
-   unsigned chroma_u_index = xv->chroma_u_index;
-   unsigned chroma_v_index = xv->chroma_v_index;
-
-   unsigned pitch = width << 1; // YUV formats used are 16 bpp.
-
-   for (; head; head = head->next)
-   {
-      int base_x = (msg_base_x + head->off_x) & ~1; // Make sure we always start on the correct boundary so the indices are correct.
-      int base_y = msg_base_y - head->off_y - head->height;
-
-      int glyph_width  = head->width;
-      int glyph_height = head->height;
-
-      const uint8_t *src = head->output;
-
-      if (base_x < 0)
-      {
-         src -= base_x;
-         glyph_width += base_x;
-         base_x = 0;
-      }
-
-      if (base_y < 0)
-      {
-         src -= base_y * (int)head->pitch;
-         glyph_height += base_y;
-         base_y = 0;
-      }
-
-      int max_width  = width - base_x;
-      int max_height = height - base_y;
-
-      if (max_width <= 0 || max_height <= 0)
-         continue;
+   struct sw_font_yuv yuv = {
+      { xv->luma_index[0], xv->luma_index[1] },
+      xv->chroma_u_index,
+      xv->chroma_v_index,
+      xv->font_y, xv->font_u, xv->font_v,
+   };
 
-      if (glyph_width > max_width)
-         glyph_width = max_width;
-      if (glyph_height > max_height)
-         glyph_height = max_height;
-
-      uint8_t *out = (uint8_t*)xv->image->data + base_y * pitch + (base_x << 1);
-
-      for (int y = 0; y < glyph_height; y++, src += head->pitch, out += pitch)
-      {
-         // 2 input pixels => 4 bytes (2Y, 1U, 1V).
-         for (int x = 0; x < glyph_width; x += 2)
-         {
-            int out_x = x << 1;
-
-            unsigned alpha[2];
-            alpha[0] = src[x + 0];
-
-            if (x + 1 < glyph_width)
-               alpha[1] = src[x + 1];
-            else
-               alpha[1] = 0;
-
-            unsigned alpha_sub = (alpha[0] + alpha[1]) >> 1; // Blended alpha for the sub-sampled U/V channels.
-
-            for (unsigned i = 0; i < 2; i++)
-            {
-               unsigned blended = (xv->font_y * alpha[i] + ((256 - alpha[i]) * out[out_x + luma_index[i]])) >> 8;
-               out[out_x + luma_index[i]] = blended;
-            }
-
-            // Blend chroma channels
-            unsigned blended = (xv->font_u * alpha_sub + ((256 - alpha_sub) * out[out_x + chroma_u_index])) >> 8;
-            out[out_x + chroma_u_index] = blended;
-
-            blended = (xv->font_v * alpha_sub + ((256 - alpha_sub) * out[out_x + chroma_v_index])) >> 8;
-            out[out_x + chroma_v_index] = blended;
-         }
-      }
-   }
-
-   xv->font_driver->free_output(xv->font, &out);
+   sw_font_blend_yuv422(xv->font, msg, (uint8_t*)xv->image->data,
+         width << 1, width, height, // YUV formats used are 16 bpp.
+         msg_base_x, msg_base_y, &yuv);
 }
 
 static bool xv_frame(void *data, const void *frame, unsigned width, unsigned height, unsigned pitch, const char *msg)
@@ -685,7 +531,7 @@ static bool xv_frame(void *data, const void *frame, unsigned width, unsigned hei
 
    XWindowAttributes target;
    XGetWindowAttributes(xv->display, xv->window, &target);
-   xv->render_func(xv, frame, width, height, pitch);
+   xv_render(xv, frame, width, height, pitch);
 
    calc_out_rect(xv->keep_aspect, &xv->vp, target.width, target.height);
    xv->vp.full_width = target.width;
@@ -766,12 +612,11 @@ static void xv_free(void *data)
 
    XCloseDisplay(xv->display);
 
-   free(xv->ytable);
-   free(xv->utable);
-   free(xv->vtable);
+#ifdef HAVE_THREADS
+   slice_threads_free(xv->threads);
+#endif
 
-   if (xv->font)
-      xv->font_driver->free(xv->font);
+   sw_font_free(xv->font);
 
    free(xv);
 }
@@ -217,6 +217,7 @@ VIDEO DRIVER
 #endif
 
 #ifdef HAVE_XVIDEO
+#include "../gfx/fonts/sw_font.c"
 #include "../gfx/xvideo.c"
 #endif
 
@@ -498,6 +499,7 @@ THREAD
 #elif defined(HAVE_THREADS)
 #include "../thread.c"
 #include "../gfx/thread_wrapper.c"
+#include "../gfx/filter_threads.c"
 #include "../audio/thread_wrapper.c"
 #ifndef RARCH_CONSOLE
 #include "../autosave.c"
@@ -510,6 +512,7 @@ NETPLAY
 ============================================================ */
 #ifdef HAVE_NETPLAY
 #include "../netplay.c"
+#include "../netplay_spectate.c"
 #endif
 
 /*============================================================
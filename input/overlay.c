@@ -50,9 +50,7 @@ struct overlay
    struct overlay_desc *descs;
    size_t size;
 
-   uint32_t *image;
-   unsigned width;
-   unsigned height;
+   struct texture_image image;
 
    bool block_scale;
    float mod_x, mod_y, mod_w, mod_h;
@@ -188,7 +186,7 @@ void input_overlay_set_scale_factor(input_overlay_t *ol, float scale)
 static void input_overlay_free_overlay(struct overlay *overlay)
 {
    free(overlay->descs);
-   free(overlay->image);
+   texture_image_free(&overlay->image);
 }
 
 static void input_overlay_free_overlays(input_overlay_t *ol)
@@ -288,17 +286,12 @@ static bool input_overlay_load_overlay(config_file_t *conf, const char *config_p
    fill_pathname_resolve_relative(overlay_resolved_path, config_path,
          overlay_path, sizeof(overlay_resolved_path));
 
-   struct texture_image img = {0};
-   if (!texture_image_load(overlay_resolved_path, &img))
+   if (!texture_image_load(overlay_resolved_path, &overlay->image))
    {
       RARCH_ERR("Failed to load image: %s.\n", overlay_path);
       return false;
    }
 
-   overlay->image  = img.pixels;
-   overlay->width  = img.width;
-   overlay->height = img.height;
-
    // By default, we stretch the overlay out in full.
    overlay->x = overlay->y = 0.0f;
    overlay->w = overlay->h = 1.0f;
@@ -349,7 +342,7 @@ static bool input_overlay_load_overlay(config_file_t *conf, const char *config_p
 
    for (size_t i = 0; i < overlay->size; i++)
    {
-      if (!input_overlay_load_desc(conf, &overlay->descs[i], index, i, img.width, img.height))
+      if (!input_overlay_load_desc(conf, &overlay->descs[i], index, i, overlay->image.width, overlay->image.height))
       {
          RARCH_ERR("[Overlay]: Failed to load overlay descs for overlay #%u.\n", (unsigned)i);
          return false;
@@ -483,7 +476,8 @@ input_overlay_t *input_overlay_new(const char *overlay)
       goto error;
 
    ol->active = &ol->overlays[0];
-   ol->iface->load(ol->iface_data, ol->active->image, ol->active->width, ol->active->height);
+   ol->iface->load(ol->iface_data, ol->active->image.pixels,
+         ol->active->image.width, ol->active->image.height);
    ol->iface->vertex_geom(ol->iface_data,
          ol->active->mod_x, ol->active->mod_y, ol->active->mod_w, ol->active->mod_h);
    ol->iface->full_screen(ol->iface_data, ol->active->full_screen);
@@ -578,7 +572,8 @@ void input_overlay_next(input_overlay_t *ol)
    ol->index = ol->next_index;
    ol->active = &ol->overlays[ol->index];
 
-   ol->iface->load(ol->iface_data, ol->active->image, ol->active->width, ol->active->height);
+   ol->iface->load(ol->iface_data, ol->active->image.pixels,
+         ol->active->image.width, ol->active->image.height);
    ol->iface->vertex_geom(ol->iface_data,
          ol->active->mod_x, ol->active->mod_y, ol->active->mod_w, ol->active->mod_h);
    ol->iface->full_screen(ol->iface_data, ol->active->full_screen);
@@ -19,10 +19,12 @@
 
 #include "netplay_compat.h"
 #include "netplay.h"
+#include "netplay_spectate.h"
 #include "general.h"
 #include "autosave.h"
 #include "dynamic.h"
 #include "message.h"
+#include "hash.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -30,15 +32,17 @@
 static bool netplay_is_alive(netplay_t *handle);
 
 static bool netplay_poll(netplay_t *handle);
-static int16_t netplay_input_state(netplay_t *handle, bool port, unsigned device, unsigned index, unsigned id);
+static int16_t netplay_input_state(netplay_t *handle, unsigned port, unsigned device, unsigned index, unsigned id);
 
 // If we're fast-forward replaying to resync, check if we should actually show frame.
 static bool netplay_should_skip(netplay_t *handle);
 static bool netplay_can_poll(netplay_t *handle);
 static void netplay_set_spectate_input(netplay_t *handle, int16_t input);
 
-static bool netplay_send_cmd(netplay_t *handle, uint32_t cmd, const void *data, size_t size);
-static bool netplay_get_cmd(netplay_t *handle);
+struct netplay_peer;
+static bool netplay_send_cmd(netplay_t *handle, struct netplay_peer *peer, uint32_t cmd, const void *data, size_t size);
+static bool netplay_get_cmd(netplay_t *handle, struct netplay_peer *peer);
+static bool netplay_handle_cmd(netplay_t *handle, struct netplay_peer *peer, uint32_t cmd);
 
 #define PREV_PTR(x) ((x) == 0 ? handle->buffer_size - 1 : (x) - 1)
 #define NEXT_PTR(x) ((x + 1) % handle->buffer_size)
@@ -46,35 +50,121 @@ static bool netplay_get_cmd(netplay_t *handle);
 struct delta_frame
 {
    void *state;
+   bool has_state; // state holds a checkpoint taken right before this frame was run.
 
-   uint16_t real_input_state;
-   uint16_t simulated_input_state;
-   bool is_simulated;
-   uint16_t self_state;
-   bool used_real;
+   uint16_t real_input_state[MAX_PLAYERS];
+   uint16_t simulated_input_state[MAX_PLAYERS]; // Input the frame was run with. Predicted for players we didn't have input from yet.
+   bool is_simulated; // Still missing input from some player.
 };
 
 #define UDP_FRAME_PACKETS 16
-#define MAX_SPECTATORS 16
+
+// Input of every player is kept around by frame. Our own, and with the host, everybody's,
+// so it can be resent until the other players have it. Input from other players is held
+// from the time it arrives, which might be before we run its frame.
+#define INPUT_LOG_SIZE 128
+// Most input frames of one player in a packet. Has to cover input delay plus how far we can get ahead of the other players.
+#define MAX_PACKET_INPUTS 48
+#define MAX_INPUT_DELAY 8
+// A packet is a header, the input frame we're at for every player (acks),
+// then a block of input for every player the receiver is missing input from.
+// A block is (player << 16 | count), the first frame, and the input states, two to a word.
+// The host relays the input of every client to every other client, so its upload grows with the square
+// of the player count. Blocks are kept small so that stays cheap.
+#define PACKET_HEADER_SIZE 6
+#define PACKET_BLOCK_HEADER_SIZE 2
+#define PACKET_BLOCK_WORDS(inputs) (((inputs) + 1) / 2)
+#define MAX_PACKET_SIZE (PACKET_HEADER_SIZE + MAX_PLAYERS + \
+      MAX_PLAYERS * (PACKET_BLOCK_HEADER_SIZE + PACKET_BLOCK_WORDS(MAX_PACKET_INPUTS)))
+// How often (in frames) the link is measured and input delay adjusted.
+#define ADAPT_INTERVAL 60
+#define SPECTATE_LISTEN_BACKLOG 64
+
+// States are only saved for frames run on predicted input, and then only every few frames.
+// Rollbacks resume from the closest checkpoint, replaying the confirmed frames in between.
+// The frame buffer is grown by this much, so the checkpoint and the input to replay from it are kept around.
+#define CHECKPOINT_INTERVAL 2
+
+// Every CHECKSUM_INTERVAL frames, the state is checksummed once all input before it is confirmed,
+// and compared with the other player's. A state is always saved for these frames.
+#define CHECKSUM_INTERVAL 30
+#define CHECKSUM_LOG_SIZE 16
+// Confirmed input is kept for this many frames, so the client can catch up from a state sent by the host.
+#define RESYNC_HISTORY 300
 
 #define NETPLAY_CMD_ACK 0
 #define NETPLAY_CMD_NAK 1
 #define NETPLAY_CMD_FLIP_PLAYERS 2
+// These are not acknowledged, and either side may send them at any time.
+#define NETPLAY_CMD_CHECKSUM 3
+#define NETPLAY_CMD_RESYNC 4
+
+struct netplay_checksum
+{
+   uint32_t frame;
+   uint32_t crc;
+   bool valid;
+};
+
+struct netplay_input
+{
+   uint32_t frame;
+   uint16_t state;
+   bool valid;
+};
+
+// Players are connected in a star. The host is player 1, and has a peer for every client.
+// Clients only have the host as peer, which relays the input of the other clients to them.
+struct netplay_peer
+{
+   int fd; // TCP connection for state sending, etc. Also used for commands.
+   unsigned player; // Player the peer controls. The host is always 0.
+   char nick[32];
+
+   struct sockaddr_storage addr; // Where to send UDP packets.
+   socklen_t addr_len;
+   bool has_addr;
+
+   uint32_t ack[MAX_PLAYERS]; // The peer has input of each player for all frames before this.
+
+   // Link measurements. Every packet carries the frame it was sent on, which is echoed back for RTT.
+   uint32_t echo_frame; // Newest packet from the peer...
+   rarch_time_t echo_time; // ... and when it arrived.
+   bool has_echo;
+   uint32_t rtt_frame; // Newest of our packets we've got an RTT sample for.
+   bool has_rtt;
+   float srtt; // Smoothed RTT in ms.
+   float rttvar; // RTT variation in ms.
+   uint32_t seq_high; // Newest packet seen, to count lost ones.
+   unsigned seq_expected;
+   unsigned seq_received;
+   float loss;
+   float relay_ms; // Client: how long the host takes to get input to the other clients.
+
+   // Desync detection. The host compares every client against itself.
+   struct netplay_checksum checksums[CHECKSUM_LOG_SIZE];
+   uint32_t resync_epoch; // Bumped on every resync. Checksums from before one are not compared.
+   bool desync; // Noticed a desync, which hasn't been resynced yet.
+};
 
 struct netplay
 {
    char nick[32];
-   char other_nick[32];
-   struct sockaddr_storage other_addr;
 
    struct retro_callbacks cbs;
-   int fd; // TCP connection for state sending, etc. Also used for commands.
-   int udp_fd; // UDP connection for game state updates.
-   unsigned port; // Which port is governed by netplay (other player)?
+   int fd; // Spectating: TCP connection, or listening socket. Host: listening socket, until all players are in.
+   int udp_fd; // UDP socket for input, shared by all peers.
+   struct addrinfo *addr;
    bool has_connection;
 
+   unsigned player; // Player we control, 0 for the host.
+   unsigned num_players;
+   struct netplay_peer peers[MAX_PLAYERS - 1];
+   unsigned num_peers;
+
    struct delta_frame *buffer;
    size_t buffer_size;
+   unsigned sync_frames; // How many frames we may run ahead of confirmed input.
 
    size_t self_ptr; // Ptr where we are now.
    size_t other_ptr; // Points to the last reliable state that self ever had.
@@ -86,32 +176,67 @@ struct netplay
    bool is_replay; // Are we replaying old frames?
    bool can_poll; // We don't want to poll several times on a frame.
 
-   uint32_t packet_buffer[UDP_FRAME_PACKETS * 2]; // To compat UDP packet loss we also send old data along with the packets.
    uint32_t frame_count;
-   uint32_t read_frame_count;
+   uint32_t read_frame_count; // Frames before this have input from every player.
    uint32_t other_frame_count;
    uint32_t tmp_frame_count;
-   struct addrinfo *addr;
-   struct sockaddr_storage their_addr;
-   bool has_client_addr;
 
    unsigned timeout_cnt;
 
+   // Input delay. Our input is used input_delay frames after it's read, and sent right away,
+   // giving it that much longer to reach the other players before they need it.
+   unsigned input_delay;
+   unsigned max_input_delay;
+   struct netplay_input input_log[MAX_PLAYERS][INPUT_LOG_SIZE];
+   uint32_t input_frame[MAX_PLAYERS]; // First frame we don't have input of a player for. Input after it might have arrived already.
+
+   rarch_time_t send_time[INPUT_LOG_SIZE]; // When the packets for a frame were first sent.
+   uint32_t next_adapt_frame;
+
+   // Desync detection. On mismatch, the host sends the client the state of its latest checksummed frame,
+   // and the client replays its confirmed input from there to catch up.
+   uint32_t checksum_frame; // Next frame to checksum.
+   struct netplay_checksum self_checksums[CHECKSUM_LOG_SIZE];
+   void *resync_state; // Host: state of the latest checksummed frame. Client: state received from the host.
+   uint32_t resync_frame;
+   bool has_resync; // Client: resync_state is waiting to be loaded.
+   bool is_resync; // Replaying from resync_state, with input from input_history.
+   uint16_t input_history[RESYNC_HISTORY][MAX_PLAYERS];
+
    // Spectating.
    bool spectate;
    bool spectate_client;
-   int spectate_fds[MAX_SPECTATORS];
+   spectate_server_t *spectate_server; // Host, or a client relaying to further spectators.
    uint16_t *spectate_input;
    size_t spectate_input_ptr;
    size_t spectate_input_size;
 
-   // Player flipping
+   // Player flipping, only with two players.
    // Flipping state. If ptr >= flip_frame, we apply the flip.
    // If not, we apply the opposite, effectively creating a trigger point.
    // To avoid collition we need to make sure our client/host is synced up well after flip_frame
    // before allowing another flip.
    bool flip;
    uint32_t flip_frame;
+
+   // Statistics.
+   rarch_time_t start_time;
+   unsigned serialize_cnt;
+   unsigned rollback_cnt;
+   unsigned replay_cnt;
+   rarch_time_t rollback_time;
+   unsigned stall_cnt;
+   unsigned resend_cnt;
+   rarch_time_t stall_time;
+   unsigned packet_cnt;
+   unsigned packet_input_cnt;
+   unsigned long bytes_sent;
+   unsigned long bytes_received;
+   rarch_time_t packet_time;
+   unsigned checksum_cnt;
+   rarch_time_t checksum_time;
+   unsigned desync_cnt;
+   unsigned resync_cnt;
 };
 
 static bool send_all(int fd, const void *data_, size_t size)
@@ -237,8 +362,7 @@ static void log_connection(const struct sockaddr_storage *their_addr,
 }
 #endif
 
-static int init_tcp_connection(const struct addrinfo *res, bool server, bool spectate,
-      struct sockaddr *other_addr, socklen_t addr_size)
+static int init_tcp_connection(const struct addrinfo *res, bool server, bool spectate)
 {
    bool ret = true;
    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
@@ -256,39 +380,17 @@ static int init_tcp_connection(const struct addrinfo *res, bool server, bool spe
          goto end;
       }
    }
-   else if (spectate)
-   {
-      int yes = 1;
-      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, CONST_CAST &yes, sizeof(int));
-
-      if (bind(fd, res->ai_addr, res->ai_addrlen) < 0 ||
-            listen(fd, MAX_SPECTATORS) < 0)
-      {
-         ret = false;
-         goto end;
-      }
-   }
    else
    {
       int yes = 1;
       setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, CONST_CAST &yes, sizeof(int));
 
       if (bind(fd, res->ai_addr, res->ai_addrlen) < 0 ||
-            listen(fd, 1) < 0)
+            listen(fd, spectate ? SPECTATE_LISTEN_BACKLOG : MAX_PLAYERS) < 0)
       {
          ret = false;
          goto end;
       }
-
-      int new_fd = accept(fd, other_addr, &addr_size);
-      if (new_fd < 0)
-      {
-         ret = false;
-         goto end;
-      }
-
-      close(fd);
-      fd = new_fd;
    }
 
 end:
@@ -301,7 +403,8 @@ end:
    return fd;
 }
 
-static bool init_tcp_socket(netplay_t *handle, const char *server, uint16_t port, bool spectate)
+// Connects to server, or listens on port if server is NULL.
+static int init_tcp_socket(const char *server, uint16_t port, bool spectate)
 {
    struct addrinfo hints, *res = NULL;
    memset(&hints, 0, sizeof(hints));
@@ -316,27 +419,21 @@ static bool init_tcp_socket(netplay_t *handle, const char *server, uint16_t port
    if (!server)
       hints.ai_flags = AI_PASSIVE;
 
-   bool ret = false;
+   int fd = -1;
    char port_buf[16];
    snprintf(port_buf, sizeof(port_buf), "%hu", (unsigned short)port);
    if (getaddrinfo(server, port_buf, &hints, &res) < 0)
-      return false;
+      return -1;
 
    if (!res)
-      return false;
+      return -1;
 
    // If "localhost" is used, it is important to check every possible address for ipv4/ipv6.
    const struct addrinfo *tmp_info = res;
    while (tmp_info)
    {
-      int fd;
-      if ((fd = init_tcp_connection(tmp_info, server, handle->spectate,
-               (struct sockaddr*)&handle->other_addr, sizeof(handle->other_addr))) >= 0)
-      {
-         ret = true;
-         handle->fd = fd;
+      if ((fd = init_tcp_connection(tmp_info, server, spectate)) >= 0)
          break;
-      }
 
       tmp_info = tmp_info->ai_next;
    }
@@ -344,10 +441,10 @@ static bool init_tcp_socket(netplay_t *handle, const char *server, uint16_t port
    if (res)
       freeaddrinfo(res);
 
-   if (!ret)
+   if (fd < 0)
       RARCH_ERR("Failed to set up netplay sockets.\n");
 
-   return ret;
+   return fd;
 }
 
 static bool init_udp_socket(netplay_t *handle, const char *server, uint16_t port)
@@ -428,7 +525,7 @@ static bool init_socket(netplay_t *handle, const char *server, uint16_t port)
    if (!netplay_init_network())
       return false;
 
-   if (!init_tcp_socket(handle, server, port, handle->spectate))
+   if ((handle->fd = init_tcp_socket(server, port, handle->spectate)) < 0)
       return false;
    if (!handle->spectate && !init_udp_socket(handle, server, port))
       return false;
@@ -488,7 +585,8 @@ static bool send_nickname(netplay_t *handle, int fd)
    return true;
 }
 
-static bool get_nickname(netplay_t *handle, int fd)
+// nick has to hold 32 chars.
+static bool get_nickname(int fd, char *nick)
 {
    uint8_t nick_size;
 
@@ -498,22 +596,23 @@ static bool get_nickname(netplay_t *handle, int fd)
       return false;
    }
 
-   if (nick_size >= sizeof(handle->other_nick))
+   if (nick_size >= 32)
    {
       RARCH_ERR("Invalid nick size.\n");
       return false;
    }
 
-   if (!recv_all(fd, handle->other_nick, nick_size))
+   if (!recv_all(fd, nick, nick_size))
    {
       RARCH_ERR("Failed to receive nick.\n");
       return false;
    }
 
+   nick[nick_size] = '\0';
    return true;
 }
 
-static bool send_info(netplay_t *handle)
+static bool send_info(netplay_t *handle, struct netplay_peer *peer)
 {
    uint32_t header[3] = {
       htonl(g_extern.cart_crc),
@@ -521,10 +620,10 @@ static bool send_info(netplay_t *handle)
       htonl(pretro_get_memory_size(RETRO_MEMORY_SAVE_RAM))
    };
 
-   if (!send_all(handle->fd, header, sizeof(header)))
+   if (!send_all(peer->fd, header, sizeof(header)))
       return false;
 
-   if (!send_nickname(handle, handle->fd))
+   if (!send_nickname(handle, peer->fd))
    {
       RARCH_ERR("Failed to send nick to host.\n");
       return false;
@@ -534,31 +633,31 @@ static bool send_info(netplay_t *handle)
    void *sram = pretro_get_memory_data(RETRO_MEMORY_SAVE_RAM);
    unsigned sram_size = pretro_get_memory_size(RETRO_MEMORY_SAVE_RAM);
 
-   if (!recv_all(handle->fd, sram, sram_size))
+   if (!recv_all(peer->fd, sram, sram_size))
    {
       RARCH_ERR("Failed to receive SRAM data from host.\n");
       return false;
    }
 
-   if (!get_nickname(handle, handle->fd))
+   if (!get_nickname(peer->fd, peer->nick))
    {
       RARCH_ERR("Failed to receive nick from host.\n");
       return false;
    }
 
    char msg[512];
-   snprintf(msg, sizeof(msg), "Connected to: \"%s\"", handle->other_nick);
+   snprintf(msg, sizeof(msg), "Connected to: \"%s\"", peer->nick);
    RARCH_LOG("%s\n", msg);
    msg_queue_push(g_extern.msg_queue, msg, 1, 180);
 
    return true;
 }
 
-static bool get_info(netplay_t *handle)
+static bool get_info(netplay_t *handle, struct netplay_peer *peer)
 {
    uint32_t header[3];
 
-   if (!recv_all(handle->fd, header, sizeof(header)))
+   if (!recv_all(peer->fd, header, sizeof(header)))
    {
       RARCH_ERR("Failed to receive header from client.\n");
       return false;
@@ -582,31 +681,97 @@ static bool get_info(netplay_t *handle)
       return false;
    }
 
-   if (!get_nickname(handle, handle->fd))
+   if (!get_nickname(peer->fd, peer->nick))
    {
       RARCH_ERR("Failed to get nickname from client.\n");
       return false;
    }
 
-   // Send SRAM data to our Player 2.
+   // Send SRAM data to our client.
    const void *sram = pretro_get_memory_data(RETRO_MEMORY_SAVE_RAM);
    unsigned sram_size = pretro_get_memory_size(RETRO_MEMORY_SAVE_RAM);
-   if (!send_all(handle->fd, sram, sram_size))
+   if (!send_all(peer->fd, sram, sram_size))
    {
       RARCH_ERR("Failed to send SRAM data to client.\n");
       return false;
    }
 
-   if (!send_nickname(handle, handle->fd))
+   if (!send_nickname(handle, peer->fd))
    {
       RARCH_ERR("Failed to send nickname to client.\n");
       return false;
    }
 
+   return true;
+}
+
+// Host: waits for every player to connect, then tells each which player it is, which starts the game.
+static bool accept_players(netplay_t *handle)
+{
+   for (unsigned i = 0; i < handle->num_peers; i++)
+   {
+      struct netplay_peer *peer = &handle->peers[i];
+
+      RARCH_LOG("Waiting for %u more player(s) to connect ...\n", handle->num_peers - i);
+
+      struct sockaddr_storage addr;
+      socklen_t addr_size = sizeof(addr);
+      if ((peer->fd = accept(handle->fd, (struct sockaddr*)&addr, &addr_size)) < 0)
+      {
+         RARCH_ERR("Failed to accept player.\n");
+         return false;
+      }
+
+      peer->player = i + 1;
+      if (!get_info(handle, peer))
+         return false;
+
 #ifndef HAVE_SOCKET_LEGACY
-   log_connection(&handle->other_addr, 0, handle->other_nick);
+      log_connection(&addr, peer->player, peer->nick);
 #endif
+   }
+
+   for (unsigned i = 0; i < handle->num_peers; i++)
+   {
+      uint32_t start[2] = { htonl(handle->peers[i].player), htonl(handle->num_players) };
+      if (!send_all(handle->peers[i].fd, start, sizeof(start)))
+      {
+         RARCH_ERR("Failed to start game for client.\n");
+         return false;
+      }
+   }
+
+   close(handle->fd);
+   handle->fd = -1;
+   return true;
+}
+
+// Client: blocks until the host has all its players.
+static bool get_player(netplay_t *handle, struct netplay_peer *peer)
+{
+   RARCH_LOG("Waiting for the host to start the game ...\n");
+
+   uint32_t start[2];
+   if (!recv_all(peer->fd, start, sizeof(start)))
+   {
+      RARCH_ERR("Failed to receive player from host.\n");
+      return false;
+   }
+
+   handle->player = ntohl(start[0]);
+   handle->num_players = ntohl(start[1]);
+   if (handle->num_players < 2 || handle->num_players > MAX_PLAYERS ||
+         handle->player == 0 || handle->player >= handle->num_players)
+   {
+      RARCH_ERR("Host sent invalid player.\n");
+      return false;
+   }
 
+   char msg[512];
+   snprintf(msg, sizeof(msg), "Netplay started. You are player %u of %u.",
+         handle->player + 1, handle->num_players);
+   RARCH_LOG("%s\n", msg);
+   msg_queue_push(g_extern.msg_queue, msg, 1, 180);
    return true;
 }
 
@@ -679,14 +844,15 @@ static bool get_info_spectate(netplay_t *handle)
       return false;
    }
 
-   if (!get_nickname(handle, handle->fd))
+   char host_nick[32];
+   if (!get_nickname(handle->fd, host_nick))
    {
       RARCH_ERR("Failed to receive nickname from host.\n");
       return false;
    }
 
    char msg[512];
-   snprintf(msg, sizeof(msg), "Connected to \"%s\"", handle->other_nick);
+   snprintf(msg, sizeof(msg), "Connected to \"%s\"", host_nick);
    msg_queue_push(g_extern.msg_queue, msg, 1, 180);
    RARCH_LOG("%s\n", msg);
 
@@ -735,11 +901,23 @@ static void init_buffers(netplay_t *handle)
       handle->buffer[i].state = malloc(handle->state_size);
       handle->buffer[i].is_simulated = true;
    }
+   handle->resync_state = malloc(handle->state_size);
+
+   // Nobody gets to use input on the first frame, it's always zero.
+   for (unsigned p = 0; p < handle->num_players; p++)
+   {
+      handle->input_log[p][0].valid = true;
+      handle->input_frame[p] = 1;
+   }
+   for (unsigned i = 0; i < handle->num_peers; i++)
+      for (unsigned p = 0; p < handle->num_players; p++)
+         handle->peers[i].ack[p] = 1;
 }
 
 netplay_t *netplay_new(const char *server, uint16_t port,
-      unsigned frames, const struct retro_callbacks *cb,
-      bool spectate,
+      unsigned frames, unsigned players,
+      const struct retro_callbacks *cb,
+      bool spectate, uint16_t relay_port,
       const char *nick)
 {
    if (frames > UDP_FRAME_PACKETS)
@@ -751,8 +929,9 @@ netplay_t *netplay_new(const char *server, uint16_t port,
 
    handle->fd = -1;
    handle->udp_fd = -1;
+   for (unsigned i = 0; i < MAX_PLAYERS - 1; i++)
+      handle->peers[i].fd = -1;
    handle->cbs = *cb;
-   handle->port = server ? 0 : 1;
    handle->spectate = spectate;
    handle->spectate_client = server != NULL;
    strlcpy(handle->nick, nick, sizeof(handle->nick));
@@ -765,29 +944,65 @@ netplay_t *netplay_new(const char *server, uint16_t port,
 
    if (spectate)
    {
+      int listen_fd = -1;
       if (server)
       {
          if (!get_info_spectate(handle))
             goto error;
+
+         // Relay what we receive to spectators of our own.
+         if (relay_port)
+         {
+            if ((listen_fd = init_tcp_socket(NULL, relay_port, true)) < 0)
+               goto error;
+            RARCH_LOG("Relaying to spectators on port %hu.\n", (unsigned short)relay_port);
+         }
+      }
+      else
+      {
+         // The spectate server owns the listening socket from here on.
+         listen_fd = handle->fd;
+         handle->fd = -1;
       }
 
-      for (unsigned i = 0; i < MAX_SPECTATORS; i++)
-         handle->spectate_fds[i] = -1;
+      if (listen_fd >= 0 && !(handle->spectate_server = spectate_server_new(listen_fd, handle->nick)))
+         goto error;
    }
    else
    {
       if (server)
       {
-         if (!send_info(handle))
+         // The host is our only peer.
+         struct netplay_peer *peer = &handle->peers[0];
+         handle->num_peers = 1;
+         peer->fd = handle->fd;
+         handle->fd = -1;
+         memcpy(&peer->addr, handle->addr->ai_addr, handle->addr->ai_addrlen);
+         peer->addr_len = handle->addr->ai_addrlen;
+         peer->has_addr = true;
+
+         if (!send_info(handle, peer) || !get_player(handle, peer))
             goto error;
       }
       else
       {
-         if (!get_info(handle))
+         if (players < 2)
+            players = 2;
+         else if (players > MAX_PLAYERS)
+            players = MAX_PLAYERS;
+
+         handle->num_players = players;
+         handle->num_peers = players - 1;
+         if (!accept_players(handle))
             goto error;
       }
 
-      handle->buffer_size = frames + 1;
+      handle->sync_frames = frames;
+      handle->max_input_delay = g_settings.input.netplay_max_input_delay;
+      if (handle->max_input_delay > MAX_INPUT_DELAY)
+         handle->max_input_delay = MAX_INPUT_DELAY;
+      handle->buffer_size = frames + CHECKPOINT_INTERVAL;
+      handle->start_time = rarch_get_time_usec();
 
       init_buffers(handle);
       handle->has_connection = true;
@@ -800,6 +1015,11 @@ error:
       close(handle->fd);
    if (handle->udp_fd >= 0)
       close(handle->udp_fd);
+   for (unsigned i = 0; i < MAX_PLAYERS - 1; i++)
+      if (handle->peers[i].fd >= 0)
+         close(handle->peers[i].fd);
+   if (handle->addr)
+      freeaddrinfo(handle->addr);
 
    free(handle);
    return NULL;
@@ -811,34 +1031,134 @@ static bool netplay_is_alive(netplay_t *handle)
    return handle->has_connection;
 }
 
-static bool send_chunk(netplay_t *handle)
+// Checked after self_ptr is advanced for the frame about to run.
+// If we're too far ahead of the other players, we have to block for input.
+static bool netplay_buffer_full(netplay_t *handle)
 {
-   const struct sockaddr *addr = NULL;
-   if (handle->addr)
-      addr = handle->addr->ai_addr;
-   else if (handle->has_client_addr)
-      addr = (const struct sockaddr*)&handle->their_addr;
+   return handle->frame_count - handle->other_frame_count >= handle->sync_frames;
+}
+
+static bool netplay_get_input(netplay_t *handle, unsigned player, uint32_t frame, uint16_t *state)
+{
+   const struct netplay_input *input = &handle->input_log[player][frame % INPUT_LOG_SIZE];
+   if (!input->valid || input->frame != frame)
+      return false;
+
+   *state = input->state;
+   return true;
+}
 
-   if (addr)
+static void netplay_set_input(netplay_t *handle, unsigned player, uint32_t frame, uint16_t state)
+{
+   struct netplay_input *input = &handle->input_log[player][frame % INPUT_LOG_SIZE];
+   input->frame = frame;
+   input->state = state;
+   input->valid = true;
+
+   while (netplay_get_input(handle, player, handle->input_frame[player], &state))
+      handle->input_frame[player]++;
+}
+
+// Everything the peer might not have gotten is resent with every packet,
+// so the amount of redundancy follows the latency and loss of the link.
+// Clients only send their own input. The host sends the input of every player but the peer's own.
+static bool send_chunk(netplay_t *handle, struct netplay_peer *peer)
+{
+   if (!peer->has_addr)
+      return true;
+
+   rarch_time_t start = rarch_get_time_usec();
+
+   uint32_t packet[MAX_PACKET_SIZE];
+   unsigned size = PACKET_HEADER_SIZE;
+   unsigned blocks = 0;
+
+   for (unsigned p = 0; p < handle->num_players; p++)
+      packet[size++] = htonl(handle->input_frame[p]);
+
+   for (unsigned p = 0; p < handle->num_players; p++)
    {
-      if (sendto(handle->udp_fd, CONST_CAST handle->packet_buffer,
-               sizeof(handle->packet_buffer), 0, addr,
-               sizeof(struct sockaddr)) != sizeof(handle->packet_buffer))
+      if (p == peer->player || (handle->player != 0 && p != handle->player))
+         continue;
+
+      uint32_t first = peer->ack[p];
+      uint32_t end = handle->input_frame[p];
+      if ((int32_t)(end - first) <= 0)
+         continue;
+      if (end - first > MAX_PACKET_INPUTS)
+         first = end - MAX_PACKET_INPUTS;
+
+      uint32_t inputs = end - first;
+      packet[size++] = htonl(p << 16 | inputs);
+      packet[size++] = htonl(first);
+      for (uint32_t i = 0; i < inputs; i += 2)
       {
-         warn_hangup();
-         handle->has_connection = false;
-         return false;
+         uint32_t word = (uint32_t)handle->input_log[p][(first + i) % INPUT_LOG_SIZE].state << 16;
+         if (i + 1 < inputs)
+            word |= handle->input_log[p][(first + i + 1) % INPUT_LOG_SIZE].state;
+         packet[size++] = htonl(word);
+      }
+
+      handle->packet_input_cnt += end - first;
+      blocks++;
+   }
+
+   // Input between clients takes a detour through us, they need to know how long it is.
+   float relay_ms = 0.0f;
+   if (handle->player == 0)
+   {
+      for (unsigned i = 0; i < handle->num_peers; i++)
+      {
+         if (&handle->peers[i] != peer && handle->peers[i].srtt / 2.0f > relay_ms)
+            relay_ms = handle->peers[i].srtt / 2.0f;
       }
    }
+
+   packet[0] = htonl(handle->frame_count);
+   packet[1] = htonl(peer->echo_frame);
+   packet[2] = htonl(peer->has_echo ? (uint32_t)(rarch_get_time_usec() - peer->echo_time) : 0xffffffffu);
+   packet[3] = htonl(handle->player);
+   packet[4] = htonl((uint32_t)(relay_ms * 1000.0f));
+   packet[5] = htonl(blocks);
+
+   size_t bytes = size * sizeof(uint32_t);
+   if (sendto(handle->udp_fd, CONST_CAST packet, bytes, 0,
+            (const struct sockaddr*)&peer->addr, peer->addr_len) != (ssize_t)bytes)
+   {
+      warn_hangup();
+      handle->has_connection = false;
+      return false;
+   }
+
+   handle->packet_cnt++;
+   handle->bytes_sent += bytes;
+   handle->packet_time += rarch_get_time_usec() - start;
+   return true;
+}
+
+static bool send_chunks(netplay_t *handle)
+{
+   for (unsigned i = 0; i < handle->num_peers; i++)
+   {
+      if (!send_chunk(handle, &handle->peers[i]))
+         return false;
+   }
+
    return true;
 }
 
 #define MAX_RETRIES 16
 #define RETRY_MS 500
 
-static int poll_input(netplay_t *handle, bool block)
+static int poll_input_select(netplay_t *handle, bool block)
 {
-   int max_fd = (handle->fd > handle->udp_fd ? handle->fd : handle->udp_fd) + 1;
+   int max_fd = handle->udp_fd;
+   for (unsigned i = 0; i < handle->num_peers; i++)
+   {
+      if (handle->peers[i].fd > max_fd)
+         max_fd = handle->peers[i].fd;
+   }
+   max_fd++;
 
    struct timeval tv = {0};
    tv.tv_sec = 0;
@@ -855,28 +1175,29 @@ static int poll_input(netplay_t *handle, bool block)
       fd_set fds;
       FD_ZERO(&fds);
       FD_SET(handle->udp_fd, &fds);
-      FD_SET(handle->fd, &fds);
+      for (unsigned i = 0; i < handle->num_peers; i++)
+         FD_SET(handle->peers[i].fd, &fds);
 
       if (select(max_fd, &fds, NULL, NULL, &tmp_tv) < 0)
          return -1;
 
       // Somewhat hacky,
-      // but we aren't using the TCP connection for anything useful atm.
-      if (FD_ISSET(handle->fd, &fds) && !netplay_get_cmd(handle))
-         return -1; 
+      // but we only use the TCP connections for commands.
+      for (unsigned i = 0; i < handle->num_peers; i++)
+      {
+         if (FD_ISSET(handle->peers[i].fd, &fds) && !netplay_get_cmd(handle, &handle->peers[i]))
+            return -1;
+      }
 
       if (FD_ISSET(handle->udp_fd, &fds))
          return 1;
 
-      if (block && !send_chunk(handle))
-      {
-         warn_hangup();
-         handle->has_connection = false;
+      if (block && !send_chunks(handle))
          return -1;
-      }
 
       if (block)
       {
+         handle->resend_cnt++;
          RARCH_LOG("Network is stalling, resending packet... Count %u of %d ...\n",
                handle->timeout_cnt, MAX_RETRIES);
       }
@@ -887,6 +1208,19 @@ static int poll_input(netplay_t *handle, bool block)
    return 0;
 }
 
+static int poll_input(netplay_t *handle, bool block)
+{
+   if (!block)
+      return poll_input_select(handle, false);
+
+   // We're blocked on the other players, keep track of how long.
+   rarch_time_t start = rarch_get_time_usec();
+   int ret = poll_input_select(handle, true);
+   handle->stall_cnt++;
+   handle->stall_time += rarch_get_time_usec() - start;
+   return ret;
+}
+
 // Grab our own input state and send this over the network.
 static bool get_self_input_state(netplay_t *handle)
 {
@@ -898,68 +1232,275 @@ static bool get_self_input_state(netplay_t *handle)
       retro_input_state_t cb = handle->cbs.state_cb;
       for (unsigned i = 0; i < RARCH_FIRST_META_KEY; i++)
       {
-         int16_t tmp = cb(g_settings.input.netplay_client_swap_input ? 0 : !handle->port,
+         int16_t tmp = cb(g_settings.input.netplay_client_swap_input ? 0 : handle->player,
                RETRO_DEVICE_JOYPAD, 0, i);
          state |= tmp ? 1 << i : 0;
       }
    }
 
-   memmove(handle->packet_buffer, handle->packet_buffer + 2,
-         sizeof (handle->packet_buffer) - 2 * sizeof(uint32_t));
-   handle->packet_buffer[(UDP_FRAME_PACKETS - 1) * 2] = htonl(handle->frame_count); 
-   handle->packet_buffer[(UDP_FRAME_PACKETS - 1) * 2 + 1] = htonl(state);
+   // If the delay went up, the input is repeated to fill the gap.
+   // If it went down, input is dropped until we've caught up.
+   uint32_t target = handle->frame_count + handle->input_delay;
+   while ((int32_t)(handle->input_frame[handle->player] - target) <= 0)
+      netplay_set_input(handle, handle->player, handle->input_frame[handle->player], state);
 
-   if (!send_chunk(handle))
-   {
-      warn_hangup();
-      handle->has_connection = false;
+   handle->send_time[handle->frame_count % INPUT_LOG_SIZE] = rarch_get_time_usec();
+   if (!send_chunks(handle))
       return false;
-   }
 
-   ptr->self_state = state;
+   uint16_t self_state = 0;
+   netplay_get_input(handle, handle->player, handle->frame_count, &self_state);
+   ptr->real_input_state[handle->player] = self_state;
+   ptr->simulated_input_state[handle->player] = self_state;
+   ptr->is_simulated = true;
+   handle->input_history[handle->frame_count % RESYNC_HISTORY][handle->player] = self_state;
    handle->self_ptr = NEXT_PTR(handle->self_ptr);
    return true;
 }
 
+// Input of a player is predicted to stay what it was last seen as.
 // TODO: Somewhat better prediction. :P
+static uint16_t netplay_predict_input(netplay_t *handle, unsigned player, uint32_t frame)
+{
+   uint16_t state = 0;
+
+   // Newer input might have arrived already, past a lost packet we're still waiting for.
+   for (; (int32_t)(frame - handle->input_frame[player]) >= 0; frame--)
+   {
+      if (netplay_get_input(handle, player, frame, &state))
+         return state;
+   }
+
+   netplay_get_input(handle, player, frame, &state);
+   return state;
+}
+
 static void simulate_input(netplay_t *handle)
 {
-   size_t ptr = PREV_PTR(handle->self_ptr);
-   size_t prev = PREV_PTR(handle->read_ptr);
+   struct delta_frame *ptr = &handle->buffer[PREV_PTR(handle->self_ptr)];
+   for (unsigned p = 0; p < handle->num_players; p++)
+   {
+      if (p != handle->player)
+         ptr->simulated_input_state[p] = netplay_predict_input(handle, p, handle->frame_count);
+   }
+}
 
-   handle->buffer[ptr].simulated_input_state = handle->buffer[prev].real_input_state;
-   handle->buffer[ptr].is_simulated = true;
-   handle->buffer[ptr].used_real = false;
+// Moves input of the other players into the frame buffer, up to the frame we're running,
+// for as long as we have the input of every player.
+static void read_early_input(netplay_t *handle)
+{
+   while ((int32_t)(handle->frame_count - handle->read_frame_count) >= 0)
+   {
+      uint32_t frame = handle->read_frame_count;
+      for (unsigned p = 0; p < handle->num_players; p++)
+      {
+         if ((int32_t)(handle->input_frame[p] - frame) <= 0)
+            return;
+      }
+
+      struct delta_frame *delta = &handle->buffer[handle->read_ptr];
+      for (unsigned p = 0; p < handle->num_players; p++)
+      {
+         if (p == handle->player)
+            continue;
+
+         netplay_get_input(handle, p, frame, &delta->real_input_state[p]);
+         handle->input_history[frame % RESYNC_HISTORY][p] = delta->real_input_state[p];
+      }
+
+      delta->is_simulated = false;
+      handle->read_ptr = NEXT_PTR(handle->read_ptr);
+      handle->read_frame_count++;
+      handle->timeout_cnt = 0;
+   }
 }
 
-static void parse_packet(netplay_t *handle, uint32_t *buffer, unsigned size)
+static void update_rtt(netplay_t *handle, struct netplay_peer *peer, uint32_t frame, uint32_t hold_usec)
 {
-   for (unsigned i = 0; i < size * 2; i++)
+   if (hold_usec == 0xffffffffu || handle->frame_count - frame >= INPUT_LOG_SIZE)
+      return;
+   if (peer->has_rtt && (int32_t)(frame - peer->rtt_frame) <= 0)
+      return;
+
+   rarch_time_t rtt = rarch_get_time_usec() - handle->send_time[frame % INPUT_LOG_SIZE] - hold_usec;
+   float sample = rtt > 0 ? rtt / 1000.0f : 0.0f;
+
+   // Same smoothing as TCP (RFC 6298).
+   if (!peer->has_rtt)
+   {
+      peer->srtt = sample;
+      peer->rttvar = sample / 2.0f;
+   }
+   else
+   {
+      float err = peer->srtt - sample;
+      peer->rttvar = 0.75f * peer->rttvar + 0.25f * (err < 0.0f ? -err : err);
+      peer->srtt = 0.875f * peer->srtt + 0.125f * sample;
+   }
+
+   peer->has_rtt = true;
+   peer->rtt_frame = frame;
+}
+
+static void parse_packet(netplay_t *handle, uint32_t *buffer, unsigned size,
+      const struct sockaddr_storage *addr, socklen_t addr_len)
+{
+   rarch_time_t start = rarch_get_time_usec();
+
+   for (unsigned i = 0; i < size; i++)
       buffer[i] = ntohl(buffer[i]);
 
-   for (unsigned i = 0; i < size && handle->read_frame_count <= handle->frame_count; i++)
+   unsigned sender = buffer[3];
+   struct netplay_peer *peer = NULL;
+   for (unsigned i = 0; i < handle->num_peers; i++)
+   {
+      if (handle->peers[i].player == sender)
+         peer = &handle->peers[i];
+   }
+
+   if (!peer)
+      return;
+
+   // We only find out where clients send from when their input shows up.
+   if (handle->player == 0)
+   {
+      memcpy(&peer->addr, addr, addr_len);
+      peer->addr_len = addr_len;
+      peer->has_addr = true;
+   }
+
+   uint32_t seq = buffer[0];
+   if (!peer->has_echo || (int32_t)(seq - peer->seq_high) > 0)
+   {
+      peer->seq_expected += peer->has_echo ? seq - peer->seq_high : 1;
+      peer->seq_received++;
+      peer->seq_high = seq;
+
+      peer->echo_frame = seq;
+      peer->echo_time = rarch_get_time_usec();
+      peer->has_echo = true;
+   }
+
+   update_rtt(handle, peer, buffer[1], buffer[2]);
+   if (handle->player != 0)
+      peer->relay_ms = buffer[4] / 1000.0f;
+
+   const uint32_t *ack = buffer + PACKET_HEADER_SIZE;
+   for (unsigned p = 0; p < handle->num_players; p++)
+   {
+      if ((int32_t)(ack[p] - peer->ack[p]) > 0 && (int32_t)(ack[p] - handle->input_frame[p]) <= 0)
+         peer->ack[p] = ack[p];
+   }
+
+   unsigned pos = PACKET_HEADER_SIZE + handle->num_players;
+   for (unsigned b = 0; b < buffer[5] && pos + PACKET_BLOCK_HEADER_SIZE <= size; b++)
    {
-      uint32_t frame = buffer[2 * i + 0];
-      uint32_t state = buffer[2 * i + 1];
+      unsigned player = buffer[pos] >> 16;
+      unsigned inputs = buffer[pos] & 0xffff;
+      uint32_t first = buffer[pos + 1];
+      pos += PACKET_BLOCK_HEADER_SIZE;
+      if (PACKET_BLOCK_WORDS(inputs) > size - pos)
+         break;
 
-      if (frame == handle->read_frame_count)
+      // Clients can only send their own input.
+      if (player < handle->num_players && player != handle->player &&
+            (handle->player != 0 || player == sender))
       {
-         handle->buffer[handle->read_ptr].is_simulated = false;
-         handle->buffer[handle->read_ptr].real_input_state = state;
-         handle->read_ptr = NEXT_PTR(handle->read_ptr);
-         handle->read_frame_count++;
-         handle->timeout_cnt = 0;
+         for (unsigned i = 0; i < inputs; i++)
+         {
+            // Skip what we have, and what's so far ahead it could overwrite input we still have to relay.
+            uint32_t frame = first + i;
+            if (frame - handle->input_frame[player] >= INPUT_LOG_SIZE - MAX_PACKET_INPUTS)
+               continue;
+
+            uint32_t word = buffer[pos + i / 2];
+            netplay_set_input(handle, player, frame, i & 1 ? word & 0xffff : word >> 16);
+         }
       }
+
+      pos += PACKET_BLOCK_WORDS(inputs);
    }
+
+   read_early_input(handle);
+   handle->packet_time += rarch_get_time_usec() - start;
 }
 
-static bool receive_data(netplay_t *handle, uint32_t *buffer, size_t size)
+// Returns size of the packet in words, or 0 if it's not a valid one.
+static unsigned receive_data(netplay_t *handle, uint32_t *buffer, size_t size,
+      struct sockaddr_storage *addr, socklen_t *addr_len)
 {
-   socklen_t addrlen = sizeof(handle->their_addr);
-   if (recvfrom(handle->udp_fd, NONCONST_CAST buffer, size, 0, (struct sockaddr*)&handle->their_addr, &addrlen) != (ssize_t)size)
-      return false;
-   handle->has_client_addr = true;
-   return true;
+   *addr_len = sizeof(*addr);
+   ssize_t ret = recvfrom(handle->udp_fd, NONCONST_CAST buffer, size, 0, (struct sockaddr*)addr, addr_len);
+   if (ret < (ssize_t)((PACKET_HEADER_SIZE + handle->num_players) * sizeof(uint32_t)))
+      return 0;
+
+   handle->bytes_received += ret;
+   return ret / sizeof(uint32_t);
+}
+
+// Picks an input delay which covers the trip to the other players, so most of the time their input
+// arrives before we need it, and we don't have to predict and roll back.
+static void netplay_adapt(netplay_t *handle)
+{
+   if ((int32_t)(handle->frame_count - handle->next_adapt_frame) < 0)
+      return;
+   handle->next_adapt_frame = handle->frame_count + ADAPT_INTERVAL;
+
+   // Go by the slowest link.
+   bool has_rtt = false;
+   float latency = 0.0f, rtt = 0.0f, loss = 0.0f;
+   for (unsigned i = 0; i < handle->num_peers; i++)
+   {
+      struct netplay_peer *peer = &handle->peers[i];
+      if (peer->seq_expected)
+      {
+         float peer_loss = 1.0f - (float)peer->seq_received / peer->seq_expected;
+         peer->loss = 0.5f * peer->loss + 0.5f * (peer_loss > 0.0f ? peer_loss : 0.0f);
+      }
+      peer->seq_expected = 0;
+      peer->seq_received = 0;
+
+      if (!peer->has_rtt)
+         continue;
+
+      has_rtt = true;
+      float peer_latency = peer->srtt / 2.0f + peer->rttvar + peer->relay_ms;
+      if (peer_latency > latency)
+         latency = peer_latency;
+      if (peer->srtt > rtt)
+         rtt = peer->srtt;
+      if (peer->loss > loss)
+         loss = peer->loss;
+   }
+
+   if (!has_rtt)
+      return;
+
+   float fps = g_extern.system.av_info.timing.fps;
+   float frame_ms = 1000.0f / (fps > 0.0f ? fps : 60.0f);
+
+   // Input of a lost packet comes with the next one, a frame later.
+   float frames = latency / frame_ms;
+   if (loss > 0.02f)
+      frames += 1.0f;
+
+   // Step by one frame at a time. Don't go down unless clearly too high, to not bounce between two values.
+   unsigned delay = handle->input_delay;
+   if (frames > delay + 0.5f && delay < handle->max_input_delay)
+      delay++;
+   else if (frames < delay - 0.75f && delay > 0)
+      delay--;
+
+   if (delay == handle->input_delay)
+      return;
+
+   handle->input_delay = delay;
+
+   char msg[512];
+   snprintf(msg, sizeof(msg), "Netplay input delay: %u frame(s) (RTT %.0f ms, %.1f%% loss).",
+         delay, rtt, loss * 100.0f);
+   RARCH_LOG("%s\n", msg);
+   msg_queue_push(g_extern.msg_queue, msg, 1, 180);
 }
 
 // Poll network to see if we have anything new. If our network buffer is full, we simply have to block for new input data.
@@ -973,19 +1514,18 @@ static bool netplay_poll(netplay_t *handle)
    if (!get_self_input_state(handle))
       return false;
 
+   // Input which arrived early might be all we need. Input on the first frame is always zero, so that's covered.
+   read_early_input(handle);
+
    // We skip reading the first frame so the host has a chance to grab our host info so we don't block forever :')
    if (handle->frame_count == 0)
    {
-      handle->buffer[0].used_real = true;
-      handle->buffer[0].is_simulated = false;
-      handle->buffer[0].real_input_state = 0;
-      handle->read_ptr = NEXT_PTR(handle->read_ptr);
-      handle->read_frame_count++;
+      simulate_input(handle);
       return true;
    }
 
    // We might have reached the end of the buffer, where we simply have to block.
-   int res = poll_input(handle, handle->other_ptr == handle->self_ptr);
+   int res = poll_input(handle, netplay_buffer_full(handle));
    if (res == -1)
    {
       handle->has_connection = false;
@@ -998,80 +1538,169 @@ static bool netplay_poll(netplay_t *handle)
       uint32_t first_read = handle->read_frame_count;
       do 
       {
-         uint32_t buffer[UDP_FRAME_PACKETS * 2];
-         if (!receive_data(handle, buffer, sizeof(buffer)))
+         uint32_t buffer[MAX_PACKET_SIZE];
+         struct sockaddr_storage addr;
+         socklen_t addr_len;
+         unsigned size = receive_data(handle, buffer, sizeof(buffer), &addr, &addr_len);
+         if (!size)
          {
             warn_hangup();
             handle->has_connection = false;
             return false;
          }
-         parse_packet(handle, buffer, UDP_FRAME_PACKETS);
+
+         uint32_t input_frames = 0;
+         for (unsigned p = 0; p < handle->num_players; p++)
+            input_frames += handle->input_frame[p];
+
+         parse_packet(handle, buffer, size, &addr, addr_len);
+
+         // The other clients might be stalled on this input as well, and we'd only relay it after we stop stalling.
+         if (handle->player == 0 && handle->num_peers > 1 && netplay_buffer_full(handle))
+         {
+            for (unsigned p = 0; p < handle->num_players; p++)
+               input_frames -= handle->input_frame[p];
+            if (input_frames && !send_chunks(handle))
+               return false;
+         }
 
       } while ((handle->read_frame_count <= handle->frame_count) && 
-            poll_input(handle, (handle->other_ptr == handle->self_ptr) && 
+            poll_input(handle, netplay_buffer_full(handle) && 
                (first_read == handle->read_frame_count)) == 1);
    }
    else
    {
       // Cannot allow this. Should not happen though.
-      if (handle->self_ptr == handle->other_ptr)
+      if (netplay_buffer_full(handle))
       {
          warn_hangup();
          return false;
       }
    }
 
-   if (handle->read_ptr != handle->self_ptr)
-      simulate_input(handle);
-   else
-      handle->buffer[PREV_PTR(handle->self_ptr)].used_real = true;
-
+   simulate_input(handle);
+   netplay_adapt(handle);
    return true;
 }
 
-static bool netplay_send_cmd(netplay_t *handle, uint32_t cmd, const void *data, size_t size)
+static bool netplay_send_cmd(netplay_t *handle, struct netplay_peer *peer, uint32_t cmd, const void *data, size_t size)
 {
    cmd = (cmd << 16) | (size & 0xffff);
    cmd = htonl(cmd);
 
-   if (!send_all(handle->fd, &cmd, sizeof(cmd)))
+   if (!send_all(peer->fd, &cmd, sizeof(cmd)))
       return false;
 
-   if (!send_all(handle->fd, data, size))
+   if (!send_all(peer->fd, data, size))
       return false;
 
    return true;
 }
 
-static bool netplay_cmd_ack(netplay_t *handle)
+static bool netplay_cmd_ack(struct netplay_peer *peer)
 {
    uint32_t cmd = htonl(NETPLAY_CMD_ACK);
-   return send_all(handle->fd, &cmd, sizeof(cmd));
+   return send_all(peer->fd, &cmd, sizeof(cmd));
 }
 
-static bool netplay_cmd_nak(netplay_t *handle)
+static bool netplay_cmd_nak(struct netplay_peer *peer)
 {
    uint32_t cmd = htonl(NETPLAY_CMD_NAK);
-   return send_all(handle->fd, &cmd, sizeof(cmd));
+   return send_all(peer->fd, &cmd, sizeof(cmd));
 }
 
-static bool netplay_get_response(netplay_t *handle)
+static bool netplay_get_response(netplay_t *handle, struct netplay_peer *peer)
 {
-   uint32_t response;
-   if (!recv_all(handle->fd, &response, sizeof(response)))
+   for (;;)
+   {
+      uint32_t response;
+      if (!recv_all(peer->fd, &response, sizeof(response)))
+         return false;
+
+      response = ntohl(response);
+      if (response == NETPLAY_CMD_ACK)
+         return true;
+      if (response == NETPLAY_CMD_NAK)
+         return false;
+
+      // The other side sent a command of its own before getting to ours.
+      if (!netplay_handle_cmd(handle, peer, response))
+         return false;
+   }
+}
+
+static void netplay_reset_checksums(netplay_t *handle, struct netplay_peer *peer)
+{
+   // The host's own checksums are still good for the other clients.
+   if (handle->player != 0)
+      memset(handle->self_checksums, 0, sizeof(handle->self_checksums));
+   memset(peer->checksums, 0, sizeof(peer->checksums));
+   peer->desync = false;
+}
+
+// Sends the state of our latest checksummed frame to a client.
+static bool netplay_send_resync(netplay_t *handle, struct netplay_peer *peer)
+{
+   uint32_t header[3] = {
+      htonl(handle->resync_frame),
+      htonl(peer->resync_epoch + 1),
+      htonl(handle->state_size),
+   };
+
+   // The state follows the command, it doesn't fit in the command size.
+   if (!netplay_send_cmd(handle, peer, NETPLAY_CMD_RESYNC, header, sizeof(header)) ||
+         !send_all(peer->fd, handle->resync_state, handle->state_size))
+      return false;
+
+   peer->resync_epoch++;
+   handle->resync_cnt++;
+   netplay_reset_checksums(handle, peer);
+   return true;
+}
+
+// Returns false if we're the host, and failed to send our state.
+static bool netplay_compare_checksums(netplay_t *handle, struct netplay_peer *peer, uint32_t frame)
+{
+   unsigned i = (frame / CHECKSUM_INTERVAL) % CHECKSUM_LOG_SIZE;
+   const struct netplay_checksum *self = &handle->self_checksums[i];
+   const struct netplay_checksum *other = &peer->checksums[i];
+
+   if (!self->valid || !other->valid || self->frame != frame || other->frame != frame ||
+         self->crc == other->crc || peer->desync)
+      return true;
+
+   peer->desync = true;
+   handle->desync_cnt++;
+
+   bool host = handle->player == 0;
+   char msg[512];
+   if (host)
+      snprintf(msg, sizeof(msg), "Netplay desync with \"%s\" at frame %u, resyncing.", peer->nick, (unsigned)frame);
+   else
+      snprintf(msg, sizeof(msg), "Netplay desync at frame %u, waiting for host to resync.", (unsigned)frame);
+   RARCH_WARN("%s\n", msg);
+   msg_queue_push(g_extern.msg_queue, msg, 1, 180);
+
+   if (host && !netplay_send_resync(handle, peer))
+   {
+      RARCH_ERR("Failed to send state to client.\n");
       return false;
+   }
 
-   return ntohl(response) == NETPLAY_CMD_ACK;
+   return true;
 }
 
-static bool netplay_get_cmd(netplay_t *handle)
+static bool netplay_get_cmd(netplay_t *handle, struct netplay_peer *peer)
 {
    uint32_t cmd;
-   if (!recv_all(handle->fd, &cmd, sizeof(cmd)))
+   if (!recv_all(peer->fd, &cmd, sizeof(cmd)))
       return false;
 
-   cmd = ntohl(cmd);
+   return netplay_handle_cmd(handle, peer, ntohl(cmd));
+}
 
+static bool netplay_handle_cmd(netplay_t *handle, struct netplay_peer *peer, uint32_t cmd)
+{
    size_t cmd_size = cmd & 0xffff;
    cmd = cmd >> 16;
 
@@ -1082,21 +1711,28 @@ static bool netplay_get_cmd(netplay_t *handle)
          if (cmd_size != sizeof(uint32_t))
          {
             RARCH_ERR("CMD_FLIP_PLAYERS has unexpected command size.\n");
-            return netplay_cmd_nak(handle);
+            return netplay_cmd_nak(peer);
          }
 
          uint32_t flip_frame;
-         if (!recv_all(handle->fd, &flip_frame, sizeof(flip_frame)))
+         if (!recv_all(peer->fd, &flip_frame, sizeof(flip_frame)))
          {
             RARCH_ERR("Failed to receive CMD_FLIP_PLAYERS argument.\n");
-            return netplay_cmd_nak(handle);
+            return netplay_cmd_nak(peer);
          }
 
          flip_frame = ntohl(flip_frame);
+         if (handle->num_players != 2)
+         {
+            RARCH_ERR("Host asked us to flip players with %u players. Only possible with two ...\n",
+                  handle->num_players);
+            return netplay_cmd_nak(peer);
+         }
+
          if (flip_frame < handle->flip_frame)
          {
             RARCH_ERR("Host asked us to flip players in the past. Not possible ...\n");
-            return netplay_cmd_nak(handle);
+            return netplay_cmd_nak(peer);
          }
 
          handle->flip ^= true;
@@ -1105,12 +1741,82 @@ static bool netplay_get_cmd(netplay_t *handle)
          RARCH_LOG("Netplay players are flipped.\n");
          msg_queue_push(g_extern.msg_queue, "Netplay players are flipped.", 1, 180);
 
-         return netplay_cmd_ack(handle);
+         return netplay_cmd_ack(peer);
+      }
+
+      case NETPLAY_CMD_CHECKSUM:
+      {
+         uint32_t payload[3];
+         if (cmd_size != sizeof(payload))
+         {
+            RARCH_ERR("CMD_CHECKSUM has unexpected command size.\n");
+            return false;
+         }
+
+         if (!recv_all(peer->fd, payload, sizeof(payload)))
+         {
+            RARCH_ERR("Failed to receive CMD_CHECKSUM argument.\n");
+            return false;
+         }
+
+         uint32_t frame = ntohl(payload[0]);
+
+         // Checksums from before a resync would only report the desync again.
+         if (ntohl(payload[2]) != peer->resync_epoch || frame % CHECKSUM_INTERVAL)
+            return true;
+
+         struct netplay_checksum *sum = &peer->checksums[(frame / CHECKSUM_INTERVAL) % CHECKSUM_LOG_SIZE];
+         sum->frame = frame;
+         sum->crc = ntohl(payload[1]);
+         sum->valid = true;
+
+         return netplay_compare_checksums(handle, peer, frame);
+      }
+
+      case NETPLAY_CMD_RESYNC:
+      {
+         uint32_t header[3];
+         if (handle->player == 0)
+         {
+            RARCH_ERR("Client asked us to resync. Only the host can do that ...\n");
+            return false;
+         }
+
+         if (cmd_size != sizeof(header))
+         {
+            RARCH_ERR("CMD_RESYNC has unexpected command size.\n");
+            return false;
+         }
+
+         if (!recv_all(peer->fd, header, sizeof(header)))
+         {
+            RARCH_ERR("Failed to receive CMD_RESYNC argument.\n");
+            return false;
+         }
+
+         if (ntohl(header[2]) != handle->state_size)
+         {
+            RARCH_ERR("Host sent state of unexpected size.\n");
+            return false;
+         }
+
+         if (!recv_all(peer->fd, handle->resync_state, handle->state_size))
+         {
+            RARCH_ERR("Failed to receive state from host.\n");
+            return false;
+         }
+
+         // Loaded in post_frame, once our input is confirmed up to the frame.
+         handle->resync_frame = ntohl(header[0]);
+         peer->resync_epoch = ntohl(header[1]);
+         handle->has_resync = true;
+         netplay_reset_checksums(handle, peer);
+         return true;
       }
 
       default:
          RARCH_ERR("Unknown netplay command received.\n");
-         return netplay_cmd_nak(handle);
+         return netplay_cmd_nak(peer);
    }
 }
 
@@ -1119,6 +1825,7 @@ void netplay_flip_players(netplay_t *handle)
    uint32_t flip_frame = handle->frame_count + 2 * UDP_FRAME_PACKETS;
    uint32_t flip_frame_net = htonl(flip_frame);
    const char *msg = NULL;
+   char error_msg[256];
 
    if (handle->spectate)
    {
@@ -1126,12 +1833,20 @@ void netplay_flip_players(netplay_t *handle)
       goto error;
    }
 
-   if (handle->port == 0)
+   if (handle->player != 0)
    {
       msg = "Cannot flip players if you're not the host.";
       goto error;
    }
 
+   if (handle->num_players != 2)
+   {
+      snprintf(error_msg, sizeof(error_msg),
+            "Cannot flip players with %u players connected, only with two.", handle->num_players);
+      msg = error_msg;
+      goto error;
+   }
+
    // Make sure both clients are definitely synced up.
    if (handle->frame_count < (handle->flip_frame + 2 * UDP_FRAME_PACKETS))
    {
@@ -1139,8 +1854,8 @@ void netplay_flip_players(netplay_t *handle)
       goto error;
    }
 
-   if (netplay_send_cmd(handle, NETPLAY_CMD_FLIP_PLAYERS, &flip_frame_net, sizeof(flip_frame_net))
-         && netplay_get_response(handle))
+   if (netplay_send_cmd(handle, &handle->peers[0], NETPLAY_CMD_FLIP_PLAYERS, &flip_frame_net, sizeof(flip_frame_net))
+         && netplay_get_response(handle, &handle->peers[0]))
    {
       RARCH_LOG("Netplay players are flipped.\n");
       msg_queue_push(g_extern.msg_queue, "Netplay players are flipped.", 1, 180);
@@ -1162,9 +1877,10 @@ error:
    msg_queue_push(g_extern.msg_queue, msg, 1, 180);
 }
 
-static bool netplay_flip_port(netplay_t *handle, bool port)
+// Returns the player controlling port.
+static unsigned netplay_flip_port(netplay_t *handle, unsigned port)
 {
-   if (handle->flip_frame == 0)
+   if (handle->flip_frame == 0 || port > 1)
       return port;
 
    size_t frame = handle->is_replay ? handle->tmp_frame_count : handle->frame_count;
@@ -1172,46 +1888,106 @@ static bool netplay_flip_port(netplay_t *handle, bool port)
    return port ^ handle->flip ^ (frame < handle->flip_frame);
 }
 
-int16_t netplay_input_state(netplay_t *handle, bool port, unsigned device, unsigned index, unsigned id)
+int16_t netplay_input_state(netplay_t *handle, unsigned port, unsigned device, unsigned index, unsigned id)
 {
    uint16_t input_state = 0;
    size_t ptr = handle->is_replay ? handle->tmp_ptr : PREV_PTR(handle->self_ptr);
 
-   port = netplay_flip_port(handle, port);
+   unsigned player = netplay_flip_port(handle, port);
+   if (player >= handle->num_players)
+      return 0;
 
-   if ((port ? 1 : 0) == handle->port)
-   {
-      if (handle->buffer[ptr].is_simulated)
-         input_state = handle->buffer[ptr].simulated_input_state;
-      else
-         input_state = handle->buffer[ptr].real_input_state;
-   }
+   if (handle->is_resync)
+      input_state = handle->input_history[handle->tmp_frame_count % RESYNC_HISTORY][player];
+   else if (handle->buffer[ptr].is_simulated)
+      input_state = handle->buffer[ptr].simulated_input_state[player];
    else
-      input_state = handle->buffer[ptr].self_state;
+      input_state = handle->buffer[ptr].real_input_state[player];
 
    return ((1 << id) & input_state) ? 1 : 0;
 }
 
+void netplay_get_stats(netplay_t *handle, struct netplay_stats *stats)
+{
+   memset(stats, 0, sizeof(*stats));
+   stats->connected = netplay_is_alive(handle);
+   if (handle->spectate)
+      return;
+
+   stats->seconds = (rarch_get_time_usec() - handle->start_time) / 1000000.0f;
+   stats->frames = handle->frame_count;
+   stats->states_saved = handle->serialize_cnt;
+   stats->rollbacks = handle->rollback_cnt;
+   stats->replayed_frames = handle->replay_cnt;
+   stats->rollback_ms = handle->rollback_time / 1000.0f;
+   stats->stalls = handle->stall_cnt;
+   stats->resends = handle->resend_cnt;
+   stats->stall_ms = handle->stall_time / 1000.0f;
+   stats->input_delay = handle->input_delay;
+   for (unsigned i = 0; i < handle->num_peers; i++)
+   {
+      if (handle->peers[i].srtt > stats->rtt_ms)
+         stats->rtt_ms = handle->peers[i].srtt;
+      if (handle->peers[i].loss > stats->loss)
+         stats->loss = handle->peers[i].loss;
+   }
+   stats->inputs_per_packet = handle->packet_cnt ? (float)handle->packet_input_cnt / handle->packet_cnt : 0.0f;
+   stats->players = handle->num_players;
+   stats->bytes_sent = handle->bytes_sent;
+   stats->bytes_received = handle->bytes_received;
+   stats->packet_ms = handle->packet_time / 1000.0f;
+   stats->checksums = handle->checksum_cnt;
+   stats->checksum_ms = handle->checksum_time / 1000.0f;
+   stats->desyncs = handle->desync_cnt;
+   stats->resyncs = handle->resync_cnt;
+
+   float fps = g_extern.system.av_info.timing.fps;
+   float frame_ms = 1000.0f / (fps > 0.0f ? fps : 60.0f);
+   if (handle->frame_count)
+      stats->checksum_load = stats->checksum_ms / (handle->frame_count * frame_ms);
+}
+
 void netplay_free(netplay_t *handle)
 {
-   close(handle->fd);
+   if (handle->fd >= 0)
+      close(handle->fd);
 
    if (handle->spectate)
    {
-      for (unsigned i = 0; i < MAX_SPECTATORS; i++)
-         if (handle->spectate_fds[i] >= 0)
-            close(handle->spectate_fds[i]);
+      if (handle->spectate_server)
+         spectate_server_free(handle->spectate_server);
 
       free(handle->spectate_input);
    }
    else
    {
       close(handle->udp_fd);
+      for (unsigned i = 0; i < handle->num_peers; i++)
+         close(handle->peers[i].fd);
+
+      struct netplay_stats stats;
+      netplay_get_stats(handle, &stats);
+      RARCH_LOG("[Netplay]: %u frames, %u states saved (%.1f per second), %u rollbacks replaying %u frames (%.2f ms per rollback).\n",
+            stats.frames, stats.states_saved, stats.seconds > 0.0f ? stats.states_saved / stats.seconds : 0.0f,
+            stats.rollbacks, stats.replayed_frames,
+            stats.rollbacks ? stats.rollback_ms / stats.rollbacks : 0.0f);
+      RARCH_LOG("[Netplay]: Stalled %u times for %.2f s, resent input %u times.\n",
+            stats.stalls, stats.stall_ms / 1000.0f, stats.resends);
+      RARCH_LOG("[Netplay]: Input delay %u frame(s), RTT %.1f ms, %.1f%% loss, %.1f input frames per packet.\n",
+            stats.input_delay, stats.rtt_ms, stats.loss * 100.0f, stats.inputs_per_packet);
+      RARCH_LOG("[Netplay]: %u players, %.0f bytes sent and %.0f received per frame, %.1f us per frame on packets.\n",
+            stats.players, stats.frames ? (float)stats.bytes_sent / stats.frames : 0.0f,
+            stats.frames ? (float)stats.bytes_received / stats.frames : 0.0f,
+            stats.frames ? stats.packet_ms * 1000.0f / stats.frames : 0.0f);
+      RARCH_LOG("[Netplay]: %u state checksums, %.3f ms each (%.3f%% of frame time), %u desyncs, %u resyncs.\n",
+            stats.checksums, stats.checksums ? stats.checksum_ms / stats.checksums : 0.0f,
+            stats.checksum_load * 100.0f, stats.desyncs, stats.resyncs);
 
       for (unsigned i = 0; i < handle->buffer_size; i++)
          free(handle->buffer[i].state);
 
       free(handle->buffer);
+      free(handle->resync_state);
    }
 
    if (handle->addr)
@@ -1225,12 +2001,41 @@ static bool netplay_should_skip(netplay_t *handle)
    return handle->is_replay && handle->has_connection;
 }
 
+// Saves state before running frame at ptr, if a rollback could ever need it.
+// Frames run on confirmed input are never rolled back to, and otherwise a checkpoint
+// a few frames back will do. Frames to be checksummed always get one.
+static void netplay_checkpoint(netplay_t *handle, size_t ptr, uint32_t frame, bool confirmed)
+{
+   struct delta_frame *delta = &handle->buffer[ptr];
+   delta->has_state = false;
+
+   bool checksum = frame % CHECKSUM_INTERVAL == 0;
+   if (confirmed && !checksum)
+      return;
+
+   size_t prev = ptr;
+   for (unsigned i = 1; i < CHECKPOINT_INTERVAL && i <= frame && !checksum; i++)
+   {
+      prev = PREV_PTR(prev);
+      if (handle->buffer[prev].has_state)
+         return;
+   }
+
+   delta->has_state = pretro_serialize(delta->state, handle->state_size);
+   handle->serialize_cnt++;
+}
+
 static void netplay_pre_frame_net(netplay_t *handle)
 {
-   pretro_serialize(handle->buffer[handle->self_ptr].state, handle->state_size);
+   // Poll first, so we know if input for this frame is confirmed before saving state.
    handle->can_poll = true;
-
    input_poll_net();
+
+   if (handle->has_connection)
+   {
+      netplay_checkpoint(handle, PREV_PTR(handle->self_ptr), handle->frame_count,
+            handle->read_frame_count > handle->frame_count);
+   }
 }
 
 static void netplay_set_spectate_input(netplay_t *handle, int16_t input)
@@ -1257,7 +2062,12 @@ static int16_t netplay_get_spectate_input(netplay_t *handle, bool port, unsigned
 {
    int16_t inp;
    if (recv_all(handle->fd, NONCONST_CAST &inp, sizeof(inp)))
-      return swap_if_big16(inp);
+   {
+      inp = swap_if_big16(inp);
+      if (handle->spectate_server)
+         netplay_set_spectate_input(handle, inp);
+      return inp;
+   }
    else
    {
       RARCH_ERR("Connection with host was cut.\n");
@@ -1276,86 +2086,20 @@ int16_t input_state_spectate_client(unsigned port, unsigned device, unsigned ind
 
 static void netplay_pre_frame_spectate(netplay_t *handle)
 {
-   if (handle->spectate_client)
-      return;
-
-   fd_set fds;
-   FD_ZERO(&fds);
-   FD_SET(handle->fd, &fds);
-
-   struct timeval tmp_tv = {0};
-   if (select(handle->fd + 1, &fds, NULL, NULL, &tmp_tv) <= 0)
-      return;
-
-   if (!FD_ISSET(handle->fd, &fds))
-      return;
-
-   struct sockaddr_storage their_addr;
-   socklen_t addr_size = sizeof(their_addr);
-   int new_fd = accept(handle->fd, (struct sockaddr*)&their_addr, &addr_size);
-   if (new_fd < 0)
-   {
-      RARCH_ERR("Failed to accept incoming spectator.\n");
+   if (!handle->spectate_server || !spectate_server_pre_frame(handle->spectate_server))
       return;
-   }
-
-   int index = -1;
-   for (unsigned i = 0; i < MAX_SPECTATORS; i++)
-   {
-      if (handle->spectate_fds[i] == -1)
-      {
-         index = i;
-         break;
-      }
-   }
-
-   // No vacant client streams :(
-   if (index == -1)
-   {
-      close(new_fd);
-      return;
-   }
-
-   if (!get_nickname(handle, new_fd))
-   {
-      RARCH_ERR("Failed to get nickname from client.\n");
-      close(new_fd);
-      return;
-   }
-
-   if (!send_nickname(handle, new_fd))
-   {
-      RARCH_ERR("Failed to send nickname to client.\n");
-      close(new_fd);
-      return;
-   }
 
+   // New spectators start from the state we're about to run.
    size_t header_size;
    uint32_t *header = bsv_header_generate(&header_size, implementation_magic_value());
    if (!header)
    {
       RARCH_ERR("Failed to generate BSV header.\n");
-      close(new_fd);
-      return;
-   }
-
-   int bufsize = header_size;
-   setsockopt(new_fd, SOL_SOCKET, SO_SNDBUF, CONST_CAST &bufsize, sizeof(int));
-
-   if (!send_all(new_fd, header, header_size))
-   {
-      RARCH_ERR("Failed to send header to client.\n");
-      close(new_fd);
-      free(header);
       return;
    }
 
+   spectate_server_start(handle->spectate_server, header, header_size);
    free(header);
-   handle->spectate_fds[index] = new_fd;
-
-#ifndef HAVE_SOCKET_LEGACY
-   log_connection(&their_addr, index, handle->other_nick);
-#endif
 }
 
 void netplay_pre_frame(netplay_t *handle)
@@ -1366,10 +2110,41 @@ void netplay_pre_frame(netplay_t *handle)
       netplay_pre_frame_net(handle);
 }
 
-static void netplay_post_frame_net(netplay_t *handle)
+// Loads the state at ptr, and runs the core up to the frame we're at.
+static void netplay_replay(netplay_t *handle, size_t ptr, uint32_t frame)
 {
-   handle->frame_count++;
+   handle->is_replay = true;
+   handle->tmp_ptr = ptr;
+   handle->tmp_frame_count = frame;
+
+   pretro_unserialize(handle->buffer[handle->tmp_ptr].state, handle->state_size);
+   bool first = true;
+   while (first || (handle->tmp_ptr != handle->self_ptr))
+   {
+      if (!first)
+      {
+         netplay_checkpoint(handle, handle->tmp_ptr, handle->tmp_frame_count,
+               handle->tmp_frame_count < handle->read_frame_count);
+      }
 
+#if defined(HAVE_THREADS) && !defined(RARCH_CONSOLE)
+      lock_autosave();
+#endif
+      pretro_run();
+#if defined(HAVE_THREADS) && !defined(RARCH_CONSOLE)
+      unlock_autosave();
+#endif
+      handle->tmp_ptr = NEXT_PTR(handle->tmp_ptr);
+      handle->tmp_frame_count++;
+      handle->replay_cnt++;
+      first = false;
+   }
+
+   handle->is_replay = false;
+}
+
+static void netplay_rollback(netplay_t *handle)
+{
    // Nothing to do...
    if (handle->other_frame_count == handle->read_frame_count)
       return;
@@ -1378,7 +2153,8 @@ static void netplay_post_frame_net(netplay_t *handle)
    while (handle->other_frame_count < handle->read_frame_count)
    {
       const struct delta_frame *ptr = &handle->buffer[handle->other_ptr];
-      if ((ptr->simulated_input_state != ptr->real_input_state) && !ptr->used_real)
+      if (memcmp(ptr->simulated_input_state, ptr->real_input_state,
+               handle->num_players * sizeof(uint16_t)))
          break;
       handle->other_ptr = NEXT_PTR(handle->other_ptr);
       handle->other_frame_count++;
@@ -1386,59 +2162,170 @@ static void netplay_post_frame_net(netplay_t *handle)
 
    if (handle->other_frame_count < handle->read_frame_count)
    {
-      // Replay frames
-      handle->is_replay = true;
-      handle->tmp_ptr = handle->other_ptr;
-      handle->tmp_frame_count = handle->other_frame_count;
+      rarch_time_t start = rarch_get_time_usec();
 
-      pretro_unserialize(handle->buffer[handle->other_ptr].state, handle->state_size);
-      bool first = true;
-      while (first || (handle->tmp_ptr != handle->self_ptr))
+      // Frames still waiting for input are replayed with a fresh prediction,
+      // so the next input to arrive does not trigger another rollback just because the old one was stale.
+      uint32_t predict_frame = handle->read_frame_count;
+      for (size_t ptr = handle->read_ptr; ptr != handle->self_ptr; ptr = NEXT_PTR(ptr), predict_frame++)
       {
-         pretro_serialize(handle->buffer[handle->tmp_ptr].state, handle->state_size);
-#if defined(HAVE_THREADS) && !defined(RARCH_CONSOLE)
-         lock_autosave();
-#endif
-         pretro_run();
-#if defined(HAVE_THREADS) && !defined(RARCH_CONSOLE)
-         unlock_autosave();
-#endif
-         handle->tmp_ptr = NEXT_PTR(handle->tmp_ptr);
-         handle->tmp_frame_count++;
-         first = false;
+         for (unsigned p = 0; p < handle->num_players; p++)
+         {
+            if (p != handle->player)
+               handle->buffer[ptr].simulated_input_state[p] = netplay_predict_input(handle, p, predict_frame);
+         }
       }
 
+      // Replay frames, from the closest checkpoint.
+      size_t ptr = handle->other_ptr;
+      uint32_t frame = handle->other_frame_count;
+      for (unsigned i = 1; i < CHECKPOINT_INTERVAL && !handle->buffer[ptr].has_state; i++)
+      {
+         ptr = PREV_PTR(ptr);
+         frame--;
+      }
+
+      netplay_replay(handle, ptr, frame);
+
       handle->other_ptr = handle->read_ptr;
       handle->other_frame_count = handle->read_frame_count;
-      handle->is_replay = false;
+
+      handle->rollback_cnt++;
+      handle->rollback_time += rarch_get_time_usec() - start;
    }
 }
 
-static void netplay_post_frame_spectate(netplay_t *handle)
+// Client: loads the state the host sent, and catches up by replaying confirmed input from there.
+static void netplay_load_resync(netplay_t *handle)
 {
-   if (handle->spectate_client)
+   uint32_t frame = handle->resync_frame;
+
+   // Until input before the host's frame is confirmed, a rollback could take us back past it.
+   if ((int32_t)(handle->other_frame_count - frame) < 0)
       return;
 
-   for (unsigned i = 0; i < MAX_SPECTATORS; i++)
+   handle->has_resync = false;
+   if (handle->other_frame_count - frame > RESYNC_HISTORY)
+   {
+      // The host will notice we're still off with the next checksum, and send a newer state.
+      RARCH_ERR("State from host is too old to catch up from (frame %u).\n", (unsigned)frame);
+      return;
+   }
+
+   rarch_time_t start = rarch_get_time_usec();
+
+   pretro_unserialize(handle->resync_state, handle->state_size);
+   handle->is_replay = true;
+   handle->is_resync = true;
+   for (handle->tmp_frame_count = frame; handle->tmp_frame_count != handle->other_frame_count;
+         handle->tmp_frame_count++)
+   {
+#if defined(HAVE_THREADS) && !defined(RARCH_CONSOLE)
+      lock_autosave();
+#endif
+      pretro_run();
+#if defined(HAVE_THREADS) && !defined(RARCH_CONSOLE)
+      unlock_autosave();
+#endif
+      handle->replay_cnt++;
+   }
+   handle->is_resync = false;
+   handle->is_replay = false;
+
+   // Every state we saved so far descends from the desynced one.
+   for (unsigned i = 0; i < handle->buffer_size; i++)
+      handle->buffer[i].has_state = false;
+
+   struct delta_frame *delta = &handle->buffer[handle->other_ptr];
+   delta->has_state = pretro_serialize(delta->state, handle->state_size);
+   handle->serialize_cnt++;
+
+   // Frames we ran on predicted input are replayed from there like on a rollback.
+   if (handle->other_ptr != handle->self_ptr && delta->has_state)
+      netplay_replay(handle, handle->other_ptr, handle->other_frame_count);
+
+   char msg[512];
+   snprintf(msg, sizeof(msg), "Netplay resynced with host from frame %u.", (unsigned)frame);
+   RARCH_LOG("%s (%.2f ms)\n", msg, (rarch_get_time_usec() - start) / 1000.0f);
+   msg_queue_push(g_extern.msg_queue, msg, 1, 180);
+   handle->resync_cnt++;
+}
+
+// Checksums the state of every CHECKSUM_INTERVAL'th frame once it's confirmed, and sends it to the other player.
+static bool netplay_checksum(netplay_t *handle)
+{
+   // Our states are known bad until the host's is loaded.
+   if (handle->has_resync)
+      return true;
+
+   while ((int32_t)(handle->other_frame_count - handle->checksum_frame) >= 0 &&
+         handle->checksum_frame != handle->frame_count)
    {
-      if (handle->spectate_fds[i] == -1)
+      uint32_t frame = handle->checksum_frame;
+      handle->checksum_frame += CHECKSUM_INTERVAL;
+
+      uint32_t age = handle->frame_count - frame;
+      size_t ptr = (handle->self_ptr + handle->buffer_size - age % handle->buffer_size) % handle->buffer_size;
+      if (age >= handle->buffer_size || !handle->buffer[ptr].has_state)
          continue;
 
-      if (!send_all(handle->spectate_fds[i],
-               handle->spectate_input, handle->spectate_input_ptr * sizeof(int16_t)))
+      rarch_time_t start = rarch_get_time_usec();
+
+      struct netplay_checksum *sum = &handle->self_checksums[(frame / CHECKSUM_INTERVAL) % CHECKSUM_LOG_SIZE];
+      sum->frame = frame;
+      sum->crc = crc32_calculate((const uint8_t*)handle->buffer[ptr].state, handle->state_size);
+      sum->valid = true;
+
+      // The host holds on to the state, in case a client turns out to have desynced.
+      if (handle->player == 0)
       {
-         RARCH_LOG("Client (#%u) disconnected ...\n", i);
+         memcpy(handle->resync_state, handle->buffer[ptr].state, handle->state_size);
+         handle->resync_frame = frame;
+      }
 
-         char msg[512];
-         snprintf(msg, sizeof(msg), "Client (#%u) disconnected.", i);
-         msg_queue_push(g_extern.msg_queue, msg, 1, 180);
+      handle->checksum_cnt++;
+      handle->checksum_time += rarch_get_time_usec() - start;
 
-         close(handle->spectate_fds[i]);
-         handle->spectate_fds[i] = -1;
-         break;
+      for (unsigned i = 0; i < handle->num_peers; i++)
+      {
+         struct netplay_peer *peer = &handle->peers[i];
+         uint32_t payload[3] = { htonl(frame), htonl(sum->crc), htonl(peer->resync_epoch) };
+         if (!netplay_send_cmd(handle, peer, NETPLAY_CMD_CHECKSUM, payload, sizeof(payload)))
+            return false;
+
+         if (!netplay_compare_checksums(handle, peer, frame))
+            return false;
       }
    }
 
+   return true;
+}
+
+static void netplay_post_frame_net(netplay_t *handle)
+{
+   handle->frame_count++;
+
+   netplay_rollback(handle);
+
+   if (!handle->has_connection)
+      return;
+
+   if (handle->has_resync)
+      netplay_load_resync(handle);
+
+   if (!netplay_checksum(handle))
+   {
+      warn_hangup();
+      handle->has_connection = false;
+   }
+}
+
+static void netplay_post_frame_spectate(netplay_t *handle)
+{
+   if (handle->spectate_server)
+      spectate_server_post_frame(handle->spectate_server,
+            handle->spectate_input, handle->spectate_input_ptr * sizeof(int16_t));
+
    handle->spectate_input_ptr = 0;
 }
 
@@ -44,12 +44,45 @@ struct retro_callbacks
 bool netplay_init_network(void);
 
 // Creates a new netplay handle. A NULL host means we're hosting (player 1). :)
+// The host waits for players - 1 clients to connect before starting, and relays input between them.
+// Clients are told which player they are by the host, players is ignored.
+// A spectating client with a non-zero relay_port serves the stream it receives to its own spectators.
 netplay_t *netplay_new(const char *server,
-      uint16_t port, unsigned frames,
+      uint16_t port, unsigned frames, unsigned players,
       const struct retro_callbacks *cb, bool spectate,
-      const char *nick);
+      uint16_t relay_port, const char *nick);
 void netplay_free(netplay_t *handle);
 
+struct netplay_stats
+{
+   bool connected;
+   float seconds; // Since the connection was established.
+   unsigned frames;
+   unsigned states_saved;
+   unsigned rollbacks;
+   unsigned replayed_frames; // Frames run again during rollbacks.
+   float rollback_ms;
+   unsigned stalls; // Times we had to block waiting for the other player.
+   unsigned resends; // Input packets resent while stalling.
+   float stall_ms;
+   unsigned input_delay; // Frames, currently.
+   float rtt_ms;
+   float loss; // Fraction of packets from the other player which were lost.
+   float inputs_per_packet; // Frames of input sent per packet, on average.
+   unsigned players;
+   unsigned long bytes_sent; // UDP payload.
+   unsigned long bytes_received;
+   float packet_ms; // Time spent building and parsing packets.
+   unsigned checksums; // States checksummed to look for desyncs.
+   float checksum_ms; // Time spent checksumming.
+   float checksum_load; // Checksumming time as a fraction of frame time.
+   unsigned desyncs;
+   unsigned resyncs; // States sent to the client (host), or loaded from the host (client).
+};
+
+// Counters since the session started. Only meaningful for regular (non-spectate) netplay.
+void netplay_get_stats(netplay_t *handle, struct netplay_stats *stats);
+
 // On regular netplay, flip who controls player 1 and 2.
 void netplay_flip_players(netplay_t *handle);
 
@@ -0,0 +1,813 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// select() is only used where poll() is missing. Make room for more than a handful of spectators there.
+#if defined(_WIN32) && !defined(FD_SETSIZE)
+#define FD_SETSIZE 1024
+#endif
+
+#include "netplay_compat.h"
+#include "netplay_spectate.h"
+#include "general.h"
+#include "message.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_THREADS
+#include "thread.h"
+#endif
+
+#if defined(__linux__)
+#define SPECTATE_EPOLL
+#include <sys/epoll.h>
+#elif !defined(_WIN32) && !defined(_XBOX) && !defined(__CELLOS_LV2__) && !defined(GEKKO)
+#define SPECTATE_POLL
+#include <poll.h>
+#else
+#define SPECTATE_SELECT
+#endif
+
+// The network thread sleeps until it is woken up through a pipe.
+// Where pipes can't be waited on together with sockets, it polls instead.
+#if defined(SPECTATE_EPOLL) || defined(SPECTATE_POLL)
+#define SPECTATE_WAKE_PIPE
+#endif
+
+// Input backlog shared by all spectators.
+#define SPECTATE_LOG_SIZE (256 * 1024)
+// Spectators lagging further behind than this are disconnected.
+// Input for a frame is tiny, so this is many seconds worth.
+#define SPECTATE_MAX_LAG (SPECTATE_LOG_SIZE / 2)
+#define SPECTATE_WAIT_MS 4
+#define SPECTATE_MAX_EVENTS 64
+#define SPECTATE_NICK_MAX 32
+
+#ifdef SPECTATE_SELECT
+#ifndef POLLIN
+#define POLLIN 0x1
+#define POLLOUT 0x4
+#define POLLERR 0x8
+#define POLLHUP 0x10
+#endif
+
+struct spectate_pollfd
+{
+   int fd;
+   short events;
+   short revents;
+};
+#else
+#define spectate_pollfd pollfd
+#endif
+
+enum spectate_state
+{
+   SPECTATE_HANDSHAKE = 0, // Waiting for nickname.
+   SPECTATE_WAITING, // Waiting for the main thread to hand over a header.
+   SPECTATE_STREAMING
+};
+
+// BSV header shared by all spectators who joined on the same frame.
+struct spectate_blob
+{
+   unsigned refs;
+   size_t size;
+   // Data follows.
+};
+
+struct spectate_client
+{
+   int fd;
+   struct sockaddr_storage addr;
+   enum spectate_state state;
+   bool readable;
+   bool writable;
+   bool dead;
+
+   uint8_t in_buf[1 + SPECTATE_NICK_MAX];
+   size_t in_len;
+
+   uint8_t out_buf[1 + SPECTATE_NICK_MAX];
+   size_t out_len;
+   size_t out_pos;
+
+   struct spectate_blob *header;
+   size_t header_pos;
+   uint64_t log_pos;
+};
+
+struct spectate_server
+{
+   int listen_fd;
+   bool listen_ready;
+   char nick[SPECTATE_NICK_MAX];
+
+   // Only ever modified by the network thread, with lock held.
+   // The main thread only touches clients which are SPECTATE_WAITING.
+   struct spectate_client **clients;
+   size_t clients_cnt;
+   size_t clients_cap;
+
+   unsigned waiting;
+   unsigned dropped;
+
+   uint8_t *log;
+   uint64_t log_end;
+
+#ifdef SPECTATE_WAKE_PIPE
+   int wake_fds[2];
+#endif
+
+#ifdef SPECTATE_EPOLL
+   int epoll_fd;
+#else
+   struct spectate_pollfd *pollfds;
+   size_t pollfds_cap;
+#endif
+
+#ifdef HAVE_THREADS
+   sthread_t *thread;
+   slock_t *lock;
+   bool quit;
+#endif
+};
+
+static inline void spectate_lock(spectate_server_t *server)
+{
+#ifdef HAVE_THREADS
+   slock_lock(server->lock);
+#else
+   (void)server;
+#endif
+}
+
+static inline void spectate_unlock(spectate_server_t *server)
+{
+#ifdef HAVE_THREADS
+   slock_unlock(server->lock);
+#else
+   (void)server;
+#endif
+}
+
+static bool spectate_socket_nonblock(int fd)
+{
+#if defined(_WIN32) || defined(_XBOX)
+   u_long mode = 1;
+   return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#elif defined(__CELLOS_LV2__)
+   int i = 1;
+   return setsockopt(fd, SOL_SOCKET, SO_NBIO, &i, sizeof(i)) == 0;
+#else
+   return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0;
+#endif
+}
+
+static bool spectate_would_block(void)
+{
+#if defined(_WIN32) || defined(_XBOX)
+   return WSAGetLastError() == WSAEWOULDBLOCK;
+#elif defined(__CELLOS_LV2__) && !defined(__PSL1GHT__)
+   return sys_net_errno == SYS_NET_EWOULDBLOCK || sys_net_errno == SYS_NET_EAGAIN;
+#else
+   return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+static void spectate_wake(spectate_server_t *server)
+{
+#if defined(HAVE_THREADS) && defined(SPECTATE_WAKE_PIPE)
+   // If the pipe is full, the thread has plenty of wakeups pending already.
+   char c = 0;
+   if (write(server->wake_fds[1], &c, 1) < 0)
+      return;
+#else
+   (void)server;
+#endif
+}
+
+static void spectate_blob_release(struct spectate_blob *blob)
+{
+   if (blob && --blob->refs == 0)
+      free(blob);
+}
+
+#ifdef SPECTATE_SELECT
+static int spectate_poll(struct spectate_pollfd *fds, size_t num, int timeout_ms)
+{
+   fd_set read_fds, write_fds;
+   FD_ZERO(&read_fds);
+   FD_ZERO(&write_fds);
+
+   int max_fd = -1;
+   for (size_t i = 0; i < num; i++)
+   {
+      if (fds[i].events & POLLIN)
+         FD_SET(fds[i].fd, &read_fds);
+      if (fds[i].events & POLLOUT)
+         FD_SET(fds[i].fd, &write_fds);
+      if (fds[i].fd > max_fd)
+         max_fd = fds[i].fd;
+   }
+
+   struct timeval tv = {0};
+   tv.tv_sec  = timeout_ms / 1000;
+   tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+   int ret = select(max_fd + 1, &read_fds, &write_fds, NULL, timeout_ms < 0 ? NULL : &tv);
+   if (ret <= 0)
+      return ret;
+
+   for (size_t i = 0; i < num; i++)
+   {
+      fds[i].revents = 0;
+      if (FD_ISSET(fds[i].fd, &read_fds))
+         fds[i].revents |= POLLIN;
+      if (FD_ISSET(fds[i].fd, &write_fds))
+         fds[i].revents |= POLLOUT;
+   }
+
+   return ret;
+}
+#elif defined(SPECTATE_POLL)
+#define spectate_poll(fds, num, timeout_ms) poll(fds, num, timeout_ms)
+#endif
+
+// Fills in readiness of listening socket and clients.
+static void spectate_wait(spectate_server_t *server, int timeout_ms)
+{
+#ifdef SPECTATE_EPOLL
+   struct epoll_event events[SPECTATE_MAX_EVENTS];
+   int num = epoll_wait(server->epoll_fd, events, SPECTATE_MAX_EVENTS, timeout_ms);
+
+   for (int i = 0; i < num; i++)
+   {
+      void *ptr = events[i].data.ptr;
+      uint32_t mask = events[i].events;
+
+      if (ptr == &server->listen_fd)
+         server->listen_ready = true;
+      else if (ptr == &server->wake_fds[0])
+      {
+         char buf[64];
+         while (read(server->wake_fds[0], buf, sizeof(buf)) > 0);
+      }
+      else
+      {
+         struct spectate_client *client = (struct spectate_client*)ptr;
+         if (mask & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            client->readable = true;
+         if (mask & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+            client->writable = true;
+      }
+   }
+#else
+   size_t num = server->clients_cnt + 2;
+   if (num > server->pollfds_cap)
+   {
+      struct spectate_pollfd *new_fds = (struct spectate_pollfd*)realloc(server->pollfds,
+            num * 2 * sizeof(*new_fds));
+      if (!new_fds)
+         return;
+
+      server->pollfds     = new_fds;
+      server->pollfds_cap = num * 2;
+   }
+
+   struct spectate_pollfd *fds = server->pollfds;
+   size_t cnt = 0;
+
+   fds[cnt].fd     = server->listen_fd;
+   fds[cnt].events = POLLIN;
+   cnt++;
+
+#ifdef SPECTATE_WAKE_PIPE
+   size_t wake_index = cnt;
+   fds[cnt].fd     = server->wake_fds[0];
+   fds[cnt].events = POLLIN;
+   cnt++;
+#endif
+
+   size_t first_client = cnt;
+   for (size_t i = 0; i < server->clients_cnt; i++, cnt++)
+   {
+      const struct spectate_client *client = server->clients[i];
+      fds[cnt].fd     = client->fd;
+      fds[cnt].events = POLLIN | (client->writable ? 0 : POLLOUT);
+   }
+
+   for (size_t i = 0; i < cnt; i++)
+      fds[i].revents = 0;
+
+   if (spectate_poll(fds, cnt, timeout_ms) <= 0)
+      return;
+
+   if (fds[0].revents & POLLIN)
+      server->listen_ready = true;
+
+#ifdef SPECTATE_WAKE_PIPE
+   if (fds[wake_index].revents & POLLIN)
+   {
+      char buf[64];
+      while (read(server->wake_fds[0], buf, sizeof(buf)) > 0);
+   }
+#endif
+
+   for (size_t i = 0; i < server->clients_cnt; i++)
+   {
+      struct spectate_client *client = server->clients[i];
+      short mask = fds[first_client + i].revents;
+      if (mask & (POLLIN | POLLHUP | POLLERR))
+         client->readable = true;
+      if (mask & (POLLOUT | POLLHUP | POLLERR))
+         client->writable = true;
+   }
+#endif
+}
+
+static void spectate_accept(spectate_server_t *server)
+{
+   server->listen_ready = false;
+
+   for (;;)
+   {
+      struct sockaddr_storage addr;
+      socklen_t addr_size = sizeof(addr);
+      int fd = accept(server->listen_fd, (struct sockaddr*)&addr, &addr_size);
+      if (fd < 0)
+      {
+         if (!spectate_would_block())
+            RARCH_ERR("Failed to accept incoming spectator.\n");
+         return;
+      }
+
+      struct spectate_client *client = (struct spectate_client*)calloc(1, sizeof(*client));
+      if (!client || !spectate_socket_nonblock(fd))
+      {
+         free(client);
+         close(fd);
+         continue;
+      }
+
+      client->fd       = fd;
+      client->addr     = addr;
+      client->readable = true;
+      client->writable = true;
+
+#ifdef SPECTATE_EPOLL
+      struct epoll_event ev = {0};
+      ev.events   = EPOLLIN | EPOLLOUT | EPOLLET;
+      ev.data.ptr = client;
+      if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+      {
+         free(client);
+         close(fd);
+         continue;
+      }
+#endif
+
+      spectate_lock(server);
+      if (server->clients_cnt >= server->clients_cap)
+      {
+         size_t new_cap = server->clients_cap ? server->clients_cap * 2 : 16;
+         struct spectate_client **new_clients = (struct spectate_client**)realloc(server->clients,
+               new_cap * sizeof(*new_clients));
+         if (new_clients)
+         {
+            server->clients     = new_clients;
+            server->clients_cap = new_cap;
+         }
+      }
+
+      bool added = server->clients_cnt < server->clients_cap;
+      if (added)
+         server->clients[server->clients_cnt++] = client;
+      spectate_unlock(server);
+
+      if (!added)
+      {
+         close(fd);
+         free(client);
+      }
+   }
+}
+
+// Nickname is a size byte, followed by the nick. Spectators are not supposed to send anything else.
+static bool spectate_handshake_done(const struct spectate_client *client)
+{
+   return client->in_len && client->in_len == 1 + (size_t)client->in_buf[0];
+}
+
+static void spectate_read(spectate_server_t *server, struct spectate_client *client)
+{
+   while (client->readable && !client->dead)
+   {
+      uint8_t discard[256];
+      uint8_t *buf = discard;
+      size_t size = sizeof(discard);
+      bool handshake = !spectate_handshake_done(client);
+
+      if (handshake)
+      {
+         buf  = client->in_buf + client->in_len;
+         size = client->in_len ? 1 + client->in_buf[0] - client->in_len : 1;
+      }
+
+      ssize_t ret = recv(client->fd, NONCONST_CAST buf, size, 0);
+      if (ret == 0 || (ret < 0 && !spectate_would_block()))
+         client->dead = true;
+      else if (ret < 0)
+         client->readable = false;
+      else if (handshake)
+      {
+         client->in_len += ret;
+         if (client->in_buf[0] >= SPECTATE_NICK_MAX)
+         {
+            RARCH_ERR("Invalid nick size from spectator.\n");
+            client->dead = true;
+         }
+         else if (spectate_handshake_done(client))
+         {
+            size_t nick_size = strlen(server->nick);
+            client->out_buf[0] = nick_size;
+            memcpy(client->out_buf + 1, server->nick, nick_size);
+            client->out_len = nick_size + 1;
+
+            spectate_lock(server);
+            client->state = SPECTATE_WAITING;
+            server->waiting++;
+            spectate_unlock(server);
+         }
+      }
+   }
+}
+
+// Returns bytes sent. Flags client as blocked or dead if nothing could be sent.
+static size_t spectate_send(struct spectate_client *client, const void *data, size_t size)
+{
+   ssize_t ret = send(client->fd, CONST_CAST data, size, 0);
+   if (ret > 0)
+      return ret;
+
+   if (ret < 0 && spectate_would_block())
+      client->writable = false;
+   else
+      client->dead = true;
+   return 0;
+}
+
+static void spectate_flush(spectate_server_t *server, struct spectate_client *client)
+{
+   while (client->out_pos < client->out_len && client->writable && !client->dead)
+      client->out_pos += spectate_send(client, client->out_buf + client->out_pos, client->out_len - client->out_pos);
+
+   spectate_lock(server);
+   bool streaming = client->state == SPECTATE_STREAMING;
+   uint64_t log_end = server->log_end;
+   spectate_unlock(server);
+
+   // From here on, the client is owned by this thread.
+   if (!streaming)
+      return;
+
+   // Checked even if the client can't be written to, so stuck spectators are dropped too.
+   if (log_end - client->log_pos > SPECTATE_MAX_LAG)
+   {
+      RARCH_WARN("Spectator is too far behind, disconnecting.\n");
+      client->dead = true;
+      return;
+   }
+
+   if (client->out_pos < client->out_len || !client->writable || client->dead)
+      return;
+
+   struct spectate_blob *header = client->header;
+   if (header)
+   {
+      const uint8_t *data = (const uint8_t*)(header + 1);
+      while (client->header_pos < header->size && client->writable && !client->dead)
+         client->header_pos += spectate_send(client, data + client->header_pos, header->size - client->header_pos);
+
+      if (client->header_pos < header->size)
+         return;
+
+      spectate_lock(server);
+      spectate_blob_release(header);
+      spectate_unlock(server);
+      client->header = NULL;
+   }
+
+   uint64_t start_pos = client->log_pos;
+   while (client->log_pos < log_end && client->writable && !client->dead)
+   {
+      size_t offset = client->log_pos % SPECTATE_LOG_SIZE;
+      size_t size = log_end - client->log_pos;
+      if (size > SPECTATE_LOG_SIZE - offset)
+         size = SPECTATE_LOG_SIZE - offset;
+
+      client->log_pos += spectate_send(client, server->log + offset, size);
+   }
+
+   // The backlog is written to without waiting for us. Make sure what we sent wasn't overwritten meanwhile.
+   spectate_lock(server);
+   if (server->log_end - start_pos > SPECTATE_LOG_SIZE)
+      client->dead = true;
+   spectate_unlock(server);
+}
+
+static void spectate_reap(spectate_server_t *server)
+{
+   for (size_t i = 0; i < server->clients_cnt; )
+   {
+      struct spectate_client *client = server->clients[i];
+      if (!client->dead)
+      {
+         i++;
+         continue;
+      }
+
+      spectate_lock(server);
+      if (client->state == SPECTATE_WAITING)
+         server->waiting--;
+      else if (client->state == SPECTATE_STREAMING)
+         server->dropped++;
+      spectate_blob_release(client->header);
+      server->clients[i] = server->clients[--server->clients_cnt];
+      spectate_unlock(server);
+
+      close(client->fd);
+      free(client);
+   }
+}
+
+static void spectate_service(spectate_server_t *server, int timeout_ms)
+{
+   spectate_wait(server, timeout_ms);
+
+   if (server->listen_ready)
+      spectate_accept(server);
+
+   for (size_t i = 0; i < server->clients_cnt; i++)
+   {
+      struct spectate_client *client = server->clients[i];
+      if (client->readable)
+         spectate_read(server, client);
+      if (!client->dead)
+         spectate_flush(server, client);
+   }
+
+   spectate_reap(server);
+}
+
+#ifdef HAVE_THREADS
+static void spectate_thread(void *data)
+{
+   spectate_server_t *server = (spectate_server_t*)data;
+
+   for (;;)
+   {
+      slock_lock(server->lock);
+      bool quit = server->quit;
+      slock_unlock(server->lock);
+
+      if (quit)
+         break;
+
+#ifdef SPECTATE_WAKE_PIPE
+      spectate_service(server, -1);
+#else
+      spectate_service(server, SPECTATE_WAIT_MS);
+#endif
+   }
+}
+#endif
+
+spectate_server_t *spectate_server_new(int listen_fd, const char *nick)
+{
+   spectate_server_t *server = (spectate_server_t*)calloc(1, sizeof(*server));
+   if (!server)
+   {
+      close(listen_fd);
+      return NULL;
+   }
+
+   server->listen_fd = listen_fd;
+   strlcpy(server->nick, nick, sizeof(server->nick));
+
+#ifdef SPECTATE_WAKE_PIPE
+   server->wake_fds[0] = server->wake_fds[1] = -1;
+#endif
+#ifdef SPECTATE_EPOLL
+   server->epoll_fd = -1;
+#endif
+
+   server->log = (uint8_t*)malloc(SPECTATE_LOG_SIZE);
+   if (!server->log || !spectate_socket_nonblock(listen_fd))
+      goto error;
+
+#ifdef SPECTATE_WAKE_PIPE
+   if (pipe(server->wake_fds) < 0)
+      goto error;
+   spectate_socket_nonblock(server->wake_fds[0]);
+   spectate_socket_nonblock(server->wake_fds[1]);
+#endif
+
+#ifdef SPECTATE_EPOLL
+   server->epoll_fd = epoll_create(SPECTATE_MAX_EVENTS);
+   if (server->epoll_fd < 0)
+      goto error;
+
+   {
+      struct epoll_event ev = {0};
+      ev.events   = EPOLLIN;
+      ev.data.ptr = &server->listen_fd;
+      if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &ev) < 0)
+         goto error;
+
+      ev.data.ptr = &server->wake_fds[0];
+      if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fds[0], &ev) < 0)
+         goto error;
+   }
+#endif
+
+#ifdef HAVE_THREADS
+   server->lock = slock_new();
+   if (!server->lock)
+      goto error;
+
+   server->thread = sthread_create(spectate_thread, server);
+   if (!server->thread)
+      goto error;
+#endif
+
+   return server;
+
+error:
+   RARCH_ERR("Failed to start serving spectators.\n");
+   spectate_server_free(server);
+   return NULL;
+}
+
+void spectate_server_free(spectate_server_t *server)
+{
+   if (!server)
+      return;
+
+#ifdef HAVE_THREADS
+   if (server->thread)
+   {
+      slock_lock(server->lock);
+      server->quit = true;
+      slock_unlock(server->lock);
+
+      spectate_wake(server);
+      sthread_join(server->thread);
+   }
+
+   if (server->lock)
+      slock_free(server->lock);
+#endif
+
+   for (size_t i = 0; i < server->clients_cnt; i++)
+   {
+      spectate_blob_release(server->clients[i]->header);
+      close(server->clients[i]->fd);
+      free(server->clients[i]);
+   }
+   free(server->clients);
+
+   close(server->listen_fd);
+
+#ifdef SPECTATE_WAKE_PIPE
+   if (server->wake_fds[0] >= 0)
+      close(server->wake_fds[0]);
+   if (server->wake_fds[1] >= 0)
+      close(server->wake_fds[1]);
+#endif
+
+#ifdef SPECTATE_EPOLL
+   if (server->epoll_fd >= 0)
+      close(server->epoll_fd);
+#else
+   free(server->pollfds);
+#endif
+
+   free(server->log);
+   free(server);
+}
+
+bool spectate_server_pre_frame(spectate_server_t *server)
+{
+   spectate_lock(server);
+   bool waiting = server->waiting > 0;
+   unsigned dropped = server->dropped;
+   server->dropped = 0;
+   spectate_unlock(server);
+
+   if (dropped)
+   {
+      char msg[512];
+      snprintf(msg, sizeof(msg), "%u spectator(s) disconnected.", dropped);
+      RARCH_LOG("%s\n", msg);
+      msg_queue_push(g_extern.msg_queue, msg, 1, 180);
+   }
+
+   return waiting;
+}
+
+static void spectate_log_connection(const struct spectate_client *client, size_t streaming)
+{
+   char nick[SPECTATE_NICK_MAX];
+   memcpy(nick, client->in_buf + 1, client->in_buf[0]);
+   nick[client->in_buf[0]] = '\0';
+
+   char host[256] = "unknown";
+#ifndef HAVE_SOCKET_LEGACY
+   getnameinfo((const struct sockaddr*)&client->addr, sizeof(client->addr),
+         host, sizeof(host), NULL, 0, NI_NUMERICHOST);
+#endif
+
+   char msg[512];
+   snprintf(msg, sizeof(msg), "Got spectator: \"%s (%s)\" (%u watching)", nick, host, (unsigned)streaming);
+   msg_queue_push(g_extern.msg_queue, msg, 1, 180);
+   RARCH_LOG("%s\n", msg);
+}
+
+void spectate_server_start(spectate_server_t *server, const void *header, size_t size)
+{
+   struct spectate_blob *blob = (struct spectate_blob*)malloc(sizeof(*blob) + size);
+   if (!blob)
+      return;
+
+   blob->refs = 1;
+   blob->size = size;
+   memcpy(blob + 1, header, size);
+
+   spectate_lock(server);
+
+   size_t streaming = 0;
+   for (size_t i = 0; i < server->clients_cnt; i++)
+      if (server->clients[i]->state == SPECTATE_STREAMING)
+         streaming++;
+
+   for (size_t i = 0; i < server->clients_cnt; i++)
+   {
+      struct spectate_client *client = server->clients[i];
+      if (client->state != SPECTATE_WAITING)
+         continue;
+
+      blob->refs++;
+      client->header     = blob;
+      client->header_pos = 0;
+      client->log_pos    = server->log_end;
+      client->state      = SPECTATE_STREAMING;
+      server->waiting--;
+
+      spectate_log_connection(client, ++streaming);
+   }
+
+   spectate_blob_release(blob);
+   spectate_unlock(server);
+
+   spectate_wake(server);
+}
+
+void spectate_server_post_frame(spectate_server_t *server, const void *data, size_t size)
+{
+   const uint8_t *in = (const uint8_t*)data;
+
+   spectate_lock(server);
+   while (size)
+   {
+      size_t offset = server->log_end % SPECTATE_LOG_SIZE;
+      size_t copy = size;
+      if (copy > SPECTATE_LOG_SIZE - offset)
+         copy = SPECTATE_LOG_SIZE - offset;
+
+      memcpy(server->log + offset, in, copy);
+      server->log_end += copy;
+      in += copy;
+      size -= copy;
+   }
+   spectate_unlock(server);
+
+#ifdef HAVE_THREADS
+   spectate_wake(server);
+#else
+   spectate_service(server, 0);
+#endif
+}
+
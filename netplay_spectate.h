@@ -0,0 +1,44 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RARCH_NETPLAY_SPECTATE_H
+#define __RARCH_NETPLAY_SPECTATE_H
+
+#include <stddef.h>
+#include "boolean.h"
+
+// Fans out the input stream to any number of spectators.
+// Sockets are non-blocking and serviced on a network thread (epoll on Linux, poll() elsewhere),
+// so a slow spectator never stalls the frame.
+// Every spectator reads from one shared backlog of input. Spectators which fall too far behind are disconnected.
+//
+// All functions are called from the main thread.
+typedef struct spectate_server spectate_server_t;
+
+// Takes ownership of listen_fd, which must already be listening.
+spectate_server_t *spectate_server_new(int listen_fd, const char *nick);
+void spectate_server_free(spectate_server_t *server);
+
+// Call once per frame, before running the core.
+// Returns true if spectators are waiting for the state to start from,
+// in which case spectate_server_start() must be called with a BSV header of the current state.
+bool spectate_server_pre_frame(spectate_server_t *server);
+void spectate_server_start(spectate_server_t *server, const void *header, size_t size);
+
+// Call once per frame, after running the core, with the input read during the frame.
+void spectate_server_post_frame(spectate_server_t *server, const void *data, size_t size);
+
+#endif
+
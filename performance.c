@@ -177,14 +177,33 @@ static void x86_cpuid(int func, int flags[4])
          "cpuid\n"
          "xchg %%" REG_b ", %%" REG_S "\n"
          : "=a"(flags[0]), "=S"(flags[1]), "=c"(flags[2]), "=d"(flags[3])
-         : "a"(func));
+         : "a"(func), "c"(0));
 #elif defined(_MSC_VER)
-   __cpuid(flags, func);
+   __cpuidex(flags, func, 0);
 #else
    RARCH_WARN("Unknown compiler. Cannot check CPUID with inline assembly.\n");
    memset(flags, 0, 4 * sizeof(int));
 #endif
 }
+
+// Only valid if CPUID reports OSXSAVE.
+static uint64_t xgetbv_x86(uint32_t idx)
+{
+#if defined(__GNUC__)
+   uint32_t eax, edx;
+   asm volatile (
+         // Older GCC versions (Apple's GCC for example) do not understand the xgetbv instruction.
+         ".byte 0x0f, 0x01, 0xd0\n"
+         : "=a"(eax), "=d"(edx) : "c"(idx));
+   return ((uint64_t)edx << 32) | eax;
+#elif _MSC_FULL_VER >= 160040219
+   // Intrinsic only available in VS2010 SP1+.
+   return _xgetbv(idx);
+#else
+   RARCH_WARN("Unknown compiler. Cannot check xgetbv bits.\n");
+   return 0;
+#endif
+}
 #endif
 
 void rarch_get_cpu_features(struct rarch_cpu_features *cpu)
@@ -200,7 +219,8 @@ void rarch_get_cpu_features(struct rarch_cpu_features *cpu)
    memcpy(vendor, vendor_shuffle, sizeof(vendor_shuffle));
    RARCH_LOG("[CPUID]: Vendor: %s\n", vendor);
 
-   if (flags[0] < 1) // Does CPUID not support func = 1? (unlikely ...)
+   int max_flag = flags[0];
+   if (max_flag < 1) // Does CPUID not support func = 1? (unlikely ...)
       return;
 
    x86_cpuid(1, flags);
@@ -211,13 +231,36 @@ void rarch_get_cpu_features(struct rarch_cpu_features *cpu)
    if (flags[3] & (1 << 26))
       cpu->simd |= RARCH_SIMD_SSE2;
 
+   if (flags[2] & (1 << 0))
+      cpu->simd |= RARCH_SIMD_SSE3;
+
+   if (flags[2] & (1 << 9))
+      cpu->simd |= RARCH_SIMD_SSSE3;
+
+   if (flags[2] & (1 << 19))
+      cpu->simd |= RARCH_SIMD_SSE4;
+
+   // AVX needs OSXSAVE as well, and the OS has to save the YMM registers (XCR0 bits 1 and 2)
+   // or AVX instructions fault.
    const int avx_flags = (1 << 27) | (1 << 28);
-   if ((flags[2] & avx_flags) == avx_flags)
+   if ((flags[2] & avx_flags) == avx_flags && (xgetbv_x86(0) & 0x6) == 0x6)
       cpu->simd |= RARCH_SIMD_AVX;
 
-   RARCH_LOG("[CPUID]: SSE:  %u\n", !!(cpu->simd & RARCH_SIMD_SSE));
-   RARCH_LOG("[CPUID]: SSE2: %u\n", !!(cpu->simd & RARCH_SIMD_SSE2));
-   RARCH_LOG("[CPUID]: AVX:  %u\n", !!(cpu->simd & RARCH_SIMD_AVX));
+   // AVX2 lives in extended features (func = 7), and is only usable if AVX is.
+   if (max_flag >= 7 && (cpu->simd & RARCH_SIMD_AVX))
+   {
+      x86_cpuid(7, flags);
+      if (flags[1] & (1 << 5))
+         cpu->simd |= RARCH_SIMD_AVX2;
+   }
+
+   RARCH_LOG("[CPUID]: SSE:   %u\n", !!(cpu->simd & RARCH_SIMD_SSE));
+   RARCH_LOG("[CPUID]: SSE2:  %u\n", !!(cpu->simd & RARCH_SIMD_SSE2));
+   RARCH_LOG("[CPUID]: SSE3:  %u\n", !!(cpu->simd & RARCH_SIMD_SSE3));
+   RARCH_LOG("[CPUID]: SSSE3: %u\n", !!(cpu->simd & RARCH_SIMD_SSSE3));
+   RARCH_LOG("[CPUID]: SSE4:  %u\n", !!(cpu->simd & RARCH_SIMD_SSE4));
+   RARCH_LOG("[CPUID]: AVX:   %u\n", !!(cpu->simd & RARCH_SIMD_AVX));
+   RARCH_LOG("[CPUID]: AVX2:  %u\n", !!(cpu->simd & RARCH_SIMD_AVX2));
 #elif defined(ANDROID) && defined(ANDROID_ARM)
    uint64_t cpu_flags = android_getCpuFeatures();
 
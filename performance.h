@@ -57,6 +57,10 @@ struct rarch_cpu_features
 #define RARCH_SIMD_VMX128   (1 << 3)
 #define RARCH_SIMD_AVX      (1 << 4)
 #define RARCH_SIMD_NEON     (1 << 5)
+#define RARCH_SIMD_SSE3     (1 << 6)
+#define RARCH_SIMD_SSSE3    (1 << 7)
+#define RARCH_SIMD_SSE4     (1 << 8)
+#define RARCH_SIMD_AVX2     (1 << 9)
 
 void rarch_get_cpu_features(struct rarch_cpu_features *cpu);
 
@@ -36,10 +36,11 @@ extern "C" {
 #include <stdio.h>
 #include <stdlib.h>
 #include "../boolean.h"
-#include "../fifo_buffer.h"
 #include "../thread.h"
 #include "../general.h"
 #include "../gfx/scaler/scaler.h"
+#include "../gfx/filter_threads.h"
+#include "../performance.h"
 #include "../conf/config_file.h"
 #include "../audio/utils.h"
 #include "../audio/resampler.h"
@@ -54,13 +55,32 @@ extern "C" {
 #include "../config.h"
 #endif
 
+#if defined(_MSC_VER)
+#include <windows.h>
+#define ffemu_barrier() MemoryBarrier()
+#else
+#define ffemu_barrier() __sync_synchronize()
+#endif
+
+#define MAX_FRAMES 32
+#define MAX_CONV_FRAMES 4
+#define MAX_PACKETS 64
+
+// Frame converted to the output format, handed from the conversion stage to the encoder.
+struct ffemu_conv_frame
+{
+   AVFrame *frame;
+   uint8_t *buf;
+};
+
 struct ff_video_info
 {
    AVCodecContext *codec;
    AVCodec *encoder;
 
-   AVFrame *conv_frame;
-   uint8_t *conv_frame_buf;
+   struct ffemu_conv_frame conv_frames[MAX_CONV_FRAMES];
+   // Last frame sent to the encoder. Held on to, so dupes can be encoded again.
+   struct ffemu_conv_frame *last_conv;
    int64_t frame_cnt;
 
    uint8_t *outbuf;
@@ -137,6 +157,7 @@ struct ff_config_param
    char format[64];
    enum PixelFormat out_pix_fmt;
    unsigned threads;
+   unsigned scale_threads;
    unsigned frame_drop_ratio;
    unsigned sample_rate;
    unsigned scale_factor;
@@ -150,6 +171,47 @@ struct ff_config_param
    AVDictionary *audio_opts;
 };
 
+// Frame buffer owned by the recorder.
+// The emulator thread copies a frame into one of these (the only copy made),
+// the conversion stage scales straight out of it and puts it back in the pool.
+struct ffemu_frame
+{
+   uint8_t *data;
+   unsigned width;
+   unsigned height;
+   size_t pitch;
+};
+
+// Ring buffer with a single producer and a single consumer.
+// Each side only ever updates its own pointer, after the data it publishes or consumes,
+// so no lock is needed. Pointers run freely and are masked, so size is a power of two.
+struct ffemu_ring
+{
+   uint8_t *buffer;
+   size_t size;
+   volatile size_t read_ptr;
+   volatile size_t write_ptr;
+};
+
+// A thread in the recording pipeline (or the emulator thread feeding it).
+struct ffemu_stage
+{
+   const char *ident;
+   sthread_t *thread;
+
+   // Set while sleeping on cond, so the other stages know to wake us up.
+   scond_t *cond;
+   volatile bool waiting;
+
+   // Statistics reported on finalize.
+   uint64_t items;
+   rarch_time_t busy_usec;
+};
+
+// The recorder is a pipeline of threads, connected by bounded single producer/single consumer queues:
+// emulator -> convert (scale and colour conversion, optionally sliced) -> encode (video codec, with its own threading)
+// -> mux (audio encode and muxing), which also gets audio straight from the emulator.
+// A full queue blocks the stage feeding it, all the way back to the emulator thread.
 struct ffemu
 {
    struct ff_video_info video;
@@ -159,16 +221,29 @@ struct ffemu
    
    struct ffemu_params params;
 
-   scond_t *cond;
-   slock_t *cond_lock;
+   struct ffemu_frame frames[MAX_FRAMES];
+   size_t frame_size;
+   struct ffemu_ring free_frames; // struct ffemu_frame*, given back by the conversion stage.
+   struct ffemu_frame *spare_frame; // Taken from free_frames, but we failed to allocate it.
+   struct ffemu_ring video_queue; // struct ffemu_frame*, NULL for dupes.
+   struct ffemu_ring audio_queue; // Raw samples.
+
+   struct ffemu_ring free_conv; // struct ffemu_conv_frame*, given back by the encoder.
+   struct ffemu_ring conv_queue; // struct ffemu_conv_frame*, NULL for dupes.
+   struct ffemu_ring packet_queue; // AVPacket, owning a copy of its data.
+
+   slice_threads_t *scale_threads;
+   size_t audio_chunk_size;
+
+   // Only taken to go to sleep, or to wake up a sleeping stage.
    slock_t *lock;
-   fifo_buffer_t *audio_fifo;
-   fifo_buffer_t *video_fifo;
-   fifo_buffer_t *attr_fifo;
-   sthread_t *thread;
+   struct ffemu_stage producer;
+   struct ffemu_stage convert;
+   struct ffemu_stage encode;
+   struct ffemu_stage mux;
 
+   rarch_time_t start_time;
    volatile bool alive;
-   volatile bool can_sleep;
 };
 
 static bool ffemu_codec_has_sample_format(enum AVSampleFormat fmt, const enum AVSampleFormat *fmts)
@@ -423,7 +498,9 @@ static bool ffemu_init_video(ffemu_t *handle)
    video->codec->sample_aspect_ratio = av_d2q(param->aspect_ratio * param->out_height / param->out_width, 255);
    video->codec->pix_fmt             = video->pix_fmt;
 
+   // Let the codec thread however it can, frames in flight or slices of a frame.
    video->codec->thread_count = params->threads;
+   video->codec->thread_type  = FF_THREAD_FRAME | FF_THREAD_SLICE;
 
    if (handle->muxer.ctx->oformat->flags & AVFMT_GLOBALHEADER)
       video->codec->flags |= CODEC_FLAG_GLOBAL_HEADER;
@@ -438,10 +515,17 @@ static bool ffemu_init_video(ffemu_t *handle)
    video->frame_drop_ratio = params->frame_drop_ratio;
 
    size_t size = avpicture_get_size(video->pix_fmt, param->out_width, param->out_height);
-   video->conv_frame_buf = (uint8_t*)av_malloc(size);
-   video->conv_frame = avcodec_alloc_frame();
-   avpicture_fill((AVPicture*)video->conv_frame, video->conv_frame_buf, video->pix_fmt,
-         param->out_width, param->out_height);
+   for (unsigned i = 0; i < MAX_CONV_FRAMES; i++)
+   {
+      struct ffemu_conv_frame *conv = &video->conv_frames[i];
+      conv->buf   = (uint8_t*)av_malloc(size);
+      conv->frame = avcodec_alloc_frame();
+      if (!conv->buf || !conv->frame)
+         return false;
+
+      avpicture_fill((AVPicture*)conv->frame, conv->buf, video->pix_fmt,
+            param->out_width, param->out_height);
+   }
 
    return true;
 }
@@ -451,6 +535,7 @@ static bool ffemu_init_config(struct ff_config_param *params, const char *config
    params->out_pix_fmt = PIX_FMT_NONE;
    params->scale_factor = 1;
    params->threads = 1;
+   params->scale_threads = 1;
    params->frame_drop_ratio = 1;
 
    if (!config)
@@ -468,6 +553,7 @@ static bool ffemu_init_config(struct ff_config_param *params, const char *config
    config_get_array(params->conf, "format", params->format, sizeof(params->format));
 
    config_get_uint(params->conf, "threads", &params->threads);
+   config_get_uint(params->conf, "scale_threads", &params->scale_threads);
 
    if (!config_get_uint(params->conf, "frame_drop_ratio", &params->frame_drop_ratio)
          || !params->frame_drop_ratio)
@@ -550,70 +636,297 @@ static bool ffemu_init_muxer_post(ffemu_t *handle)
    return avformat_write_header(handle->muxer.ctx, NULL) >= 0;
 }
 
-#define MAX_FRAMES 32
+static bool ffemu_ring_init(struct ffemu_ring *ring, size_t size)
+{
+   ring->size      = next_pow2(size);
+   ring->read_ptr  = 0;
+   ring->write_ptr = 0;
+   ring->buffer    = (uint8_t*)av_malloc(ring->size);
+   return ring->buffer != NULL;
+}
+
+static void ffemu_ring_free(struct ffemu_ring *ring)
+{
+   av_free(ring->buffer);
+   ring->buffer = NULL;
+}
+
+static size_t ffemu_ring_read_avail(const struct ffemu_ring *ring)
+{
+   return ring->write_ptr - ring->read_ptr;
+}
+
+static size_t ffemu_ring_write_avail(const struct ffemu_ring *ring)
+{
+   return ring->size - (ring->write_ptr - ring->read_ptr);
+}
+
+static void ffemu_ring_write(struct ffemu_ring *ring, const void *data, size_t size)
+{
+   size_t offset = ring->write_ptr & (ring->size - 1);
+   size_t first  = ring->size - offset;
+   if (first > size)
+      first = size;
+
+   memcpy(ring->buffer + offset, data, first);
+   memcpy(ring->buffer, (const uint8_t*)data + first, size - first);
+
+   // Data must be visible before the consumer sees the new write pointer.
+   ffemu_barrier();
+   ring->write_ptr += size;
+}
+
+static void ffemu_ring_read(struct ffemu_ring *ring, void *data, size_t size)
+{
+   // Don't read data older than the write pointer we checked.
+   ffemu_barrier();
+
+   size_t offset = ring->read_ptr & (ring->size - 1);
+   size_t first  = ring->size - offset;
+   if (first > size)
+      first = size;
+
+   memcpy(data, ring->buffer + offset, first);
+   memcpy((uint8_t*)data + first, ring->buffer, size - first);
+
+   // We must be done reading before the producer may overwrite it.
+   ffemu_barrier();
+   ring->read_ptr += size;
+}
+
+// Wakes up a stage if it went to sleep waiting for us.
+// The barrier pairs with the one in ffemu_sleep(), so either we see the waiting flag,
+// or the sleeper sees what we just did before going to sleep.
+static void ffemu_wake(ffemu_t *handle, struct ffemu_stage *stage)
+{
+   ffemu_barrier();
+   if (!stage->waiting)
+      return;
+
+   slock_lock(handle->lock);
+   scond_signal(stage->cond);
+   slock_unlock(handle->lock);
+}
+
+static void ffemu_sleep(ffemu_t *handle, struct ffemu_stage *stage,
+      bool (*ready)(ffemu_t*, size_t), size_t arg)
+{
+   slock_lock(handle->lock);
+   stage->waiting = true;
+   ffemu_barrier();
 
-static void ffemu_thread(void *data);
+   while (handle->alive && !ready(handle, arg))
+      scond_wait(stage->cond, handle->lock);
+
+   stage->waiting = false;
+   slock_unlock(handle->lock);
+}
+
+static bool ffemu_ring_has_ptr(const struct ffemu_ring *ring)
+{
+   return ffemu_ring_read_avail(ring) >= sizeof(void*);
+}
+
+static bool ffemu_ring_fits_ptr(const struct ffemu_ring *ring)
+{
+   return ffemu_ring_write_avail(ring) >= sizeof(void*);
+}
+
+static void ffemu_ring_write_ptr(struct ffemu_ring *ring, void *ptr)
+{
+   ffemu_ring_write(ring, &ptr, sizeof(ptr));
+}
+
+static void *ffemu_ring_read_ptr(struct ffemu_ring *ring)
+{
+   void *ptr;
+   ffemu_ring_read(ring, &ptr, sizeof(ptr));
+   return ptr;
+}
+
+static bool ffemu_can_push_frame(ffemu_t *handle, size_t is_dupe)
+{
+   return ffemu_ring_fits_ptr(&handle->video_queue) &&
+      (is_dupe || handle->spare_frame || ffemu_ring_has_ptr(&handle->free_frames));
+}
+
+static bool ffemu_can_push_audio(ffemu_t *handle, size_t size)
+{
+   (void)size;
+   return ffemu_ring_write_avail(&handle->audio_queue) > 0;
+}
+
+static bool ffemu_convert_ready(ffemu_t *handle, size_t unused)
+{
+   (void)unused;
+   return ffemu_ring_has_ptr(&handle->video_queue) &&
+      ffemu_ring_fits_ptr(&handle->conv_queue) &&
+      ffemu_ring_has_ptr(&handle->free_conv);
+}
+
+static bool ffemu_encode_ready(ffemu_t *handle, size_t unused)
+{
+   (void)unused;
+   return ffemu_ring_has_ptr(&handle->conv_queue) &&
+      ffemu_ring_write_avail(&handle->packet_queue) >= sizeof(AVPacket);
+}
+
+static bool ffemu_mux_ready(ffemu_t *handle, size_t unused)
+{
+   (void)unused;
+   return ffemu_ring_read_avail(&handle->packet_queue) >= sizeof(AVPacket) ||
+      ffemu_ring_read_avail(&handle->audio_queue) >= handle->audio_chunk_size;
+}
+
+static struct ffemu_frame *ffemu_frame_get(ffemu_t *handle)
+{
+   struct ffemu_frame *frame = handle->spare_frame;
+   handle->spare_frame = NULL;
+   if (!frame)
+      frame = (struct ffemu_frame*)ffemu_ring_read_ptr(&handle->free_frames);
+
+   // Buffers are only allocated once we actually have to queue up that many frames.
+   // Only the conversion stage may put frames back in the free ring, so hang on to it if that fails.
+   if (!frame->data)
+   {
+      frame->data = (uint8_t*)av_malloc(handle->frame_size);
+      if (!frame->data)
+      {
+         handle->spare_frame = frame;
+         return NULL;
+      }
+   }
+
+   return frame;
+}
+
+static void ffemu_convert_thread(void *data);
+static void ffemu_encode_thread(void *data);
+static void ffemu_mux_thread(void *data);
+
+static bool ffemu_init_stage(struct ffemu_stage *stage, const char *ident)
+{
+   memset(stage, 0, sizeof(*stage));
+   stage->ident = ident;
+   stage->cond  = scond_new();
+   return stage->cond != NULL;
+}
 
 static bool init_thread(ffemu_t *handle)
 {
    handle->lock = slock_new();
-   handle->cond_lock = slock_new();
-   handle->cond = scond_new();
-   handle->audio_fifo = fifo_new(32000 * sizeof(int16_t) * handle->params.channels * MAX_FRAMES / 60); // Some arbitrary max size.
-   handle->attr_fifo = fifo_new(sizeof(struct ffemu_video_data) * MAX_FRAMES);
-   handle->video_fifo = fifo_new(handle->params.fb_width * handle->params.fb_height *
-            handle->video.pix_size * MAX_FRAMES);
 
+   bool stages_ok = ffemu_init_stage(&handle->producer, "Emulator");
+   stages_ok = ffemu_init_stage(&handle->convert, "Convert") && stages_ok;
+   stages_ok = ffemu_init_stage(&handle->encode, "Encode") && stages_ok;
+   stages_ok = ffemu_init_stage(&handle->mux, "Mux") && stages_ok;
+
+   // For some reason, FFmpeg has a tendency to crash if we don't overallocate a bit. :s
+   handle->frame_size = handle->params.fb_width * (handle->params.fb_height + 1) *
+      handle->video.pix_size + FF_INPUT_BUFFER_PADDING_SIZE;
+   handle->audio_chunk_size = handle->audio.codec->frame_size * handle->params.channels * sizeof(int16_t);
+
+   bool ring_ok = ffemu_ring_init(&handle->audio_queue,
+         32000 * sizeof(int16_t) * handle->params.channels * MAX_FRAMES / 60); // Some arbitrary max size.
+   ring_ok = ffemu_ring_init(&handle->free_frames, MAX_FRAMES * sizeof(struct ffemu_frame*)) && ring_ok;
+   ring_ok = ffemu_ring_init(&handle->video_queue, 2 * MAX_FRAMES * sizeof(struct ffemu_frame*)) && ring_ok;
+   ring_ok = ffemu_ring_init(&handle->free_conv, MAX_CONV_FRAMES * sizeof(struct ffemu_conv_frame*)) && ring_ok;
+   ring_ok = ffemu_ring_init(&handle->conv_queue, 2 * MAX_CONV_FRAMES * sizeof(struct ffemu_conv_frame*)) && ring_ok;
+   ring_ok = ffemu_ring_init(&handle->packet_queue, MAX_PACKETS * sizeof(AVPacket)) && ring_ok;
+   assert(handle->lock && stages_ok && ring_ok);
+
+   for (unsigned i = 0; i < MAX_FRAMES; i++)
+      ffemu_ring_write_ptr(&handle->free_frames, &handle->frames[i]);
+   for (unsigned i = 0; i < MAX_CONV_FRAMES; i++)
+      ffemu_ring_write_ptr(&handle->free_conv, &handle->video.conv_frames[i]);
+
+   if (handle->config.scale_threads > 1)
+   {
+      handle->scale_threads = slice_threads_new(handle->config.scale_threads);
+      if (handle->scale_threads)
+         RARCH_LOG("[FFmpeg]: Converting frames with %u threads.\n", handle->config.scale_threads);
+   }
+
+   handle->start_time = rarch_get_time_usec();
    handle->alive = true;
-   handle->can_sleep = true;
-   handle->thread = sthread_create(ffemu_thread, handle);
+   handle->convert.thread = sthread_create(ffemu_convert_thread, handle);
+   handle->encode.thread  = sthread_create(ffemu_encode_thread, handle);
+   handle->mux.thread     = sthread_create(ffemu_mux_thread, handle);
 
-   assert(handle->lock && handle->cond_lock &&
-      handle->cond && handle->audio_fifo &&
-      handle->attr_fifo && handle->video_fifo && handle->thread);
+   assert(handle->convert.thread && handle->encode.thread && handle->mux.thread);
 
    return true;
 }
 
 static void deinit_thread(ffemu_t *handle)
 {
-   if (!handle->thread)
+   if (!handle->lock)
       return;
 
-   slock_lock(handle->cond_lock);
+   slock_lock(handle->lock);
    handle->alive = false;
-   handle->can_sleep = false;
-   slock_unlock(handle->cond_lock);
-
-   scond_signal(handle->cond);
-   sthread_join(handle->thread);
+   scond_signal(handle->producer.cond);
+   scond_signal(handle->convert.cond);
+   scond_signal(handle->encode.cond);
+   scond_signal(handle->mux.cond);
+   slock_unlock(handle->lock);
 
-   slock_free(handle->lock);
-   slock_free(handle->cond_lock);
-   scond_free(handle->cond);
+   struct ffemu_stage *stages[] = { &handle->convert, &handle->encode, &handle->mux };
+   for (unsigned i = 0; i < sizeof(stages) / sizeof(stages[0]); i++)
+   {
+      if (stages[i]->thread)
+         sthread_join(stages[i]->thread);
+      stages[i]->thread = NULL;
+   }
+}
 
-   handle->thread = NULL;
+static void ffemu_free_stage(struct ffemu_stage *stage)
+{
+   if (stage->cond)
+      scond_free(stage->cond);
+   stage->cond = NULL;
 }
 
 static void deinit_thread_buf(ffemu_t *handle)
 {
-   if (handle->audio_fifo)
-   {
-      fifo_free(handle->audio_fifo);
-      handle->audio_fifo = NULL;
-   }
-   
-   if (handle->attr_fifo)
+   // Packets which never made it to the muxer still own their data.
+   if (handle->packet_queue.buffer)
    {
-      fifo_free(handle->attr_fifo);
-      handle->attr_fifo = NULL;
+      while (ffemu_ring_read_avail(&handle->packet_queue) >= sizeof(AVPacket))
+      {
+         AVPacket pkt;
+         ffemu_ring_read(&handle->packet_queue, &pkt, sizeof(pkt));
+         av_free(pkt.data);
+      }
    }
 
-   if (handle->video_fifo)
+   ffemu_ring_free(&handle->audio_queue);
+   ffemu_ring_free(&handle->free_frames);
+   ffemu_ring_free(&handle->video_queue);
+   ffemu_ring_free(&handle->free_conv);
+   ffemu_ring_free(&handle->conv_queue);
+   ffemu_ring_free(&handle->packet_queue);
+
+   for (unsigned i = 0; i < MAX_FRAMES; i++)
    {
-      fifo_free(handle->video_fifo);
-      handle->video_fifo = NULL;
+      av_free(handle->frames[i].data);
+      handle->frames[i].data = NULL;
    }
+   handle->spare_frame = NULL;
+   handle->video.last_conv = NULL;
+
+   if (handle->scale_threads)
+      slice_threads_free(handle->scale_threads);
+   handle->scale_threads = NULL;
+
+   ffemu_free_stage(&handle->producer);
+   ffemu_free_stage(&handle->convert);
+   ffemu_free_stage(&handle->encode);
+   ffemu_free_stage(&handle->mux);
+
+   if (handle->lock)
+      slock_free(handle->lock);
+   handle->lock = NULL;
 }
 
 ffemu_t *ffemu_new(const struct ffemu_params *params)
@@ -630,6 +943,9 @@ ffemu_t *ffemu_new(const struct ffemu_params *params)
    if (!ffemu_init_config(&handle->config, params->config))
       goto error;
 
+   if (params->keep_all_frames)
+      handle->config.frame_drop_ratio = 1;
+
    if (!ffemu_init_muxer_pre(handle))
       goto error;
 
@@ -674,8 +990,11 @@ void ffemu_free(ffemu_t *handle)
       av_free(handle->video.codec);
    }
 
-   av_free(handle->video.conv_frame);
-   av_free(handle->video.conv_frame_buf);
+   for (unsigned i = 0; i < MAX_CONV_FRAMES; i++)
+   {
+      av_free(handle->video.conv_frames[i].frame);
+      av_free(handle->video.conv_frames[i].buf);
+   }
 
    scaler_ctx_gen_reset(&handle->video.scaler);
 
@@ -707,85 +1026,71 @@ bool ffemu_push_video(ffemu_t *handle, const struct ffemu_video_data *data)
    if (drop_frame)
       return true;
 
-   for (;;)
+   if (!ffemu_can_push_frame(handle, data->is_dupe))
    {
-      slock_lock(handle->lock);
-      unsigned avail = fifo_write_avail(handle->attr_fifo);
-      slock_unlock(handle->lock);
-
-      if (!handle->alive)
-         return false;
-
-      if (avail >= sizeof(*data))
-         break;
-
-      slock_lock(handle->cond_lock);
-      if (handle->can_sleep)
-      {
-         handle->can_sleep = false;
-         scond_wait(handle->cond, handle->cond_lock);
-         handle->can_sleep = true;
-      }
-      else
-         scond_signal(handle->cond);
-
-      slock_unlock(handle->cond_lock);
+      rarch_time_t start = rarch_get_time_usec();
+      ffemu_sleep(handle, &handle->producer, ffemu_can_push_frame, data->is_dupe);
+      handle->producer.busy_usec += rarch_get_time_usec() - start;
    }
 
-   slock_lock(handle->lock);
+   if (!handle->alive)
+      return false;
 
-   // Tightly pack our frame to conserve memory. libretro tends to use a very large pitch.
-   struct ffemu_video_data attr_data = *data;
+   struct ffemu_frame *frame = NULL;
+   if (!data->is_dupe)
+   {
+      // Tightly pack our frame to conserve memory. libretro tends to use a very large pitch.
+      size_t pitch = data->width * handle->video.pix_size;
+      if (data->width > handle->params.fb_width || data->height > handle->params.fb_height)
+         return false;
 
-   if (attr_data.is_dupe)
-      attr_data.width = attr_data.height = attr_data.pitch = 0;
-   else
-      attr_data.pitch = attr_data.width * handle->video.pix_size;
+      frame = ffemu_frame_get(handle);
+      if (!frame)
+         return false;
 
-   fifo_write(handle->attr_fifo, &attr_data, sizeof(attr_data));
+      frame->width  = data->width;
+      frame->height = data->height;
+      frame->pitch  = pitch;
 
-   int offset = 0;
-   for (unsigned y = 0; y < attr_data.height; y++, offset += data->pitch)
-      fifo_write(handle->video_fifo, (const uint8_t*)data->data + offset, attr_data.pitch);
+      const uint8_t *src = (const uint8_t*)data->data;
+      for (unsigned y = 0; y < data->height; y++, src += data->pitch)
+         memcpy(frame->data + y * pitch, src, pitch);
+   }
 
-   slock_unlock(handle->lock);
-   scond_signal(handle->cond);
+   ffemu_ring_write_ptr(&handle->video_queue, frame);
+   ffemu_wake(handle, &handle->convert);
+   handle->producer.items++;
 
    return true;
 }
 
 bool ffemu_push_audio(ffemu_t *handle, const struct ffemu_audio_data *data)
 {
-   for (;;)
+   const uint8_t *samples = (const uint8_t*)data->data;
+   size_t size = data->frames * handle->params.channels * sizeof(int16_t);
+
+   while (size)
    {
-      slock_lock(handle->lock);
-      unsigned avail = fifo_write_avail(handle->audio_fifo);
-      slock_unlock(handle->lock);
+      if (!ffemu_can_push_audio(handle, size))
+      {
+         rarch_time_t start = rarch_get_time_usec();
+         ffemu_sleep(handle, &handle->producer, ffemu_can_push_audio, size);
+         handle->producer.busy_usec += rarch_get_time_usec() - start;
+      }
 
       if (!handle->alive)
          return false;
 
-      if (avail >= data->frames * handle->params.channels * sizeof(int16_t))
-         break;
+      size_t avail = ffemu_ring_write_avail(&handle->audio_queue);
+      size_t write_size = size > avail ? avail : size;
 
-      slock_lock(handle->cond_lock);
-      if (handle->can_sleep)
-      {
-         handle->can_sleep = false;
-         scond_wait(handle->cond, handle->cond_lock);
-         handle->can_sleep = true;
-      }
-      else
-         scond_signal(handle->cond);
+      ffemu_ring_write(&handle->audio_queue, samples, write_size);
+      ffemu_wake(handle, &handle->mux);
 
-      slock_unlock(handle->cond_lock);
+      samples += write_size;
+      size    -= write_size;
    }
 
-   slock_lock(handle->lock);
-   fifo_write(handle->audio_fifo, data->data, data->frames * handle->params.channels * sizeof(int16_t));
-   slock_unlock(handle->lock);
-   scond_signal(handle->cond);
-
    return true;
 }
 
@@ -823,61 +1128,120 @@ static bool encode_video(ffemu_t *handle, AVPacket *pkt, AVFrame *frame)
    return true;
 }
 
-static void ffemu_scale_input(ffemu_t *handle, const struct ffemu_video_data *data)
+struct ffemu_scale_job
+{
+   const struct scaler_ctx *scaler;
+   uint8_t *out;
+   const uint8_t *in;
+};
+
+static void ffemu_scale_slice(void *data, unsigned first_line, unsigned last_line)
+{
+   const struct ffemu_scale_job *job = (const struct ffemu_scale_job*)data;
+   const struct scaler_ctx *ctx = job->scaler;
+
+   ctx->direct_pixconv(job->out + first_line * ctx->out_stride,
+         job->in + first_line * ctx->in_stride,
+         ctx->out_width, last_line - first_line,
+         ctx->out_stride, ctx->in_stride);
+}
+
+static void ffemu_scale_input(ffemu_t *handle, AVFrame *out, const struct ffemu_frame *frame)
 {
    // Attempt to preserve more information if we scale down.
-   bool shrunk = handle->params.out_width < data->width || handle->params.out_height < data->height;
+   bool shrunk = handle->params.out_width < frame->width || handle->params.out_height < frame->height;
 
    if (handle->video.use_sws)
    {
-      handle->video.sws = sws_getCachedContext(handle->video.sws, data->width, data->height, handle->video.in_pix_fmt,
+      handle->video.sws = sws_getCachedContext(handle->video.sws, frame->width, frame->height, handle->video.in_pix_fmt,
             handle->params.out_width, handle->params.out_height, handle->video.pix_fmt,
             shrunk ? SWS_BILINEAR : SWS_POINT, NULL, NULL, NULL);
 
-      int linesize = data->pitch;
-      sws_scale(handle->video.sws, (const uint8_t* const*)&data->data, &linesize, 0,
-            data->height, handle->video.conv_frame->data, handle->video.conv_frame->linesize);
+      int linesize = frame->pitch;
+      sws_scale(handle->video.sws, (const uint8_t* const*)&frame->data, &linesize, 0,
+            frame->height, out->data, out->linesize);
    }
    else
    {
-      if ((int)data->width != handle->video.scaler.in_width || (int)data->height != handle->video.scaler.in_height)
+      if ((int)frame->width != handle->video.scaler.in_width || (int)frame->height != handle->video.scaler.in_height)
       {
-         handle->video.scaler.in_width  = data->width;
-         handle->video.scaler.in_height = data->height;
-         handle->video.scaler.in_stride = data->pitch;
+         handle->video.scaler.in_width  = frame->width;
+         handle->video.scaler.in_height = frame->height;
+         handle->video.scaler.in_stride = frame->pitch;
 
          handle->video.scaler.scaler_type = shrunk ? SCALER_TYPE_BILINEAR : SCALER_TYPE_POINT;
 
          handle->video.scaler.out_width  = handle->params.out_width;
          handle->video.scaler.out_height = handle->params.out_height;
-         handle->video.scaler.out_stride = handle->video.conv_frame->linesize[0];
+         // All converted frames are allocated alike.
+         handle->video.scaler.out_stride = out->linesize[0];
 
          scaler_ctx_gen_filter(&handle->video.scaler);
       }
 
-      scaler_ctx_scale(&handle->video.scaler, handle->video.conv_frame->data[0], data->data);
+      // Plain pixel format conversion (recording at native resolution) is split up by lines.
+      // Actual scaling still runs on the conversion thread only.
+      if (handle->scale_threads && handle->video.scaler.unscaled)
+      {
+         struct ffemu_scale_job job = { &handle->video.scaler, out->data[0], frame->data };
+         slice_threads_run(handle->scale_threads, ffemu_scale_slice, &job, frame->height);
+      }
+      else
+         scaler_ctx_scale(&handle->video.scaler, out->data[0], frame->data);
    }
 }
 
-static bool ffemu_push_video_thread(ffemu_t *handle, const struct ffemu_video_data *data)
+// Conversion stage. Scales an input frame into a free converted frame, and gives the input frame back to the emulator.
+static struct ffemu_conv_frame *ffemu_convert_frame(ffemu_t *handle, struct ffemu_frame *frame)
 {
-   if (!data->is_dupe)
-      ffemu_scale_input(handle, data);
+   struct ffemu_conv_frame *conv = (struct ffemu_conv_frame*)ffemu_ring_read_ptr(&handle->free_conv);
+   ffemu_scale_input(handle, conv->frame, frame);
 
-   handle->video.conv_frame->pts = handle->video.frame_cnt;
+   ffemu_ring_write_ptr(&handle->free_frames, frame);
+   ffemu_wake(handle, &handle->producer);
+   return conv;
+}
 
-   AVPacket pkt;
-   if (!encode_video(handle, &pkt, handle->video.conv_frame))
-      return false;
+// Encoding stage. conv is NULL for dupes, which encode the last converted frame again.
+// Hands the previously encoded frame back to the conversion stage once it's replaced.
+static bool ffemu_encode_frame(ffemu_t *handle, struct ffemu_conv_frame *conv, AVPacket *pkt)
+{
+   struct ff_video_info *video = &handle->video;
 
-   if (pkt.size)
+   if (conv)
    {
-      if (av_interleaved_write_frame(handle->muxer.ctx, &pkt) < 0)
-         return false;
+      if (video->last_conv)
+      {
+         ffemu_ring_write_ptr(&handle->free_conv, video->last_conv);
+         ffemu_wake(handle, &handle->convert);
+      }
+      video->last_conv = conv;
    }
 
-   handle->video.frame_cnt++;
-   return true;
+   // Dupe before the first frame, nothing to repeat yet.
+   if (!video->last_conv)
+   {
+      video->frame_cnt++;
+      pkt->size = 0;
+      return true;
+   }
+
+   AVFrame *frame = video->last_conv->frame;
+   frame->pts = video->frame_cnt++;
+   return encode_video(handle, pkt, frame);
+}
+
+// Mux stage. The muxer makes its own copy of whatever it has to buffer up for interleaving.
+static bool ffemu_mux_queued_packet(ffemu_t *handle)
+{
+   AVPacket pkt;
+   ffemu_ring_read(&handle->packet_queue, &pkt, sizeof(pkt));
+   ffemu_wake(handle, &handle->encode);
+
+   uint8_t *data = pkt.data;
+   bool ret = av_interleaved_write_frame(handle->muxer.ctx, &pkt) >= 0;
+   av_free(data);
+   return ret;
 }
 
 static void planarize_float(float *out, const float *in, size_t frames)
@@ -1084,12 +1448,24 @@ static bool ffemu_push_audio_thread(ffemu_t *handle, struct ffemu_audio_data *da
    return true;
 }
 
-static void ffemu_flush_audio(ffemu_t *handle, void *audio_buf, size_t audio_buf_size)
+static void ffemu_pop_audio(ffemu_t *handle, void *audio_buf)
+{
+   ffemu_ring_read(&handle->audio_queue, audio_buf, handle->audio_chunk_size);
+   ffemu_wake(handle, &handle->producer);
+
+   struct ffemu_audio_data aud = {0};
+   aud.frames = handle->audio.codec->frame_size;
+   aud.data = audio_buf;
+
+   ffemu_push_audio_thread(handle, &aud, true);
+}
+
+static void ffemu_flush_audio(ffemu_t *handle, void *audio_buf)
 {
-   size_t avail = fifo_read_avail(handle->audio_fifo);
+   size_t avail = ffemu_ring_read_avail(&handle->audio_queue);
    if (avail)
    {
-      fifo_read(handle->audio_fifo, audio_buf, avail);
+      ffemu_ring_read(&handle->audio_queue, audio_buf, avail);
 
       struct ffemu_audio_data aud = {0};
       aud.frames = avail / (sizeof(int16_t) * handle->params.channels);
@@ -1118,11 +1494,25 @@ static void ffemu_flush_video(ffemu_t *handle)
    }
 }
 
+static void ffemu_flush_encoded(ffemu_t *handle, struct ffemu_conv_frame *conv)
+{
+   AVPacket pkt;
+   if (ffemu_encode_frame(handle, conv, &pkt) && pkt.size)
+      av_interleaved_write_frame(handle->muxer.ctx, &pkt);
+}
+
+// Runs whatever is still in flight through the remaining stages on the calling thread.
+// Stages are drained from the back, so video frames stay in order.
 static void ffemu_flush_buffers(ffemu_t *handle)
 {
-   void *video_buf = av_malloc(2 * handle->params.fb_width * handle->params.fb_height * handle->video.pix_size);
-   size_t audio_buf_size = handle->audio.codec->frame_size * handle->params.channels * sizeof(int16_t);
-   void *audio_buf = av_malloc(audio_buf_size);
+   void *audio_buf = av_malloc(handle->audio_chunk_size);
+
+   while (ffemu_ring_read_avail(&handle->packet_queue) >= sizeof(AVPacket))
+      ffemu_mux_queued_packet(handle);
+
+   while (ffemu_ring_has_ptr(&handle->conv_queue))
+      ffemu_flush_encoded(handle,
+            (struct ffemu_conv_frame*)ffemu_ring_read_ptr(&handle->conv_queue));
 
    // Try pushing data in an interleaving pattern to ease the work of the muxer a bit.
    bool did_work;
@@ -1130,43 +1520,55 @@ static void ffemu_flush_buffers(ffemu_t *handle)
    {
       did_work = false;
 
-      if (fifo_read_avail(handle->audio_fifo) >= audio_buf_size)
+      if (ffemu_ring_read_avail(&handle->audio_queue) >= handle->audio_chunk_size)
       {
-         fifo_read(handle->audio_fifo, audio_buf, audio_buf_size);
-
-         struct ffemu_audio_data aud = {0};
-         aud.frames = handle->audio.codec->frame_size;
-         aud.data = audio_buf;
-
-         ffemu_push_audio_thread(handle, &aud, true);
+         ffemu_pop_audio(handle, audio_buf);
          did_work = true;
       }
 
-      struct ffemu_video_data attr_buf;
-      if (fifo_read_avail(handle->attr_fifo) >= sizeof(attr_buf))
+      if (ffemu_ring_has_ptr(&handle->video_queue))
       {
-         fifo_read(handle->attr_fifo, &attr_buf, sizeof(attr_buf));
-         fifo_read(handle->video_fifo, video_buf, attr_buf.height * attr_buf.pitch);
-         attr_buf.data = video_buf;
-         ffemu_push_video_thread(handle, &attr_buf);
-
+         struct ffemu_frame *frame = (struct ffemu_frame*)ffemu_ring_read_ptr(&handle->video_queue);
+         ffemu_flush_encoded(handle, frame ? ffemu_convert_frame(handle, frame) : NULL);
          did_work = true;
       }
    } while (did_work);
 
    // Flush out last audio.
-   ffemu_flush_audio(handle, audio_buf, audio_buf_size);
+   ffemu_flush_audio(handle, audio_buf);
 
    // Flush out last video.
    ffemu_flush_video(handle);
 
-   av_free(video_buf);
    av_free(audio_buf);
 }
 
+static void ffemu_log_stats(ffemu_t *handle)
+{
+   rarch_time_t wall_usec = rarch_get_time_usec() - handle->start_time;
+   if (wall_usec <= 0)
+      return;
+
+   const struct ffemu_stage *stages[] = { &handle->convert, &handle->encode, &handle->mux };
+   for (unsigned i = 0; i < sizeof(stages) / sizeof(stages[0]); i++)
+   {
+      const struct ffemu_stage *stage = stages[i];
+      double busy = stage->busy_usec / 1000000.0;
+      RARCH_LOG("[FFmpeg]: %s stage: %llu items, busy %.1f %% of the time, %.1f items/s while busy.\n",
+            stage->ident, (unsigned long long)stage->items,
+            100.0 * stage->busy_usec / wall_usec,
+            busy > 0.0 ? stage->items / busy : 0.0);
+   }
+
+   RARCH_LOG("[FFmpeg]: %s thread: %llu frames, blocked on the recorder %.1f %% of the time.\n",
+         handle->producer.ident, (unsigned long long)handle->producer.items,
+         100.0 * handle->producer.busy_usec / wall_usec);
+}
+
 bool ffemu_finalize(ffemu_t *handle)
 {
    deinit_thread(handle);
+   ffemu_log_stats(handle);
 
    // Flush out data still in buffers (internal, and FFmpeg internal).
    ffemu_flush_buffers(handle);
@@ -1179,75 +1581,105 @@ bool ffemu_finalize(ffemu_t *handle)
    return true;
 }
 
-static void ffemu_thread(void *data)
+static void ffemu_convert_thread(void *data)
 {
    ffemu_t *ff = (ffemu_t*)data;
 
-   // For some reason, FFmpeg has a tendency to crash if we don't overallocate a bit. :s
-   void *video_buf = av_malloc(2 * ff->params.fb_width * ff->params.fb_height * ff->video.pix_size);
-   assert(video_buf);
+   while (ff->alive)
+   {
+      if (!ffemu_convert_ready(ff, 0))
+      {
+         ffemu_sleep(ff, &ff->convert, ffemu_convert_ready, 0);
+         continue;
+      }
+
+      rarch_time_t start = rarch_get_time_usec();
 
-   size_t audio_buf_size = ff->audio.codec->frame_size * ff->params.channels * sizeof(int16_t);
-   void *audio_buf = av_malloc(audio_buf_size);
+      struct ffemu_frame *frame = (struct ffemu_frame*)ffemu_ring_read_ptr(&ff->video_queue);
+      ffemu_wake(ff, &ff->producer);
+
+      struct ffemu_conv_frame *conv = NULL;
+      if (frame)
+      {
+         conv = ffemu_convert_frame(ff, frame);
+         ff->convert.items++;
+      }
+
+      ffemu_ring_write_ptr(&ff->conv_queue, conv);
+      ffemu_wake(ff, &ff->encode);
+
+      ff->convert.busy_usec += rarch_get_time_usec() - start;
+   }
+}
+
+static void ffemu_encode_thread(void *data)
+{
+   ffemu_t *ff = (ffemu_t*)data;
 
    while (ff->alive)
    {
-      struct ffemu_video_data attr_buf;
-
-      bool avail_video = false;
-      bool avail_audio = false;
+      if (!ffemu_encode_ready(ff, 0))
+      {
+         ffemu_sleep(ff, &ff->encode, ffemu_encode_ready, 0);
+         continue;
+      }
 
-      slock_lock(ff->lock);
-      if (fifo_read_avail(ff->attr_fifo) >= sizeof(attr_buf))
-         avail_video = true;
+      rarch_time_t start = rarch_get_time_usec();
 
-      if (fifo_read_avail(ff->audio_fifo) >= audio_buf_size)
-         avail_audio = true;
-      slock_unlock(ff->lock);
+      struct ffemu_conv_frame *conv = (struct ffemu_conv_frame*)ffemu_ring_read_ptr(&ff->conv_queue);
+      ffemu_wake(ff, &ff->convert);
 
-      if (!avail_video && !avail_audio)
+      AVPacket pkt;
+      if (ffemu_encode_frame(ff, conv, &pkt) && pkt.size)
       {
-         slock_lock(ff->cond_lock);
-         if (ff->can_sleep)
+         // The packet points into the encoder's output buffer, which is reused right away.
+         uint8_t *data = (uint8_t*)av_malloc(pkt.size);
+         if (data)
          {
-            ff->can_sleep = false;
-            scond_wait(ff->cond, ff->cond_lock);
-            ff->can_sleep = true;
+            memcpy(data, pkt.data, pkt.size);
+            pkt.data = data;
+            ffemu_ring_write(&ff->packet_queue, &pkt, sizeof(pkt));
+            ffemu_wake(ff, &ff->mux);
          }
-         else
-            scond_signal(ff->cond);
+      }
 
-         slock_unlock(ff->cond_lock);
+      ff->encode.items++;
+      ff->encode.busy_usec += rarch_get_time_usec() - start;
+   }
+}
+
+static void ffemu_mux_thread(void *data)
+{
+   ffemu_t *ff = (ffemu_t*)data;
+   void *audio_buf = av_malloc(ff->audio_chunk_size);
+
+   while (ff->alive)
+   {
+      bool avail_packet = ffemu_ring_read_avail(&ff->packet_queue) >= sizeof(AVPacket);
+      bool avail_audio  = ffemu_ring_read_avail(&ff->audio_queue) >= ff->audio_chunk_size;
+
+      if (!avail_packet && !avail_audio)
+      {
+         ffemu_sleep(ff, &ff->mux, ffemu_mux_ready, 0);
+         continue;
       }
 
-      if (avail_video)
+      rarch_time_t start = rarch_get_time_usec();
+
+      if (avail_packet)
       {
-         slock_lock(ff->lock);
-         fifo_read(ff->attr_fifo, &attr_buf, sizeof(attr_buf));
-         fifo_read(ff->video_fifo, video_buf, attr_buf.height * attr_buf.pitch);
-         slock_unlock(ff->lock);
-         scond_signal(ff->cond);
-
-         attr_buf.data = video_buf;
-         ffemu_push_video_thread(ff, &attr_buf);
+         ffemu_mux_queued_packet(ff);
+         ff->mux.items++;
       }
 
       if (avail_audio)
       {
-         slock_lock(ff->lock);
-         fifo_read(ff->audio_fifo, audio_buf, audio_buf_size);
-         slock_unlock(ff->lock);
-         scond_signal(ff->cond);
-
-         struct ffemu_audio_data aud = {0};
-         aud.frames = ff->audio.codec->frame_size;
-         aud.data = audio_buf;
-
-         ffemu_push_audio_thread(ff, &aud, true);
+         ffemu_pop_audio(ff, audio_buf);
+         ff->mux.items++;
       }
+
+      ff->mux.busy_usec += rarch_get_time_usec() - start;
    }
 
-   av_free(video_buf);
    av_free(audio_buf);
 }
-
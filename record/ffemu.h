@@ -61,6 +61,10 @@ struct ffemu_params
 
    // Path to config. Optional.
    const char *config;
+
+   // Encode every frame pushed, ignoring frame_drop_ratio from config.
+   // Used when rendering offline, where there is no realtime budget to protect.
+   bool keep_all_frames;
 };
 
 struct ffemu_video_data
@@ -0,0 +1,667 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rawcap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../thread.h"
+#include "../fifo_buffer.h"
+#include "../general.h"
+
+#define RAWCAP_MAX_FRAMES 32
+
+bool rawcap_delta_encode(uint32_t *out, size_t max_words,
+      const uint32_t *prev, const uint32_t *cur, size_t words, size_t *size)
+{
+   size_t out_pos = 0;
+   size_t i = 0;
+
+   while (i < words)
+   {
+      size_t skip_start = i;
+      while (i < words && prev[i] == cur[i])
+         i++;
+      if (i == words)
+         break;
+
+      // A single unchanged word is cheaper to XOR than to start a new run for.
+      size_t run_start = i;
+      while (i < words && (prev[i] != cur[i] || (i + 1 < words && prev[i + 1] != cur[i + 1])))
+         i++;
+
+      size_t count = i - run_start;
+      if (out_pos + 2 + count > max_words)
+         return false;
+
+      out[out_pos++] = run_start - skip_start;
+      out[out_pos++] = count;
+      for (size_t j = run_start; j < i; j++)
+         out[out_pos++] = prev[j] ^ cur[j];
+   }
+
+   *size = out_pos * sizeof(uint32_t);
+   return true;
+}
+
+bool rawcap_delta_apply(uint32_t *frame, size_t words,
+      const uint32_t *delta, size_t delta_words)
+{
+   size_t pos = 0;
+   size_t i = 0;
+
+   while (i + 2 <= delta_words)
+   {
+      size_t skip  = delta[i++];
+      size_t count = delta[i++];
+
+      if (skip > words - pos || count > words - pos - skip || count > delta_words - i)
+         return false;
+
+      pos += skip;
+      for (size_t j = 0; j < count; j++)
+         frame[pos++] ^= delta[i++];
+   }
+
+   return i == delta_words;
+}
+
+unsigned rawcap_pix_size(enum ffemu_pix_format pix_fmt)
+{
+   switch (pix_fmt)
+   {
+      case FFEMU_PIX_RGB565:
+         return 2;
+      case FFEMU_PIX_BGR24:
+         return 3;
+      case FFEMU_PIX_ARGB8888:
+         return 4;
+      default:
+         return 0;
+   }
+}
+
+struct rawcap_slot
+{
+   uint32_t *data; // Tightly packed, zero padded to whole words.
+   unsigned width;
+   unsigned height;
+   bool is_dupe;
+};
+
+struct rawcap
+{
+   struct ffemu_params params;
+   FILE *file;
+   unsigned pix_size;
+   size_t frame_words;
+
+   // Filled by the emulator thread, drained by the writer thread.
+   // The emulator only copies frames and samples in, everything else happens on the writer thread.
+   struct rawcap_slot slots[RAWCAP_MAX_FRAMES];
+   unsigned slot_read;
+   unsigned slot_count;
+   fifo_buffer_t *audio_fifo;
+
+   slock_t *lock;
+   scond_t *cond;
+   scond_t *space_cond;
+   sthread_t *thread;
+   bool alive;
+
+   // Writer thread only.
+   uint32_t *prev; // Last frame written, swapped with slot buffers.
+   unsigned prev_width;
+   unsigned prev_height;
+   bool has_prev;
+   unsigned since_key;
+   uint32_t *delta;
+   int16_t *audio_buf;
+   size_t audio_buf_size;
+   bool error;
+
+   uint64_t frames;
+   uint64_t key_frames;
+   uint64_t audio_frames;
+   uint64_t video_bytes;
+};
+
+static void rawcap_write(rawcap_t *handle, const void *data, size_t size)
+{
+   if (!size || handle->error)
+      return;
+
+   if (fwrite(data, 1, size, handle->file) != size)
+   {
+      RARCH_ERR("[RawCap]: Failed to write to %s.\n", handle->params.filename);
+      handle->error = true;
+   }
+}
+
+static void rawcap_write_chunk(rawcap_t *handle, enum rawcap_chunk_type type,
+      const void *head, size_t head_size, const void *data, size_t size)
+{
+   static const uint8_t padding[8] = {0};
+
+   struct rawcap_chunk chunk;
+   chunk.type = type;
+   chunk.size = head_size + size;
+
+   rawcap_write(handle, &chunk, sizeof(chunk));
+   rawcap_write(handle, head, head_size);
+   rawcap_write(handle, data, size);
+   rawcap_write(handle, padding, RAWCAP_ALIGN(chunk.size) - chunk.size);
+}
+
+static void rawcap_write_frame(rawcap_t *handle, struct rawcap_slot *slot)
+{
+   handle->frames++;
+
+   if (slot->is_dupe)
+   {
+      rawcap_write_chunk(handle, RAWCAP_CHUNK_DUPE, NULL, 0, NULL, 0);
+      return;
+   }
+
+   size_t size  = slot->width * slot->height * handle->pix_size;
+   size_t words = (size + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+   struct rawcap_frame frame;
+   frame.width  = slot->width;
+   frame.height = slot->height;
+
+   bool key = !handle->has_prev || handle->since_key >= RAWCAP_KEY_INTERVAL ||
+      slot->width != handle->prev_width || slot->height != handle->prev_height;
+
+   size_t delta_size = 0;
+   if (key || !rawcap_delta_encode(handle->delta, words, handle->prev, slot->data, words, &delta_size))
+   {
+      rawcap_write_chunk(handle, RAWCAP_CHUNK_KEY, &frame, sizeof(frame), slot->data, size);
+      handle->video_bytes += size;
+      handle->key_frames++;
+      handle->since_key = 0;
+   }
+   else
+   {
+      if (delta_size)
+         rawcap_write_chunk(handle, RAWCAP_CHUNK_DELTA, &frame, sizeof(frame), handle->delta, delta_size);
+      else
+         rawcap_write_chunk(handle, RAWCAP_CHUNK_DUPE, NULL, 0, NULL, 0);
+      handle->video_bytes += delta_size;
+      handle->since_key++;
+   }
+
+   // Keep the frame we just wrote for the next delta, and hand our old one back to the queue.
+   uint32_t *tmp      = handle->prev;
+   handle->prev       = slot->data;
+   slot->data         = tmp;
+   handle->prev_width  = slot->width;
+   handle->prev_height = slot->height;
+   handle->has_prev    = true;
+}
+
+static void rawcap_thread(void *data)
+{
+   rawcap_t *handle = (rawcap_t*)data;
+   size_t sample_size = handle->params.channels * sizeof(int16_t);
+
+   for (;;)
+   {
+      slock_lock(handle->lock);
+      while (handle->alive && !handle->slot_count && fifo_read_avail(handle->audio_fifo) < sample_size)
+         scond_wait(handle->cond, handle->lock);
+
+      // Audio is pushed in arbitrary pieces, only take whole samples.
+      size_t audio_size = fifo_read_avail(handle->audio_fifo);
+      if (audio_size > handle->audio_buf_size)
+         audio_size = handle->audio_buf_size;
+      audio_size -= audio_size % sample_size;
+      fifo_read(handle->audio_fifo, handle->audio_buf, audio_size);
+
+      // Slots are only filled at the back, so the front one is ours until we give it back.
+      struct rawcap_slot *slot = handle->slot_count ? &handle->slots[handle->slot_read] : NULL;
+      bool done = !handle->alive && !slot && !audio_size;
+
+      if (audio_size)
+         scond_signal(handle->space_cond);
+      slock_unlock(handle->lock);
+
+      if (done)
+         break;
+
+      if (audio_size)
+      {
+         rawcap_write_chunk(handle, RAWCAP_CHUNK_AUDIO, NULL, 0, handle->audio_buf, audio_size);
+         handle->audio_frames += audio_size / sample_size;
+      }
+
+      if (slot)
+      {
+         rawcap_write_frame(handle, slot);
+
+         slock_lock(handle->lock);
+         handle->slot_read = (handle->slot_read + 1) % RAWCAP_MAX_FRAMES;
+         handle->slot_count--;
+         scond_signal(handle->space_cond);
+         slock_unlock(handle->lock);
+      }
+   }
+}
+
+rawcap_t *rawcap_new(const struct ffemu_params *params)
+{
+   rawcap_t *handle = (rawcap_t*)calloc(1, sizeof(*handle));
+   if (!handle)
+      return NULL;
+
+   handle->params      = *params;
+   handle->pix_size    = rawcap_pix_size(params->pix_fmt);
+   handle->frame_words = (params->fb_width * params->fb_height * handle->pix_size +
+         sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+   handle->file = fopen(params->filename, "wb");
+   if (!handle->file)
+   {
+      RARCH_ERR("[RawCap]: Failed to open %s for writing.\n", params->filename);
+      goto error;
+   }
+   // Writes are big already, but audio chunks are not.
+   setvbuf(handle->file, NULL, _IOFBF, 1 << 20);
+
+   for (unsigned i = 0; i < RAWCAP_MAX_FRAMES; i++)
+   {
+      handle->slots[i].data = (uint32_t*)calloc(handle->frame_words, sizeof(uint32_t));
+      if (!handle->slots[i].data)
+         goto error;
+   }
+
+   handle->prev  = (uint32_t*)calloc(handle->frame_words, sizeof(uint32_t));
+   handle->delta = (uint32_t*)malloc(handle->frame_words * sizeof(uint32_t));
+
+   handle->audio_buf_size = 32000 * sizeof(int16_t) * params->channels * RAWCAP_MAX_FRAMES / 60; // Some arbitrary max size.
+   handle->audio_buf      = (int16_t*)malloc(handle->audio_buf_size);
+   handle->audio_fifo     = fifo_new(handle->audio_buf_size);
+
+   if (!handle->prev || !handle->delta || !handle->audio_buf || !handle->audio_fifo)
+      goto error;
+
+   struct rawcap_header header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, RAWCAP_MAGIC, sizeof(header.magic));
+   header.version      = RAWCAP_VERSION;
+   header.byte_order   = RAWCAP_BYTE_ORDER;
+   header.pix_fmt      = params->pix_fmt;
+   header.fb_width     = params->fb_width;
+   header.fb_height    = params->fb_height;
+   header.out_width    = params->out_width;
+   header.out_height   = params->out_height;
+   header.channels     = params->channels;
+   header.aspect_ratio = params->aspect_ratio;
+   header.fps          = params->fps;
+   header.samplerate   = params->samplerate;
+
+   rawcap_write(handle, &header, sizeof(header));
+   if (handle->error)
+      goto error;
+
+   handle->lock       = slock_new();
+   handle->cond       = scond_new();
+   handle->space_cond = scond_new();
+   if (!handle->lock || !handle->cond || !handle->space_cond)
+      goto error;
+
+   handle->alive  = true;
+   handle->thread = sthread_create(rawcap_thread, handle);
+   if (!handle->thread)
+   {
+      handle->alive = false;
+      goto error;
+   }
+
+   return handle;
+
+error:
+   rawcap_free(handle);
+   return NULL;
+}
+
+static void rawcap_stop_thread(rawcap_t *handle)
+{
+   if (!handle->thread)
+      return;
+
+   // The writer drains everything still queued up before it exits.
+   slock_lock(handle->lock);
+   handle->alive = false;
+   scond_signal(handle->cond);
+   scond_signal(handle->space_cond);
+   slock_unlock(handle->lock);
+
+   sthread_join(handle->thread);
+   handle->thread = NULL;
+}
+
+void rawcap_free(rawcap_t *handle)
+{
+   if (!handle)
+      return;
+
+   rawcap_stop_thread(handle);
+
+   if (handle->file)
+      fclose(handle->file);
+
+   for (unsigned i = 0; i < RAWCAP_MAX_FRAMES; i++)
+      free(handle->slots[i].data);
+   free(handle->prev);
+   free(handle->delta);
+   free(handle->audio_buf);
+   if (handle->audio_fifo)
+      fifo_free(handle->audio_fifo);
+
+   if (handle->lock)
+      slock_free(handle->lock);
+   if (handle->cond)
+      scond_free(handle->cond);
+   if (handle->space_cond)
+      scond_free(handle->space_cond);
+
+   free(handle);
+}
+
+bool rawcap_push_video(rawcap_t *handle, const struct ffemu_video_data *data)
+{
+   if (!data->is_dupe && (data->width > handle->params.fb_width || data->height > handle->params.fb_height))
+      return false;
+
+   slock_lock(handle->lock);
+   while (handle->alive && handle->slot_count == RAWCAP_MAX_FRAMES)
+      scond_wait(handle->space_cond, handle->lock);
+   bool alive = handle->alive;
+   // Only the writer thread frees up slots, so the back one stays ours until we publish it.
+   struct rawcap_slot *slot = &handle->slots[(handle->slot_read + handle->slot_count) % RAWCAP_MAX_FRAMES];
+   slock_unlock(handle->lock);
+
+   if (!alive)
+      return false;
+
+   slot->is_dupe = data->is_dupe;
+
+   if (!data->is_dupe)
+   {
+      size_t pitch = data->width * handle->pix_size;
+      size_t size  = pitch * data->height;
+
+      slot->width  = data->width;
+      slot->height = data->height;
+
+      uint8_t *dst = (uint8_t*)slot->data;
+      const uint8_t *src = (const uint8_t*)data->data;
+      for (unsigned y = 0; y < data->height; y++, src += data->pitch, dst += pitch)
+         memcpy(dst, src, pitch);
+
+      // Deltas work on whole words.
+      memset((uint8_t*)slot->data + size, 0,
+            ((size + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1)) - size);
+   }
+
+   slock_lock(handle->lock);
+   handle->slot_count++;
+   scond_signal(handle->cond);
+   slock_unlock(handle->lock);
+
+   return true;
+}
+
+bool rawcap_push_audio(rawcap_t *handle, const struct ffemu_audio_data *data)
+{
+   const uint8_t *samples = (const uint8_t*)data->data;
+   size_t size = data->frames * handle->params.channels * sizeof(int16_t);
+
+   while (size)
+   {
+      slock_lock(handle->lock);
+      while (handle->alive && !fifo_write_avail(handle->audio_fifo))
+         scond_wait(handle->space_cond, handle->lock);
+
+      if (!handle->alive)
+      {
+         slock_unlock(handle->lock);
+         return false;
+      }
+
+      size_t avail = fifo_write_avail(handle->audio_fifo);
+      size_t write_size = size > avail ? avail : size;
+      fifo_write(handle->audio_fifo, samples, write_size);
+      scond_signal(handle->cond);
+      slock_unlock(handle->lock);
+
+      samples += write_size;
+      size    -= write_size;
+   }
+
+   return true;
+}
+
+bool rawcap_finalize(rawcap_t *handle)
+{
+   rawcap_stop_thread(handle);
+
+   struct rawcap_end end;
+   end.frames       = handle->frames;
+   end.audio_frames = handle->audio_frames;
+   rawcap_write_chunk(handle, RAWCAP_CHUNK_END, &end, sizeof(end), NULL, 0);
+
+   if (fflush(handle->file) != 0)
+      handle->error = true;
+
+   RARCH_LOG("[RawCap]: Wrote %llu frames (%llu key frames, %.1f MiB of video), %llu audio frames.\n",
+         (unsigned long long)handle->frames, (unsigned long long)handle->key_frames,
+         handle->video_bytes / (1024.0 * 1024.0), (unsigned long long)handle->audio_frames);
+
+   return !handle->error;
+}
+
+struct rawcap_reader
+{
+   FILE *file;
+   struct rawcap_header header;
+   unsigned pix_size;
+
+   uint32_t *frame; // Current frame, zero padded to whole words.
+   size_t frame_words;
+   unsigned width;
+   unsigned height;
+   bool has_frame;
+   bool finished;
+
+   uint8_t *buf; // Chunk payload.
+   size_t buf_size;
+};
+
+rawcap_reader_t *rawcap_reader_new(const char *path)
+{
+   struct rawcap_header *header = NULL;
+   rawcap_reader_t *reader = (rawcap_reader_t*)calloc(1, sizeof(*reader));
+   if (!reader)
+      return NULL;
+
+   header = &reader->header;
+   reader->file = fopen(path, "rb");
+   if (!reader->file)
+   {
+      RARCH_ERR("[RawCap]: Failed to open %s.\n", path);
+      goto error;
+   }
+
+   if (fread(header, sizeof(*header), 1, reader->file) != 1 ||
+         memcmp(header->magic, RAWCAP_MAGIC, sizeof(header->magic)) != 0)
+   {
+      RARCH_ERR("[RawCap]: %s is not a raw capture.\n", path);
+      goto error;
+   }
+
+   if (header->byte_order != RAWCAP_BYTE_ORDER || header->version != RAWCAP_VERSION)
+   {
+      RARCH_ERR("[RawCap]: %s was recorded with an incompatible version or byte order.\n", path);
+      goto error;
+   }
+
+   reader->pix_size = rawcap_pix_size((enum ffemu_pix_format)header->pix_fmt);
+   if (!reader->pix_size || !header->fb_width || !header->fb_height || !header->channels)
+   {
+      RARCH_ERR("[RawCap]: %s has an invalid header.\n", path);
+      goto error;
+   }
+
+   reader->frame_words = ((size_t)header->fb_width * header->fb_height * reader->pix_size +
+         sizeof(uint32_t) - 1) / sizeof(uint32_t);
+   reader->frame = (uint32_t*)calloc(reader->frame_words, sizeof(uint32_t));
+   if (!reader->frame)
+      goto error;
+
+   return reader;
+
+error:
+   rawcap_reader_free(reader);
+   return NULL;
+}
+
+void rawcap_reader_free(rawcap_reader_t *reader)
+{
+   if (!reader)
+      return;
+
+   if (reader->file)
+      fclose(reader->file);
+   free(reader->frame);
+   free(reader->buf);
+   free(reader);
+}
+
+const struct rawcap_header *rawcap_reader_header(const rawcap_reader_t *reader)
+{
+   return &reader->header;
+}
+
+static bool rawcap_reader_read_chunk(rawcap_reader_t *reader, struct rawcap_chunk *chunk)
+{
+   if (fread(chunk, sizeof(*chunk), 1, reader->file) != 1)
+      return false;
+
+   size_t size = RAWCAP_ALIGN(chunk->size);
+   if (size > reader->buf_size)
+   {
+      // A chunk never holds more than a whole frame, or the writer's audio buffer.
+      if (size > sizeof(struct rawcap_frame) + reader->frame_words * sizeof(uint32_t) + (64 << 20))
+         return false;
+
+      uint8_t *buf = (uint8_t*)realloc(reader->buf, size);
+      if (!buf)
+         return false;
+      reader->buf      = buf;
+      reader->buf_size = size;
+   }
+
+   return fread(reader->buf, 1, size, reader->file) == size;
+}
+
+bool rawcap_reader_next(rawcap_reader_t *reader, struct rawcap_packet *pkt)
+{
+   memset(pkt, 0, sizeof(*pkt));
+
+   struct rawcap_chunk chunk;
+   if (!rawcap_reader_read_chunk(reader, &chunk))
+      return false;
+
+   // Chunks unknown to us can be skipped.
+   while (chunk.type > RAWCAP_CHUNK_END)
+      if (!rawcap_reader_read_chunk(reader, &chunk))
+         return false;
+
+   switch (chunk.type)
+   {
+      case RAWCAP_CHUNK_AUDIO:
+      {
+         size_t frame_size = reader->header.channels * sizeof(int16_t);
+         pkt->type         = RAWCAP_CHUNK_AUDIO;
+         pkt->data         = reader->buf;
+         pkt->audio_frames = chunk.size / frame_size;
+         return true;
+      }
+
+      case RAWCAP_CHUNK_DUPE:
+         pkt->type = RAWCAP_CHUNK_DUPE;
+         return true;
+
+      case RAWCAP_CHUNK_KEY:
+      case RAWCAP_CHUNK_DELTA:
+      {
+         if (chunk.size < sizeof(struct rawcap_frame))
+            return false;
+
+         struct rawcap_frame frame;
+         memcpy(&frame, reader->buf, sizeof(frame));
+         if (!frame.width || !frame.height ||
+               frame.width > reader->header.fb_width || frame.height > reader->header.fb_height)
+            return false;
+
+         size_t size    = frame.width * frame.height * reader->pix_size;
+         size_t words   = (size + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+         const uint8_t *payload = reader->buf + sizeof(frame);
+         size_t payload_size    = chunk.size - sizeof(frame);
+
+         if (chunk.type == RAWCAP_CHUNK_KEY)
+         {
+            if (payload_size != size)
+               return false;
+            memcpy(reader->frame, payload, size);
+            memset((uint8_t*)reader->frame + size, 0, words * sizeof(uint32_t) - size);
+         }
+         else
+         {
+            if (!reader->has_frame || frame.width != reader->width || frame.height != reader->height ||
+                  payload_size % sizeof(uint32_t) ||
+                  !rawcap_delta_apply(reader->frame, words, (const uint32_t*)payload,
+                     payload_size / sizeof(uint32_t)))
+               return false;
+         }
+
+         reader->width     = frame.width;
+         reader->height    = frame.height;
+         reader->has_frame = true;
+
+         pkt->type   = RAWCAP_CHUNK_KEY;
+         pkt->data   = reader->frame;
+         pkt->width  = frame.width;
+         pkt->height = frame.height;
+         pkt->pitch  = frame.width * reader->pix_size;
+         return true;
+      }
+
+      case RAWCAP_CHUNK_END:
+         reader->finished = true;
+         return false;
+
+      default:
+         return false;
+   }
+}
+
+bool rawcap_reader_finished(const rawcap_reader_t *reader)
+{
+   return reader->finished;
+}
+
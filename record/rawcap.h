@@ -0,0 +1,152 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RAWCAP_H
+#define __RAWCAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../boolean.h"
+#include "ffemu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lossless raw capture (.rcap).
+// Video is stored exactly as the core rendered it, either as whole frames (key frames),
+// or as XOR deltas against the previous frame, run-length coded much like the rewind buffer.
+// Audio is stored as interleaved S16 PCM.
+// Recording costs the emulator thread a frame copy. Use retroarch-transcode to encode it afterwards.
+//
+// The file is a struct rawcap_header, followed by chunks until end of file.
+// Every chunk starts with a struct rawcap_chunk and is padded to 8 bytes,
+// so the file can be written as a stream, and walked in place when memory mapped.
+// Everything is stored in the byte order of the recording machine, see byte_order.
+
+#define RAWCAP_MAGIC "RARCHCAP"
+#define RAWCAP_VERSION 1
+#define RAWCAP_BYTE_ORDER 0x01020304U
+#define RAWCAP_EXTENSION "rcap"
+
+// Force a key frame this often, so a frame never depends on a longer chain of deltas.
+// Reading still stops at the first damaged chunk.
+#define RAWCAP_KEY_INTERVAL 600
+
+#define RAWCAP_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+enum rawcap_chunk_type
+{
+   RAWCAP_CHUNK_KEY = 1, // struct rawcap_frame, then the frame, lines tightly packed.
+   RAWCAP_CHUNK_DELTA,   // struct rawcap_frame, then the delta against the previous frame.
+   RAWCAP_CHUNK_DUPE,    // Previous frame is shown again. No payload.
+   RAWCAP_CHUNK_AUDIO,   // Interleaved S16 samples.
+   RAWCAP_CHUNK_END      // struct rawcap_end. Missing if recording was cut short.
+};
+
+struct rawcap_header
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t byte_order;
+
+   uint32_t pix_fmt; // enum ffemu_pix_format
+   uint32_t fb_width; // Upper bound for frame sizes.
+   uint32_t fb_height;
+   uint32_t out_width; // Output size requested at record time.
+   uint32_t out_height;
+   uint32_t channels;
+   float aspect_ratio;
+   uint32_t reserved;
+
+   double fps;
+   double samplerate;
+};
+
+struct rawcap_chunk
+{
+   uint32_t type; // enum rawcap_chunk_type
+   uint32_t size; // Payload size, not counting padding.
+};
+
+struct rawcap_frame
+{
+   uint32_t width;
+   uint32_t height;
+};
+
+struct rawcap_end
+{
+   uint64_t frames; // Including dupes.
+   uint64_t audio_frames;
+};
+
+// The delta is a sequence of runs over the frame as 32-bit words (frames are zero padded to whole words):
+// uint32_t skip (unchanged words), uint32_t count, then count words to XOR into the previous frame.
+// Words after the last run are unchanged.
+
+// Returns false if the delta would not fit in max_words. *size is set to the size in bytes,
+// which is 0 if the frames are identical.
+bool rawcap_delta_encode(uint32_t *out, size_t max_words,
+      const uint32_t *prev, const uint32_t *cur, size_t words, size_t *size);
+
+// Applies delta to frame in place. Returns false if delta is corrupt.
+bool rawcap_delta_apply(uint32_t *frame, size_t words,
+      const uint32_t *delta, size_t delta_words);
+
+unsigned rawcap_pix_size(enum ffemu_pix_format pix_fmt);
+
+// Writer. Takes the same parameters and data as ffemu_t.
+typedef struct rawcap rawcap_t;
+
+rawcap_t *rawcap_new(const struct ffemu_params *params);
+void rawcap_free(rawcap_t *handle);
+
+bool rawcap_push_video(rawcap_t *handle, const struct ffemu_video_data *data);
+bool rawcap_push_audio(rawcap_t *handle, const struct ffemu_audio_data *data);
+bool rawcap_finalize(rawcap_t *handle);
+
+// Reader.
+typedef struct rawcap_reader rawcap_reader_t;
+
+struct rawcap_packet
+{
+   // RAWCAP_CHUNK_KEY for all decoded frames, RAWCAP_CHUNK_DUPE or RAWCAP_CHUNK_AUDIO.
+   enum rawcap_chunk_type type;
+
+   // Video: decoded frame, lines tightly packed. Audio: interleaved S16 samples.
+   const void *data;
+   unsigned width;
+   unsigned height;
+   size_t pitch;
+
+   size_t audio_frames;
+};
+
+rawcap_reader_t *rawcap_reader_new(const char *path);
+void rawcap_reader_free(rawcap_reader_t *reader);
+
+const struct rawcap_header *rawcap_reader_header(const rawcap_reader_t *reader);
+// Returns false at end of capture, or if the rest of the file is damaged.
+bool rawcap_reader_next(rawcap_reader_t *reader, struct rawcap_packet *pkt);
+// Whether the capture was read up to its end chunk, i.e. it was finalized and is undamaged.
+bool rawcap_reader_finished(const rawcap_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -27,6 +27,7 @@
 #include "performance.h"
 #include "audio/utils.h"
 #include "record/ffemu.h"
+#include "record/rawcap.h"
 #include "rewind.h"
 #include "movie.h"
 #include "compat/strl.h"
@@ -89,16 +90,10 @@ static bool take_screenshot_viewport(void)
    }
 
    // Data read from viewport is in bottom-up order, suitable for BMP.
-   if (!screenshot_dump(g_settings.screenshot_directory,
+   // The buffer is handed over to the screenshot encoder.
+   return screenshot_dump_buffer(g_settings.screenshot_directory,
          buffer,
-         vp.width, vp.height, vp.width * 3, true))
-   {
-      free(buffer);
-      return false;
-   }
-
-   free(buffer);
-   return true;
+         vp.width, vp.height, vp.width * 3, true);
 }
 
 static bool take_screenshot_raw(void)
@@ -115,23 +110,79 @@ static bool take_screenshot_raw(void)
          width, height, -pitch, false);
 }
 
-void rarch_take_screenshot(void)
+static bool use_screenshot_viewport(void)
 {
-   if (!(*g_settings.screenshot_directory))
-      return;
+   return (g_settings.video.gpu_screenshot ||
+            g_extern.system.hw_render_callback.context_type != RETRO_HW_CONTEXT_NONE) &&
+         driver.video->read_viewport &&
+         driver.video->viewport_info;
+}
+
+// GPU screenshots taken from the main loop are read back asynchronously when the driver can,
+// so the capture doesn't stall rendering like a synchronous read_viewport() does.
+// The frame is mapped a few frames later in poll_screenshot_viewport().
+#define SCREENSHOT_MAP_FRAMES 8
+static unsigned screenshot_map_frames;
+
+static bool poll_screenshot_viewport(void)
+{
+   unsigned pitch = 0;
+   const void *frame = driver.video_poke->map_viewport(driver.video_data, &pitch);
+   if (!frame)
+   {
+      if (--screenshot_map_frames)
+         return true; // Not read back yet, come back next frame.
+
+      RARCH_WARN("Asynchronous screenshot readback timed out. Reading viewport directly.\n");
+      return take_screenshot_viewport();
+   }
+
+   screenshot_map_frames = 0;
 
+   struct rarch_viewport vp = {0};
+   video_viewport_info_func(&vp);
+
+   // Mapped frame is bottom-up ARGB8888. It is copied before returning,
+   // and converted on the encoder thread.
+   bool ret = screenshot_dump_xrgb8888(g_settings.screenshot_directory,
+         frame, vp.width, vp.height, pitch);
+   driver.video_poke->unmap_viewport(driver.video_data);
+   return ret;
+}
+
+static bool use_screenshot_viewport_async(void)
+{
+   return !g_extern.is_paused && use_screenshot_viewport() &&
+         driver.video_poke && driver.video_poke->map_viewport && driver.video_poke->unmap_viewport;
+}
+
+static bool take_screenshot(bool async)
+{
    bool ret = false;
 
-   if ((g_settings.video.gpu_screenshot ||
-            g_extern.system.hw_render_callback.context_type != RETRO_HW_CONTEXT_NONE) &&
-         driver.video->read_viewport &&
-         driver.video->viewport_info)
+   if (async && use_screenshot_viewport_async())
+   {
+      // The first map request kicks off the readback of the current frame.
+      screenshot_map_frames = SCREENSHOT_MAP_FRAMES;
+      ret = poll_screenshot_viewport();
+   }
+   else if (use_screenshot_viewport())
       ret = take_screenshot_viewport();
    else if (g_extern.frame_cache.data && (g_extern.frame_cache.data != RETRO_HW_FRAME_BUFFER_VALID))
       ret = take_screenshot_raw();
    else
       RARCH_ERR("Cannot take screenshot. GPU rendering is used and read_viewport is not supported.\n");
 
+   return ret;
+}
+
+static void take_screenshot_notify(bool async)
+{
+   if (!(*g_settings.screenshot_directory))
+      return;
+
+   bool ret = take_screenshot(async);
+
    const char *msg = NULL;
    if (ret)
    {
@@ -154,6 +205,11 @@ void rarch_take_screenshot(void)
    else
       msg_queue_push(g_extern.msg_queue, msg, 1, 180);
 }
+
+void rarch_take_screenshot(void)
+{
+   take_screenshot_notify(false);
+}
 #endif
 
 static void readjust_audio_input_rate(void)
@@ -180,11 +236,19 @@ static void readjust_audio_input_rate(void)
 #ifdef HAVE_FFMPEG
 static void deinit_recording(void);
 
+static void recording_push_video(const struct ffemu_video_data *data)
+{
+   if (g_extern.rec_raw)
+      rawcap_push_video(g_extern.rec_raw, data);
+   else
+      ffemu_push_video(g_extern.rec, data);
+}
+
 static void recording_dump_frame(const void *data, unsigned width, unsigned height, size_t pitch)
 {
    struct ffemu_video_data ffemu_data = {0};
 
-   if (g_extern.record_gpu_buffer)
+   if (g_extern.record_gpu_buffer || g_extern.record_gpu_mapped)
    {
       struct rarch_viewport vp = {0};
       video_viewport_info_func(&vp);
@@ -193,6 +257,7 @@ static void recording_dump_frame(const void *data, unsigned width, unsigned heig
          RARCH_WARN("Viewport size calculation failed! Will continue using raw data. This will probably not work right ...\n");
          free(g_extern.record_gpu_buffer);
          g_extern.record_gpu_buffer = NULL;
+         g_extern.record_gpu_mapped = false;
 
          recording_dump_frame(data, width, height, pitch);
          return;
@@ -211,6 +276,27 @@ static void recording_dump_frame(const void *data, unsigned width, unsigned heig
          return;
       }
 
+      if (g_extern.record_gpu_mapped)
+      {
+         // Push the driver's readback buffer straight to the recorder.
+         // The frame is only copied once, into the recording queue.
+         // Frames are read back asynchronously, so it takes a few frames before one is ready.
+         unsigned mapped_pitch;
+         const void *mapped = driver.video_poke->map_viewport(driver.video_data, &mapped_pitch);
+         if (!mapped)
+            return;
+
+         ffemu_data.pitch  = mapped_pitch;
+         ffemu_data.width  = g_extern.record_gpu_width;
+         ffemu_data.height = g_extern.record_gpu_height;
+         ffemu_data.data   = (const uint8_t*)mapped + (ffemu_data.height - 1) * ffemu_data.pitch;
+         ffemu_data.pitch  = -ffemu_data.pitch;
+
+         recording_push_video(&ffemu_data);
+         driver.video_poke->unmap_viewport(driver.video_data);
+         return;
+      }
+
       // Big bottleneck.
       // Since we might need to do read-backs asynchronously, it might take 3-4 times
       // before this returns true ...
@@ -233,7 +319,7 @@ static void recording_dump_frame(const void *data, unsigned width, unsigned heig
       ffemu_data.is_dupe = !data;
    }
 
-   ffemu_push_video(g_extern.rec, &ffemu_data);
+   recording_push_video(&ffemu_data);
 }
 #endif
 
@@ -251,23 +337,62 @@ static void video_frame(const void *data, unsigned width, unsigned height, size_
    {
       RARCH_PERFORMANCE_INIT(video_frame_conv);
       RARCH_PERFORMANCE_START(video_frame_conv);
+
+      void *output                = driver.scaler_out;
+      unsigned out_pitch          = width * sizeof(uint16_t);
+      enum scaler_pix_fmt out_fmt = SCALER_FMT_RGB565;
+
+      // If only the video driver will see the converted frame,
+      // convert straight into its upload buffer so the frame is only touched once.
+      bool upload_direct = !g_extern.filter.active &&
+            driver.video_poke && driver.video_poke->get_upload_buffer;
+#ifdef HAVE_FFMPEG
+      upload_direct = upload_direct && !g_extern.recording;
+#endif
+
+      if (upload_direct)
+      {
+         unsigned upload_pitch;
+         enum scaler_pix_fmt upload_fmt;
+         void *upload = driver.video_poke->get_upload_buffer(driver.video_data,
+               width, height, &upload_pitch, &upload_fmt);
+
+         if (upload)
+         {
+            output    = upload;
+            out_pitch = upload_pitch;
+            out_fmt   = upload_fmt;
+         }
+      }
+
       driver.scaler.in_width = width;
       driver.scaler.in_height = height;
       driver.scaler.out_width = width;
       driver.scaler.out_height = height;
       driver.scaler.in_stride = pitch;
-      driver.scaler.out_stride = width * sizeof(uint16_t);
+      driver.scaler.out_stride = out_pitch;
+
+      if (driver.scaler.out_fmt != out_fmt)
+      {
+         driver.scaler.out_fmt = out_fmt;
+         if (!scaler_ctx_gen_filter(&driver.scaler))
+         {
+            RARCH_ERR("Failed to regenerate pixel converter.\n");
+            g_extern.video_active = false;
+            return;
+         }
+      }
 
-      scaler_ctx_scale(&driver.scaler, driver.scaler_out, data);
-      data = driver.scaler_out;
-      pitch = driver.scaler.out_stride;
+      scaler_ctx_scale(&driver.scaler, output, data);
+      data = output;
+      pitch = out_pitch;
       RARCH_PERFORMANCE_STOP(video_frame_conv);
    }
 
    // Slightly messy code,
    // but we really need to do processing before blocking on VSync for best possible scheduling.
 #ifdef HAVE_FFMPEG
-   if (g_extern.recording && (!g_extern.filter.active || !g_settings.video.post_filter_record || !data || g_extern.record_gpu_buffer))
+   if (g_extern.recording && (!g_extern.filter.active || !g_settings.video.post_filter_record || !data || g_extern.record_gpu_buffer || g_extern.record_gpu_mapped))
       recording_dump_frame(data, width, height, pitch);
 #endif
 
@@ -288,8 +413,18 @@ static void video_frame(const void *data, unsigned width, unsigned height, size_
       unsigned owidth = width;
       unsigned oheight = height;
       g_extern.filter.psize(&owidth, &oheight);
-      g_extern.filter.prender(g_extern.filter.colormap, g_extern.filter.buffer, 
-            g_extern.filter.pitch, g_extern.filter.scaler_out, scaler->out_stride, width, height);
+
+      RARCH_PERFORMANCE_INIT(filter_render);
+      RARCH_PERFORMANCE_START(filter_render);
+#ifdef HAVE_THREADS
+      if (g_extern.filter.threads)
+         filter_threads_render(g_extern.filter.threads, g_extern.filter.colormap, g_extern.filter.buffer,
+               g_extern.filter.pitch, g_extern.filter.scaler_out, scaler->out_stride, width, height);
+      else
+#endif
+         g_extern.filter.prender(g_extern.filter.colormap, g_extern.filter.buffer, 
+               g_extern.filter.pitch, g_extern.filter.scaler_out, scaler->out_stride, width, height);
+      RARCH_PERFORMANCE_STOP(filter_render);
 
 #ifdef HAVE_FFMPEG
       if (g_extern.recording && g_settings.video.post_filter_record)
@@ -341,7 +476,10 @@ static bool audio_flush(const int16_t *data, size_t samples)
       ffemu_data.data                    = data;
       ffemu_data.frames                  = samples / 2;
 
-      ffemu_push_audio(g_extern.rec, &ffemu_data);
+      if (g_extern.rec_raw)
+         rawcap_push_audio(g_extern.rec_raw, &ffemu_data);
+      else
+         ffemu_push_audio(g_extern.rec, &ffemu_data);
    }
 #endif
 
@@ -670,12 +808,14 @@ static void print_help(void)
 
 #ifdef HAVE_NETPLAY
    puts("\t-H/--host: Host netplay as player 1.");
-   puts("\t-C/--connect: Connect to netplay as player 2.");
+   puts("\t-C/--connect: Connect to netplay. The host decides which player you are.");
+   puts("\t--players: Number of players when hosting netplay, up to 8. Defaults to 2.");
    puts("\t--port: Port used to netplay. Default is 55435.");
    puts("\t-F/--frames: Sync frames when using netplay.");
    puts("\t--spectate: Netplay will become spectating mode.");
    puts("\t\tHost can live stream the game content to players that connect.");
    puts("\t\tHowever, the client will not be able to play. Multiple clients can connect to the host.");
+   puts("\t--relay: When spectating as a client, re-broadcasts the stream to other spectators on this port.");
    puts("\t--nick: Picks a nickname for use with netplay. Not mandatory.");
 #endif
 #ifdef HAVE_NETWORK_CMD
@@ -685,8 +825,14 @@ static void print_help(void)
 
 #ifdef HAVE_FFMPEG
    puts("\t-r/--record: Path to record video file.\n\t\tUsing .mkv extension is recommended.");
+   puts("\t\tUsing .rcap extension writes a lossless raw capture instead, which costs very little CPU.");
+   puts("\t\tConvert it to a regular video file afterwards with retroarch-transcode.");
    puts("\t--recordconfig: Path to settings used during recording.");
    puts("\t--size: Overrides output video size when recording with FFmpeg (format: WIDTHxHEIGHT).");
+#ifdef HAVE_BSV_MOVIE
+   puts("\t--render: Renders the movie given with --bsvplay to the file given with --record, then exits.");
+   puts("\t\tRuns headless and as fast as possible, without dropping any frames.");
+#endif
 #endif
    puts("\t-v/--verbose: Verbose logging.");
    puts("\t-U/--ups: Specifies path for UPS patch that will be applied to ROM.");
@@ -774,6 +920,9 @@ static void parse_input(int argc, char *argv[])
       { "record", 1, NULL, 'r' },
       { "recordconfig", 1, &val, 'R' },
       { "size", 1, &val, 's' },
+#ifdef HAVE_BSV_MOVIE
+      { "render", 0, &val, 'r' },
+#endif
 #endif
       { "verbose", 0, NULL, 'v' },
       { "gameboy", 1, NULL, 'g' },
@@ -803,6 +952,8 @@ static void parse_input(int argc, char *argv[])
       { "port", 1, &val, 'p' },
       { "spectate", 0, &val, 'S' },
       { "nick", 1, &val, 'N' },
+      { "relay", 1, &val, 'y' },
+      { "players", 1, &val, 'u' },
 #endif
 #ifdef HAVE_NETWORK_CMD
       { "command", 1, &val, 'c' },
@@ -1045,6 +1196,14 @@ static void parse_input(int argc, char *argv[])
                case 'N':
                   strlcpy(g_extern.netplay_nick, optarg, sizeof(g_extern.netplay_nick));
                   break;
+
+               case 'y':
+                  g_extern.netplay_relay_port = strtoul(optarg, NULL, 0);
+                  break;
+
+               case 'u':
+                  g_extern.netplay_players = strtoul(optarg, NULL, 0);
+                  break;
 #endif
 
 #ifdef HAVE_NETWORK_CMD
@@ -1101,6 +1260,12 @@ static void parse_input(int argc, char *argv[])
                case 'R':
                   strlcpy(g_extern.record_config, optarg, sizeof(g_extern.record_config));
                   break;
+
+#ifdef HAVE_BSV_MOVIE
+               case 'r':
+                  g_extern.bsv.movie_render = true;
+                  break;
+#endif
 #endif
                case 'f':
                   print_features();
@@ -1134,6 +1299,24 @@ static void parse_input(int argc, char *argv[])
    else
       g_extern.libretro_no_rom = true;
 
+#if defined(HAVE_BSV_MOVIE) && defined(HAVE_FFMPEG)
+   if (g_extern.bsv.movie_render)
+   {
+      if (!g_extern.bsv.movie_start_playback || !g_extern.recording)
+      {
+         RARCH_ERR("--render needs both a movie to play back (--bsvplay) and a file to record to (--record).\n");
+         rarch_fail(1, "parse_input()");
+      }
+#ifdef HAVE_NETPLAY
+      if (g_extern.netplay_enable)
+      {
+         RARCH_ERR("--render cannot be used with netplay.\n");
+         rarch_fail(1, "parse_input()");
+      }
+#endif
+   }
+#endif
+
    // Copy SRM/state dirs used, so they can be reused on reentrancy.
    if (g_extern.has_set_save_path && path_is_directory(g_extern.savefile_name_srm))
       strlcpy(g_extern.savefile_dir, g_extern.savefile_name_srm, sizeof(g_extern.savefile_dir));
@@ -1290,6 +1473,9 @@ static void init_recording(void)
    params.samplerate = samplerate;
    params.pix_fmt    = g_extern.system.pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888 ? FFEMU_PIX_ARGB8888 : FFEMU_PIX_RGB565;
    params.config     = *g_extern.record_config ? g_extern.record_config : NULL;
+#ifdef HAVE_BSV_MOVIE
+   params.keep_all_frames = g_extern.bsv.movie_render;
+#endif
 
    if (g_settings.video.gpu_record && driver.video->read_viewport)
    {
@@ -1321,12 +1507,21 @@ static void init_recording(void)
       RARCH_LOG("Detected viewport of %u x %u\n",
             vp.width, vp.height);
 
-      g_extern.record_gpu_buffer = (uint8_t*)malloc(vp.width * vp.height * 3);
-      if (!g_extern.record_gpu_buffer)
+      // Prefer recording straight out of the driver's readback buffers.
+      if (driver.video_poke && driver.video_poke->map_viewport && driver.video_poke->unmap_viewport)
       {
-         RARCH_ERR("Failed to allocate GPU record buffer.\n");
-         g_extern.recording = false;
-         return;
+         params.pix_fmt             = FFEMU_PIX_ARGB8888;
+         g_extern.record_gpu_mapped = true;
+      }
+      else
+      {
+         g_extern.record_gpu_buffer = (uint8_t*)malloc(vp.width * vp.height * 3);
+         if (!g_extern.record_gpu_buffer)
+         {
+            RARCH_ERR("Failed to allocate GPU record buffer.\n");
+            g_extern.recording = false;
+            return;
+         }
       }
    }
    else
@@ -1355,20 +1550,29 @@ static void init_recording(void)
       }
    }
 
-   RARCH_LOG("Recording with FFmpeg to %s @ %ux%u. (FB size: %ux%u pix_fmt: %u)\n",
+   const char *ext = path_get_extension(g_extern.record_path);
+   bool raw = strcasecmp(ext, RAWCAP_EXTENSION) == 0;
+
+   RARCH_LOG("Recording %s to %s @ %ux%u. (FB size: %ux%u pix_fmt: %u)\n",
+         raw ? "lossless raw capture" : "with FFmpeg",
          g_extern.record_path,
          params.out_width, params.out_height,
          params.fb_width, params.fb_height,
          (unsigned)params.pix_fmt);
 
-   g_extern.rec = ffemu_new(&params);
-   if (!g_extern.rec)
+   if (raw)
+      g_extern.rec_raw = rawcap_new(&params);
+   else
+      g_extern.rec = ffemu_new(&params);
+
+   if (!g_extern.rec && !g_extern.rec_raw)
    {
-      RARCH_ERR("Failed to start FFmpeg recording.\n");
+      RARCH_ERR("Failed to start %s recording.\n", raw ? "raw" : "FFmpeg");
       g_extern.recording = false;
 
       free(g_extern.record_gpu_buffer);
       g_extern.record_gpu_buffer = NULL;
+      g_extern.record_gpu_mapped = false;
    }
 }
 
@@ -1377,12 +1581,23 @@ static void deinit_recording(void)
    if (!g_extern.recording)
       return;
 
-   ffemu_finalize(g_extern.rec);
-   ffemu_free(g_extern.rec);
-   g_extern.rec = NULL;
+   if (g_extern.rec_raw)
+   {
+      if (!rawcap_finalize(g_extern.rec_raw))
+         RARCH_ERR("Raw capture to %s is incomplete.\n", g_extern.record_path);
+      rawcap_free(g_extern.rec_raw);
+      g_extern.rec_raw = NULL;
+   }
+   else
+   {
+      ffemu_finalize(g_extern.rec);
+      ffemu_free(g_extern.rec);
+      g_extern.rec = NULL;
+   }
 
    free(g_extern.record_gpu_buffer);
    g_extern.record_gpu_buffer = NULL;
+   g_extern.record_gpu_mapped = false;
 }
 #endif
 
@@ -1469,6 +1684,38 @@ void rarch_deinit_rewind(void)
 }
 
 #ifdef HAVE_BSV_MOVIE
+#ifdef HAVE_FFMPEG
+// Overrides config for --render. Nothing is shown or played back, and the core runs unthrottled,
+// so rendering is bound only by emulation and encoding speed.
+static void init_movie_render(void)
+{
+   if (!g_extern.bsv.movie_render)
+      return;
+
+   strlcpy(g_settings.video.driver, "null", sizeof(g_settings.video.driver));
+   strlcpy(g_settings.audio.driver, "null", sizeof(g_settings.audio.driver));
+   strlcpy(g_settings.input.driver, "null", sizeof(g_settings.input.driver));
+
+   // Audio is still handed to the recorder when disabled, this only skips resampling and output.
+   g_settings.audio.enable = false;
+   g_settings.audio.sync = false;
+   g_settings.video.vsync = false;
+   g_settings.video.threaded = false;
+   g_settings.video.gpu_record = false;
+   g_settings.fastforward_ratio = -1.0f;
+
+   // Don't touch the user's saves, and don't spend time on rewind.
+   g_settings.rewind_enable = false;
+   g_settings.savestate_auto_load = false;
+   g_settings.savestate_auto_save = false;
+   g_extern.sram_save_disable = true;
+   g_extern.config_save_on_exit = false;
+
+   RARCH_LOG("Rendering movie \"%s\" to \"%s\".\n",
+         g_extern.bsv.movie_start_path, g_extern.record_path);
+}
+#endif
+
 static void init_movie(void)
 {
    if (g_extern.bsv.movie_start_playback)
@@ -1481,6 +1728,7 @@ static void init_movie(void)
       }
 
       g_extern.bsv.movie_playback = true;
+      g_extern.bsv.movie_render_start = rarch_get_time_usec();
       msg_queue_push(g_extern.msg_queue, "Starting movie playback.", 2, 180);
       RARCH_LOG("Starting movie playback.\n");
       g_settings.rewind_granularity = 1;
@@ -1545,8 +1793,9 @@ static void init_netplay(void)
 
    g_extern.netplay = netplay_new(g_extern.netplay_is_client ? g_extern.netplay_server : NULL,
          g_extern.netplay_port ? g_extern.netplay_port : RARCH_DEFAULT_PORT,
-         g_extern.netplay_sync_frames, &cbs, g_extern.netplay_is_spectate,
-         g_extern.netplay_nick);
+         g_extern.netplay_sync_frames, g_extern.netplay_players ? g_extern.netplay_players : 2,
+         &cbs, g_extern.netplay_is_spectate,
+         g_extern.netplay_relay_port, g_extern.netplay_nick);
 
    if (!g_extern.netplay)
    {
@@ -2165,6 +2414,17 @@ static void check_movie_playback(bool pressed)
       msg_queue_push(g_extern.msg_queue, "Movie playback ended.", 1, 180);
       RARCH_LOG("Movie playback ended.\n");
 
+#ifdef HAVE_FFMPEG
+      if (g_extern.bsv.movie_render)
+      {
+         double secs = (rarch_get_time_usec() - g_extern.bsv.movie_render_start) / 1000000.0;
+         double duration = g_extern.bsv.movie_render_frames / g_extern.system.av_info.timing.fps;
+         RARCH_LOG("Rendered %u frames in %.1f s (%.2fx realtime).\n",
+               g_extern.bsv.movie_render_frames, secs, secs > 0.0 ? duration / secs : 0.0);
+         g_extern.system.shutdown = true;
+      }
+#endif
+
       bsv_movie_free(g_extern.bsv.movie);
       g_extern.bsv.movie = NULL;
       g_extern.bsv.movie_end = false;
@@ -2533,12 +2793,25 @@ static void check_disk(void)
 #if defined(HAVE_SCREENSHOTS) && !defined(_XBOX)
 static void check_screenshot(void)
 {
+   if (screenshot_map_frames && !poll_screenshot_viewport())
+      RARCH_WARN("Failed to take screenshot ...\n");
+
    static bool old_pressed;
    bool pressed = input_key_pressed_func(RARCH_SCREENSHOT);
-   if (pressed && !old_pressed)
-      rarch_take_screenshot();
+   if (pressed && !old_pressed && !screenshot_map_frames)
+      take_screenshot_notify(true);
 
    old_pressed = pressed;
+
+   // Time-lapse screenshots are taken silently, as they would flood the message queue.
+   static unsigned timelapse_frames;
+   unsigned interval = g_settings.video.screenshot_interval;
+   if (interval && *g_settings.screenshot_directory && !g_extern.is_paused &&
+         !screenshot_map_frames && ++timelapse_frames >= interval)
+   {
+      timelapse_frames = 0;
+      take_screenshot(true);
+   }
 }
 #endif
 
@@ -2864,6 +3137,10 @@ int rarch_main_init(int argc, char *argv[])
    validate_cpu_features();
    config_load();
 
+#if defined(HAVE_BSV_MOVIE) && defined(HAVE_FFMPEG)
+   init_movie_render();
+#endif
+
    init_libretro_sym(g_extern.libretro_dummy);
    rarch_init_system_info();
 
@@ -2923,6 +3200,13 @@ int rarch_main_init(int argc, char *argv[])
    
 #ifdef HAVE_FFMPEG
    init_recording();
+#ifdef HAVE_BSV_MOVIE
+   if (g_extern.bsv.movie_render && !g_extern.rec && !g_extern.rec_raw)
+   {
+      RARCH_ERR("Nothing to render to, giving up.\n");
+      goto error;
+   }
+#endif
 #endif
 
 #ifdef HAVE_NETPLAY
@@ -2953,6 +3237,10 @@ int rarch_main_init(int argc, char *argv[])
    return 0;
 
 error:
+#if defined(HAVE_SCREENSHOTS) && !defined(_XBOX)
+   screenshot_deinit();
+#endif
+
    uninit_drivers();
    pretro_unload_game();
    pretro_deinit();
@@ -3078,7 +3366,11 @@ bool rarch_main_iterate(void)
 
 #ifdef HAVE_BSV_MOVIE
    if (g_extern.bsv.movie)
+   {
       bsv_movie_set_frame_end(g_extern.bsv.movie);
+      if (g_extern.bsv.movie_render)
+         g_extern.bsv.movie_render_frames++;
+   }
 #endif
 
 #ifdef HAVE_NETPLAY
@@ -3120,6 +3412,10 @@ void rarch_main_deinit(void)
    deinit_recording();
 #endif
 
+#if defined(HAVE_SCREENSHOTS) && !defined(_XBOX)
+   screenshot_deinit();
+#endif
+
    if (g_extern.use_sram)
       save_files();
 
@@ -28,9 +28,18 @@
 #include "config.h"
 #endif
 
+#if defined(HAVE_THREADS) && !defined(RARCH_CONSOLE)
+#define HAVE_SCREENSHOT_THREAD
+#include "thread.h"
+#include "gfx/filter_threads.h"
+#endif
+
 #ifdef HAVE_ZLIB_DEFLATE
 #include "gfx/rpng/rpng.h"
+#define IMG_EXT "png"
 #else
+#define IMG_EXT "bmp"
+
 static bool write_header_bmp(FILE *file, unsigned width, unsigned height)
 {
    unsigned line_size = (width * 3 + 3) & ~3;
@@ -96,7 +105,7 @@ static void dump_line_32(uint8_t *line, const uint32_t *src, unsigned width)
 }
 
 static void dump_content(FILE *file, const void *frame,
-      int width, int height, int pitch, bool bgr24)
+      int width, int height, int pitch, bool bgr24, enum retro_pixel_format pix_fmt)
 {
    union
    {
@@ -124,7 +133,7 @@ static void dump_content(FILE *file, const void *frame,
       for (int j = 0; j < height; j++, u.u8 += pitch)
          dump_line_bgr(lines[j], u.u8, width);
    }
-   else if (g_extern.system.pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
+   else if (pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
    {
       for (int j = 0; j < height; j++, u.u8 += pitch)
          dump_line_32(lines[j], u.u32, width);
@@ -144,21 +153,38 @@ end:
 }
 #endif
 
-// Take frame bottom-up.
-bool screenshot_dump(const char *folder, const void *frame,
-      unsigned width, unsigned height, int pitch, bool bgr24)
+struct screenshot_job
 {
+   struct screenshot_job *next;
    char filename[PATH_MAX];
-   char shotname[PATH_MAX];
 
-#ifdef HAVE_ZLIB_DEFLATE
-#define IMG_EXT "png"
-#else
-#define IMG_EXT "bmp"
+   // Bottom-up frame.
+   const void *frame;
+   unsigned width;
+   unsigned height;
+   int pitch;
+   bool bgr24;
+   enum retro_pixel_format pix_fmt;
+
+   // Freed once the screenshot is written.
+   void *buffer;
+};
+
+#if defined(HAVE_SCREENSHOT_THREAD) && defined(HAVE_ZLIB_DEFLATE)
+static void run_slices(void *userdata, rpng_range_func_t func, void *data, unsigned count)
+{
+   slice_threads_run((slice_threads_t*)userdata, func, data, count);
+}
 #endif
 
-   fill_dated_filename(shotname, IMG_EXT, sizeof(shotname));
-   fill_pathname_join(filename, folder, shotname, sizeof(filename));
+// slices optionally spreads encoding over several threads.
+static bool write_screenshot(const struct screenshot_job *job, void *slices)
+{
+   const char *filename = job->filename;
+   const void *frame    = job->frame;
+   unsigned width       = job->width;
+   unsigned height      = job->height;
+   int pitch            = job->pitch;
 
 #ifdef HAVE_ZLIB_DEFLATE
    uint8_t *out_buffer = (uint8_t*)malloc(width * height * 3);
@@ -175,9 +201,9 @@ bool screenshot_dump(const char *folder, const void *frame,
    scaler.out_fmt = SCALER_FMT_BGR24;
    scaler.scaler_type = SCALER_TYPE_POINT;
 
-   if (bgr24)
+   if (job->bgr24)
       scaler.in_fmt = SCALER_FMT_BGR24;
-   else if (g_extern.system.pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
+   else if (job->pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
       scaler.in_fmt = SCALER_FMT_ARGB8888;
    else
       scaler.in_fmt = SCALER_FMT_RGB565;
@@ -187,12 +213,20 @@ bool screenshot_dump(const char *folder, const void *frame,
    scaler_ctx_gen_reset(&scaler);
 
    RARCH_LOG("Using RPNG for PNG screenshots.\n");
+#ifdef HAVE_SCREENSHOT_THREAD
+   bool ret = rpng_save_image_bgr24_parallel(filename, out_buffer, width, height, width * 3,
+         slices ? run_slices : NULL, slices);
+#else
+   (void)slices;
    bool ret = rpng_save_image_bgr24(filename, out_buffer, width, height, width * 3);
+#endif
    if (!ret)
       RARCH_ERR("Failed to take screenshot.\n");
    free(out_buffer);
    return ret;
 #else
+   (void)slices;
+
    FILE *file = fopen(filename, "wb");
    if (!file)
    {
@@ -203,7 +237,7 @@ bool screenshot_dump(const char *folder, const void *frame,
    bool ret = write_header_bmp(file, width, height);
 
    if (ret)
-      dump_content(file, frame, width, height, pitch, bgr24);
+      dump_content(file, frame, width, height, pitch, job->bgr24, job->pix_fmt);
    else
       RARCH_ERR("Failed to write image header.\n");
 
@@ -212,3 +246,244 @@ bool screenshot_dump(const char *folder, const void *frame,
 #endif
 }
 
+#ifdef HAVE_SCREENSHOT_THREAD
+// Screenshots which are queued, but not yet written.
+// Further screenshots are dropped rather than piling up frames in memory.
+#define SCREENSHOT_MAX_PENDING 8
+
+static struct
+{
+   sthread_t *thread;
+   slock_t *lock;
+   scond_t *cond;
+   slice_threads_t *slices;
+
+   struct screenshot_job *head;
+   struct screenshot_job *tail;
+   unsigned pending;
+   bool quit;
+} encoder;
+
+static void encoder_thread(void *data)
+{
+   (void)data;
+
+   for (;;)
+   {
+      slock_lock(encoder.lock);
+      while (!encoder.head && !encoder.quit)
+         scond_wait(encoder.cond, encoder.lock);
+
+      // Pending screenshots are still written when quitting.
+      struct screenshot_job *job = encoder.head;
+      if (job)
+      {
+         encoder.head = job->next;
+         if (!encoder.head)
+            encoder.tail = NULL;
+      }
+      slock_unlock(encoder.lock);
+
+      if (!job)
+         break;
+
+      write_screenshot(job, encoder.slices);
+
+      free(job->buffer);
+      free(job);
+
+      slock_lock(encoder.lock);
+      encoder.pending--;
+      slock_unlock(encoder.lock);
+   }
+}
+
+static bool encoder_init(void)
+{
+   if (encoder.thread)
+      return true;
+
+   encoder.lock = slock_new();
+   encoder.cond = scond_new();
+   if (!encoder.lock || !encoder.cond)
+      goto error;
+
+   if (g_settings.video.screenshot_threads > 1)
+   {
+      encoder.slices = slice_threads_new(g_settings.video.screenshot_threads);
+      if (!encoder.slices)
+         RARCH_WARN("Failed to create screenshot encoder threads, encoding on one thread.\n");
+   }
+
+   encoder.thread = sthread_create(encoder_thread, NULL);
+   if (!encoder.thread)
+      goto error;
+
+   RARCH_LOG("Encoding screenshots in the background (%u threads).\n",
+         encoder.slices ? g_settings.video.screenshot_threads : 1);
+   return true;
+
+error:
+   RARCH_WARN("Failed to start screenshot encoder thread, encoding on main thread.\n");
+   screenshot_deinit();
+   return false;
+}
+
+static bool encoder_push(struct screenshot_job *job)
+{
+   slock_lock(encoder.lock);
+   bool busy = encoder.pending >= SCREENSHOT_MAX_PENDING;
+   if (!busy)
+   {
+      if (encoder.tail)
+         encoder.tail->next = job;
+      else
+         encoder.head = job;
+      encoder.tail = job;
+      encoder.pending++;
+      scond_signal(encoder.cond);
+   }
+   slock_unlock(encoder.lock);
+
+   if (busy)
+      RARCH_WARN("Screenshot encoder is falling behind, dropping screenshot.\n");
+   return !busy;
+}
+#endif
+
+void screenshot_deinit(void)
+{
+#ifdef HAVE_SCREENSHOT_THREAD
+   if (encoder.thread)
+   {
+      slock_lock(encoder.lock);
+      encoder.quit = true;
+      scond_signal(encoder.cond);
+      slock_unlock(encoder.lock);
+      sthread_join(encoder.thread);
+   }
+
+   if (encoder.slices)
+      slice_threads_free(encoder.slices);
+   if (encoder.lock)
+      slock_free(encoder.lock);
+   if (encoder.cond)
+      scond_free(encoder.cond);
+
+   memset(&encoder, 0, sizeof(encoder));
+#endif
+}
+
+// Time-lapse capture can take several screenshots within a second,
+// so repeated timestamps get a counter appended.
+static void fill_screenshot_path(char *path, size_t size, const char *folder)
+{
+   static char last_stamp[64];
+   static unsigned repeat;
+
+   char stamp[64];
+   char shotname[PATH_MAX];
+
+   fill_dated_filename(stamp, "", sizeof(stamp));
+   size_t len = strlen(stamp);
+   if (len && stamp[len - 1] == '.')
+      stamp[len - 1] = '\0';
+
+   if (!strcmp(stamp, last_stamp))
+      repeat++;
+   else
+   {
+      strlcpy(last_stamp, stamp, sizeof(last_stamp));
+      repeat = 0;
+   }
+
+   if (repeat)
+      snprintf(shotname, sizeof(shotname), "%s-%u.%s", stamp, repeat, IMG_EXT);
+   else
+      snprintf(shotname, sizeof(shotname), "%s.%s", stamp, IMG_EXT);
+
+   fill_pathname_join(path, folder, shotname, size);
+}
+
+// Takes ownership of buffer (if any).
+static bool dump_job(const char *folder, const void *frame, void *buffer,
+      unsigned width, unsigned height, int pitch, bool bgr24, enum retro_pixel_format pix_fmt)
+{
+   struct screenshot_job *job = (struct screenshot_job*)calloc(1, sizeof(*job));
+   if (!job)
+   {
+      free(buffer);
+      return false;
+   }
+
+   fill_screenshot_path(job->filename, sizeof(job->filename), folder);
+   job->width   = width;
+   job->height  = height;
+   job->bgr24   = bgr24;
+   job->pix_fmt = pix_fmt;
+
+#ifdef HAVE_SCREENSHOT_THREAD
+   if (encoder_init())
+   {
+      // The frame may go away as soon as we return, so the encoder gets its own copy.
+      if (!buffer)
+      {
+         size_t line_size = width * (bgr24 ? 3 :
+               (job->pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888 ? sizeof(uint32_t) : sizeof(uint16_t)));
+
+         buffer = malloc(line_size * height);
+         if (!buffer)
+         {
+            free(job);
+            return false;
+         }
+
+         const uint8_t *src = (const uint8_t*)frame;
+         uint8_t *dst = (uint8_t*)buffer;
+         for (unsigned h = 0; h < height; h++, src += pitch, dst += line_size)
+            memcpy(dst, src, line_size);
+
+         frame = buffer;
+         pitch = line_size;
+      }
+
+      job->frame  = frame;
+      job->pitch  = pitch;
+      job->buffer = buffer;
+
+      if (encoder_push(job))
+         return true;
+
+      free(job->buffer);
+      free(job);
+      return false;
+   }
+#endif
+
+   job->frame = frame;
+   job->pitch = pitch;
+   bool ret = write_screenshot(job, NULL);
+
+   free(buffer);
+   free(job);
+   return ret;
+}
+
+bool screenshot_dump(const char *folder, const void *frame,
+      unsigned width, unsigned height, int pitch, bool bgr24)
+{
+   return dump_job(folder, frame, NULL, width, height, pitch, bgr24, g_extern.system.pix_fmt);
+}
+
+bool screenshot_dump_buffer(const char *folder, void *frame,
+      unsigned width, unsigned height, int pitch, bool bgr24)
+{
+   return dump_job(folder, frame, frame, width, height, pitch, bgr24, g_extern.system.pix_fmt);
+}
+
+bool screenshot_dump_xrgb8888(const char *folder, const void *frame,
+      unsigned width, unsigned height, int pitch)
+{
+   return dump_job(folder, frame, NULL, width, height, pitch, false, RETRO_PIXEL_FORMAT_XRGB8888);
+}
+
@@ -20,9 +20,24 @@
 #include <stddef.h>
 #include "boolean.h"
 
+// Takes frame bottom-up. The frame is copied before returning.
+// With threads, the screenshot is encoded and written on a background thread,
+// and failures past this point are only logged.
 bool screenshot_dump(const char *folder, const void *frame, 
       unsigned width, unsigned height, int pitch, bool bgr24);
 
+// Same as screenshot_dump(), but takes ownership of frame instead of copying it.
+// frame must be allocated with malloc(), and pitch must be positive.
+bool screenshot_dump_buffer(const char *folder, void *frame,
+      unsigned width, unsigned height, int pitch, bool bgr24);
+
+// Same as screenshot_dump(), but frame is always XRGB8888, regardless of the core's pixel format.
+bool screenshot_dump_xrgb8888(const char *folder, const void *frame,
+      unsigned width, unsigned height, int pitch);
+
+// Waits for queued screenshots to be written, and stops the encoder.
+void screenshot_deinit(void);
+
 void screenshot_generate_filename(char *filename, size_t size);
 
 #endif
@@ -192,9 +192,14 @@ void config_set_defaults(void)
    g_settings.video.msg_color_b = ((message_color >>  0) & 0xff) / 255.0f;
 
    g_settings.video.refresh_rate = refresh_rate;
+   g_settings.video.filter_threads = video_filter_threads;
+   g_settings.video.xvideo_threads = video_xvideo_threads;
    g_settings.video.post_filter_record = post_filter_record;
    g_settings.video.gpu_record = gpu_record;
+   g_settings.video.gpu_record_depth = gpu_record_depth;
    g_settings.video.gpu_screenshot = gpu_screenshot;
+   g_settings.video.screenshot_threads = video_screenshot_threads;
+   g_settings.video.screenshot_interval = video_screenshot_interval;
 
    g_settings.audio.enable = audio_enable;
    g_settings.audio.out_rate = out_rate;
@@ -248,6 +253,7 @@ void config_set_defaults(void)
 
    g_settings.input.axis_threshold = axis_threshold;
    g_settings.input.netplay_client_swap_input = netplay_client_swap_input;
+   g_settings.input.netplay_max_input_delay = netplay_max_input_delay;
    g_settings.input.turbo_period = turbo_period;
    g_settings.input.turbo_duty_cycle = turbo_duty_cycle;
    g_settings.input.overlay_opacity = 1.0f;
@@ -612,18 +618,32 @@ bool config_load_file(const char *path)
 
    CONFIG_GET_BOOL(video.post_filter_record, "video_post_filter_record");
    CONFIG_GET_BOOL(video.gpu_record, "video_gpu_record");
+   CONFIG_GET_INT(video.gpu_record_depth, "video_gpu_record_depth");
    CONFIG_GET_BOOL(video.gpu_screenshot, "video_gpu_screenshot");
+   CONFIG_GET_INT(video.screenshot_threads, "video_screenshot_threads");
+   CONFIG_GET_INT(video.screenshot_interval, "video_screenshot_interval");
 
 #ifdef HAVE_DYLIB
    CONFIG_GET_PATH(video.filter_path, "video_filter");
+   CONFIG_GET_INT(video.filter_threads, "video_filter_threads");
 #endif
+   CONFIG_GET_INT(video.xvideo_threads, "video_xvideo_threads");
 
    CONFIG_GET_PATH(video.shader_dir, "video_shader_dir");
    if (!strcmp(g_settings.video.shader_dir, "default"))
       *g_settings.video.shader_dir = '\0';
 
+   CONFIG_GET_PATH(video.shader_cache_dir, "video_shader_cache_dir");
+   if (!strcmp(g_settings.video.shader_cache_dir, "default"))
+      *g_settings.video.shader_cache_dir = '\0';
+
+   CONFIG_GET_PATH(video.image_cache_dir, "video_image_cache_dir");
+   if (!strcmp(g_settings.video.image_cache_dir, "default"))
+      *g_settings.video.image_cache_dir = '\0';
+
    CONFIG_GET_FLOAT(input.axis_threshold, "input_axis_threshold");
    CONFIG_GET_BOOL(input.netplay_client_swap_input, "netplay_client_swap_input");
+   CONFIG_GET_INT(input.netplay_max_input_delay, "netplay_max_input_delay");
 
    for (unsigned i = 0; i < MAX_PLAYERS; i++)
    {
@@ -1012,6 +1032,16 @@ bool config_save_file(const char *path)
    else
       config_set_string(conf, "video_shader_dir", "default");
 
+   if (*g_settings.video.shader_cache_dir)
+      config_set_string(conf, "video_shader_cache_dir", g_settings.video.shader_cache_dir);
+   else
+      config_set_string(conf, "video_shader_cache_dir", "default");
+
+   if (*g_settings.video.image_cache_dir)
+      config_set_string(conf, "video_image_cache_dir", g_settings.video.image_cache_dir);
+   else
+      config_set_string(conf, "video_image_cache_dir", "default");
+
 #if defined(HAVE_RGUI) || defined(HAVE_RMENU)
    if (*g_settings.rgui_browser_directory)
       config_set_string(conf, "rgui_browser_directory", g_settings.rgui_browser_directory);
@@ -0,0 +1,456 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../netplay_compat.h"
+#include "netplay_proxy.h"
+#include "../thread.h"
+#include "../performance.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest we sleep in select() between checking for packets that are due.
+#define PROXY_POLL_MS 1
+#define PROXY_MAX_PACKET 4096
+
+enum proxy_dir
+{
+   PROXY_TO_HOST = 0,
+   PROXY_TO_CLIENT,
+};
+
+struct proxy_packet
+{
+   struct proxy_packet *next;
+   rarch_time_t due;
+   enum proxy_dir dir;
+   bool udp;
+   size_t size;
+   uint8_t data[];
+};
+
+struct netplay_proxy
+{
+   struct netplay_impairment impairment;
+   uint32_t rng;
+
+   struct sockaddr_storage host_addr;
+   socklen_t host_addr_len;
+
+   int listen_fd; // TCP, waiting for the client.
+   int udp_fd; // UDP, facing the client.
+   int client_fd; // TCP connection from the client.
+   int host_fd; // TCP connection to the host.
+   int host_udp_fd; // UDP, facing the host.
+
+   struct sockaddr_storage client_udp_addr;
+   socklen_t client_udp_addr_len;
+   bool has_client_udp_addr;
+
+   // Packets in flight, in the order they were received.
+   struct proxy_packet *head;
+   struct proxy_packet *tail;
+   rarch_time_t tcp_due[2];
+
+   sthread_t *thread;
+   slock_t *lock;
+   volatile bool quit;
+
+   struct netplay_proxy_stats stats;
+};
+
+// xorshift32. Good enough to decide the fate of packets, and the same on every platform.
+static uint32_t proxy_rand(netplay_proxy_t *proxy)
+{
+   uint32_t x = proxy->rng;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   proxy->rng = x;
+   return x;
+}
+
+static float proxy_randf(netplay_proxy_t *proxy)
+{
+   return (proxy_rand(proxy) >> 8) / 16777216.0f;
+}
+
+static bool proxy_send_all(int fd, const uint8_t *data, size_t size)
+{
+   while (size)
+   {
+      ssize_t ret = send(fd, CONST_CAST data, size, 0);
+      if (ret <= 0)
+         return false;
+
+      data += ret;
+      size -= ret;
+   }
+
+   return true;
+}
+
+static void proxy_close(int *fd)
+{
+   if (*fd >= 0)
+      close(*fd);
+   *fd = -1;
+}
+
+static void proxy_end_session(netplay_proxy_t *proxy)
+{
+   proxy_close(&proxy->client_fd);
+   proxy_close(&proxy->host_fd);
+   proxy_close(&proxy->listen_fd);
+
+   slock_lock(proxy->lock);
+   proxy->stats.connected = false;
+   proxy->stats.finished = true;
+   slock_unlock(proxy->lock);
+}
+
+static void proxy_queue(netplay_proxy_t *proxy, enum proxy_dir dir, bool udp, const uint8_t *data, size_t size)
+{
+   const struct netplay_impairment *imp = &proxy->impairment;
+   rarch_time_t delay = imp->latency_ms * 1000;
+
+   if (udp)
+   {
+      // Always draw the same amount of random numbers per packet,
+      // so the impairments applied to a packet only depend on its place in the stream.
+      bool drop = proxy_randf(proxy) < imp->loss;
+      bool reorder = proxy_randf(proxy) < imp->reorder;
+      unsigned jitter = imp->jitter_ms ? proxy_rand(proxy) % (imp->jitter_ms + 1) : 0;
+
+      slock_lock(proxy->lock);
+      proxy->stats.udp_packets++;
+      if (drop)
+         proxy->stats.udp_dropped++;
+      else if (reorder)
+         proxy->stats.udp_reordered++;
+      slock_unlock(proxy->lock);
+
+      if (drop)
+         return;
+
+      delay += jitter * 1000;
+      if (reorder)
+         delay += imp->reorder_ms * 1000;
+   }
+
+   struct proxy_packet *pkt = (struct proxy_packet*)malloc(sizeof(*pkt) + size);
+   if (!pkt)
+      return;
+
+   pkt->next = NULL;
+   pkt->dir  = dir;
+   pkt->udp  = udp;
+   pkt->size = size;
+   pkt->due  = rarch_get_time_usec() + delay;
+   memcpy(pkt->data, data, size);
+
+   // A stream can't be reordered.
+   if (!udp)
+   {
+      if (pkt->due < proxy->tcp_due[dir])
+         pkt->due = proxy->tcp_due[dir];
+      proxy->tcp_due[dir] = pkt->due;
+
+      slock_lock(proxy->lock);
+      proxy->stats.tcp_bytes += size;
+      slock_unlock(proxy->lock);
+   }
+
+   if (proxy->tail)
+      proxy->tail->next = pkt;
+   else
+      proxy->head = pkt;
+   proxy->tail = pkt;
+}
+
+// Sends whatever is due. Returns time until the next packet is due, or -1 if nothing is queued.
+static rarch_time_t proxy_flush(netplay_proxy_t *proxy)
+{
+   rarch_time_t now = rarch_get_time_usec();
+   rarch_time_t next = -1;
+
+   struct proxy_packet **link = &proxy->head;
+   struct proxy_packet *last = NULL;
+   while (*link)
+   {
+      struct proxy_packet *pkt = *link;
+      if (pkt->due > now)
+      {
+         if (next < 0 || pkt->due - now < next)
+            next = pkt->due - now;
+         last = pkt;
+         link = &pkt->next;
+         continue;
+      }
+
+      bool ok = true;
+      if (!pkt->udp)
+         ok = proxy_send_all(pkt->dir == PROXY_TO_HOST ? proxy->host_fd : proxy->client_fd, pkt->data, pkt->size);
+      else if (pkt->dir == PROXY_TO_HOST)
+         send(proxy->host_udp_fd, CONST_CAST pkt->data, pkt->size, 0);
+      else if (proxy->has_client_udp_addr)
+         sendto(proxy->udp_fd, CONST_CAST pkt->data, pkt->size, 0,
+               (const struct sockaddr*)&proxy->client_udp_addr, proxy->client_udp_addr_len);
+
+      *link = pkt->next;
+      free(pkt);
+
+      if (!ok)
+      {
+         proxy_end_session(proxy);
+         break;
+      }
+   }
+
+   proxy->tail = last;
+   if (*link) // Bailed out early, find the real tail.
+      for (proxy->tail = *link; proxy->tail->next; proxy->tail = proxy->tail->next);
+
+   return next;
+}
+
+static void proxy_accept(netplay_proxy_t *proxy)
+{
+   int fd = accept(proxy->listen_fd, NULL, NULL);
+   if (fd < 0)
+      return;
+
+   proxy->host_fd = socket(proxy->host_addr.ss_family, SOCK_STREAM, 0);
+   if (proxy->host_fd < 0 ||
+         connect(proxy->host_fd, (const struct sockaddr*)&proxy->host_addr, proxy->host_addr_len) < 0)
+   {
+      fprintf(stderr, "[Proxy]: Failed to connect to host.\n");
+      close(fd);
+      proxy_end_session(proxy);
+      return;
+   }
+
+   int flag = 1;
+   setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, CONST_CAST &flag, sizeof(int));
+   setsockopt(proxy->host_fd, IPPROTO_TCP, TCP_NODELAY, CONST_CAST &flag, sizeof(int));
+
+   proxy->client_fd = fd;
+
+   slock_lock(proxy->lock);
+   proxy->stats.connected = true;
+   slock_unlock(proxy->lock);
+}
+
+static void proxy_forward_tcp(netplay_proxy_t *proxy, int fd, enum proxy_dir dir)
+{
+   uint8_t buf[PROXY_MAX_PACKET];
+   ssize_t ret = recv(fd, NONCONST_CAST buf, sizeof(buf), 0);
+   if (ret <= 0)
+   {
+      proxy_end_session(proxy);
+      return;
+   }
+
+   proxy_queue(proxy, dir, false, buf, ret);
+}
+
+static void proxy_forward_udp(netplay_proxy_t *proxy, int fd, enum proxy_dir dir)
+{
+   uint8_t buf[PROXY_MAX_PACKET];
+   struct sockaddr_storage addr;
+   socklen_t addr_len = sizeof(addr);
+
+   ssize_t ret = recvfrom(fd, NONCONST_CAST buf, sizeof(buf), 0, (struct sockaddr*)&addr, &addr_len);
+   if (ret <= 0)
+      return;
+
+   // Answers from the host go back to wherever the client sent from.
+   if (dir == PROXY_TO_HOST)
+   {
+      memcpy(&proxy->client_udp_addr, &addr, addr_len);
+      proxy->client_udp_addr_len = addr_len;
+      proxy->has_client_udp_addr = true;
+   }
+
+   proxy_queue(proxy, dir, true, buf, ret);
+}
+
+static void proxy_thread(void *data)
+{
+   netplay_proxy_t *proxy = (netplay_proxy_t*)data;
+
+   while (!proxy->quit)
+   {
+      rarch_time_t next = proxy_flush(proxy);
+
+      struct timeval tv = {0};
+      tv.tv_usec = PROXY_POLL_MS * 1000;
+      if (next >= 0 && next < tv.tv_usec)
+         tv.tv_usec = next;
+
+      int fds_list[] = { proxy->listen_fd, proxy->udp_fd, proxy->host_udp_fd, proxy->client_fd, proxy->host_fd };
+      fd_set fds;
+      FD_ZERO(&fds);
+      int max_fd = -1;
+      for (unsigned i = 0; i < sizeof(fds_list) / sizeof(fds_list[0]); i++)
+      {
+         // Don't let anyone else in while a session is running.
+         if (fds_list[i] < 0 || (fds_list[i] == proxy->listen_fd && proxy->client_fd >= 0))
+            continue;
+
+         FD_SET(fds_list[i], &fds);
+         if (fds_list[i] > max_fd)
+            max_fd = fds_list[i];
+      }
+
+      if (select(max_fd + 1, &fds, NULL, NULL, &tv) <= 0)
+         continue;
+
+      if (proxy->listen_fd >= 0 && proxy->client_fd < 0 && FD_ISSET(proxy->listen_fd, &fds))
+         proxy_accept(proxy);
+      if (proxy->udp_fd >= 0 && FD_ISSET(proxy->udp_fd, &fds))
+         proxy_forward_udp(proxy, proxy->udp_fd, PROXY_TO_HOST);
+      if (proxy->host_udp_fd >= 0 && FD_ISSET(proxy->host_udp_fd, &fds))
+         proxy_forward_udp(proxy, proxy->host_udp_fd, PROXY_TO_CLIENT);
+      if (proxy->client_fd >= 0 && FD_ISSET(proxy->client_fd, &fds))
+         proxy_forward_tcp(proxy, proxy->client_fd, PROXY_TO_HOST);
+      if (proxy->host_fd >= 0 && FD_ISSET(proxy->host_fd, &fds))
+         proxy_forward_tcp(proxy, proxy->host_fd, PROXY_TO_CLIENT);
+   }
+}
+
+static int proxy_bind(const char *host, uint16_t port, int type)
+{
+   struct addrinfo hints, *res = NULL;
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family = AF_INET;
+   hints.ai_socktype = type;
+   hints.ai_flags = AI_PASSIVE;
+
+   char port_buf[16];
+   snprintf(port_buf, sizeof(port_buf), "%hu", (unsigned short)port);
+   if (getaddrinfo(host, port_buf, &hints, &res) < 0 || !res)
+      return -1;
+
+   int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+   if (fd >= 0)
+   {
+      int yes = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, CONST_CAST &yes, sizeof(int));
+
+      if (bind(fd, res->ai_addr, res->ai_addrlen) < 0 ||
+            (type == SOCK_STREAM && listen(fd, 1) < 0))
+      {
+         close(fd);
+         fd = -1;
+      }
+   }
+
+   freeaddrinfo(res);
+   return fd;
+}
+
+netplay_proxy_t *netplay_proxy_new(uint16_t port, const char *host, uint16_t host_port,
+      const struct netplay_impairment *impairment)
+{
+   netplay_proxy_t *proxy = (netplay_proxy_t*)calloc(1, sizeof(*proxy));
+   if (!proxy)
+      return NULL;
+
+   proxy->impairment = *impairment;
+   proxy->rng = impairment->seed ? impairment->seed : 1;
+   proxy->listen_fd = proxy->udp_fd = proxy->client_fd = proxy->host_fd = proxy->host_udp_fd = -1;
+
+   struct addrinfo hints, *res = NULL;
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+
+   char port_buf[16];
+   snprintf(port_buf, sizeof(port_buf), "%hu", (unsigned short)host_port);
+   if (getaddrinfo(host, port_buf, &hints, &res) < 0 || !res)
+   {
+      fprintf(stderr, "[Proxy]: Cannot resolve %s.\n", host);
+      goto error;
+   }
+
+   memcpy(&proxy->host_addr, res->ai_addr, res->ai_addrlen);
+   proxy->host_addr_len = res->ai_addrlen;
+   freeaddrinfo(res);
+
+   proxy->listen_fd = proxy_bind(NULL, port, SOCK_STREAM);
+   proxy->udp_fd = proxy_bind(NULL, port, SOCK_DGRAM);
+   if (proxy->listen_fd < 0 || proxy->udp_fd < 0)
+   {
+      fprintf(stderr, "[Proxy]: Failed to bind port %hu.\n", (unsigned short)port);
+      goto error;
+   }
+
+   proxy->host_udp_fd = socket(proxy->host_addr.ss_family, SOCK_DGRAM, 0);
+   if (proxy->host_udp_fd < 0 ||
+         connect(proxy->host_udp_fd, (const struct sockaddr*)&proxy->host_addr, proxy->host_addr_len) < 0)
+      goto error;
+
+   proxy->lock = slock_new();
+   if (!proxy->lock)
+      goto error;
+
+   proxy->thread = sthread_create(proxy_thread, proxy);
+   if (!proxy->thread)
+      goto error;
+
+   return proxy;
+
+error:
+   netplay_proxy_free(proxy);
+   return NULL;
+}
+
+void netplay_proxy_free(netplay_proxy_t *proxy)
+{
+   if (!proxy)
+      return;
+
+   if (proxy->thread)
+   {
+      proxy->quit = true;
+      sthread_join(proxy->thread);
+   }
+
+   proxy_close(&proxy->listen_fd);
+   proxy_close(&proxy->udp_fd);
+   proxy_close(&proxy->client_fd);
+   proxy_close(&proxy->host_fd);
+   proxy_close(&proxy->host_udp_fd);
+
+   while (proxy->head)
+   {
+      struct proxy_packet *next = proxy->head->next;
+      free(proxy->head);
+      proxy->head = next;
+   }
+
+   if (proxy->lock)
+      slock_free(proxy->lock);
+   free(proxy);
+}
+
+void netplay_proxy_get_stats(netplay_proxy_t *proxy, struct netplay_proxy_stats *stats)
+{
+   slock_lock(proxy->lock);
+   *stats = proxy->stats;
+   slock_unlock(proxy->lock);
+}
+
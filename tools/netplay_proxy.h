@@ -0,0 +1,55 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __NETPLAY_PROXY_H
+#define __NETPLAY_PROXY_H
+
+#include <stdint.h>
+#include "../boolean.h"
+
+// Sits between a netplay client and host, forwarding the TCP and UDP traffic of one session
+// while impairing it. Which packets are dropped or held back only depends on the seed and
+// the order packets arrive in, so a run can be repeated.
+struct netplay_impairment
+{
+   unsigned latency_ms; // One-way, in both directions.
+   unsigned jitter_ms; // Random extra delay on top of latency. UDP only, TCP stays in order.
+   float loss; // Chance a UDP packet is dropped.
+   float reorder; // Chance a UDP packet is held back, so it arrives after the ones sent after it.
+   unsigned reorder_ms; // How long reordered packets are held back.
+   uint32_t seed;
+};
+
+struct netplay_proxy_stats
+{
+   unsigned long udp_packets;
+   unsigned long udp_dropped;
+   unsigned long udp_reordered;
+   unsigned long tcp_bytes;
+   bool connected; // A client is connected, and we're connected to the host.
+   bool finished; // The session has ended.
+};
+
+typedef struct netplay_proxy netplay_proxy_t;
+
+// Listens for a client on port (TCP and UDP), and connects it to host:host_port once it shows up.
+netplay_proxy_t *netplay_proxy_new(uint16_t port, const char *host, uint16_t host_port,
+      const struct netplay_impairment *impairment);
+void netplay_proxy_free(netplay_proxy_t *proxy);
+
+void netplay_proxy_get_stats(netplay_proxy_t *proxy, struct netplay_proxy_stats *stats);
+
+#endif
+
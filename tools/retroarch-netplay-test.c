@@ -0,0 +1,597 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Runs a netplay host and its clients on this machine, each client talking through its own proxy which
+// adds latency, jitter, loss and reordering, and reports how netplay coped.
+// Every player runs a fake core whose state is a hash of all input it has seen,
+// and the states of every client are compared with the host's frame by frame to find desyncs.
+// A desync can be forced with --corrupt, to check netplay notices it and resyncs.
+//
+// With --proxy, only the proxy is run, so real RetroArch instances can be tested.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include "../compat/getopt_rarch.h"
+#include "../boolean.h"
+#include "../general.h"
+#include "../netplay.h"
+#include "../performance.h"
+#include "netplay_proxy.h"
+
+// Need to be present for build to work, but it's not *really* used.
+struct settings g_settings;
+struct global g_extern;
+
+#define DEFAULT_PORT 55435
+#define FRAME_USEC (1000000 / 60)
+
+static unsigned g_frames = 3600;
+static unsigned g_sync_frames = 4;
+static unsigned g_players = 2;
+static unsigned g_max_input_delay = 4;
+static unsigned g_state_size = 256 * 1024;
+static unsigned g_work_usec = 2000;
+static uint16_t g_port = DEFAULT_PORT;
+static int g_corrupt_frame = -1;
+static char *g_proxy_target = NULL;
+static struct netplay_impairment g_impairment = { 0, 0, 0.0f, 0.0f, 20, 1 };
+
+static void print_help(void)
+{
+   puts("==========================");
+   puts(" retroarch-netplay-test");
+   puts("==========================");
+   puts("Usage: retroarch-netplay-test [ options ... ]");
+   puts("");
+   puts("Runs a netplay host and its clients with a fake core over impaired loopback connections,");
+   puts("and reports rollbacks, stalls, resends and desyncs.");
+   puts("");
+   puts("-f/--frames: Frames to run. Defaults to 3600 (one minute).");
+   puts("-F/--sync: Sync frames, same as retroarch -F. Defaults to 4.");
+   puts("-n/--players: Players in the session, same as retroarch --players. Defaults to 2.");
+   puts("-D/--max-delay: Most input delay netplay may use, same as netplay_max_input_delay. Defaults to 4.");
+   puts("-l/--latency: One-way latency in ms.");
+   puts("-j/--jitter: Random extra latency in ms, on top of --latency.");
+   puts("-d/--loss: Percentage of UDP packets to drop.");
+   puts("-r/--reorder: Percentage of UDP packets to hold back, so they arrive out of order.");
+   puts("-R/--reorder-delay: How long reordered packets are held back in ms. Defaults to 20.");
+   puts("-s/--seed: Seed deciding which packets are impaired. Runs with the same seed impair the same packets.");
+   puts("-S/--state-size: Size of the fake core's save state in KiB. Defaults to 256.");
+   puts("-w/--work: Time the fake core takes to run a frame in microseconds. Defaults to 2000.");
+   puts("-p/--port: Port the host listens on. The proxies use the ports after it. Defaults to 55435.");
+   puts("-c/--corrupt: Corrupt the first client's state after running this frame.");
+   puts("\tNetplay should notice the desync and resync the client to the host.");
+   puts("-P/--proxy: Only run the proxy, listening on --port and forwarding to HOST:PORT,");
+   puts("\tto test real RetroArch instances. Connect the client to --port.");
+   puts("-v/--verbose: Verbose logging.");
+   puts("-h/--help: This help.");
+}
+
+static void parse_input(int argc, char *argv[])
+{
+   char optstring[] = "f:F:n:D:l:j:d:r:R:s:S:w:p:c:P:vh";
+   struct option opts[] = {
+      { "frames", 1, NULL, 'f' },
+      { "sync", 1, NULL, 'F' },
+      { "players", 1, NULL, 'n' },
+      { "max-delay", 1, NULL, 'D' },
+      { "latency", 1, NULL, 'l' },
+      { "jitter", 1, NULL, 'j' },
+      { "loss", 1, NULL, 'd' },
+      { "reorder", 1, NULL, 'r' },
+      { "reorder-delay", 1, NULL, 'R' },
+      { "seed", 1, NULL, 's' },
+      { "state-size", 1, NULL, 'S' },
+      { "work", 1, NULL, 'w' },
+      { "port", 1, NULL, 'p' },
+      { "corrupt", 1, NULL, 'c' },
+      { "proxy", 1, NULL, 'P' },
+      { "verbose", 0, NULL, 'v' },
+      { "help", 0, NULL, 'h' },
+      { NULL, 0, NULL, 0 }
+   };
+
+   int option_index = 0;
+   for (;;)
+   {
+      int c = getopt_long(argc, argv, optstring, opts, &option_index);
+      if (c == -1)
+         break;
+
+      switch (c)
+      {
+         case 'h':
+            print_help();
+            exit(0);
+
+         case 'f':
+            g_frames = strtoul(optarg, NULL, 0);
+            break;
+
+         case 'F':
+            g_sync_frames = strtoul(optarg, NULL, 0);
+            break;
+
+         case 'n':
+            g_players = strtoul(optarg, NULL, 0);
+            break;
+
+         case 'D':
+            g_max_input_delay = strtoul(optarg, NULL, 0);
+            break;
+
+         case 'l':
+            g_impairment.latency_ms = strtoul(optarg, NULL, 0);
+            break;
+
+         case 'j':
+            g_impairment.jitter_ms = strtoul(optarg, NULL, 0);
+            break;
+
+         case 'd':
+            g_impairment.loss = strtod(optarg, NULL) / 100.0;
+            break;
+
+         case 'r':
+            g_impairment.reorder = strtod(optarg, NULL) / 100.0;
+            break;
+
+         case 'R':
+            g_impairment.reorder_ms = strtoul(optarg, NULL, 0);
+            break;
+
+         case 's':
+            g_impairment.seed = strtoul(optarg, NULL, 0);
+            break;
+
+         case 'S':
+            g_state_size = strtoul(optarg, NULL, 0) * 1024;
+            break;
+
+         case 'w':
+            g_work_usec = strtoul(optarg, NULL, 0);
+            break;
+
+         case 'p':
+            g_port = strtoul(optarg, NULL, 0);
+            break;
+
+         case 'c':
+            g_corrupt_frame = strtol(optarg, NULL, 0);
+            break;
+
+         case 'P':
+            g_proxy_target = strdup(optarg);
+            break;
+
+         case 'v':
+            g_extern.verbose = true;
+            break;
+
+         default:
+            print_help();
+            exit(1);
+      }
+   }
+
+   if (optind < argc || g_state_size < 16 || g_players < 2 || g_players > MAX_PLAYERS)
+   {
+      print_help();
+      exit(1);
+   }
+}
+
+// The fake core. Its state is the frame counter and a running hash of the input.
+// Input is a function of player and frame, and is held for a few frames at a time like a real player would,
+// so prediction is right most of the time.
+struct core_state
+{
+   uint32_t frame;
+   uint32_t pad;
+   uint64_t hash;
+};
+
+static uint8_t *g_state;
+static uint64_t *g_hash_log; // Hash after each frame, as the core last ran it.
+static retro_input_state_t g_input_cb;
+static unsigned g_self_frame; // Frame being run by the frontend, for our own input.
+static unsigned g_client; // Which client we are, from 1. 0 on the host.
+static bool g_corrupt; // Corrupt the state every time g_corrupt_frame is run, rollbacks would undo it otherwise.
+
+static uint16_t input_for(unsigned player, unsigned frame)
+{
+   if (frame == 0) // Netplay always uses zero input for the first frame.
+      return 0;
+
+   uint32_t x = (player + 1) * 2654435761u ^ (frame / 7) * 40503u;
+   x ^= x >> 13;
+   x *= 0x5bd1e995;
+   x ^= x >> 15;
+   return x & 0xfff;
+}
+
+static uint64_t hash_frame(uint64_t hash, unsigned frame, const uint16_t *input)
+{
+   hash = hash * 1099511628211ull + frame;
+   for (unsigned p = 0; p < g_players; p++)
+      hash = hash * 1099511628211ull + input[p];
+   return hash;
+}
+
+static void core_run(void)
+{
+   struct core_state *state = (struct core_state*)g_state;
+   input_poll_net();
+
+   uint16_t input[MAX_PLAYERS] = {0};
+   for (unsigned p = 0; p < g_players; p++)
+      for (unsigned i = 0; i < 12; i++)
+         input[p] |= input_state_net(p, RETRO_DEVICE_JOYPAD, 0, i) ? 1 << i : 0;
+
+   state->hash = hash_frame(state->hash, state->frame, input);
+   if (g_corrupt && (int)state->frame == g_corrupt_frame)
+      state->hash ^= 1;
+   if (state->frame < g_frames)
+      g_hash_log[state->frame] = state->hash;
+   state->frame++;
+
+   rarch_time_t end = rarch_get_time_usec() + g_work_usec;
+   while (rarch_get_time_usec() < end);
+
+   video_frame_net(NULL, 0, 0, 0);
+}
+
+static size_t core_serialize_size(void)
+{
+   return g_state_size;
+}
+
+static bool core_serialize(void *data, size_t size)
+{
+   memcpy(data, g_state, size);
+   return true;
+}
+
+static bool core_unserialize(const void *data, size_t size)
+{
+   memcpy(g_state, data, size);
+   return true;
+}
+
+static void core_set_input_state(retro_input_state_t cb)
+{
+   g_input_cb = cb;
+}
+
+static unsigned core_api_version(void)
+{
+   return RETRO_API_VERSION;
+}
+
+static void *core_get_memory_data(unsigned id)
+{
+   (void)id;
+   return NULL;
+}
+
+static size_t core_get_memory_size(unsigned id)
+{
+   (void)id;
+   return 0;
+}
+
+void (*pretro_run)(void) = core_run;
+size_t (*pretro_serialize_size)(void) = core_serialize_size;
+bool (*pretro_serialize)(void*, size_t) = core_serialize;
+bool (*pretro_unserialize)(const void*, size_t) = core_unserialize;
+void (*pretro_set_input_state)(retro_input_state_t) = core_set_input_state;
+unsigned (*pretro_api_version)(void) = core_api_version;
+void *(*pretro_get_memory_data)(unsigned) = core_get_memory_data;
+size_t (*pretro_get_memory_size)(unsigned) = core_get_memory_size;
+
+void lock_autosave(void) {}
+void unlock_autosave(void) {}
+void msg_queue_push(msg_queue_t *queue, const char *msg, unsigned prio, unsigned duration)
+{
+   (void)queue; (void)msg; (void)prio; (void)duration;
+}
+void msg_queue_clear(msg_queue_t *queue)
+{
+   (void)queue;
+}
+
+static int16_t input_state(unsigned port, unsigned device, unsigned index, unsigned id)
+{
+   (void)device;
+   (void)index;
+   return (input_for(port, g_self_frame) >> id) & 1;
+}
+
+static void video_frame(const void *data, unsigned width, unsigned height, size_t pitch)
+{
+   (void)data; (void)width; (void)height; (void)pitch;
+}
+
+static void audio_sample(int16_t left, int16_t right)
+{
+   (void)left; (void)right;
+}
+
+static size_t audio_sample_batch(const int16_t *data, size_t frames)
+{
+   (void)data;
+   return frames;
+}
+
+// Plays one player of the session. Returns true if it ran without losing the connection.
+static bool run_session(bool host, uint16_t port)
+{
+   char name[32] = "Host";
+   if (!host)
+      snprintf(name, sizeof(name), "Client %u", g_client);
+
+   g_state = (uint8_t*)calloc(1, g_state_size);
+   g_hash_log = (uint64_t*)calloc(g_frames, sizeof(*g_hash_log));
+   if (!g_state || !g_hash_log)
+      return false;
+
+   g_corrupt = g_client == 1 && g_corrupt_frame >= 0;
+
+   struct retro_callbacks cbs = { video_frame, audio_sample, audio_sample_batch, input_state };
+   netplay_t *netplay = netplay_new(host ? NULL : "127.0.0.1", port, g_sync_frames, g_players,
+         &cbs, false, 0, name);
+   if (!netplay)
+   {
+      fprintf(stderr, "[%s]: Failed to start netplay.\n", name);
+      return false;
+   }
+
+   g_extern.netplay = netplay;
+
+   int lost_frame = -1;
+   rarch_time_t start = rarch_get_time_usec();
+   for (g_self_frame = 0; g_self_frame < g_frames; g_self_frame++)
+   {
+      rarch_time_t wait = start + (rarch_time_t)g_self_frame * FRAME_USEC - rarch_get_time_usec();
+      if (wait > 0)
+         usleep(wait);
+
+      netplay_pre_frame(netplay);
+      pretro_run();
+      netplay_post_frame(netplay);
+
+      struct netplay_stats stats;
+      netplay_get_stats(netplay, &stats);
+      if (!stats.connected && lost_frame < 0)
+         lost_frame = g_self_frame;
+   }
+
+   struct netplay_stats stats;
+   netplay_get_stats(netplay, &stats);
+
+   // Let the other side catch up before hanging up on it.
+   usleep(500000);
+   netplay_free(netplay);
+
+   fprintf(stderr, "[%s]: %u frames in %.1f s. %.2f rollbacks/s replaying %.1f frames/s (%.2f ms per rollback). %.1f states saved/s.\n",
+         name, stats.frames, stats.seconds,
+         stats.rollbacks / stats.seconds, stats.replayed_frames / stats.seconds,
+         stats.rollbacks ? stats.rollback_ms / stats.rollbacks : 0.0f,
+         stats.states_saved / stats.seconds);
+   fprintf(stderr, "[%s]: Stalled %u times for %.2f s, resent input %u times.\n",
+         name, stats.stalls, stats.stall_ms / 1000.0f, stats.resends);
+   fprintf(stderr, "[%s]: Input delay %u frame(s), RTT %.1f ms, %.1f%% loss, %.1f input frames per packet.\n",
+         name, stats.input_delay, stats.rtt_ms, stats.loss * 100.0f, stats.inputs_per_packet);
+   fprintf(stderr, "[%s]: %u state checksums, %.3f ms each (%.3f%% of frame time), %u desyncs, %u resyncs.\n",
+         name, stats.checksums, stats.checksums ? stats.checksum_ms / stats.checksums : 0.0f,
+         stats.checksum_load * 100.0f, stats.desyncs, stats.resyncs);
+   fprintf(stderr, "[%s]: %u players, %.0f bytes sent and %.0f received per frame, %.1f us per frame on packets.\n",
+         name, stats.players, (float)stats.bytes_sent / stats.frames, (float)stats.bytes_received / stats.frames,
+         stats.packet_ms * 1000.0f / stats.frames);
+
+   if (lost_frame >= 0)
+   {
+      fprintf(stderr, "[%s]: Connection lost at frame %d (%.2f s).\n",
+            name, lost_frame, lost_frame / 60.0f);
+      return false;
+   }
+
+   return true;
+}
+
+// Compares our states with a client's, which it sends over pipe_fd.
+static bool check_desync(unsigned client, int pipe_fd)
+{
+   uint64_t *client_log = (uint64_t*)calloc(g_frames, sizeof(*client_log));
+   if (!client_log)
+      return false;
+
+   size_t size = g_frames * sizeof(*client_log);
+   uint8_t *ptr = (uint8_t*)client_log;
+   while (size)
+   {
+      ssize_t ret = read(pipe_fd, ptr, size);
+      if (ret <= 0)
+         break;
+      ptr += ret;
+      size -= ret;
+   }
+
+   bool ok = !size;
+   if (!ok)
+      fprintf(stderr, "[Netplay]: Didn't get the states of client %u.\n", client);
+
+   // The last few frames might still be running on predicted input, don't check those.
+   unsigned checked = g_frames > g_sync_frames + 16 ? g_frames - (g_sync_frames + 16) : 0;
+   int first_desync = -1, last_desync = -1;
+   for (unsigned i = 0; ok && i < checked; i++)
+   {
+      if (g_hash_log[i] != client_log[i])
+      {
+         if (first_desync < 0)
+            first_desync = i;
+         last_desync = i;
+      }
+   }
+
+   if (first_desync < 0)
+      fprintf(stderr, "[Netplay]: No desync with client %u in %u frames.\n", client, checked);
+   else
+   {
+      fprintf(stderr, "[Netplay]: Desync with client %u at frame %d (%.2f s).\n",
+            client, first_desync, first_desync / 60.0f);
+
+      // A forced desync is fine, as long as netplay got us back in sync.
+      if (client == 1 && first_desync == g_corrupt_frame && last_desync + 1 < (int)checked)
+         fprintf(stderr, "[Netplay]: Back in sync with client %u from frame %d (%.2f s).\n",
+               client, last_desync + 1, (last_desync + 1) / 60.0f);
+      else
+         ok = false;
+   }
+
+   free(client_log);
+   return ok;
+}
+
+static void print_proxy_stats(netplay_proxy_t *proxy)
+{
+   struct netplay_proxy_stats stats;
+   netplay_proxy_get_stats(proxy, &stats);
+   fprintf(stderr, "[Proxy]: %lu UDP packets, %lu dropped, %lu reordered. %lu TCP bytes.\n",
+         stats.udp_packets, stats.udp_dropped, stats.udp_reordered, stats.tcp_bytes);
+}
+
+static int run_proxy(void)
+{
+   char host[256];
+   unsigned host_port = 0;
+   if (sscanf(g_proxy_target, "%255[^:]:%u", host, &host_port) != 2 || !host_port)
+   {
+      fprintf(stderr, "Wrong format for --proxy, use HOST:PORT.\n");
+      return 1;
+   }
+
+   netplay_proxy_t *proxy = netplay_proxy_new(g_port, host, host_port, &g_impairment);
+   if (!proxy)
+      return 1;
+
+   fprintf(stderr, "[Proxy]: Forwarding port %hu to %s:%u.\n", (unsigned short)g_port, host, host_port);
+
+   struct netplay_proxy_stats stats;
+   for (unsigned i = 1; ; i++)
+   {
+      usleep(100000);
+      netplay_proxy_get_stats(proxy, &stats);
+      if (stats.finished)
+         break;
+      if (stats.connected && i % 50 == 0)
+         print_proxy_stats(proxy);
+   }
+
+   print_proxy_stats(proxy);
+   netplay_proxy_free(proxy);
+   return 0;
+}
+
+int main(int argc, char *argv[])
+{
+   parse_input(argc, argv);
+
+   g_extern.system.info.library_name = "netplay-test";
+   g_extern.system.info.library_version = "1";
+   g_settings.input.netplay_max_input_delay = g_max_input_delay;
+
+   if (!netplay_init_network())
+      return 1;
+
+   if (g_proxy_target)
+      return run_proxy();
+
+   // Each client gets its own proxy, so each link is impaired on its own.
+   unsigned clients = g_players - 1;
+   pid_t pids[MAX_PLAYERS] = {0};
+   int pipe_fds[MAX_PLAYERS];
+   netplay_proxy_t *proxies[MAX_PLAYERS] = {NULL};
+   bool ok = true;
+
+   for (unsigned i = 0; i < clients; i++)
+   {
+      int fds[2];
+      if (pipe(fds) < 0)
+         return 1;
+
+      pids[i] = fork();
+      if (pids[i] < 0)
+         return 1;
+
+      if (pids[i] == 0)
+      {
+         close(fds[0]);
+
+         // Give the host and proxies a moment to start listening, and connect in order.
+         usleep(250000 + i * 50000);
+         g_client = i + 1;
+         ok = run_session(false, g_port + 1 + i);
+         if (g_hash_log)
+            write(fds[1], g_hash_log, g_frames * sizeof(*g_hash_log));
+         exit(ok ? 0 : 1);
+      }
+
+      close(fds[1]);
+      pipe_fds[i] = fds[0];
+   }
+
+   for (unsigned i = 0; i < clients && ok; i++)
+   {
+      proxies[i] = netplay_proxy_new(g_port + 1 + i, "127.0.0.1", g_port, &g_impairment);
+      ok = proxies[i];
+   }
+
+   if (!ok)
+   {
+      for (unsigned i = 0; i < clients; i++)
+      {
+         kill(pids[i], SIGKILL);
+         if (proxies[i])
+            netplay_proxy_free(proxies[i]);
+      }
+      return 1;
+   }
+
+   ok = run_session(true, g_port);
+   for (unsigned i = 0; i < clients; i++)
+      ok = check_desync(i + 1, pipe_fds[i]) && ok;
+
+   for (unsigned i = 0; i < clients; i++)
+   {
+      int status = 0;
+      waitpid(pids[i], &status, 0);
+      ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+      print_proxy_stats(proxies[i]);
+      netplay_proxy_free(proxies[i]);
+   }
+
+   return ok ? 0 : 1;
+}
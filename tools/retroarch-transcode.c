@@ -0,0 +1,195 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2013 - Hans-Kristian Arntzen
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Encodes a lossless raw capture (.rcap) into a regular video file, with the same
+// FFmpeg recording backend (and recording config) RetroArch uses when recording live.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../compat/getopt_rarch.h"
+#include "../boolean.h"
+#include "../general.h"
+#include "../performance.h"
+#include "../record/ffemu.h"
+#include "../record/rawcap.h"
+
+// Need to be present for build to work, but it's not *really* used.
+struct settings g_settings;
+struct global g_extern;
+
+static char *g_config_path = NULL;
+static unsigned g_out_width = 0;
+static unsigned g_out_height = 0;
+
+static void print_help(void)
+{
+   puts("======================");
+   puts(" retroarch-transcode");
+   puts("======================");
+   puts("Usage: retroarch-transcode [ options ... ] capture.rcap output");
+   puts("");
+   puts("Encodes a raw capture, recorded with retroarch --record capture.rcap, to a regular video file.");
+   puts("Output format is guessed from the extension of output. Using .mkv extension is recommended.");
+   puts("");
+   puts("-c/--recordconfig: Path to settings used for encoding, same as retroarch --recordconfig.");
+   puts("-s/--size: Output video size (format: WIDTHxHEIGHT). Defaults to the size used while recording.");
+   puts("-v/--verbose: Verbose logging.");
+   puts("-h/--help: This help.");
+}
+
+static void parse_input(int argc, char *argv[])
+{
+   char optstring[] = "c:s:vh";
+   struct option opts[] = {
+      { "recordconfig", 1, NULL, 'c' },
+      { "size", 1, NULL, 's' },
+      { "verbose", 0, NULL, 'v' },
+      { "help", 0, NULL, 'h' },
+      { NULL, 0, NULL, 0 }
+   };
+
+   int option_index = 0;
+   for (;;)
+   {
+      int c = getopt_long(argc, argv, optstring, opts, &option_index);
+      if (c == -1)
+         break;
+
+      switch (c)
+      {
+         case 'h':
+            print_help();
+            exit(0);
+
+         case 'c':
+            g_config_path = strdup(optarg);
+            break;
+
+         case 's':
+            if (sscanf(optarg, "%ux%u", &g_out_width, &g_out_height) != 2 || !g_out_width || !g_out_height)
+            {
+               fprintf(stderr, "Wrong format for --size.\n");
+               print_help();
+               exit(1);
+            }
+            break;
+
+         case 'v':
+            g_extern.verbose = true;
+            break;
+
+         default:
+            print_help();
+            exit(1);
+      }
+   }
+
+   if (argc - optind != 2)
+   {
+      print_help();
+      exit(1);
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   parse_input(argc, argv);
+
+   const char *in_path  = argv[optind];
+   const char *out_path = argv[optind + 1];
+
+   rawcap_reader_t *reader = rawcap_reader_new(in_path);
+   if (!reader)
+   {
+      fprintf(stderr, "Couldn't open raw capture %s.\n", in_path);
+      return 1;
+   }
+
+   const struct rawcap_header *header = rawcap_reader_header(reader);
+
+   struct ffemu_params params = {0};
+   params.fps          = header->fps;
+   params.samplerate   = header->samplerate;
+   params.out_width    = g_out_width ? g_out_width : header->out_width;
+   params.out_height   = g_out_height ? g_out_height : header->out_height;
+   params.fb_width     = header->fb_width;
+   params.fb_height    = header->fb_height;
+   params.aspect_ratio = header->aspect_ratio;
+   params.channels     = header->channels;
+   params.pix_fmt      = (enum ffemu_pix_format)header->pix_fmt;
+   params.filename     = out_path;
+   params.config       = g_config_path;
+
+   ffemu_t *rec = ffemu_new(&params);
+   if (!rec)
+   {
+      fprintf(stderr, "Failed to start encoding to %s.\n", out_path);
+      rawcap_reader_free(reader);
+      return 1;
+   }
+
+   fprintf(stderr, "Transcoding %s to %s @ %ux%u, %.4f FPS.\n",
+         in_path, out_path, params.out_width, params.out_height, params.fps);
+
+   rarch_time_t start = rarch_get_time_usec();
+   uint64_t frames = 0;
+
+   // The recorder blocks while its queues are full, so this runs as fast as the encoder does.
+   struct rawcap_packet pkt;
+   while (rawcap_reader_next(reader, &pkt))
+   {
+      if (pkt.type == RAWCAP_CHUNK_AUDIO)
+      {
+         struct ffemu_audio_data audio = {0};
+         audio.data   = pkt.data;
+         audio.frames = pkt.audio_frames;
+         ffemu_push_audio(rec, &audio);
+      }
+      else
+      {
+         struct ffemu_video_data video = {0};
+         video.data    = pkt.data;
+         video.width   = pkt.width;
+         video.height  = pkt.height;
+         video.pitch   = pkt.pitch;
+         video.is_dupe = pkt.type == RAWCAP_CHUNK_DUPE;
+         ffemu_push_video(rec, &video);
+         frames++;
+      }
+   }
+
+   bool finished = rawcap_reader_finished(reader);
+   if (!finished)
+      fprintf(stderr, "%s is truncated or damaged, encoding what could be read.\n", in_path);
+
+   double duration = header->fps > 0.0 ? frames / header->fps : 0.0;
+
+   ffemu_finalize(rec);
+   ffemu_free(rec);
+   rawcap_reader_free(reader);
+
+   double secs = (rarch_get_time_usec() - start) / 1000000.0;
+   fprintf(stderr, "Transcoded %llu frames in %.1f s (%.2fx realtime).\n",
+         (unsigned long long)frames, secs, secs > 0.0 ? duration / secs : 0.0);
+
+   free(g_config_path);
+   return finished ? 0 : 2;
+}
+